@@ -34,6 +34,8 @@
 #include "highlevel/bidib_highlevel_getter.h"
 #include "highlevel/bidib_highlevel_setter.h"
 #include "highlevel/bidib_highlevel_util.h"
+#include "highlevel/bidib_highlevel_export.h"
+#include "highlevel/bidib_highlevel_server.h"
 
 // Lowlevel send functions
 #include "lowlevel/bidib_lowlevel_system.h"
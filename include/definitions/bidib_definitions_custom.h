@@ -211,6 +211,8 @@ typedef struct {
 typedef struct {
 	bool available;
 	t_bidib_peripheral_state_data data;
+	uint64_t received_ns; /**< CLOCK_MONOTONIC time in ns at which the packet that last
+	                       * updated the state was received, 0 if none did */
 } t_bidib_peripheral_state_query;
 
 typedef enum {
@@ -232,6 +234,8 @@ typedef struct {
 typedef struct {
 	bool available;
 	t_bidib_reverser_state_data data;
+	uint64_t received_ns; /**< CLOCK_MONOTONIC time in ns at which the packet that last
+	                       * updated the state was received, 0 if none did */
 } t_bidib_reverser_state_query;
 
 typedef enum {
@@ -270,8 +274,15 @@ typedef struct {
 typedef struct {
 	bool known;
 	t_bidib_segment_state_data data;
+	uint64_t received_ns; /**< CLOCK_MONOTONIC time in ns at which the packet that last
+	                       * updated the state was received, 0 if none did */
 } t_bidib_segment_state_query;
 
+typedef struct {
+	size_t length;
+	t_bidib_segment_state_query *states;
+} t_bidib_segment_state_list_query;
+
 typedef struct {
 	char *id;
 	uint8_t state;
@@ -320,8 +331,15 @@ typedef struct {
 typedef struct {
 	bool known;
 	t_bidib_train_state_data data;
+	uint64_t received_ns; /**< CLOCK_MONOTONIC time in ns at which the packet that last
+	                       * updated the state was received, 0 if none did */
 } t_bidib_train_state_query;
 
+typedef struct {
+	size_t length;
+	t_bidib_train_state_query *states;
+} t_bidib_train_state_list_query;
+
 typedef enum {
 	BIDIB_BSTR_OFF = BIDIB_BST_STATE_OFF,
 	BIDIB_BSTR_OFF_SHORT = BIDIB_BST_STATE_OFF_SHORT,
@@ -361,6 +379,8 @@ typedef struct {
 typedef struct {
 	bool known;
 	t_bidib_booster_state_data data;
+	uint64_t received_ns; /**< CLOCK_MONOTONIC time in ns at which the packet that last
+	                       * updated the state was received, 0 if none did */
 } t_bidib_booster_state_query;
 
 typedef enum {
@@ -383,6 +403,8 @@ typedef struct {
 typedef struct {
 	bool known;
 	t_bidib_cs_state cs_state;
+	uint64_t received_ns; /**< CLOCK_MONOTONIC time in ns at which the packet that last
+	                       * updated the state was received, 0 if none did */
 } t_bidib_track_output_state_query;
 
 typedef struct {
@@ -406,8 +428,27 @@ typedef struct {
 	t_bidib_booster_state *booster;
 	size_t track_outputs_count;
 	t_bidib_track_output_state *track_outputs;
+	void *block; /**< Holds all arrays and strings, NULL if the caller provided it */
 } t_bidib_track_state;
 
+typedef struct {
+	uint64_t version;
+	t_bidib_track_state state;
+} t_bidib_track_state_snapshot;
+
+typedef struct {
+	uint64_t seq;
+	t_bidib_track_state state;
+} t_bidib_track_state_changes;
+
+#define BIDIB_BOARD_OCCUPANCY_WORDS 4
+
+// Bit n % 64 of occupied[n / 64] is set if the segment with BM number n is occupied
+typedef struct {
+	bool known;
+	uint64_t occupied[BIDIB_BOARD_OCCUPANCY_WORDS];
+} t_bidib_board_occupancy_query;
+
 typedef enum {
 	BIDIB_ACCESSORY_BOARD,
 	BIDIB_ACCESSORY_DCC
@@ -420,8 +461,27 @@ typedef struct {
 		t_bidib_board_accessory_state_data board_accessory_state;
 		t_bidib_dcc_accessory_state_data dcc_accessory_state;
 	};
+	uint64_t received_ns; /**< CLOCK_MONOTONIC time in ns at which the packet that last
+	                       * updated the state was received, 0 if none did */
 } t_bidib_unified_accessory_state_query;
 
+typedef struct {
+	size_t length;
+	t_bidib_unified_accessory_state_query *states;
+} t_bidib_unified_accessory_state_list_query;
+
+// Visitors are called with the id and the current state of an entity while its
+// state is locked. The id lives as long as the loaded config, all other
+// pointers only until the visitor returns.
+typedef void (*t_bidib_accessory_state_visitor)(
+		const char *id, const t_bidib_unified_accessory_state_query *state, void *ctx);
+typedef void (*t_bidib_peripheral_state_visitor)(
+		const char *id, const t_bidib_peripheral_state_data *data, void *ctx);
+typedef void (*t_bidib_segment_state_visitor)(
+		const char *id, const t_bidib_segment_state_data *data, void *ctx);
+typedef void (*t_bidib_train_state_visitor)(
+		const char *id, const t_bidib_train_state_data *data, void *ctx);
+
 typedef struct {
 	bool known;
 	char *id;
@@ -432,6 +492,11 @@ typedef struct {
 	char **ids;
 } t_bidib_id_list_query;
 
+typedef struct {
+	size_t length;
+	const char *const *ids;
+} t_bidib_id_ref_list_query;
+
 typedef struct {
 	uint8_t number;
 	uint8_t value;
@@ -448,6 +513,12 @@ typedef struct {
 	bool orientation_is_left;
 } t_bidib_train_position_query;
 
+typedef struct {
+	size_t length;
+	char **trains;
+	t_bidib_train_position_query *positions;
+} t_bidib_train_position_list_query;
+
 typedef struct {
 	bool known_and_avail;
 	int speed_step;
@@ -469,5 +540,77 @@ typedef struct {
 	t_bidib_unique_id_mod *unique_ids;
 } t_bidib_unique_id_list_query;
 
+typedef enum {
+	BIDIB_MSG_CLASS_DRIVE,     /**< MSG_CS_DRIVE */
+	BIDIB_MSG_CLASS_ACCESSORY, /**< MSG_ACCESSORY_SET and MSG_CS_ACCESSORY */
+	BIDIB_MSG_CLASS_LC_OUTPUT, /**< MSG_LC_OUTPUT */
+	BIDIB_MSG_CLASS_FEATURE,   /**< MSG_FEATURE_* */
+	BIDIB_MSG_CLASS_COUNT
+} t_bidib_message_class;
+
+typedef struct {
+	unsigned int dropped[BIDIB_MSG_CLASS_COUNT]; /**< expired messages per message class */
+} t_bidib_message_drop_counters;
+
+typedef struct {
+	bool known;                        /**< false if no message was exchanged with the node yet */
+	bool stall;
+	int current_response_bytes;        /**< bytes of responses the node still owes */
+	int max_response_bytes;            /**< limit for current_response_bytes */
+	unsigned int response_queue_length;
+	unsigned int message_queue_length; /**< messages waiting to be sent */
+	unsigned int dequeued_count;       /**< messages that were sent after waiting in the queue */
+	uint64_t total_queue_wait_us;      /**< summed wait of the dequeued messages, for the average */
+	uint64_t max_queue_wait_us;
+	unsigned int expired_count;        /**< queued messages dropped because of their time-to-live */
+	unsigned int rejected_count;       /**< messages rejected because the queue was full */
+	unsigned int coalesced_count;      /**< messages that replaced a queued one because the queue was full */
+} t_bidib_node_tx_status_query;
+
+typedef enum {
+	BIDIB_MEMORY_RECEIVED_MESSAGES, /**< received messages that are being handled */
+	BIDIB_MEMORY_UPLINK_QUEUES,     /**< messages waiting to be read by the application */
+	BIDIB_MEMORY_NODE_STATES,       /**< per-node transmission states */
+	BIDIB_MEMORY_MESSAGE_QUEUES,    /**< messages waiting to be sent to a node */
+	BIDIB_MEMORY_RESPONSE_QUEUES,   /**< responses expected from a node */
+	BIDIB_MEMORY_STALL_ENTRIES,     /**< nodes waiting for a stalled super-node */
+	BIDIB_MEMORY_TRACK_STATE,       /**< track state and its change stamps */
+	BIDIB_MEMORY_CONFIG,            /**< config data, i.e. ids, mappings and aspect tables */
+	BIDIB_MEMORY_INDEXES,           /**< lookup tables by id, node and DCC address */
+	BIDIB_MEMORY_SNAPSHOTS,         /**< published track state snapshots */
+	BIDIB_MEMORY_SUBSYSTEM_COUNT
+} t_bidib_memory_subsystem;
+
+typedef struct {
+	size_t bytes;
+	size_t objects;
+	size_t max_bytes;   /**< high-water mark of bytes */
+	size_t max_objects; /**< high-water mark of objects */
+} t_bidib_memory_usage;
+
+typedef struct {
+	t_bidib_memory_usage subsystems[BIDIB_MEMORY_SUBSYSTEM_COUNT];
+	size_t total_bytes; /**< sum of bytes over all subsystems */
+} t_bidib_memory_stats;
+
+typedef enum {
+	BIDIB_ROUTE_ELEMENT_POINT,
+	BIDIB_ROUTE_ELEMENT_SIGNAL,
+	BIDIB_ROUTE_ELEMENT_PERIPHERAL
+} t_bidib_route_element_type;
+
+typedef struct {
+	t_bidib_route_element_type type;
+	const char *id;
+	const char *aspect;
+} t_bidib_route_element;
+
+typedef enum {
+	BIDIB_ROUTE_UNKNOWN,  /**< the route handle is invalid or was freed */
+	BIDIB_ROUTE_PENDING,  /**< some elements did not report their final state yet */
+	BIDIB_ROUTE_COMPLETE, /**< all elements reported their aspect as reached */
+	BIDIB_ROUTE_FAILED    /**< an element reported an error or its message was rejected */
+} t_bidib_route_status;
+
 
 #endif
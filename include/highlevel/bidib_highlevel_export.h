@@ -0,0 +1,180 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#ifndef BIDIB_HIGHLEVEL_EXPORT_H
+#define BIDIB_HIGHLEVEL_EXPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Layout of the shared memory state export. The segment starts with the header,
+// followed by the id table and the image. The id table holds the offsets (uint32_t,
+// relative to the start of the segment) of the ids of the segments, points,
+// signals, trains and boosters, in this order, which do not change while the
+// segment exists. The image holds the state and is rewritten under the seqlock:
+// seq is odd while the image is written, and a copy of the image is consistent
+// if seq was even and unchanged before and after the copy.
+
+// "BIDIBSX1" read as a little endian number
+#define BIDIB_EXPORT_MAGIC 0x3158534249444942ULL
+#define BIDIB_EXPORT_VERSION 1
+
+typedef struct {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t size;           /**< Size of the whole segment */
+	uint32_t segment_count;
+	uint32_t point_count;
+	uint32_t signal_count;
+	uint32_t train_count;
+	uint32_t booster_count;
+	uint32_t ids_offset;
+	uint32_t image_offset;
+	uint32_t image_size;
+	uint64_t seq;            /**< Seqlock, only to be accessed atomically */
+} t_bidib_export_header;
+
+typedef struct {
+	int16_t aspect;          /**< Position of the aspect in the config, -1 if unknown */
+	uint8_t execution_state; /**< t_bidib_accessory_execution_state, 0xFF for DCC accessories */
+	uint8_t reserved;
+} t_bidib_export_accessory;
+
+typedef struct {
+	uint8_t on_track;
+	uint8_t is_forwards;
+	uint8_t orientation_is_left;
+	uint8_t segment_cnt;     /**< Number of segments that detect the train */
+	int16_t speed_step;
+	int16_t speed_kmh;       /**< -1 means unknown speed */
+	int32_t segment;         /**< Position of the first segment that detects the train, or -1 */
+} t_bidib_export_train;
+
+typedef struct {
+	uint8_t power_state;     /**< t_bidib_booster_power_state */
+	uint8_t power_state_simple;
+	uint8_t current_known;
+	uint8_t overcurrent;
+	uint16_t current;        /**< in mA */
+	uint8_t voltage_known;
+	uint8_t voltage;         /**< in 100 mV */
+	uint8_t temp_known;
+	int8_t temp_celsius;
+	uint16_t reserved;
+} t_bidib_export_booster;
+
+// The image: the change sequence number of the state it reflects, followed by
+// uint64_t occupied[(segment_count + 63) / 64], one bit per segment,
+// t_bidib_export_accessory points[point_count], signals[signal_count],
+// t_bidib_export_train trains[train_count] and
+// t_bidib_export_booster boosters[booster_count].
+typedef struct {
+	uint64_t change_seq;
+	const uint64_t *occupied;
+	const t_bidib_export_accessory *points;
+	const t_bidib_export_accessory *signals;
+	const t_bidib_export_train *trains;
+	const t_bidib_export_booster *boosters;
+} t_bidib_export_image;
+
+typedef enum {
+	BIDIB_EXPORT_SEGMENTS,
+	BIDIB_EXPORT_POINTS,
+	BIDIB_EXPORT_SIGNALS,
+	BIDIB_EXPORT_TRAINS,
+	BIDIB_EXPORT_BOOSTERS
+} t_bidib_export_kind;
+
+typedef struct t_bidib_export_reader t_bidib_export_reader;
+
+
+/**
+ * Maps a shared memory state export for reading. The reader functions do not
+ * need the rest of the library, they are also available on their own in the
+ * bidib_export_reader library.
+ *
+ * @param name the name of the shared memory object, as passed to
+ * bidib_set_state_export.
+ * @return the reader, or NULL if the export does not exist or is incompatible.
+ * Must be closed by the caller.
+ */
+t_bidib_export_reader *bidib_export_open(const char *name);
+
+/**
+ * Returns the header of an export, e.g. for the number of entries.
+ *
+ * @param reader the reader.
+ * @return the header.
+ */
+const t_bidib_export_header *bidib_export_header(const t_bidib_export_reader *reader);
+
+/**
+ * Returns the id of an entry of an export.
+ *
+ * @param reader the reader.
+ * @param kind the kind of the entry.
+ * @param position the position of the entry, as in the image.
+ * @return the id, or NULL if there is no such entry.
+ */
+const char *bidib_export_id(const t_bidib_export_reader *reader, t_bidib_export_kind kind,
+                            size_t position);
+
+/**
+ * Copies a consistent image of the track state without any system call. The
+ * image stays valid until the next read or until the reader is closed.
+ *
+ * @param reader the reader.
+ * @param image the image that is filled.
+ * @return true if successful, false if the library closed the export or stopped
+ * while writing it.
+ */
+bool bidib_export_read(t_bidib_export_reader *reader, t_bidib_export_image *image);
+
+/**
+ * Locates the parts of an image, e.g. of a copy that a logger stored.
+ *
+ * @param header the header of the export.
+ * @param data the image, aligned to 8 bytes. NULL to only compute the size.
+ * @param image the image that is filled, may be NULL if data is NULL.
+ * @return the size of the image.
+ */
+size_t bidib_export_locate(const t_bidib_export_header *header, const void *data,
+                           t_bidib_export_image *image);
+
+/**
+ * Unmaps an export and frees the reader.
+ *
+ * @param reader the reader.
+ */
+void bidib_export_close(t_bidib_export_reader *reader);
+
+
+#endif
@@ -33,12 +33,107 @@
 
 
 /**
- * Returns the overall state of the track.
+ * Returns the overall state of the track. All arrays and strings of the state
+ * are placed in one allocation.
  *
  * @return the overall state of the track. Must be freed by the caller.
  */
 t_bidib_track_state bidib_get_state(void);
 
+/**
+ * Returns the size of the buffer that bidib_get_state_buf needs for the current
+ * state of the track. The size changes with the state ids and the detected dcc
+ * addresses, so a buffer with some room to spare is less likely to be too small.
+ *
+ * @return the size in bytes.
+ */
+size_t bidib_get_state_size(void);
+
+/**
+ * Copies the overall state of the track into a caller-provided buffer. All
+ * arrays and strings of the state are placed in the buffer and nothing is
+ * allocated, so the buffer can be reused across calls.
+ *
+ * @param state the state that is filled, its arrays point into the buffer. Must
+ * not be used after the buffer is reused or freed. bidib_free_track_state does
+ * nothing for it.
+ * @param buffer the buffer, aligned like memory returned by malloc.
+ * @param size the size of the buffer.
+ * @param required the size the state needs (out-parameter, may be NULL).
+ * @return true if the state fit into the buffer, otherwise false and the state
+ * must not be used.
+ */
+bool bidib_get_state_buf(t_bidib_track_state *state, void *buffer, size_t size,
+                         size_t *required);
+
+/**
+ * Returns the latest published snapshot of the overall state of the track.
+ * A new snapshot is published after each batch of state updates; snapshots are
+ * immutable and their version increases with every publication. Does not block,
+ * not even while the state is being updated.
+ *
+ * @return NULL if the library is not running, otherwise the snapshot. Must be
+ * released with bidib_release_state_snapshot and must not be freed otherwise.
+ */
+const t_bidib_track_state_snapshot *bidib_acquire_state_snapshot(void);
+
+/**
+ * Releases a snapshot acquired with bidib_acquire_state_snapshot. The snapshot
+ * must not be accessed afterwards.
+ *
+ * @param snapshot the snapshot, may be NULL.
+ */
+void bidib_release_state_snapshot(const t_bidib_track_state_snapshot *snapshot);
+
+/**
+ * Returns the points, signals, peripherals, segments, reversers, trains,
+ * boosters and track outputs that changed after a change sequence number.
+ * Every change of an entity stamps it with a new, globally increasing change
+ * sequence number. An entity that changed several times is only returned once.
+ *
+ * @param seq the change sequence number returned by the previous call, 0 to
+ * get all entities.
+ * @return the changed entities and the change sequence number to pass to the
+ * next call. Must be freed by the caller.
+ */
+t_bidib_track_state_changes bidib_get_changes_since(uint64_t seq);
+
+/**
+ * Blocks until any point, signal, peripheral, segment, reverser, train, booster
+ * or track output changed after a change sequence number.
+ *
+ * @param seq the change sequence number, e.g. returned by bidib_get_changes_since.
+ * @param timeout_ms the maximum time to wait in milliseconds.
+ * @return the current change sequence number. Equal to seq if nothing changed
+ * before the timeout or the library was stopped.
+ */
+uint64_t bidib_wait_for_changes(uint64_t seq, unsigned int timeout_ms);
+
+/**
+ * Blocks until a train is detected on a segment. Wakes up as soon as the state
+ * was updated, instead of polling the segment state.
+ *
+ * @param segment the id of the segment.
+ * @param train the id of the train.
+ * @param timeout_ms the maximum time to wait in milliseconds.
+ * @return true if the train is detected on the segment, false if the timeout
+ * expired, the library was stopped or the segment or train does not exist.
+ */
+bool bidib_wait_segment_has_train(const char *segment, const char *train,
+                                  unsigned int timeout_ms);
+
+/**
+ * Blocks until a point is in an aspect. Wakes up as soon as the state was
+ * updated, instead of polling the point state.
+ *
+ * @param point the id of the point.
+ * @param aspect the id of the aspect.
+ * @param timeout_ms the maximum time to wait in milliseconds.
+ * @return true if the point is in the aspect, false if the timeout expired,
+ * the library was stopped or the point does not exist.
+ */
+bool bidib_wait_point_state(const char *point, const char *aspect, unsigned int timeout_ms);
+
 /**
  * Returns the index of a point within the bidib_track_state.points_board array.
  *
@@ -68,6 +163,45 @@ size_t bidib_get_segment_state_index(const char *segment);
  */
 t_bidib_unified_accessory_state_query bidib_get_point_state(const char *point);
 
+/**
+ * Calls a visitor with the current state of a point, without copying it. The
+ * state of the points and signals stays locked while the visitor runs, so the
+ * visitor must be short and must not call other functions of the library.
+ *
+ * @param point the id of the point.
+ * @param visitor the visitor.
+ * @param ctx passed to the visitor.
+ * @return true if the point exists and the visitor was called, otherwise false.
+ */
+bool bidib_visit_point_state(const char *point, t_bidib_accessory_state_visitor visitor,
+                             void *ctx);
+
+/**
+ * Fills a caller-provided query with the current state of a point. Nothing is
+ * allocated, the state id is copied into the given buffer and truncated if
+ * it is too long.
+ *
+ * @param point the id of the point.
+ * @param query the query that is filled, its state id points to state_id.
+ * @param state_id the buffer for the state id, may be NULL.
+ * @param state_id_size the size of the state id buffer.
+ * @return true if the point exists, otherwise false.
+ */
+bool bidib_get_point_state_buf(const char *point, t_bidib_unified_accessory_state_query *query,
+                               char *state_id, size_t state_id_size);
+
+/**
+ * Returns the current states of several points. The state of the points and
+ * signals is locked once for all of them.
+ *
+ * @param points the ids of the points.
+ * @param count the number of ids.
+ * @return the states in the order of the ids, unknown points are marked as
+ * such. Must be freed by the caller.
+ */
+t_bidib_unified_accessory_state_list_query bidib_get_point_states(const char *const *points,
+                                                                  size_t count);
+
 /**
  * Returns the current state of a signal.
  *
@@ -76,6 +210,45 @@ t_bidib_unified_accessory_state_query bidib_get_point_state(const char *point);
  */
 t_bidib_unified_accessory_state_query bidib_get_signal_state(const char *signal);
 
+/**
+ * Calls a visitor with the current state of a signal, without copying it. The
+ * state of the points and signals stays locked while the visitor runs, so the
+ * visitor must be short and must not call other functions of the library.
+ *
+ * @param signal the id of the signal.
+ * @param visitor the visitor.
+ * @param ctx passed to the visitor.
+ * @return true if the signal exists and the visitor was called, otherwise false.
+ */
+bool bidib_visit_signal_state(const char *signal, t_bidib_accessory_state_visitor visitor,
+                              void *ctx);
+
+/**
+ * Fills a caller-provided query with the current state of a signal. Nothing is
+ * allocated, the state id is copied into the given buffer and truncated if
+ * it is too long.
+ *
+ * @param signal the id of the signal.
+ * @param query the query that is filled, its state id points to state_id.
+ * @param state_id the buffer for the state id, may be NULL.
+ * @param state_id_size the size of the state id buffer.
+ * @return true if the signal exists, otherwise false.
+ */
+bool bidib_get_signal_state_buf(const char *signal, t_bidib_unified_accessory_state_query *query,
+                                char *state_id, size_t state_id_size);
+
+/**
+ * Returns the current states of several signals. The state of the points and
+ * signals is locked once for all of them.
+ *
+ * @param signals the ids of the signals.
+ * @param count the number of ids.
+ * @return the states in the order of the ids, unknown signals are marked as
+ * such. Must be freed by the caller.
+ */
+t_bidib_unified_accessory_state_list_query bidib_get_signal_states(const char *const *signals,
+                                                                   size_t count);
+
 /**
  * Returns the current state of a peripheral (e.g. light).
  *
@@ -84,6 +257,33 @@ t_bidib_unified_accessory_state_query bidib_get_signal_state(const char *signal)
  */
 t_bidib_peripheral_state_query bidib_get_peripheral_state(const char *peripheral);
 
+/**
+ * Calls a visitor with the current state of a peripheral, without copying it.
+ * The state of the peripherals stays locked while the visitor runs, so the
+ * visitor must be short and must not call other functions of the library.
+ *
+ * @param peripheral the id of the peripheral.
+ * @param visitor the visitor.
+ * @param ctx passed to the visitor.
+ * @return true if the peripheral exists and the visitor was called, otherwise false.
+ */
+bool bidib_visit_peripheral_state(const char *peripheral,
+                                  t_bidib_peripheral_state_visitor visitor, void *ctx);
+
+/**
+ * Fills caller-provided data with the current state of a peripheral. Nothing
+ * is allocated, the state id is copied into the given buffer and truncated if
+ * it is too long.
+ *
+ * @param peripheral the id of the peripheral.
+ * @param data the data that is filled, its state id points to state_id.
+ * @param state_id the buffer for the state id, may be NULL.
+ * @param state_id_size the size of the state id buffer.
+ * @return true if the peripheral exists, otherwise false.
+ */
+bool bidib_get_peripheral_state_buf(const char *peripheral, t_bidib_peripheral_state_data *data,
+                                    char *state_id, size_t state_id_size);
+
 /**
  * Returns the occupancy state of a section.
  *
@@ -92,6 +292,45 @@ t_bidib_peripheral_state_query bidib_get_peripheral_state(const char *peripheral
  */
 t_bidib_segment_state_query bidib_get_segment_state(const char *segment);
 
+/**
+ * Calls a visitor with the current occupancy state of a section, without
+ * copying it. The state of the sections stays locked while the visitor runs,
+ * so the visitor must be short and must not call other functions of the library.
+ *
+ * @param segment the id of the section.
+ * @param visitor the visitor.
+ * @param ctx passed to the visitor.
+ * @return true if the section exists and the visitor was called, otherwise false.
+ */
+bool bidib_visit_segment_state(const char *segment, t_bidib_segment_state_visitor visitor,
+                               void *ctx);
+
+/**
+ * Fills caller-provided data with the current occupancy state of a section.
+ * Nothing is allocated. The dcc address count is the number of detected
+ * addresses; if it exceeds the capacity, only the first addresses are copied.
+ *
+ * @param segment the id of the section.
+ * @param data the data that is filled, its addresses point to dcc_addresses.
+ * @param dcc_addresses the buffer for the detected dcc addresses.
+ * @param dcc_address_capacity the number of addresses that fit into the buffer.
+ * @return true if the section exists, otherwise false.
+ */
+bool bidib_get_segment_state_buf(const char *segment, t_bidib_segment_state_data *data,
+                                 t_bidib_dcc_address *dcc_addresses, size_t dcc_address_capacity);
+
+/**
+ * Returns the current states of several segments. The segment states are
+ * locked once for all of them.
+ *
+ * @param segments the ids of the segments.
+ * @param count the number of ids.
+ * @return the states in the order of the ids, unknown segments are marked as
+ * such. Must be freed by the caller.
+ */
+t_bidib_segment_state_list_query bidib_get_segment_states(const char *const *segments,
+                                                          size_t count);
+
 /**
  * Returns the current state of a reverser.
  *
@@ -238,6 +477,31 @@ t_bidib_id_list_query bidib_get_connected_peripherals(void);
  */
 t_bidib_id_list_query bidib_get_connected_segments(void);
 
+/**
+ * Returns the occupancy of all segments of a board as a bitmap indexed by the
+ * BM numbers of the segments. The bitmap is read without waiting for updates
+ * of the track state.
+ *
+ * @param board the id of the board.
+ * @return the occupancy of the segments of the board.
+ */
+t_bidib_board_occupancy_query bidib_get_board_occupancy(const char *board);
+
+/**
+ * Returns all occupied segment ids.
+ *
+ * @return all occupied segment ids. Must be freed by the caller.
+ */
+t_bidib_id_list_query bidib_get_occupied_segments(void);
+
+/**
+ * Returns all occupied segment ids without copying them. The ids point into the
+ * configuration and stay valid until the library is stopped.
+ *
+ * @return all occupied segment ids. Must be freed by the caller.
+ */
+t_bidib_id_ref_list_query bidib_get_occupied_segments_ref(void);
+
 /**
  * Returns all connected reverser ids.
  *
@@ -303,6 +567,14 @@ t_bidib_id_list_query bidib_get_trains(void);
  */
 t_bidib_id_list_query bidib_get_trains_on_track(void);
 
+/**
+ * Returns all train ids which are on the track without copying them. The ids
+ * point into the configuration and stay valid until the library is stopped.
+ *
+ * @return all train ids which are on the track. Must be freed by the caller.
+ */
+t_bidib_id_ref_list_query bidib_get_trains_on_track_ref(void);
+
 /**
  * Returns all peripherals of a train.
  *
@@ -335,6 +607,45 @@ t_bidib_dcc_address_query bidib_get_train_dcc_addr(const char *train);
  */
 t_bidib_train_state_query bidib_get_train_state(const char *train);
 
+/**
+ * Calls a visitor with the current state of a train, without copying it. The
+ * state of the trains stays locked while the visitor runs, so the visitor must
+ * be short and must not call other functions of the library.
+ *
+ * @param train the id of the train.
+ * @param visitor the visitor.
+ * @param ctx passed to the visitor.
+ * @return true if the train exists and the visitor was called, otherwise false.
+ */
+bool bidib_visit_train_state(const char *train, t_bidib_train_state_visitor visitor, void *ctx);
+
+/**
+ * Fills caller-provided data with the current state of a train. Nothing is
+ * allocated, the ids of the peripherals live as long as the loaded config.
+ * The peripheral count is the number of peripherals of the train; if it
+ * exceeds the capacity, only the first peripherals are copied.
+ *
+ * @param train the id of the train.
+ * @param data the data that is filled, its peripherals point to peripherals.
+ * @param peripherals the buffer for the peripheral states.
+ * @param peripheral_capacity the number of peripheral states that fit into the buffer.
+ * @return true if the train exists, otherwise false.
+ */
+bool bidib_get_train_state_buf(const char *train, t_bidib_train_state_data *data,
+                               t_bidib_train_peripheral_state *peripherals,
+                               size_t peripheral_capacity);
+
+/**
+ * Returns the current states of several trains. The train states are locked
+ * once for all of them.
+ *
+ * @param trains the ids of the trains.
+ * @param count the number of ids.
+ * @return the states in the order of the ids, unknown trains are marked as
+ * such. Must be freed by the caller.
+ */
+t_bidib_train_state_list_query bidib_get_train_states(const char *const *trains, size_t count);
+
 /**
  * Returns the current state of a train peripheral.
  *
@@ -353,6 +664,14 @@ t_bidib_train_peripheral_state_query bidib_get_train_peripheral_state(const char
  */
 t_bidib_train_position_query bidib_get_train_position(const char *train);
 
+/**
+ * Returns the current positions of all trains which are on the track. The
+ * locks are acquired once for all trains.
+ *
+ * @return the train ids and their positions. Must be freed by the caller.
+ */
+t_bidib_train_position_list_query bidib_get_train_positions_all(void);
+
 /**
  * Returns the current speed step of a train.
  *
@@ -408,6 +727,13 @@ t_bidib_id_list_query bidib_get_peripheral_aspects(const char *peripheral);
  */
 void bidib_free_track_state(t_bidib_track_state track_state);
 
+/**
+ * Frees the memory allocated by the changes of a track state.
+ *
+ * @param changes the changes of the track state which values should be freed.
+ */
+void bidib_free_track_state_changes(t_bidib_track_state_changes changes);
+
 /**
  * Frees the memory allocated by an unified accessory state query.
  *
@@ -450,6 +776,13 @@ void bidib_free_id_query(t_bidib_id_query query);
  */
 void bidib_free_id_list_query(t_bidib_id_list_query query);
 
+/**
+ * Frees the memory allocated by an id reference list query.
+ *
+ * @param query the id reference list query which values should be freed.
+ */
+void bidib_free_id_ref_list_query(t_bidib_id_ref_list_query query);
+
 /**
  * Frees the memory allocated by an unique id list query.
  *
@@ -471,6 +804,35 @@ void bidib_free_board_features_query(t_bidib_board_features_query query);
  */
 void bidib_free_train_position_query(t_bidib_train_position_query query);
 
+/**
+ * Frees the memory allocated by a train position list query.
+ *
+ * @param query the train position list query which values should be freed.
+ */
+void bidib_free_train_position_list_query(t_bidib_train_position_list_query query);
+
+/**
+ * Frees the memory allocated by an accessory state list query.
+ *
+ * @param query the accessory state list query which values should be freed.
+ */
+void bidib_free_unified_accessory_state_list_query(
+		t_bidib_unified_accessory_state_list_query query);
+
+/**
+ * Frees the memory allocated by a segment state list query.
+ *
+ * @param query the segment state list query which values should be freed.
+ */
+void bidib_free_segment_state_list_query(t_bidib_segment_state_list_query query);
+
+/**
+ * Frees the memory allocated by a train state list query.
+ *
+ * @param query the train state list query which values should be freed.
+ */
+void bidib_free_train_state_list_query(t_bidib_train_state_list_query query);
+
 /**
  * Frees the memory allocated by a train state query.
  *
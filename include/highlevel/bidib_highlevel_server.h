@@ -0,0 +1,83 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#ifndef BIDIB_HIGHLEVEL_SERVER_H
+#define BIDIB_HIGHLEVEL_SERVER_H
+
+#include <stdint.h>
+
+#include "bidib_highlevel_export.h"
+
+
+// Protocol of the state server, see bidib_set_state_server. A client connects to
+// the Unix domain socket and receives records in host byte order, each a
+// t_bidib_server_record followed by size bytes of payload. First the snapshot:
+// - one BIDIB_SERVER_HELLO record, the payload is a t_bidib_server_hello;
+// - a BIDIB_SERVER_ID record for each entry, the payload is the id including
+//   its terminating NUL;
+// - a BIDIB_SERVER_ENTRY record for each entry, the payload is the state of the
+//   entry: an uint8_t occupancy for segments, t_bidib_export_accessory for points
+//   and signals, t_bidib_export_train for trains and t_bidib_export_booster for
+//   boosters (see bidib_highlevel_export.h);
+// - one BIDIB_SERVER_SYNC record, the payload is the uint64_t change sequence
+//   number of the state.
+// Afterwards each change of the state is sent as the BIDIB_SERVER_ENTRY records
+// of the changed entries, followed by a BIDIB_SERVER_SYNC record. The state of a
+// client is consistent after each BIDIB_SERVER_SYNC record. If a client reads
+// slower than the state changes, the server waits until the client received
+// everything that was sent to it, and then sends the latest state of all entries
+// that changed in the meantime. Clients are not expected to send anything.
+
+#define BIDIB_SERVER_VERSION 1
+
+typedef enum {
+	BIDIB_SERVER_HELLO,
+	BIDIB_SERVER_ID,
+	BIDIB_SERVER_ENTRY,
+	BIDIB_SERVER_SYNC
+} t_bidib_server_record_type;
+
+typedef struct {
+	uint8_t type;            /**< t_bidib_server_record_type */
+	uint8_t kind;            /**< t_bidib_export_kind of ID and ENTRY records */
+	uint16_t size;           /**< Size of the payload that follows */
+	uint32_t position;       /**< Position of the entry of ID and ENTRY records */
+} t_bidib_server_record;
+
+typedef struct {
+	uint32_t version;
+	uint32_t segment_count;
+	uint32_t point_count;
+	uint32_t signal_count;
+	uint32_t train_count;
+	uint32_t booster_count;
+} t_bidib_server_hello;
+
+
+#endif
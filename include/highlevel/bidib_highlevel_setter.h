@@ -39,7 +39,8 @@
  *
  * @param point the id of the point.
  * @param aspect the new position of the point.
- * @return 0 for valid params, otherwise 1.
+ * @return 0 for valid params, otherwise 1. Also 1 if the message was rejected
+ *         because the message queue of the node is full.
  */
 int bidib_switch_point(const char *point, const char *aspect);
 
@@ -48,7 +49,8 @@ int bidib_switch_point(const char *point, const char *aspect);
  *
  * @param signal the id of the signal.
  * @param aspect the new state.
- * @return 0 for valid params, otherwise 1.
+ * @return 0 for valid params, otherwise 1. Also 1 if the message was rejected
+ *         because the message queue of the node is full.
  */
 int bidib_set_signal(const char *signal, const char *aspect);
 
@@ -57,10 +59,54 @@ int bidib_set_signal(const char *signal, const char *aspect);
  *
  * @param peripheral the id of the peripheral.
  * @param aspect the new state.
- * @return 0 for valid params, otherwise 1.
+ * @return 0 for valid params, otherwise 1. Also 1 if the message was rejected
+ *         because the message queue of the node is full.
  */
 int bidib_set_peripheral(const char *peripheral, const char *aspect);
 
+/**
+ * Sets the points, signals and peripherals of a route. All elements are resolved
+ * before anything is sent, so an invalid element leaves the whole route unset.
+ * The messages are grouped by node and sent together with one action id in as
+ * few packets as possible, without waiting for a board before addressing the
+ * next one. DCC points and signals report no feedback, they count as reached
+ * once sent. If a message is rejected because the message queue of its node is
+ * full, the route fails.
+ *
+ * @param elements the elements of the route.
+ * @param count the number of elements.
+ * @return the route handle, 0 if an element is invalid or its board is not
+ * connected. Must be freed with bidib_free_route.
+ */
+unsigned int bidib_set_route(const t_bidib_route_element *elements, size_t count);
+
+/**
+ * Returns whether the elements of a route reported their final state, i.e. a
+ * MSG_ACCESSORY_STATE with the aspect reached or a MSG_LC_STAT with the aspect.
+ *
+ * @param route the route handle.
+ * @return the status of the route.
+ */
+t_bidib_route_status bidib_get_route_status(unsigned int route);
+
+/**
+ * Blocks until all elements of a route reported their final state or one of
+ * them reported an error. Wakes up as soon as the state was updated.
+ *
+ * @param route the route handle.
+ * @param timeout_ms the maximum time to wait in milliseconds.
+ * @return the status of the route, BIDIB_ROUTE_PENDING if the timeout expired
+ * or the library was stopped.
+ */
+t_bidib_route_status bidib_wait_route(unsigned int route, unsigned int timeout_ms);
+
+/**
+ * Frees a route handle. Does not change the elements of the route.
+ *
+ * @param route the route handle.
+ */
+void bidib_free_route(unsigned int route);
+
 /**
  * Sets the speed of a train.
  *
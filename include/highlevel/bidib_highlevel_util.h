@@ -35,6 +35,50 @@
 #include "../definitions/bidib_definitions_custom.h"
 
 
+/**
+ * Sets a file in which the last confirmed states of the board points, board
+ * signals and peripherals are kept across restarts. If the library is started
+ * again with the same configs, the states are pre-populated from the file and
+ * verified by querying the boards, and only the initial values that the states
+ * do not already have are sent. The file is written as the boards report
+ * their states. Must be called before the library is started, the setting is
+ * cleared when it is stopped.
+ *
+ * @param path the path of the file, which is created if it does not exist. NULL
+ * disables the state file.
+ * @return 0 if successful, otherwise 1 (library is running).
+ */
+int bidib_set_state_file(const char *path);
+
+/**
+ * Sets a POSIX shared memory object to which a compact image of the track state
+ * is published: segment occupancy, accessory aspects, train speeds and positions
+ * and booster diagnostics. Other processes on the host can read consistent
+ * images from it without system calls, see bidib_highlevel_export.h. The object
+ * is created when the library is started and removed when it is stopped. Must
+ * be called before the library is started, the setting is cleared when it is
+ * stopped.
+ *
+ * @param name the name of the shared memory object, starting with a slash. NULL
+ * disables the export.
+ * @return 0 if successful, otherwise 1 (library is running).
+ */
+int bidib_set_state_export(const char *name);
+
+/**
+ * Sets a Unix domain socket on which a server thread accepts local clients that
+ * follow the track state. Each client first receives a snapshot of the state
+ * and then compact binary deltas whenever the state changes, see
+ * bidib_highlevel_server.h for the protocol. Changes for clients that read
+ * slowly are coalesced. The socket is created when the library is started and
+ * removed when it is stopped. Must be called before the library is started, the
+ * setting is cleared when it is stopped.
+ *
+ * @param path the path of the socket. NULL disables the server.
+ * @return 0 if successful, otherwise 1 (library is running).
+ */
+int bidib_set_state_server(const char *path);
+
 /**
  * Starts the system, handles the connection via two function pointers. Also
  * configures the syslog file. This must be run before all other usages of the
@@ -97,6 +141,77 @@ uint8_t *bidib_read_error_message(void);
  */
 void bidib_flush(void);
 
+/**
+ * Sets the time-to-live of queued messages of a message class. A message that
+ * waited longer than this in the queue of a node (e.g. during a stall) is dropped
+ * instead of sent, and its action id is reported as expired.
+ *
+ * @param message_class the message class.
+ * @param ttl_ms the time-to-live in ms. If 0, messages never expire (default).
+ */
+void bidib_set_message_class_ttl(t_bidib_message_class message_class, unsigned int ttl_ms);
+
+/**
+ * Checks whether a message belonging to an action id was dropped because its
+ * time-to-live expired. Only the most recently expired action ids are remembered.
+ *
+ * @param action_id the action id.
+ * @return true if a message of the action id expired, otherwise false.
+ */
+bool bidib_is_action_id_expired(unsigned int action_id);
+
+/**
+ * Checks whether a message belonging to an action id was dropped because the
+ * message queue of its node was full (see bidib_set_node_queue_limit), or was
+ * replaced in the queue by a later message for the same object. Only the most
+ * recently rejected action ids are remembered.
+ *
+ * @param action_id the action id.
+ * @return true if a message of the action id was rejected, otherwise false.
+ */
+bool bidib_is_action_id_rejected(unsigned int action_id);
+
+/**
+ * Returns the number of messages dropped because their time-to-live expired.
+ *
+ * @return the drop counters per message class.
+ */
+t_bidib_message_drop_counters bidib_get_message_drop_counters(void);
+
+/**
+ * Returns the transmission status of a node, i.e. how much traffic is pending for it.
+ *
+ * @param node_address the address of the node.
+ * @return the transmission status of the node.
+ */
+t_bidib_node_tx_status_query bidib_get_node_tx_status(t_bidib_node_address node_address);
+
+/**
+ * Returns the memory held by the library, i.e. the bytes and objects per subsystem
+ * and their high-water marks. Allocation overhead of malloc and glib containers is
+ * not included. The track state and the config arrays are measured when called,
+ * so the high-water mark of the track state only covers the calls of this function.
+ *
+ * @return the memory usage per subsystem.
+ */
+t_bidib_memory_stats bidib_get_memory_stats(void);
+
+/**
+ * Resets the high-water marks of the memory stats to the current usage.
+ */
+void bidib_reset_memory_high_water_marks(void);
+
+/**
+ * Limits the number of messages that may wait in the queue of a node. If the
+ * queue of a node is full, a new message replaces a queued message of the same type
+ * for the same object (e.g. the same DCC address or accessory), otherwise the new
+ * message is rejected.
+ *
+ * @param max_queued_messages the maximum number of queued messages per node.
+ * If 0, the queues are unlimited (default).
+ */
+void bidib_set_node_queue_limit(unsigned int max_queued_messages);
+
 /**
  * Check if bidib is currently running.
  * 
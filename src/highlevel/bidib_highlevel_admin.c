@@ -48,7 +48,7 @@ int bidib_ping(const char *board, uint8_t ping_byte) {
 		unsigned int action_id = bidib_get_and_incr_action_id();
 		syslog_libbidib(LOG_NOTICE, "Send ping to board: "
 		                "%s (0x%02x 0x%02x 0x%02x 0x00) "
-		                "with action id: %d", tmp_board->id->str,
+		                "with action id: %d", tmp_board->id,
 		                tmp_board->node_addr.top, tmp_board->node_addr.sub,
 		                tmp_board->node_addr.subsub, action_id);
 		t_bidib_node_address tmp_addr = tmp_board->node_addr;
@@ -72,7 +72,7 @@ int bidib_identify(const char *board, uint8_t state) {
 		unsigned int action_id = bidib_get_and_incr_action_id();
 		syslog_libbidib(LOG_NOTICE, "Send identify to board: "
 		                "%s (0x%02x 0x%02x 0x%02x 0x00) "
-		                "with action id: %d", tmp_board->id->str,
+		                "with action id: %d", tmp_board->id,
 		                tmp_board->node_addr.top, tmp_board->node_addr.sub,
 		                tmp_board->node_addr.subsub, action_id);
 		t_bidib_node_address tmp_addr = tmp_board->node_addr;
@@ -96,7 +96,7 @@ int bidib_get_protocol_version(const char *board) {
 		unsigned int action_id = bidib_get_and_incr_action_id();
 		syslog_libbidib(LOG_NOTICE, "Send get protocol version to board: "
 		                "%s (0x%02x 0x%02x 0x%02x 0x00) with action id: %d", 
-		                tmp_board->id->str,
+		                tmp_board->id,
 		                tmp_board->node_addr.top, tmp_board->node_addr.sub,
 		                tmp_board->node_addr.subsub, action_id);
 		t_bidib_node_address tmp_addr = tmp_board->node_addr;
@@ -120,7 +120,7 @@ int bidib_get_software_version(const char *board) {
 		unsigned int action_id = bidib_get_and_incr_action_id();
 		syslog_libbidib(LOG_NOTICE, "Send get software version to board: "
 		                "%s (0x%02x 0x%02x 0x%02x 0x00) with action id: %d", 
-		                tmp_board->id->str,
+		                tmp_board->id,
 		                tmp_board->node_addr.top, tmp_board->node_addr.sub,
 		                tmp_board->node_addr.subsub, action_id);
 		t_bidib_node_address tmp_addr = tmp_board->node_addr;
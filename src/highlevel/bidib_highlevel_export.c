@@ -0,0 +1,160 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../include/highlevel/bidib_highlevel_export.h"
+
+
+// Only depends on the C library, so that it can also be built as a reader
+// library for processes that do not link libbidib.
+
+#define BIDIB_EXPORT_READ_TRIES (1u << 24)
+
+struct t_bidib_export_reader {
+	const t_bidib_export_header *header;
+	size_t size;
+	// Private copy of the image, so that the returned image stays consistent
+	uint64_t *copy;
+};
+
+
+size_t bidib_export_locate(const t_bidib_export_header *header, const void *data,
+                           t_bidib_export_image *image) {
+	const size_t occupied_words = (header->segment_count + 63) / 64;
+	const size_t occupied = sizeof(uint64_t);
+	const size_t points = occupied + sizeof(uint64_t) * occupied_words;
+	const size_t signals = points + sizeof(t_bidib_export_accessory) * header->point_count;
+	const size_t trains = signals + sizeof(t_bidib_export_accessory) * header->signal_count;
+	const size_t boosters = trains + sizeof(t_bidib_export_train) * header->train_count;
+	const size_t size = boosters + sizeof(t_bidib_export_booster) * header->booster_count;
+	if (data != NULL) {
+		const char *const bytes = data;
+		memcpy(&image->change_seq, bytes, sizeof(uint64_t));
+		image->occupied = (const uint64_t *) (bytes + occupied);
+		image->points = (const t_bidib_export_accessory *) (bytes + points);
+		image->signals = (const t_bidib_export_accessory *) (bytes + signals);
+		image->trains = (const t_bidib_export_train *) (bytes + trains);
+		image->boosters = (const t_bidib_export_booster *) (bytes + boosters);
+	}
+	return size;
+}
+
+t_bidib_export_reader *bidib_export_open(const char *name) {
+	if (name == NULL) {
+		return NULL;
+	}
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd == -1) {
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(t_bidib_export_header)) {
+		close(fd);
+		return NULL;
+	}
+	const size_t size = (size_t) st.st_size;
+	void *mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping stays valid after the object is closed
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		return NULL;
+	}
+	const t_bidib_export_header *header = mapped;
+	if (header->magic != BIDIB_EXPORT_MAGIC || header->version != BIDIB_EXPORT_VERSION ||
+	    header->size != size || (size_t) header->image_offset + header->image_size > size ||
+	    bidib_export_locate(header, NULL, NULL) != header->image_size) {
+		munmap(mapped, size);
+		return NULL;
+	}
+	t_bidib_export_reader *reader = malloc(sizeof(t_bidib_export_reader));
+	reader->header = header;
+	reader->size = size;
+	reader->copy = malloc(header->image_size);
+	return reader;
+}
+
+const t_bidib_export_header *bidib_export_header(const t_bidib_export_reader *reader) {
+	return reader->header;
+}
+
+const char *bidib_export_id(const t_bidib_export_reader *reader, t_bidib_export_kind kind,
+                            size_t position) {
+	const t_bidib_export_header *const header = reader->header;
+	const uint32_t counts[] = {header->segment_count, header->point_count,
+	                           header->signal_count, header->train_count,
+	                           header->booster_count};
+	if ((size_t) kind >= sizeof(counts) / sizeof(counts[0]) || position >= counts[kind]) {
+		return NULL;
+	}
+	size_t index = position;
+	for (size_t i = 0; i < (size_t) kind; i++) {
+		index += counts[i];
+	}
+	const uint32_t *const offsets =
+			(const uint32_t *) ((const char *) header + header->ids_offset);
+	return (const char *) header + offsets[index];
+}
+
+bool bidib_export_read(t_bidib_export_reader *reader, t_bidib_export_image *image) {
+	const t_bidib_export_header *const header = reader->header;
+	_Atomic uint64_t *const seq = (_Atomic uint64_t *) &header->seq;
+	const char *const data = (const char *) header + header->image_offset;
+	for (unsigned int tries = 0; ; tries++) {
+		// Gives up if the writer died while writing the image
+		if (tries == BIDIB_EXPORT_READ_TRIES || header->magic != BIDIB_EXPORT_MAGIC) {
+			return false;
+		}
+		const uint64_t before = atomic_load_explicit(seq, memory_order_acquire);
+		if (before & 1) {
+			continue;
+		}
+		memcpy(reader->copy, data, header->image_size);
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(seq, memory_order_relaxed) == before) {
+			break;
+		}
+	}
+	bidib_export_locate(header, reader->copy, image);
+	return true;
+}
+
+void bidib_export_close(t_bidib_export_reader *reader) {
+	if (reader != NULL) {
+		munmap((void *) reader->header, reader->size);
+		free(reader->copy);
+		free(reader);
+	}
+}
@@ -28,262 +28,527 @@
  */
 
 #include <memory.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <glib.h>
 
 #include "../../include/highlevel/bidib_highlevel_getter.h"
 #include "bidib_highlevel_intern.h"
 #include "../state/bidib_state_getter_intern.h"
+#include "../transmission/bidib_transmission_intern.h"
 
 
-static t_bidib_board_accessory_state *bidib_get_state_accessories_board(GArray *accessories) {
-	t_bidib_board_accessory_state *state = malloc(
-			sizeof(t_bidib_board_accessory_state) * accessories->len);
-	t_bidib_board_accessory_state *tmp;
+// Holds the arrays and strings of a composite query in one block. Reservations
+// beyond the size of the block are only counted, so that the same code measures
+// the size a query needs and fills the block.
+typedef struct {
+	char *data;
+	size_t size;
+	size_t used;
+} t_bidib_query_block;
+
+static void *bidib_query_block_reserve(t_bidib_query_block *block, size_t size,
+                                       size_t alignment) {
+	const uintptr_t base = (uintptr_t) block->data;
+	const size_t offset = ((base + block->used + alignment - 1) & ~(uintptr_t) (alignment - 1))
+	                      - base;
+	block->used = offset + size;
+	if (block->data == NULL || block->used > block->size) {
+		return NULL;
+	}
+	return block->data + offset;
+}
+
+static char *bidib_query_block_strdup(t_bidib_query_block *block, const char *str) {
+	const size_t size = strlen(str) + 1;
+	char *copy = bidib_query_block_reserve(block, size, 1);
+	if (copy != NULL) {
+		memcpy(copy, str, size);
+	}
+	return copy;
+}
+
+#define bidib_query_block_array(block, type, count) \
+	((type *) bidib_query_block_reserve((block), sizeof(type) * (count), _Alignof(type)))
+
+// Allocates the block after a query measured it, returns whether the query shall
+// be repeated to fill the block. Both passes have to see the same state.
+static bool bidib_query_block_next(t_bidib_query_block *block) {
+	if (block->data != NULL || block->used == 0) {
+		return false;
+	}
+	block->data = malloc(block->used);
+	block->size = block->used;
+	block->used = 0;
+	return true;
+}
+
+// Builds an id list in one block: the table of ids followed by the strings. The
+// ids are added twice, first to measure the block and then to fill it. Borrowed
+// lists only hold the table and point into the ids of the configuration.
+typedef struct {
+	t_bidib_query_block block;
+	size_t length;
+	size_t capacity;
+	char **ids;
+	bool borrowed;
+} t_bidib_id_list_builder;
+
+#define BIDIB_ID_LIST_BUILDER(borrowed) {{NULL, 0, 0}, 0, 0, NULL, (borrowed)}
+
+static void bidib_id_list_add(t_bidib_id_list_builder *list, const char *id) {
+	if (list->ids == NULL) {
+		if (!list->borrowed) {
+			bidib_query_block_strdup(&list->block, id);
+		}
+		list->length++;
+	} else if (list->length < list->capacity) {
+		// Ids that were not measured, e.g. of a segment occupied in between, are dropped
+		char *copy = list->borrowed ? (char *) id : bidib_query_block_strdup(&list->block, id);
+		if (copy != NULL) {
+			list->ids[list->length] = copy;
+			list->length++;
+		}
+	}
+}
+
+// Allocates the block after the first pass, returns whether the ids shall be added again
+static bool bidib_id_list_next(t_bidib_id_list_builder *list) {
+	if (list->ids != NULL || list->length == 0) {
+		return false;
+	}
+	const size_t table = sizeof(char *) * list->length;
+	list->block.size = table + list->block.used;
+	list->block.data = malloc(list->block.size);
+	list->block.used = table;
+	list->capacity = list->length;
+	list->length = 0;
+	list->ids = (char **) list->block.data;
+	return true;
+}
+
+// Shall only be called with the lock of the indexed array acquired
+static bool bidib_get_state_changed(t_bidib_state_index index, size_t position, uint64_t since) {
+	return since == 0 || bidib_state_get_stamp(index, position) > since;
+}
+
+// Shall only be called with the lock of the indexed array acquired
+static size_t bidib_get_state_changed_count(t_bidib_state_index index, const GArray *array,
+                                            uint64_t since) {
+	if (since == 0) {
+		return array->len;
+	}
+	size_t count = 0;
+	for (size_t i = 0; i < array->len; i++) {
+		if (bidib_get_state_changed(index, i, since)) {
+			count++;
+		}
+	}
+	return count;
+}
+
+// Shall only be called with trackstate_accessories_mutex acquired
+static t_bidib_board_accessory_state *bidib_get_state_accessories_board(
+		t_bidib_query_block *block, GArray *accessories, t_bidib_state_index index,
+		uint64_t since, size_t *count) {
+	*count = bidib_get_state_changed_count(index, accessories, since);
+	t_bidib_board_accessory_state *state =
+			bidib_query_block_array(block, t_bidib_board_accessory_state, *count);
+	size_t n = 0;
 	for (size_t i = 0; i < accessories->len; i++) {
-		tmp = &g_array_index(accessories, t_bidib_board_accessory_state, i);
-		state[i] = *tmp;
-		state[i].id = strdup(tmp->id);
-		char *state_id;
-		if (tmp->data.state_id != NULL) {
-			state_id = tmp->data.state_id;
-		} else {
-			state_id = "unknown";
+		if (!bidib_get_state_changed(index, i, since)) {
+			continue;
+		}
+		const t_bidib_board_accessory_state *const tmp =
+				&g_array_index(accessories, t_bidib_board_accessory_state, i);
+		char *id = bidib_query_block_strdup(block, tmp->id);
+		char *state_id = bidib_query_block_strdup(
+				block, tmp->data.state_id != NULL ? tmp->data.state_id : "unknown");
+		if (state != NULL) {
+			state[n] = *tmp;
+			state[n].id = id;
+			state[n].data.state_id = state_id;
 		}
-		state[i].data.state_id = strdup(state_id);
+		n++;
 	}
 	return state;
 }
 
-static t_bidib_dcc_accessory_state *bidib_get_state_accessories_dcc(GArray *accessories) {
-	t_bidib_dcc_accessory_state *state = malloc(
-			sizeof(t_bidib_dcc_accessory_state) * accessories->len);
-	t_bidib_dcc_accessory_state *tmp;
+// Shall only be called with trackstate_accessories_mutex acquired
+static t_bidib_dcc_accessory_state *bidib_get_state_accessories_dcc(
+		t_bidib_query_block *block, GArray *accessories, t_bidib_state_index index,
+		uint64_t since, size_t *count) {
+	*count = bidib_get_state_changed_count(index, accessories, since);
+	t_bidib_dcc_accessory_state *state =
+			bidib_query_block_array(block, t_bidib_dcc_accessory_state, *count);
+	size_t n = 0;
 	for (size_t i = 0; i < accessories->len; i++) {
-		tmp = &g_array_index(accessories, t_bidib_dcc_accessory_state, i);
-		state[i] = *tmp;
-		state[i].id = strdup(tmp->id);
-		char *state_id;
-		if (tmp->data.state_id != NULL) {
-			state_id = tmp->data.state_id;
-		} else {
-			state_id = "unknown";
+		if (!bidib_get_state_changed(index, i, since)) {
+			continue;
+		}
+		const t_bidib_dcc_accessory_state *const tmp =
+				&g_array_index(accessories, t_bidib_dcc_accessory_state, i);
+		char *id = bidib_query_block_strdup(block, tmp->id);
+		char *state_id = bidib_query_block_strdup(
+				block, tmp->data.state_id != NULL ? tmp->data.state_id : "unknown");
+		if (state != NULL) {
+			state[n] = *tmp;
+			state[n].id = id;
+			state[n].data.state_id = state_id;
 		}
-		state[i].data.state_id = strdup(state_id);
+		n++;
 	}
 	return state;
 }
 
 // Shall only be called with trackstate_peripherals_mutex acquired
-static t_bidib_peripheral_state *bidib_get_state_peripherals(void) {
-	t_bidib_peripheral_state *state = malloc(
-			sizeof(t_bidib_peripheral_state) * bidib_track_state.peripherals->len);
-	t_bidib_peripheral_state *tmp;
+static t_bidib_peripheral_state *bidib_get_state_peripherals(t_bidib_query_block *block,
+                                                             uint64_t since, size_t *count) {
+	*count = bidib_get_state_changed_count(BIDIB_STATE_INDEX_PERIPHERALS,
+	                                       bidib_track_state.peripherals, since);
+	t_bidib_peripheral_state *state =
+			bidib_query_block_array(block, t_bidib_peripheral_state, *count);
+	size_t n = 0;
 	for (size_t i = 0; i < bidib_track_state.peripherals->len; i++) {
-		tmp = &g_array_index(bidib_track_state.peripherals, t_bidib_peripheral_state, i);
-		state[i] = *tmp;
-		state[i].id = strdup(tmp->id);
-		char *state_id;
-		if (tmp->data.state_id != NULL) {
-			state_id = tmp->data.state_id;
-		} else {
-			state_id = "unknown";
+		if (!bidib_get_state_changed(BIDIB_STATE_INDEX_PERIPHERALS, i, since)) {
+			continue;
+		}
+		const t_bidib_peripheral_state *const tmp =
+				&g_array_index(bidib_track_state.peripherals, t_bidib_peripheral_state, i);
+		char *id = bidib_query_block_strdup(block, tmp->id);
+		char *state_id = bidib_query_block_strdup(
+				block, tmp->data.state_id != NULL ? tmp->data.state_id : "unknown");
+		if (state != NULL) {
+			state[n] = *tmp;
+			state[n].id = id;
+			state[n].data.state_id = state_id;
 		}
-		state[i].data.state_id = strdup(state_id);
+		n++;
 	}
 	return state;
 }
 
-// Shall only be called with trackstate_segments_mutex acquired
-static t_bidib_segment_state *bidib_get_state_segments(void) {
-	t_bidib_segment_state *state = malloc(
-			sizeof(t_bidib_segment_state) * bidib_track_state.segments->len);
-	t_bidib_segment_state_intern *tmp;
+// Shall only be called with trackstate_segments_mutex and the shard locks acquired
+static t_bidib_segment_state *bidib_get_state_segments(t_bidib_query_block *block,
+                                                       uint64_t since, size_t *count) {
+	*count = bidib_get_state_changed_count(BIDIB_STATE_INDEX_SEGMENTS,
+	                                       bidib_track_state.segments, since);
+	t_bidib_segment_state *state = bidib_query_block_array(block, t_bidib_segment_state, *count);
+	size_t n = 0;
 	for (size_t i = 0; i < bidib_track_state.segments->len; i++) {
-		tmp = &g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern, i);
-		state[i].id = strdup(tmp->id->str);
-		state[i].data.occupied = tmp->occupied;
-		state[i].data.confidence = tmp->confidence;
-		state[i].data.power_consumption = tmp->power_consumption;
-		state[i].data.dcc_address_cnt = tmp->dcc_addresses->len;
-		state[i].data.dcc_addresses = malloc(sizeof(t_bidib_dcc_address) * tmp->dcc_addresses->len);
-		memcpy(state[i].data.dcc_addresses, tmp->dcc_addresses->data,
-		       sizeof(t_bidib_dcc_address) * tmp->dcc_addresses->len);
+		if (!bidib_get_state_changed(BIDIB_STATE_INDEX_SEGMENTS, i, since)) {
+			continue;
+		}
+		const t_bidib_segment_state_intern *const tmp =
+				&g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern, i);
+		char *id = bidib_query_block_strdup(block, tmp->id);
+		t_bidib_dcc_address *dcc_addresses = bidib_query_block_array(
+				block, t_bidib_dcc_address, tmp->dcc_addresses->len);
+		if (state != NULL && dcc_addresses != NULL) {
+			state[n].id = id;
+			state[n].data.occupied = tmp->occupied;
+			state[n].data.confidence = tmp->confidence;
+			state[n].data.power_consumption = tmp->power_consumption;
+			state[n].data.dcc_address_cnt = tmp->dcc_addresses->len;
+			state[n].data.dcc_addresses = dcc_addresses;
+			memcpy(dcc_addresses, tmp->dcc_addresses->data,
+			       sizeof(t_bidib_dcc_address) * tmp->dcc_addresses->len);
+		}
+		n++;
 	}
 	return state;
 }
 
 // Shall only be called with trackstate_reversers_mutex acquired
-static t_bidib_reverser_state *bidib_get_state_reversers(void) {
-	t_bidib_reverser_state *state = malloc(
-			sizeof(t_bidib_reverser_state) * bidib_track_state.reversers->len);
-	t_bidib_reverser_state *tmp;
+static t_bidib_reverser_state *bidib_get_state_reversers(t_bidib_query_block *block,
+                                                         uint64_t since, size_t *count) {
+	*count = bidib_get_state_changed_count(BIDIB_STATE_INDEX_REVERSERS,
+	                                       bidib_track_state.reversers, since);
+	t_bidib_reverser_state *state = bidib_query_block_array(block, t_bidib_reverser_state, *count);
+	size_t n = 0;
 	for (size_t i = 0; i < bidib_track_state.reversers->len; i++) {
-		tmp = &g_array_index(bidib_track_state.reversers, t_bidib_reverser_state, i);
-		state[i] = *tmp;
-		state[i].id = strdup(tmp->id);
-		char *state_id;
-		if (tmp->data.state_id != NULL) {
-			state_id = tmp->data.state_id;
-		} else {
-			state_id = "unknown";
+		if (!bidib_get_state_changed(BIDIB_STATE_INDEX_REVERSERS, i, since)) {
+			continue;
+		}
+		const t_bidib_reverser_state *const tmp =
+				&g_array_index(bidib_track_state.reversers, t_bidib_reverser_state, i);
+		char *id = bidib_query_block_strdup(block, tmp->id);
+		char *state_id = bidib_query_block_strdup(
+				block, tmp->data.state_id != NULL ? tmp->data.state_id : "unknown");
+		if (state != NULL) {
+			state[n] = *tmp;
+			state[n].id = id;
+			state[n].data.state_id = state_id;
 		}
-		state[i].data.state_id = strdup(state_id);
+		n++;
 	}
 	return state;
 }
 
 // Shall only be called with trackstate_trains_mutex acquired
-static t_bidib_train_state *bidib_get_state_trains(void) {
-	t_bidib_train_state *state = malloc(sizeof(t_bidib_train_state)*bidib_track_state.trains->len);
+static t_bidib_train_peripheral_state *bidib_get_state_train_peripherals(
+		t_bidib_query_block *block, const t_bidib_train_peripheral_state *peripherals,
+		size_t count) {
+	t_bidib_train_peripheral_state *copy =
+			bidib_query_block_array(block, t_bidib_train_peripheral_state, count);
+	for (size_t i = 0; i < count; i++) {
+		char *id = bidib_query_block_strdup(block, peripherals[i].id);
+		if (copy != NULL) {
+			copy[i].id = id;
+			copy[i].state = peripherals[i].state;
+		}
+	}
+	return copy;
+}
+
+// Shall only be called with trackstate_trains_mutex acquired
+static t_bidib_train_state *bidib_get_state_trains(t_bidib_query_block *block,
+                                                   uint64_t since, size_t *count) {
+	*count = bidib_get_state_changed_count(BIDIB_STATE_INDEX_TRAIN_STATES,
+	                                       bidib_track_state.trains, since);
+	t_bidib_train_state *state = bidib_query_block_array(block, t_bidib_train_state, *count);
+	size_t n = 0;
 	for (size_t i = 0; i < bidib_track_state.trains->len; i++) {
+		if (!bidib_get_state_changed(BIDIB_STATE_INDEX_TRAIN_STATES, i, since)) {
+			continue;
+		}
 		const t_bidib_train_state_intern *const tmp = 
 		             &g_array_index(bidib_track_state.trains, t_bidib_train_state_intern, i);
-		state[i].id = strdup(tmp->id->str);
-		state[i].data.on_track = tmp->on_track;
-		state[i].data.orientation = tmp->orientation;
-		state[i].data.set_speed_step = tmp->set_speed_step;
-		state[i].data.set_is_forwards = tmp->set_is_forwards;
-		state[i].data.ack = tmp->ack;
-		state[i].data.detected_kmh_speed = tmp->detected_kmh_speed;
-		state[i].data.peripheral_cnt = tmp->peripherals->len;
-		state[i].data.peripherals = malloc(
-				sizeof(t_bidib_train_peripheral_state) * tmp->peripherals->len);
-		t_bidib_train_peripheral_state peripheral_state_i;
-		for (size_t j = 0; j < tmp->peripherals->len; j++) {
-			peripheral_state_i = g_array_index(tmp->peripherals,
-			                                   t_bidib_train_peripheral_state, j);
-			state[i].data.peripherals[j].id = strdup(peripheral_state_i.id);
-			state[i].data.peripherals[j].state = peripheral_state_i.state;
-		}
-		state[i].data.decoder_state = tmp->decoder_state;
+		char *id = bidib_query_block_strdup(block, tmp->id);
+		t_bidib_train_peripheral_state *peripherals = bidib_get_state_train_peripherals(
+				block, (const t_bidib_train_peripheral_state *) tmp->peripherals->data,
+				tmp->peripherals->len);
+		if (state != NULL) {
+			state[n].id = id;
+			state[n].data.on_track = tmp->on_track;
+			state[n].data.orientation = tmp->orientation;
+			state[n].data.set_speed_step = tmp->set_speed_step;
+			state[n].data.set_is_forwards = tmp->set_is_forwards;
+			state[n].data.ack = tmp->ack;
+			state[n].data.detected_kmh_speed = tmp->detected_kmh_speed;
+			state[n].data.peripheral_cnt = tmp->peripherals->len;
+			state[n].data.peripherals = peripherals;
+			state[n].data.decoder_state = tmp->decoder_state;
+		}
+		n++;
 	}
 	return state;
 }
 
 // Shall only be called with trackstate_boosters_mutex acquired
-static t_bidib_booster_state *bidib_get_state_boosters(void) {
-	t_bidib_booster_state *state = malloc(
-			sizeof(t_bidib_booster_state) * bidib_track_state.boosters->len);
+static t_bidib_booster_state *bidib_get_state_boosters(t_bidib_query_block *block,
+                                                       uint64_t since, size_t *count) {
+	*count = bidib_get_state_changed_count(BIDIB_STATE_INDEX_BOOSTERS,
+	                                       bidib_track_state.boosters, since);
+	t_bidib_booster_state *state = bidib_query_block_array(block, t_bidib_booster_state, *count);
+	size_t n = 0;
 	for (size_t i = 0; i < bidib_track_state.boosters->len; i++) {
+		if (!bidib_get_state_changed(BIDIB_STATE_INDEX_BOOSTERS, i, since)) {
+			continue;
+		}
 		const t_bidib_booster_state *const tmp = 
 		         &g_array_index(bidib_track_state.boosters, t_bidib_booster_state, i);
-		state[i].id = strdup(tmp->id);
-		state[i].data.power_state = tmp->data.power_state;
-		state[i].data.power_state_simple = tmp->data.power_state_simple;
-		state[i].data.power_consumption = tmp->data.power_consumption;
-		state[i].data.voltage_known = tmp->data.voltage_known;
-		state[i].data.voltage = tmp->data.voltage;
-		state[i].data.temp_celsius = tmp->data.temp_celsius;
+		char *id = bidib_query_block_strdup(block, tmp->id);
+		if (state != NULL) {
+			state[n].id = id;
+			state[n].data = tmp->data;
+		}
+		n++;
 	}
 	return state;
 }
 
 // Shall only be called with trackstate_track_outputs_mutex acquired
-static t_bidib_track_output_state *bidib_get_state_track_outputs(void) {
-	t_bidib_track_output_state *state = malloc(
-			sizeof(t_bidib_track_output_state) * bidib_track_state.track_outputs->len);
+static t_bidib_track_output_state *bidib_get_state_track_outputs(t_bidib_query_block *block,
+                                                                 uint64_t since, size_t *count) {
+	*count = bidib_get_state_changed_count(BIDIB_STATE_INDEX_TRACK_OUTPUTS,
+	                                       bidib_track_state.track_outputs, since);
+	t_bidib_track_output_state *state =
+			bidib_query_block_array(block, t_bidib_track_output_state, *count);
+	size_t n = 0;
 	for (size_t i = 0; i < bidib_track_state.track_outputs->len; i++) {
+		if (!bidib_get_state_changed(BIDIB_STATE_INDEX_TRACK_OUTPUTS, i, since)) {
+			continue;
+		}
 		const t_bidib_track_output_state *const tmp = 
 		         &g_array_index(bidib_track_state.track_outputs, t_bidib_track_output_state, i);
-		state[i].id = strdup(tmp->id);
-		state[i].cs_state = tmp->cs_state;
+		char *id = bidib_query_block_strdup(block, tmp->id);
+		if (state != NULL) {
+			state[n].id = id;
+			state[n].cs_state = tmp->cs_state;
+		}
+		n++;
 	}
 	return state;
 }
 
+static void bidib_get_state_category(t_bidib_query_block *block, t_bidib_state_category category,
+                                     uint64_t since, t_bidib_track_state *query) {
+	switch (category) {
+		case BIDIB_STATE_CATEGORY_ACCESSORIES:
+			// For accessing bidib_track_state.points_board, .points_dcc, .signals_board, .signals_dcc
+			pthread_mutex_lock(&trackstate_accessories_mutex);
+			query->points_board = bidib_get_state_accessories_board(
+					block, bidib_track_state.points_board, BIDIB_STATE_INDEX_POINTS_BOARD,
+					since, &query->points_board_count);
+			query->points_dcc = bidib_get_state_accessories_dcc(
+					block, bidib_track_state.points_dcc, BIDIB_STATE_INDEX_POINTS_DCC,
+					since, &query->points_dcc_count);
+			query->signals_board = bidib_get_state_accessories_board(
+					block, bidib_track_state.signals_board, BIDIB_STATE_INDEX_SIGNALS_BOARD,
+					since, &query->signals_board_count);
+			query->signals_dcc = bidib_get_state_accessories_dcc(
+					block, bidib_track_state.signals_dcc, BIDIB_STATE_INDEX_SIGNALS_DCC,
+					since, &query->signals_dcc_count);
+			pthread_mutex_unlock(&trackstate_accessories_mutex);
+			break;
+		case BIDIB_STATE_CATEGORY_PERIPHERALS:
+			// For accessing bidib_track_state.peripherals, for bidib_get_state_peripherals
+			pthread_mutex_lock(&trackstate_peripherals_mutex);
+			query->peripherals = bidib_get_state_peripherals(block, since,
+			                                                 &query->peripherals_count);
+			pthread_mutex_unlock(&trackstate_peripherals_mutex);
+			break;
+		case BIDIB_STATE_CATEGORY_SEGMENTS:
+			// For accessing bidib_track_state.segments, for bidib_get_state_segments
+			pthread_mutex_lock(&trackstate_segments_mutex);
+			bidib_state_index_lock_segment_shards();
+			query->segments = bidib_get_state_segments(block, since, &query->segments_count);
+			bidib_state_index_unlock_segment_shards();
+			pthread_mutex_unlock(&trackstate_segments_mutex);
+			break;
+		case BIDIB_STATE_CATEGORY_REVERSERS:
+			// For accessing bidib_track_state.reversers, for bidib_get_state_reversers
+			pthread_mutex_lock(&trackstate_reversers_mutex);
+			query->reversers = bidib_get_state_reversers(block, since, &query->reversers_count);
+			pthread_mutex_unlock(&trackstate_reversers_mutex);
+			break;
+		case BIDIB_STATE_CATEGORY_TRAINS:
+			// For accessing bidib_track_state.trains, for bidib_get_state_trains
+			pthread_mutex_lock(&trackstate_trains_mutex);
+			query->trains = bidib_get_state_trains(block, since, &query->trains_count);
+			pthread_mutex_unlock(&trackstate_trains_mutex);
+			break;
+		case BIDIB_STATE_CATEGORY_BOOSTERS:
+			// For accessing bidib_track_state.boosters, for bidib_get_state_boosters
+			pthread_mutex_lock(&trackstate_boosters_mutex);
+			query->booster = bidib_get_state_boosters(block, since, &query->booster_count);
+			pthread_mutex_unlock(&trackstate_boosters_mutex);
+			break;
+		case BIDIB_STATE_CATEGORY_TRACK_OUTPUTS:
+			// For accessing bidib_track_state.track_outputs, for bidib_get_state_track_outputs
+			pthread_mutex_lock(&trackstate_track_outputs_mutex);
+			query->track_outputs = bidib_get_state_track_outputs(block, since,
+			                                                     &query->track_outputs_count);
+			pthread_mutex_unlock(&trackstate_track_outputs_mutex);
+			break;
+		default:
+			break;
+	}
+}
+
+// Copies the categories into the buffer, returns false if it is too small. Each
+// category is consistent in itself, as it is copied under its own lock.
+static bool bidib_get_state_categories_buf(unsigned int categories, uint64_t since,
+                                           t_bidib_track_state *query, void *buffer,
+                                           size_t size, size_t *required) {
+	t_bidib_query_block block = {buffer, size, 0};
+	for (int category = 0; category < BIDIB_STATE_CATEGORY_COUNT; category++) {
+		if (categories & (1u << category)) {
+			bidib_get_state_category(&block, (t_bidib_state_category) category, since, query);
+		}
+	}
+	if (required != NULL) {
+		*required = block.used;
+	}
+	query->block = NULL;
+	return buffer != NULL ? block.used <= size : block.used == 0;
+}
+
+size_t bidib_get_state_categories(unsigned int categories, uint64_t since,
+                                  t_bidib_track_state *query) {
+	void *buffer = NULL;
+	size_t size = 0;
+	size_t required;
+	// Measures first, then retries as long as the copied entries grew in between
+	while (!bidib_get_state_categories_buf(categories, since, query, buffer, size, &required)) {
+		free(buffer);
+		size = required + required / 8;
+		buffer = malloc(size);
+	}
+	query->block = buffer;
+	return size;
+}
+
 t_bidib_track_state bidib_get_state(void) {
 	t_bidib_track_state query = {0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL,
-	                             0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL};
-	// For accessing bidib_track_state.points_board, .points_dcc, .signals_board, .signals_dcc
-	pthread_mutex_lock(&trackstate_accessories_mutex);
-	query.points_board_count = bidib_track_state.points_board->len;
-	query.points_board = bidib_get_state_accessories_board(bidib_track_state.points_board);
-	query.points_dcc_count = bidib_track_state.points_dcc->len;
-	query.points_dcc = bidib_get_state_accessories_dcc(bidib_track_state.points_dcc);
-	query.signals_board_count = bidib_track_state.signals_board->len;
-	query.signals_board = bidib_get_state_accessories_board(bidib_track_state.signals_board);
-	query.signals_dcc_count = bidib_track_state.signals_dcc->len;
-	query.signals_dcc = bidib_get_state_accessories_dcc(bidib_track_state.signals_dcc);
-	pthread_mutex_unlock(&trackstate_accessories_mutex);
-	
-	// For accessing bidib_track_state.peripherals, for bidib_get_state_peripherals
-	pthread_mutex_lock(&trackstate_peripherals_mutex);
-	query.peripherals_count = bidib_track_state.peripherals->len;
-	query.peripherals = bidib_get_state_peripherals();
-	pthread_mutex_unlock(&trackstate_peripherals_mutex);
-	
-	// For accessing bidib_track_state.segments, for bidib_get_state_segments
-	pthread_mutex_lock(&trackstate_segments_mutex);
-	query.segments_count = bidib_track_state.segments->len;
-	query.segments = bidib_get_state_segments();
-	pthread_mutex_unlock(&trackstate_segments_mutex);
-	
-	// For accessing bidib_track_state.reversers, for bidib_get_state_reversers
-	pthread_mutex_lock(&trackstate_reversers_mutex);
-	query.reversers_count = bidib_track_state.reversers->len;
-	query.reversers = bidib_get_state_reversers();
-	pthread_mutex_unlock(&trackstate_reversers_mutex);
-	
-	// For accessing bidib_track_state.trains, for bidib_get_state_trains
-	pthread_mutex_lock(&trackstate_trains_mutex);
-	query.trains_count = bidib_track_state.trains->len;
-	query.trains = bidib_get_state_trains();
-	pthread_mutex_unlock(&trackstate_trains_mutex);
-	
-	// For accessing bidib_track_state.boosters, for bidib_get_state_boosters
-	pthread_mutex_lock(&trackstate_boosters_mutex);
-	query.booster_count = bidib_track_state.boosters->len;
-	query.booster = bidib_get_state_boosters();
-	pthread_mutex_unlock(&trackstate_boosters_mutex);
-	
-	// For accessing bidib_track_state.track_outputs, for bidib_get_state_track_outputs
-	pthread_mutex_lock(&trackstate_track_outputs_mutex);
-	query.track_outputs_count = bidib_track_state.track_outputs->len;
-	query.track_outputs = bidib_get_state_track_outputs();
-	pthread_mutex_unlock(&trackstate_track_outputs_mutex);
-	
+	                             0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, NULL};
+	bidib_get_state_categories(BIDIB_STATE_CATEGORIES_ALL, 0, &query);
 	return query;
 }
 
+size_t bidib_get_state_size(void) {
+	t_bidib_track_state query;
+	size_t required;
+	bidib_get_state_categories_buf(BIDIB_STATE_CATEGORIES_ALL, 0, &query, NULL, 0, &required);
+	return required;
+}
+
+bool bidib_get_state_buf(t_bidib_track_state *state, void *buffer, size_t size,
+                         size_t *required) {
+	if (state == NULL) {
+		return false;
+	}
+	return bidib_get_state_categories_buf(BIDIB_STATE_CATEGORIES_ALL, 0, state,
+	                                      buffer, size, required);
+}
+
+t_bidib_track_state_changes bidib_get_changes_since(uint64_t seq) {
+	t_bidib_track_state_changes changes = {0, {0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL,
+	                                           0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL,
+	                                           NULL}};
+	// Every change stamped up to here is visible once the lock of its category
+	// is acquired, later changes may be included as well
+	changes.seq = bidib_state_get_change_seq();
+	if (seq >= changes.seq) {
+		return changes;
+	}
+	bidib_get_state_categories(BIDIB_STATE_CATEGORIES_ALL, seq, &changes.state);
+	return changes;
+}
+
 t_bidib_id_list_query bidib_get_boards(void) {
 	t_bidib_id_list_query query = {0, NULL};
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	if (bidib_boards->len > 0) {
-		query.length = bidib_boards->len;
-		query.ids = malloc(sizeof(char *) * query.length);
+	do {
 		for (size_t i = 0; i < bidib_boards->len; i++) {
 			const t_bidib_board *const board_i = &g_array_index(bidib_boards, t_bidib_board, i);
-			query.ids[i] = strdup(board_i->id->str);
+			bidib_id_list_add(&list, board_i->id);
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 t_bidib_id_list_query bidib_get_boards_connected(void) {
 	t_bidib_id_list_query query = {0, NULL};
-	size_t count = 0;
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		const t_bidib_board *const count_tmp = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (count_tmp != NULL && count_tmp->connected) {
-			count++;
-		}
-	}
-	if (count > 0) {
-		query.length = count;
-		query.ids = malloc(sizeof(char *) * count);
-		size_t current_index = 0;
-		for (size_t i = 0; i < bidib_boards->len && current_index < count; i++) {
+	do {
+		for (size_t i = 0; i < bidib_boards->len; i++) {
 			const t_bidib_board *const tmp = &g_array_index(bidib_boards, t_bidib_board, i);
 			if (tmp != NULL && tmp->connected) {
-				query.ids[current_index] = strdup(tmp->id->str);
-				current_index++;
+				bidib_id_list_add(&list, tmp->id);
 			}
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
@@ -326,7 +591,7 @@ t_bidib_id_query bidib_get_board_id(t_bidib_unique_id_mod unique_id) {
 		const t_bidib_board *const board_i = &g_array_index(bidib_boards, t_bidib_board, i);
 		if (board_i != NULL && bidib_state_uids_equal(&unique_id, &board_i->unique_id)) {
 			query.known = true;
-			query.id = strdup(board_i->id->str);
+			query.id = strdup(board_i->id);
 			break;
 		}
 	}
@@ -403,30 +668,29 @@ t_bidib_id_list_query bidib_get_board_points(const char *board) {
 	if (board == NULL) {
 		return query;
 	}
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For bidib_state_get_board_ref
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	const t_bidib_board *const board_ref = bidib_state_get_board_ref(board);
-	if (board_ref != NULL && (board_ref->points_board->len > 0 ||
-	                          board_ref->points_dcc->len > 0)) {
-		query.length = board_ref->points_board->len + board_ref->points_dcc->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		size_t current_index = 0;
-		for (size_t i = 0; i < board_ref->points_board->len; i++) {
-			const t_bidib_board_accessory_mapping *const board_accessory_mapping = 
-			                       &g_array_index(board_ref->points_board,
-			                                      t_bidib_board_accessory_mapping, i);
-			query.ids[current_index] = strdup(board_accessory_mapping->id->str);
-			current_index++;
-		}
-		for (size_t i = 0; i < board_ref->points_dcc->len; i++) {
-			const t_bidib_dcc_accessory_mapping *const dcc_accessory_mapping = 
-			                       &g_array_index(board_ref->points_dcc,
-			                                      t_bidib_dcc_accessory_mapping, i);
-			query.ids[current_index] = strdup(dcc_accessory_mapping->id->str);
-			current_index++;
-		}
+	if (board_ref != NULL) {
+		do {
+			for (size_t i = 0; i < board_ref->points_board->len; i++) {
+				const t_bidib_board_accessory_mapping *const board_accessory_mapping = 
+				                       &g_array_index(board_ref->points_board,
+				                                      t_bidib_board_accessory_mapping, i);
+				bidib_id_list_add(&list, board_accessory_mapping->id);
+			}
+			for (size_t i = 0; i < board_ref->points_dcc->len; i++) {
+				const t_bidib_dcc_accessory_mapping *const dcc_accessory_mapping = 
+				                       &g_array_index(board_ref->points_dcc,
+				                                      t_bidib_dcc_accessory_mapping, i);
+				bidib_id_list_add(&list, dcc_accessory_mapping->id);
+			}
+		} while (bidib_id_list_next(&list));
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
@@ -435,30 +699,29 @@ t_bidib_id_list_query bidib_get_board_signals(const char *board) {
 	if (board == NULL) {
 		return query;
 	}
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For bidib_state_get_board_ref
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	const t_bidib_board *const board_ref = bidib_state_get_board_ref(board);
-	if (board_ref != NULL && (board_ref->signals_board->len > 0 ||
-	                          board_ref->signals_dcc->len > 0)) {
-		query.length = board_ref->signals_board->len + board_ref->signals_dcc->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		size_t current_index = 0;
-		for (size_t i = 0; i < board_ref->signals_board->len; i++) {
-			const t_bidib_board_accessory_mapping *const board_accessory_mapping = 
-			                         &g_array_index(board_ref->signals_board,
-			                                        t_bidib_board_accessory_mapping, i);
-			query.ids[current_index] = strdup(board_accessory_mapping->id->str);
-			current_index++;
-		}
-		for (size_t i = 0; i < board_ref->signals_dcc->len; i++) {
-			const t_bidib_dcc_accessory_mapping *const dcc_accessory_mapping = 
-			                         &g_array_index(board_ref->signals_dcc,
-			                                        t_bidib_dcc_accessory_mapping, i);
-			query.ids[current_index] = strdup(dcc_accessory_mapping->id->str);
-			current_index++;
-		}
+	if (board_ref != NULL) {
+		do {
+			for (size_t i = 0; i < board_ref->signals_board->len; i++) {
+				const t_bidib_board_accessory_mapping *const board_accessory_mapping = 
+				                       &g_array_index(board_ref->signals_board,
+				                                      t_bidib_board_accessory_mapping, i);
+				bidib_id_list_add(&list, board_accessory_mapping->id);
+			}
+			for (size_t i = 0; i < board_ref->signals_dcc->len; i++) {
+				const t_bidib_dcc_accessory_mapping *const dcc_accessory_mapping = 
+				                       &g_array_index(board_ref->signals_dcc,
+				                                      t_bidib_dcc_accessory_mapping, i);
+				bidib_id_list_add(&list, dcc_accessory_mapping->id);
+			}
+		} while (bidib_id_list_next(&list));
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
@@ -467,20 +730,22 @@ t_bidib_id_list_query bidib_get_board_peripherals(const char *board) {
 	if (board == NULL) {
 		return query;
 	}
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For bidib_state_get_board_ref
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	const t_bidib_board *const board_ref = bidib_state_get_board_ref(board);
-	if (board_ref != NULL && (board_ref->peripherals->len > 0)) {
-		query.length = board_ref->peripherals->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		for (size_t i = 0; i < board_ref->peripherals->len; i++) {
-			const t_bidib_peripheral_mapping *const peripheral_mapping = 
-			                          &g_array_index(board_ref->peripherals,
-			                                        t_bidib_peripheral_mapping, i);
-			query.ids[i] = strdup(peripheral_mapping->id->str);
-		}
+	if (board_ref != NULL) {
+		do {
+			for (size_t i = 0; i < board_ref->peripherals->len; i++) {
+				const t_bidib_peripheral_mapping *const peripheral_mapping = 
+				        &g_array_index(board_ref->peripherals, t_bidib_peripheral_mapping, i);
+				bidib_id_list_add(&list, peripheral_mapping->id);
+			}
+		} while (bidib_id_list_next(&list));
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
@@ -489,20 +754,22 @@ t_bidib_id_list_query bidib_get_board_segments(const char *board) {
 	if (board == NULL) {
 		return query;
 	}
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For bidib_state_get_board_ref
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	const t_bidib_board *const board_ref = bidib_state_get_board_ref(board);
-	if (board_ref != NULL && (board_ref->segments->len > 0)) {
-		query.length = board_ref->segments->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		for (size_t i = 0; i < board_ref->segments->len; i++) {
-			const t_bidib_segment_mapping *const segment_mapping = 
-			                      &g_array_index(board_ref->segments,
-			                                     t_bidib_segment_mapping, i);
-			query.ids[i] = strdup(segment_mapping->id->str);
-		}
+	if (board_ref != NULL) {
+		do {
+			for (size_t i = 0; i < board_ref->segments->len; i++) {
+				const t_bidib_segment_mapping *const segment_mapping = 
+				        &g_array_index(board_ref->segments, t_bidib_segment_mapping, i);
+				bidib_id_list_add(&list, segment_mapping->id);
+			}
+		} while (bidib_id_list_next(&list));
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
@@ -511,273 +778,287 @@ t_bidib_id_list_query bidib_get_board_reversers(const char *board) {
 	if (board == NULL) {
 		return query;
 	}
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For bidib_state_get_board_ref
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	const t_bidib_board *const board_ref = bidib_state_get_board_ref(board);
-	if (board_ref != NULL && (board_ref->reversers->len > 0)) {
-		query.length = board_ref->reversers->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		for (size_t i = 0; i < board_ref->reversers->len; i++) {
-			const t_bidib_reverser_mapping *const reverser_mapping = 
-			                          &g_array_index(board_ref->reversers,
-			                                        t_bidib_reverser_mapping, i);
-			query.ids[i] = strdup(reverser_mapping->id->str);
-		}
+	if (board_ref != NULL) {
+		do {
+			for (size_t i = 0; i < board_ref->reversers->len; i++) {
+				const t_bidib_reverser_mapping *const reverser_mapping = 
+				        &g_array_index(board_ref->reversers, t_bidib_reverser_mapping, i);
+				bidib_id_list_add(&list, reverser_mapping->id);
+			}
+		} while (bidib_id_list_next(&list));
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 t_bidib_id_list_query bidib_get_connected_points(void) {
 	t_bidib_id_list_query query = {0, NULL};
-	size_t count = 0;
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (board_ref != NULL && board_ref->connected) {
-			count += board_ref->points_board->len;
-			count += board_ref->points_dcc->len;
-		}
-	}
-	if (count > 0) {
-		query.length = count;
-		query.ids = malloc(sizeof(char *) * count);
-		size_t current_index = 0;
+	do {
 		for (size_t i = 0; i < bidib_boards->len; i++) {
 			const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
 			if (board_ref != NULL && board_ref->connected) {
 				for (size_t j = 0; j < board_ref->points_board->len; j++) {
 					const t_bidib_board_accessory_mapping *const mapping = &g_array_index(
 							board_ref->points_board, t_bidib_board_accessory_mapping, j);
-					query.ids[current_index] = strdup(mapping->id->str);
-					current_index++;
+					bidib_id_list_add(&list, mapping->id);
 				}
 				for (size_t j = 0; j < board_ref->points_dcc->len; j++) {
 					const t_bidib_dcc_accessory_mapping *const mapping = &g_array_index(
 							board_ref->points_dcc, t_bidib_dcc_accessory_mapping, j);
-					query.ids[current_index] = strdup(mapping->id->str);
-					current_index++;
+					bidib_id_list_add(&list, mapping->id);
 				}
 			}
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 t_bidib_id_list_query bidib_get_connected_signals(void) {
 	t_bidib_id_list_query query = {0, NULL};
-	size_t count = 0;
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (board_ref != NULL && board_ref->connected) {
-			count += board_ref->signals_board->len;
-			count += board_ref->signals_dcc->len;
-		}
-	}
-	if (count > 0) {
-		query.length = count;
-		query.ids = malloc(sizeof(char *) * count);
-		size_t current_index = 0;
+	do {
 		for (size_t i = 0; i < bidib_boards->len; i++) {
 			const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
 			if (board_ref != NULL && board_ref->connected) {
 				for (size_t j = 0; j < board_ref->signals_board->len; j++) {
 					const t_bidib_board_accessory_mapping *const mapping = &g_array_index(
 							board_ref->signals_board, t_bidib_board_accessory_mapping, j);
-					query.ids[current_index] = strdup(mapping->id->str);
-					current_index++;
+					bidib_id_list_add(&list, mapping->id);
 				}
 				for (size_t j = 0; j < board_ref->signals_dcc->len; j++) {
 					const t_bidib_dcc_accessory_mapping *const mapping = &g_array_index(
 							board_ref->signals_dcc, t_bidib_dcc_accessory_mapping, j);
-					query.ids[current_index] = strdup(mapping->id->str);
-					current_index++;
+					bidib_id_list_add(&list, mapping->id);
 				}
 			}
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 t_bidib_id_list_query bidib_get_connected_peripherals(void) {
 	t_bidib_id_list_query query = {0, NULL};
-	size_t count = 0;
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (board_ref != NULL && board_ref->connected) {
-			count += board_ref->peripherals->len;
-		}
-	}
-	if (count > 0) {
-		query.length = count;
-		query.ids = malloc(sizeof(char *) * count);
-		size_t current_index = 0;
+	do {
 		for (size_t i = 0; i < bidib_boards->len; i++) {
 			const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
 			if (board_ref != NULL && board_ref->connected) {
 				for (size_t j = 0; j < board_ref->peripherals->len; j++) {
 					const t_bidib_peripheral_mapping *const mapping = &g_array_index(
 							board_ref->peripherals, t_bidib_peripheral_mapping, j);
-					query.ids[current_index] = strdup(mapping->id->str);
-					current_index++;
+					bidib_id_list_add(&list, mapping->id);
 				}
 			}
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 t_bidib_id_list_query bidib_get_connected_segments(void) {
 	t_bidib_id_list_query query = {0, NULL};
-	size_t count = 0;
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (board_ref != NULL && board_ref->connected) {
-			count += board_ref->segments->len;
-		}
-	}
-	if (count > 0) {
-		query.length = count;
-		query.ids = malloc(sizeof(char *) * count);
-		size_t current_index = 0;
+	do {
 		for (size_t i = 0; i < bidib_boards->len; i++) {
 			const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
 			if (board_ref != NULL && board_ref->connected) {
 				for (size_t j = 0; j < board_ref->segments->len; j++) {
 					const t_bidib_segment_mapping *const mapping = &g_array_index(
 							board_ref->segments, t_bidib_segment_mapping, j);
-					query.ids[current_index] = strdup(mapping->id->str);
-					current_index++;
+					bidib_id_list_add(&list, mapping->id);
 				}
 			}
 		}
+	} while (bidib_id_list_next(&list));
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
+	return query;
+}
+
+t_bidib_board_occupancy_query bidib_get_board_occupancy(const char *board) {
+	t_bidib_board_occupancy_query query = {false, {0}};
+	if (board == NULL) {
+		return query;
+	}
+	size_t position;
+	// For bidib_state_index_lookup and bidib_state_index_get_board_routes
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+	const t_bidib_board_routes *routes = NULL;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_BOARDS, board, NULL, &position)) {
+		routes = bidib_state_index_get_board_routes(position);
+	}
+	if (routes != NULL) {
+		query.known = true;
+		for (size_t i = 0; i < BIDIB_BOARD_OCCUPANCY_WORDS; i++) {
+			query.occupied[i] = atomic_load_explicit(&routes->occupancy[i],
+			                                         memory_order_acquire);
+		}
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
 	return query;
 }
 
+// Shall only be called with bidib_boards_rwlock >= read acquired
+static void bidib_get_occupied_segments_list(t_bidib_id_list_builder *list) {
+	do {
+		for (size_t i = 0; i < bidib_boards->len; i++) {
+			const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
+			const t_bidib_board_routes *const routes = bidib_state_index_get_board_routes(i);
+			if (routes == NULL) {
+				continue;
+			}
+			for (size_t j = 0; j < BIDIB_BOARD_OCCUPANCY_WORDS; j++) {
+				uint64_t word = atomic_load_explicit(&routes->occupancy[j], memory_order_acquire);
+				while (word != 0) {
+					const size_t number = j * 64 + (size_t) __builtin_ctzll(word);
+					word &= word - 1;
+					if (routes->segments[number].mapping != 0) {
+						const t_bidib_segment_mapping *const mapping = &g_array_index(
+								board_ref->segments, t_bidib_segment_mapping,
+								routes->segments[number].mapping - 1);
+						bidib_id_list_add(list, mapping->id);
+					}
+				}
+			}
+		}
+	} while (bidib_id_list_next(list));
+}
+
+t_bidib_id_list_query bidib_get_occupied_segments(void) {
+	t_bidib_id_list_query query = {0, NULL};
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
+	// For bidib_get_occupied_segments_list
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+	bidib_get_occupied_segments_list(&list);
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
+	return query;
+}
+
+t_bidib_id_ref_list_query bidib_get_occupied_segments_ref(void) {
+	t_bidib_id_ref_list_query query = {0, NULL};
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(true);
+	// For bidib_get_occupied_segments_list
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+	bidib_get_occupied_segments_list(&list);
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = (const char *const *) list.ids;
+	return query;
+}
+
 t_bidib_id_list_query bidib_get_connected_reversers(void) {
 	t_bidib_id_list_query query = {0, NULL};
-	size_t count = 0;
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (board_ref != NULL && board_ref->connected) {
-			count += board_ref->reversers->len;
-		}
-	}
-	if (count > 0) {
-		query.length = count;
-		query.ids = malloc(sizeof(char *) * count);
-		size_t current_index = 0;
+	do {
 		for (size_t i = 0; i < bidib_boards->len; i++) {
 			const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
 			if (board_ref != NULL && board_ref->connected) {
 				for (size_t j = 0; j < board_ref->reversers->len; j++) {
 					const t_bidib_reverser_mapping *const mapping = &g_array_index(
 							board_ref->reversers, t_bidib_reverser_mapping, j);
-					query.ids[current_index] = strdup(mapping->id->str);
-					current_index++;
+					bidib_id_list_add(&list, mapping->id);
 				}
 			}
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 t_bidib_id_list_query bidib_get_connected_boosters(void) {
 	t_bidib_id_list_query query = {0, NULL};
-	size_t count = 0;
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (board_ref->connected && board_ref->unique_id.class_id & (1 << 1)) {
-			count++;
-		}
-	}
-	if (count > 0) {
-		query.length = count;
-		query.ids = malloc(sizeof(char *) * count);
-		size_t current_index = 0;
+	do {
 		for (size_t i = 0; i < bidib_boards->len; i++) {
 			const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
 			if (board_ref->connected && (board_ref->unique_id.class_id & (1 << 1))) {
-				query.ids[current_index] = strdup(board_ref->id->str);
-				current_index++;
+				bidib_id_list_add(&list, board_ref->id);
 			}
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 t_bidib_id_list_query bidib_get_boosters(void) {
 	t_bidib_id_list_query query = {0, NULL};
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For accessing bidib_track_state.boosters
 	pthread_mutex_lock(&trackstate_boosters_mutex);
-	if (bidib_track_state.boosters->len > 0) {
-		query.length = bidib_track_state.boosters->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		t_bidib_booster_state state_i;
+	do {
 		for (size_t i = 0; i < bidib_track_state.boosters->len; i++) {
-			state_i = g_array_index(bidib_track_state.boosters, t_bidib_booster_state, i);
-			query.ids[i] = strdup(state_i.id);
+			const t_bidib_booster_state *const state_i =
+			        &g_array_index(bidib_track_state.boosters, t_bidib_booster_state, i);
+			bidib_id_list_add(&list, state_i->id);
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_mutex_unlock(&trackstate_boosters_mutex);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 t_bidib_id_list_query bidib_get_connected_track_outputs(void) {
 	t_bidib_id_list_query query = {0, NULL};
-	size_t count = 0;
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (board_ref != NULL && board_ref->connected && board_ref->unique_id.class_id & (1 << 4)) {
-			count++;
-		}
-	}
-	if (count > 0) {
-		query.length = count;
-		query.ids = malloc(sizeof(char *) * count);
-		size_t current_index = 0;
+	do {
 		for (size_t i = 0; i < bidib_boards->len; i++) {
 			const t_bidib_board *const board_ref = &g_array_index(bidib_boards, t_bidib_board, i);
-			if (board_ref != NULL && board_ref->connected &&
-			    (board_ref->unique_id.class_id & (1 << 4))) {
-				query.ids[current_index] = strdup(board_ref->id->str);
-				current_index++;
+			if (board_ref != NULL && board_ref->connected && (board_ref->unique_id.class_id & (1 << 4))) {
+				bidib_id_list_add(&list, board_ref->id);
 			}
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 t_bidib_id_list_query bidib_get_track_outputs(void) {
 	t_bidib_id_list_query query = {0, NULL};
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For accessing bidib_track_state.track_outputs
 	pthread_mutex_lock(&trackstate_track_outputs_mutex);
-	
-	if (bidib_track_state.track_outputs->len > 0) {
-		query.length = bidib_track_state.track_outputs->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		t_bidib_track_output_state state_i;
+	do {
 		for (size_t i = 0; i < bidib_track_state.track_outputs->len; i++) {
-			state_i = g_array_index(bidib_track_state.track_outputs,
-			                        t_bidib_track_output_state, i);
-			query.ids[i] = strdup(state_i.id);
+			const t_bidib_track_output_state *const state_i =
+			        &g_array_index(bidib_track_state.track_outputs, t_bidib_track_output_state, i);
+			bidib_id_list_add(&list, state_i->id);
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_mutex_unlock(&trackstate_track_outputs_mutex);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
@@ -818,7 +1099,7 @@ size_t bidib_get_segment_state_index(const char *segment) {
 	for (size_t i = 0; i < bidib_track_state.segments->len; i++) {
 		const t_bidib_segment_state_intern *const segment_state_i = &g_array_index(
 			bidib_track_state.segments, t_bidib_segment_state_intern, i);
-		if (!strcmp(segment_state_i->id->str, segment)) {
+		if (!strcmp(segment_state_i->id, segment)) {
 			pthread_mutex_unlock(&trackstate_segments_mutex);
 			return i;
 		}
@@ -827,155 +1108,491 @@ size_t bidib_get_segment_state_index(const char *segment) {
 	return -1;
 }
 
-t_bidib_unified_accessory_state_query bidib_get_point_state(const char *point) {
-	t_bidib_unified_accessory_state_query query = { .known = false };
-	if (point == NULL) {
-		return query;
-	}
-	
-	
-	// For bidib_state_get_board_accessory_state_ref and bidib_state_get_dcc_accessory_state_ref
-	pthread_mutex_lock(&trackstate_accessories_mutex);
-	
+// Fills the query with the state of a point or signal, whose state id is not
+// copied. Shall only be called with trackstate_accessories_mutex acquired.
+static const char *bidib_get_accessory_state_ref(const char *accessory, bool point,
+                                                 t_bidib_unified_accessory_state_query *query) {
 	const t_bidib_board_accessory_state *const board_accessory_tmp = 
-	        bidib_state_get_board_accessory_state_ref(point, true);
+	        bidib_state_get_board_accessory_state_ref(accessory, point);
 	if (board_accessory_tmp != NULL) {
-		query.known = true;
-		query.type = BIDIB_ACCESSORY_BOARD;
-		char *state_id;
-		if (board_accessory_tmp->data.state_id != NULL) {
-			state_id = board_accessory_tmp->data.state_id;
-		} else {
-			state_id = "unknown";
+		query->known = true;
+		query->type = BIDIB_ACCESSORY_BOARD;
+		query->board_accessory_state = board_accessory_tmp->data;
+		if (query->board_accessory_state.state_id == NULL) {
+			query->board_accessory_state.state_id = "unknown";
 		}
-		query.board_accessory_state.state_id = strdup(state_id);
-		query.board_accessory_state.state_value = board_accessory_tmp->data.state_value;
-		query.board_accessory_state.execution_state = board_accessory_tmp->data.execution_state;
-		query.board_accessory_state.wait_details = board_accessory_tmp->data.wait_details;
-	} else {
-		const t_bidib_dcc_accessory_state *const dcc_tmp = 
-		        bidib_state_get_dcc_accessory_state_ref(point, true);
-		if (dcc_tmp != NULL) {
-			query.known = true;
-			query.type = BIDIB_ACCESSORY_DCC;
-			char *state_id;
-			if (dcc_tmp->data.state_id != NULL) {
-				state_id = dcc_tmp->data.state_id;
-			} else {
-				state_id = "unknown";
-			}
-			query.dcc_accessory_state.state_id = strdup(state_id);
-			query.dcc_accessory_state.state_value = dcc_tmp->data.state_value;
-			query.dcc_accessory_state.coil_on = dcc_tmp->data.coil_on;
-			query.dcc_accessory_state.time_unit = dcc_tmp->data.time_unit;
-			query.dcc_accessory_state.switch_time = dcc_tmp->data.switch_time;
+		query->received_ns = bidib_state_get_receive_time(
+				point ? BIDIB_STATE_INDEX_POINTS_BOARD : BIDIB_STATE_INDEX_SIGNALS_BOARD,
+				board_accessory_tmp);
+		return board_accessory_tmp->id;
+	}
+	const t_bidib_dcc_accessory_state *const dcc_tmp = 
+	        bidib_state_get_dcc_accessory_state_ref(accessory, point);
+	if (dcc_tmp != NULL) {
+		query->known = true;
+		query->type = BIDIB_ACCESSORY_DCC;
+		query->dcc_accessory_state = dcc_tmp->data;
+		if (query->dcc_accessory_state.state_id == NULL) {
+			query->dcc_accessory_state.state_id = "unknown";
 		}
+		query->received_ns = bidib_state_get_receive_time(
+				point ? BIDIB_STATE_INDEX_POINTS_DCC : BIDIB_STATE_INDEX_SIGNALS_DCC, dcc_tmp);
+		return dcc_tmp->id;
 	}
-	pthread_mutex_unlock(&trackstate_accessories_mutex);
-	return query;
+	query->known = false;
+	query->received_ns = 0;
+	return NULL;
 }
 
-t_bidib_unified_accessory_state_query bidib_get_signal_state(const char *signal) {
+static char **bidib_get_accessory_state_id_ref(t_bidib_unified_accessory_state_query *query) {
+	if (query->type == BIDIB_ACCESSORY_BOARD) {
+		return &query->board_accessory_state.state_id;
+	} else {
+		return &query->dcc_accessory_state.state_id;
+	}
+}
+
+static t_bidib_unified_accessory_state_query bidib_get_accessory_state(const char *accessory,
+                                                                       bool point) {
 	t_bidib_unified_accessory_state_query query = { .known = false };
-	if (signal == NULL) {
+	if (accessory == NULL) {
 		return query;
 	}
 	// For bidib_state_get_board_accessory_state_ref and bidib_state_get_dcc_accessory_state_ref
 	pthread_mutex_lock(&trackstate_accessories_mutex);
-	
-	const t_bidib_board_accessory_state *const board_accessory_tmp = 
-	        bidib_state_get_board_accessory_state_ref(signal, false);
-	if (board_accessory_tmp != NULL) {
-		query.known = true;
-		query.type = BIDIB_ACCESSORY_BOARD;
-		char *state_id;
-		if (board_accessory_tmp->data.state_id != NULL) {
-			state_id = board_accessory_tmp->data.state_id;
-		} else {
-			state_id = "unknown";
-		}
-		query.board_accessory_state.state_id = strdup(state_id);
-		query.board_accessory_state.state_value = board_accessory_tmp->data.state_value;
-		query.board_accessory_state.execution_state = board_accessory_tmp->data.execution_state;
-		query.board_accessory_state.wait_details = board_accessory_tmp->data.wait_details;
-	} else {
-		const t_bidib_dcc_accessory_state *const dcc_tmp = 
-		        bidib_state_get_dcc_accessory_state_ref(signal, false);
-		if (dcc_tmp != NULL) {
-			query.known = true;
-			query.type = BIDIB_ACCESSORY_DCC;
-			char *state_id;
-			if (dcc_tmp->data.state_id != NULL) {
-				state_id = dcc_tmp->data.state_id;
-			} else {
-				state_id = "unknown";
-			}
-			query.dcc_accessory_state.state_id = strdup(state_id);
-			query.dcc_accessory_state.state_value = dcc_tmp->data.state_value;
-			query.dcc_accessory_state.time_unit = dcc_tmp->data.time_unit;
-			query.dcc_accessory_state.switch_time = dcc_tmp->data.switch_time;
-		}
+	if (bidib_get_accessory_state_ref(accessory, point, &query) != NULL) {
+		char **state_id = bidib_get_accessory_state_id_ref(&query);
+		*state_id = strdup(*state_id);
 	}
 	pthread_mutex_unlock(&trackstate_accessories_mutex);
 	return query;
 }
 
-t_bidib_peripheral_state_query bidib_get_peripheral_state(const char *peripheral) {
-	t_bidib_peripheral_state_query query;
-	query.available = false;
-	if (peripheral == NULL) {
-		return query;
+static bool bidib_visit_accessory_state(const char *accessory, bool point,
+                                        t_bidib_accessory_state_visitor visitor, void *ctx) {
+	if (accessory == NULL || visitor == NULL) {
+		return false;
 	}
-	// For bidib_state_get_peripheral_state_ref
-	pthread_mutex_lock(&trackstate_peripherals_mutex);
-	
-	const t_bidib_peripheral_state *const tmp = bidib_state_get_peripheral_state_ref(peripheral);
-	if (tmp != NULL) {
-		query.available = true;
-		char *state_id;
-		if (tmp->data.state_id != NULL) {
-			state_id = tmp->data.state_id;
+	t_bidib_unified_accessory_state_query query;
+	// For bidib_state_get_board_accessory_state_ref and bidib_state_get_dcc_accessory_state_ref
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	const char *id = bidib_get_accessory_state_ref(accessory, point, &query);
+	if (id != NULL) {
+		visitor(id, &query, ctx);
+	}
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+	return id != NULL;
+}
+
+static bool bidib_get_accessory_state_buf(const char *accessory, bool point,
+                                          t_bidib_unified_accessory_state_query *query,
+                                          char *state_id, size_t state_id_size) {
+	if (accessory == NULL || query == NULL) {
+		return false;
+	}
+	// For bidib_state_get_board_accessory_state_ref and bidib_state_get_dcc_accessory_state_ref
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	if (bidib_get_accessory_state_ref(accessory, point, query) != NULL) {
+		char **state_id_ref = bidib_get_accessory_state_id_ref(query);
+		if (state_id != NULL && state_id_size > 0) {
+			snprintf(state_id, state_id_size, "%s", *state_id_ref);
+			*state_id_ref = state_id;
 		} else {
-			state_id = "unknown";
+			*state_id_ref = NULL;
 		}
-		query.data.state_id = strdup(state_id);
-		query.data.state_value = tmp->data.state_value;
-		query.data.time_unit = tmp->data.time_unit;
-		query.data.wait = tmp->data.wait;
+	}
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+	return query->known;
+}
+
+// Shall only be called with trackstate_accessories_mutex acquired
+static t_bidib_unified_accessory_state_query *bidib_get_accessory_states_block(
+		t_bidib_query_block *block, const char *const *accessories, size_t count, bool point) {
+	t_bidib_unified_accessory_state_query *states =
+			bidib_query_block_array(block, t_bidib_unified_accessory_state_query, count);
+	for (size_t i = 0; i < count; i++) {
+		t_bidib_unified_accessory_state_query state = { .known = false };
+		if (accessories[i] != NULL &&
+		    bidib_get_accessory_state_ref(accessories[i], point, &state) != NULL) {
+			char **state_id = bidib_get_accessory_state_id_ref(&state);
+			*state_id = bidib_query_block_strdup(block, *state_id);
+		}
+		if (states != NULL) {
+			states[i] = state;
+		}
+	}
+	return states;
+}
+
+static t_bidib_unified_accessory_state_list_query bidib_get_accessory_states(
+		const char *const *accessories, size_t count, bool point) {
+	t_bidib_unified_accessory_state_list_query query = {0, NULL};
+	if (accessories == NULL || count == 0) {
+		return query;
+	}
+	t_bidib_query_block block = {NULL, 0, 0};
+	// For bidib_get_accessory_states_block
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	do {
+		query.states = bidib_get_accessory_states_block(&block, accessories, count, point);
+	} while (bidib_query_block_next(&block));
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+	query.length = count;
+	return query;
+}
+
+t_bidib_unified_accessory_state_query bidib_get_point_state(const char *point) {
+	return bidib_get_accessory_state(point, true);
+}
+
+bool bidib_visit_point_state(const char *point, t_bidib_accessory_state_visitor visitor,
+                             void *ctx) {
+	return bidib_visit_accessory_state(point, true, visitor, ctx);
+}
+
+bool bidib_get_point_state_buf(const char *point, t_bidib_unified_accessory_state_query *query,
+                               char *state_id, size_t state_id_size) {
+	return bidib_get_accessory_state_buf(point, true, query, state_id, state_id_size);
+}
+
+t_bidib_unified_accessory_state_list_query bidib_get_point_states(const char *const *points,
+                                                                  size_t count) {
+	return bidib_get_accessory_states(points, count, true);
+}
+
+t_bidib_unified_accessory_state_query bidib_get_signal_state(const char *signal) {
+	return bidib_get_accessory_state(signal, false);
+}
+
+bool bidib_visit_signal_state(const char *signal, t_bidib_accessory_state_visitor visitor,
+                              void *ctx) {
+	return bidib_visit_accessory_state(signal, false, visitor, ctx);
+}
+
+bool bidib_get_signal_state_buf(const char *signal, t_bidib_unified_accessory_state_query *query,
+                                char *state_id, size_t state_id_size) {
+	return bidib_get_accessory_state_buf(signal, false, query, state_id, state_id_size);
+}
+
+t_bidib_unified_accessory_state_list_query bidib_get_signal_states(const char *const *signals,
+                                                                   size_t count) {
+	return bidib_get_accessory_states(signals, count, false);
+}
+
+void bidib_wait_deadline(unsigned int timeout_ms, struct timespec *deadline) {
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += timeout_ms / 1000;
+	deadline->tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+bool bidib_wait_deadline_passed(const struct timespec *deadline) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec > deadline->tv_sec ||
+	       (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+// Evaluates the predicate after every change of the track state until it holds
+static bool bidib_wait_until(bool (*predicate)(const char *, const char *),
+                             const char *id, const char *arg, unsigned int timeout_ms) {
+	if (id == NULL || arg == NULL) {
+		return false;
+	}
+	struct timespec deadline;
+	bidib_wait_deadline(timeout_ms, &deadline);
+	while (bidib_running) {
+		// Read before the predicate, so that no change in between is missed
+		const uint64_t seq = bidib_state_get_change_seq();
+		if (predicate(id, arg)) {
+			return true;
+		}
+		if (bidib_wait_deadline_passed(&deadline)) {
+			return false;
+		}
+		bidib_state_wait_change(seq, &deadline);
+	}
+	return false;
+}
+
+static bool bidib_segment_has_train(const char *segment, const char *train) {
+	bool has_train = false;
+	// For bidib_state_get_train_ref
+	pthread_rwlock_rdlock(&bidib_trains_rwlock);
+	const t_bidib_train *const train_ref = bidib_state_get_train_ref(train);
+	if (train_ref != NULL) {
+		// For bidib_state_get_segment_state_ref
+		pthread_mutex_lock(&trackstate_segments_mutex);
+		const t_bidib_segment_state_intern *const segment_state =
+				bidib_state_get_segment_state_ref(segment);
+		if (segment_state != NULL) {
+			for (size_t i = 0; i < segment_state->dcc_addresses->len && !has_train; i++) {
+				const t_bidib_dcc_address *const dcc_address =
+						&g_array_index(segment_state->dcc_addresses, t_bidib_dcc_address, i);
+				has_train = dcc_address->addrh == train_ref->dcc_addr.addrh &&
+				            dcc_address->addrl == train_ref->dcc_addr.addrl;
+			}
+		}
+		pthread_mutex_unlock(&trackstate_segments_mutex);
+	}
+	pthread_rwlock_unlock(&bidib_trains_rwlock);
+	return has_train;
+}
+
+static bool bidib_point_has_aspect(const char *point, const char *aspect) {
+	t_bidib_unified_accessory_state_query query;
+	// For bidib_state_get_board_accessory_state_ref and bidib_state_get_dcc_accessory_state_ref
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	const bool has_aspect = bidib_get_accessory_state_ref(point, true, &query) != NULL &&
+	                        strcmp(*bidib_get_accessory_state_id_ref(&query), aspect) == 0;
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+	return has_aspect;
+}
+
+uint64_t bidib_wait_for_changes(uint64_t seq, unsigned int timeout_ms) {
+	struct timespec deadline;
+	bidib_wait_deadline(timeout_ms, &deadline);
+	uint64_t current = bidib_state_get_change_seq();
+	while (bidib_running && current == seq && !bidib_wait_deadline_passed(&deadline)) {
+		current = bidib_state_wait_change(seq, &deadline);
+	}
+	return current;
+}
+
+bool bidib_wait_segment_has_train(const char *segment, const char *train,
+                                  unsigned int timeout_ms) {
+	return bidib_wait_until(bidib_segment_has_train, segment, train, timeout_ms);
+}
+
+bool bidib_wait_point_state(const char *point, const char *aspect, unsigned int timeout_ms) {
+	return bidib_wait_until(bidib_point_has_aspect, point, aspect, timeout_ms);
+}
+
+// Fills the data with the state of a peripheral, whose state id is not copied, and
+// the receive time if received_ns is not NULL.
+// Shall only be called with trackstate_peripherals_mutex acquired.
+static const char *bidib_get_peripheral_state_data_ref(const char *peripheral,
+                                                       t_bidib_peripheral_state_data *data,
+                                                       uint64_t *received_ns) {
+	const t_bidib_peripheral_state *const tmp = bidib_state_get_peripheral_state_ref(peripheral);
+	if (tmp == NULL) {
+		return NULL;
+	}
+	*data = tmp->data;
+	if (received_ns != NULL) {
+		*received_ns = bidib_state_get_receive_time(BIDIB_STATE_INDEX_PERIPHERALS, tmp);
+	}
+	if (data->state_id == NULL) {
+		data->state_id = "unknown";
+	}
+	return tmp->id;
+}
+
+t_bidib_peripheral_state_query bidib_get_peripheral_state(const char *peripheral) {
+	t_bidib_peripheral_state_query query;
+	query.available = false;
+	query.received_ns = 0;
+	if (peripheral == NULL) {
+		return query;
+	}
+	// For bidib_state_get_peripheral_state_ref
+	pthread_mutex_lock(&trackstate_peripherals_mutex);
+	if (bidib_get_peripheral_state_data_ref(peripheral, &query.data, &query.received_ns) != NULL) {
+		query.available = true;
+		query.data.state_id = strdup(query.data.state_id);
 	}
 	pthread_mutex_unlock(&trackstate_peripherals_mutex);
 	return query;
 }
 
+bool bidib_visit_peripheral_state(const char *peripheral,
+                                  t_bidib_peripheral_state_visitor visitor, void *ctx) {
+	if (peripheral == NULL || visitor == NULL) {
+		return false;
+	}
+	t_bidib_peripheral_state_data data;
+	// For bidib_state_get_peripheral_state_ref
+	pthread_mutex_lock(&trackstate_peripherals_mutex);
+	const char *id = bidib_get_peripheral_state_data_ref(peripheral, &data, NULL);
+	if (id != NULL) {
+		visitor(id, &data, ctx);
+	}
+	pthread_mutex_unlock(&trackstate_peripherals_mutex);
+	return id != NULL;
+}
+
+bool bidib_get_peripheral_state_buf(const char *peripheral, t_bidib_peripheral_state_data *data,
+                                    char *state_id, size_t state_id_size) {
+	if (peripheral == NULL || data == NULL) {
+		return false;
+	}
+	// For bidib_state_get_peripheral_state_ref
+	pthread_mutex_lock(&trackstate_peripherals_mutex);
+	bool known = bidib_get_peripheral_state_data_ref(peripheral, data, NULL) != NULL;
+	if (known) {
+		if (state_id != NULL && state_id_size > 0) {
+			snprintf(state_id, state_id_size, "%s", data->state_id);
+			data->state_id = state_id;
+		} else {
+			data->state_id = NULL;
+		}
+	}
+	pthread_mutex_unlock(&trackstate_peripherals_mutex);
+	return known;
+}
+
+// Looks up a segment state and acquires its shard lock, or trackstate_segments_mutex
+// if no board maps the segment. The lock is returned in lock.
+static const t_bidib_segment_state_intern *bidib_lock_segment_state(const char *segment,
+                                                                    pthread_mutex_t **lock) {
+	const t_bidib_segment_state_intern *const segment_state =
+			bidib_state_get_segment_state_ref(segment);
+	if (segment_state == NULL) {
+		return NULL;
+	}
+	*lock = bidib_state_index_segment_lock(segment_state);
+	if (*lock == NULL) {
+		*lock = &trackstate_segments_mutex;
+	}
+	pthread_mutex_lock(*lock);
+	return segment_state;
+}
+
+// Fills the data with the state of a segment, whose dcc addresses are not copied.
+// Shall only be called with the lock of the segment acquired.
+static const char *bidib_get_segment_state_data_ref(const t_bidib_segment_state_intern *tmp,
+                                                    t_bidib_segment_state_data *data) {
+	data->occupied = tmp->occupied;
+	data->confidence = tmp->confidence;
+	data->power_consumption = tmp->power_consumption;
+	data->dcc_address_cnt = tmp->dcc_addresses->len;
+	data->dcc_addresses = (t_bidib_dcc_address *) tmp->dcc_addresses->data;
+	return tmp->id;
+}
+
 t_bidib_segment_state_query bidib_get_segment_state(const char *segment) {
 	t_bidib_segment_state_query query;
 	query.known = false;
+	query.received_ns = 0;
 	query.data.dcc_addresses = NULL;
 	if (segment == NULL) {
 		return query;
 	}
-	// For bidib_state_get_segment_state_ref
-	pthread_mutex_lock(&trackstate_segments_mutex);
-	
-	const t_bidib_segment_state_intern *const tmp = bidib_state_get_segment_state_ref(segment);
-	if (tmp != NULL) {
+	pthread_mutex_t *lock;
+	const t_bidib_segment_state_intern *const segment_state =
+			bidib_lock_segment_state(segment, &lock);
+	if (segment_state != NULL) {
+		bidib_get_segment_state_data_ref(segment_state, &query.data);
 		query.known = true;
-		query.data.occupied = tmp->occupied;
-		query.data.confidence = tmp->confidence;
-		query.data.power_consumption = tmp->power_consumption;
-		query.data.dcc_address_cnt = tmp->dcc_addresses->len;
+		query.received_ns = bidib_state_get_receive_time(BIDIB_STATE_INDEX_SEGMENTS,
+		                                                 segment_state);
+		const t_bidib_dcc_address *const dcc_addresses = query.data.dcc_addresses;
 		query.data.dcc_addresses = malloc(
-				sizeof(t_bidib_dcc_address) * tmp->dcc_addresses->len);
-		memcpy(query.data.dcc_addresses, tmp->dcc_addresses->data,
-		       sizeof(t_bidib_dcc_address) * tmp->dcc_addresses->len);
+				sizeof(t_bidib_dcc_address) * query.data.dcc_address_cnt);
+		memcpy(query.data.dcc_addresses, dcc_addresses,
+		       sizeof(t_bidib_dcc_address) * query.data.dcc_address_cnt);
+		pthread_mutex_unlock(lock);
+	}
+	return query;
+}
+
+bool bidib_visit_segment_state(const char *segment, t_bidib_segment_state_visitor visitor,
+                               void *ctx) {
+	if (segment == NULL || visitor == NULL) {
+		return false;
 	}
+	t_bidib_segment_state_data data;
+	pthread_mutex_t *lock;
+	const t_bidib_segment_state_intern *const segment_state =
+			bidib_lock_segment_state(segment, &lock);
+	if (segment_state == NULL) {
+		return false;
+	}
+	visitor(bidib_get_segment_state_data_ref(segment_state, &data), &data, ctx);
+	pthread_mutex_unlock(lock);
+	return true;
+}
+
+bool bidib_get_segment_state_buf(const char *segment, t_bidib_segment_state_data *data,
+                                 t_bidib_dcc_address *dcc_addresses, size_t dcc_address_capacity) {
+	if (segment == NULL || data == NULL) {
+		return false;
+	}
+	pthread_mutex_t *lock;
+	const t_bidib_segment_state_intern *const segment_state =
+			bidib_lock_segment_state(segment, &lock);
+	if (segment_state == NULL) {
+		return false;
+	}
+	bidib_get_segment_state_data_ref(segment_state, data);
+	size_t copied = data->dcc_address_cnt < dcc_address_capacity
+	                ? data->dcc_address_cnt : dcc_address_capacity;
+	if (copied > 0) {
+		memcpy(dcc_addresses, data->dcc_addresses, sizeof(t_bidib_dcc_address) * copied);
+	}
+	data->dcc_addresses = dcc_addresses;
+	pthread_mutex_unlock(lock);
+	return true;
+}
+
+// Shall only be called with trackstate_segments_mutex and the shard locks acquired
+static t_bidib_segment_state_query *bidib_get_segment_states_block(
+		t_bidib_query_block *block, const char *const *segments, size_t count) {
+	t_bidib_segment_state_query *states =
+			bidib_query_block_array(block, t_bidib_segment_state_query, count);
+	for (size_t i = 0; i < count; i++) {
+		t_bidib_segment_state_query state;
+		state.known = false;
+		state.received_ns = 0;
+		state.data.dcc_addresses = NULL;
+		const t_bidib_segment_state_intern *const segment_state =
+				segments[i] != NULL ? bidib_state_get_segment_state_ref(segments[i]) : NULL;
+		if (segment_state != NULL) {
+			bidib_get_segment_state_data_ref(segment_state, &state.data);
+			state.known = true;
+			state.received_ns = bidib_state_get_receive_time(BIDIB_STATE_INDEX_SEGMENTS,
+			                                                 segment_state);
+			const t_bidib_dcc_address *const dcc_addresses = state.data.dcc_addresses;
+			state.data.dcc_addresses = bidib_query_block_array(
+					block, t_bidib_dcc_address, state.data.dcc_address_cnt);
+			if (state.data.dcc_addresses != NULL) {
+				memcpy(state.data.dcc_addresses, dcc_addresses,
+				       sizeof(t_bidib_dcc_address) * state.data.dcc_address_cnt);
+			}
+		}
+		if (states != NULL) {
+			states[i] = state;
+		}
+	}
+	return states;
+}
+
+t_bidib_segment_state_list_query bidib_get_segment_states(const char *const *segments,
+                                                          size_t count) {
+	t_bidib_segment_state_list_query query = {0, NULL};
+	if (segments == NULL || count == 0) {
+		return query;
+	}
+	t_bidib_query_block block = {NULL, 0, 0};
+	// For bidib_get_segment_states_block
+	pthread_mutex_lock(&trackstate_segments_mutex);
+	bidib_state_index_lock_segment_shards();
+	do {
+		query.states = bidib_get_segment_states_block(&block, segments, count);
+	} while (bidib_query_block_next(&block));
+	bidib_state_index_unlock_segment_shards();
 	pthread_mutex_unlock(&trackstate_segments_mutex);
+	query.length = count;
 	return query;
 }
 
 t_bidib_reverser_state_query bidib_get_reverser_state(const char *reverser) {
 	t_bidib_reverser_state_query query;
 	query.available = false;
+	query.received_ns = 0;
 	if (reverser == NULL) {
 		return query;
 	}
@@ -993,6 +1610,7 @@ t_bidib_reverser_state_query bidib_get_reverser_state(const char *reverser) {
 		}
 		query.data.state_id = strdup(state_id);
 		query.data.state_value = tmp->data.state_value;
+		query.received_ns = bidib_state_get_receive_time(BIDIB_STATE_INDEX_REVERSERS, tmp);
 	}
 	pthread_mutex_unlock(&trackstate_reversers_mutex);
 	return query;
@@ -1001,6 +1619,7 @@ t_bidib_reverser_state_query bidib_get_reverser_state(const char *reverser) {
 t_bidib_booster_state_query bidib_get_booster_state(const char *booster) {
 	t_bidib_booster_state_query query;
 	query.known = false;
+	query.received_ns = 0;
 	if (booster == NULL) {
 		return query;
 	}
@@ -1017,6 +1636,7 @@ t_bidib_booster_state_query bidib_get_booster_state(const char *booster) {
 		query.data.voltage = tmp->data.voltage;
 		query.data.temp_known = tmp->data.temp_known;
 		query.data.temp_celsius = tmp->data.temp_celsius;
+		query.received_ns = bidib_state_get_receive_time(BIDIB_STATE_INDEX_BOOSTERS, tmp);
 	}
 	pthread_mutex_unlock(&trackstate_boosters_mutex);
 	return query;
@@ -1025,6 +1645,7 @@ t_bidib_booster_state_query bidib_get_booster_state(const char *booster) {
 t_bidib_track_output_state_query bidib_get_track_output_state(const char *track_output) {
 	t_bidib_track_output_state_query query;
 	query.known = false;
+	query.received_ns = 0;
 	if (track_output == NULL) {
 		return query;
 	}
@@ -1035,6 +1656,7 @@ t_bidib_track_output_state_query bidib_get_track_output_state(const char *track_
 	if (tmp != NULL) {
 		query.known = true;
 		query.cs_state = tmp->cs_state;
+		query.received_ns = bidib_state_get_receive_time(BIDIB_STATE_INDEX_TRACK_OUTPUTS, tmp);
 	}
 	pthread_mutex_unlock(&trackstate_track_outputs_mutex);
 	return query;
@@ -1042,47 +1664,55 @@ t_bidib_track_output_state_query bidib_get_track_output_state(const char *track_
 
 t_bidib_id_list_query bidib_get_trains(void) {
 	t_bidib_id_list_query query = {0, NULL};
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For accessing bidib_trains
 	pthread_rwlock_rdlock(&bidib_trains_rwlock);
-	if (bidib_trains->len > 0) {
-		query.length = bidib_trains->len;
-		query.ids = malloc(sizeof(char *) * query.length);
+	do {
 		for (size_t i = 0; i < bidib_trains->len; i++) {
 			const t_bidib_train *const train_i = &g_array_index(bidib_trains, t_bidib_train, i);
-			query.ids[i] = strdup(train_i->id->str);
+			bidib_id_list_add(&list, train_i->id);
 		}
-	}
+	} while (bidib_id_list_next(&list));
 	pthread_rwlock_unlock(&bidib_trains_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
-t_bidib_id_list_query bidib_get_trains_on_track(void) {
-	t_bidib_id_list_query query = {0, NULL};
-	size_t count = 0;
-	// For accessing bidib_track_state.trains
-	pthread_mutex_lock(&trackstate_trains_mutex); 
-	
-	for (size_t i = 0; i < bidib_track_state.trains->len; i++) {
-		const t_bidib_train_state_intern *const train_state_tmp =
-		    &g_array_index(bidib_track_state.trains, t_bidib_train_state_intern, i);
-		if (train_state_tmp->on_track) {
-			count++;
-		}
-	}
-	if (count > 0) {
-		query.length = count;
-		query.ids = malloc(sizeof(char *) * count);
-		size_t current_index = 0;
-		for (size_t i = 0; i < bidib_track_state.trains->len && current_index < count; i++) {
+// Shall only be called with trackstate_trains_mutex acquired
+static void bidib_get_trains_on_track_list(t_bidib_id_list_builder *list) {
+	do {
+		for (size_t i = 0; i < bidib_track_state.trains->len; i++) {
 			const t_bidib_train_state_intern *const tmp = 
 			        &g_array_index(bidib_track_state.trains, t_bidib_train_state_intern, i);
 			if (tmp->on_track) {
-				query.ids[current_index] = strdup(tmp->id->str);
-				current_index++;
+				bidib_id_list_add(list, tmp->id);
 			}
 		}
-	}
+	} while (bidib_id_list_next(list));
+}
+
+t_bidib_id_list_query bidib_get_trains_on_track(void) {
+	t_bidib_id_list_query query = {0, NULL};
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
+	// For bidib_get_trains_on_track_list
+	pthread_mutex_lock(&trackstate_trains_mutex);
+	bidib_get_trains_on_track_list(&list);
+	pthread_mutex_unlock(&trackstate_trains_mutex);
+	query.length = list.length;
+	query.ids = list.ids;
+	return query;
+}
+
+t_bidib_id_ref_list_query bidib_get_trains_on_track_ref(void) {
+	t_bidib_id_ref_list_query query = {0, NULL};
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(true);
+	// For bidib_get_trains_on_track_list
+	pthread_mutex_lock(&trackstate_trains_mutex);
+	bidib_get_trains_on_track_list(&list);
 	pthread_mutex_unlock(&trackstate_trains_mutex);
+	query.length = list.length;
+	query.ids = (const char *const *) list.ids;
 	return query;
 }
 
@@ -1095,7 +1725,7 @@ t_bidib_id_query bidib_get_train_id(t_bidib_dcc_address dcc_address) {
 		if (train_i->dcc_addr.addrl == dcc_address.addrl &&
 		    train_i->dcc_addr.addrh == dcc_address.addrh) {
 			query.known = true;
-			query.id = strdup(train_i->id->str);
+			query.id = strdup(train_i->id);
 			break;
 		}
 	}
@@ -1127,56 +1757,150 @@ t_bidib_id_list_query bidib_get_train_peripherals(const char *train) {
 	if (train == NULL) {
 		return query;
 	}
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For bidib_state_get_train_ref
 	pthread_rwlock_rdlock(&bidib_trains_rwlock);
 	const t_bidib_train *const tmp = bidib_state_get_train_ref(train);
 	if (tmp != NULL) {
-		query.length = tmp->peripherals->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		for (size_t i = 0; i < query.length; i++) {
-			const t_bidib_train_peripheral_mapping *const mapping_i = 
-			        &g_array_index(tmp->peripherals, t_bidib_train_peripheral_mapping, i);
-			query.ids[i] = strdup(mapping_i->id->str);
-		}
+		do {
+			for (size_t i = 0; i < tmp->peripherals->len; i++) {
+				const t_bidib_train_peripheral_mapping *const mapping_i = 
+				        &g_array_index(tmp->peripherals, t_bidib_train_peripheral_mapping, i);
+				bidib_id_list_add(&list, mapping_i->id);
+			}
+		} while (bidib_id_list_next(&list));
 	}
 	pthread_rwlock_unlock(&bidib_trains_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
+// Fills the data with the state of a train, whose peripherals are not copied, and
+// the receive time if received_ns is not NULL.
+// Shall only be called with trackstate_trains_mutex acquired.
+static const char *bidib_get_train_state_data_ref(const char *train,
+                                                  t_bidib_train_state_data *data,
+                                                  uint64_t *received_ns) {
+	const t_bidib_train_state_intern *const train_state = bidib_state_get_train_state_ref(train);
+	if (train_state == NULL) {
+		return NULL;
+	}
+	if (received_ns != NULL) {
+		*received_ns = bidib_state_get_receive_time(BIDIB_STATE_INDEX_TRAIN_STATES, train_state);
+	}
+	data->on_track = train_state->on_track;
+	data->orientation = train_state->orientation;
+	data->set_speed_step = train_state->set_speed_step;
+	data->set_is_forwards = train_state->set_is_forwards;
+	data->detected_kmh_speed = train_state->detected_kmh_speed;
+	data->ack = train_state->ack;
+	data->peripheral_cnt = train_state->peripherals->len;
+	data->peripherals = (t_bidib_train_peripheral_state *) train_state->peripherals->data;
+	data->decoder_state = train_state->decoder_state;
+	return train_state->id;
+}
+
 t_bidib_train_state_query bidib_get_train_state(const char *train) {
 	t_bidib_train_state_query query;
 	query.known = false;
+	query.received_ns = 0;
 	query.data.peripherals = NULL;
 	if (train == NULL) {
 		return query;
 	}
 	// For bidib_state_get_train_state_ref
 	pthread_mutex_lock(&trackstate_trains_mutex);
-	
-	const t_bidib_train_state_intern *const train_state = bidib_state_get_train_state_ref(train);
-	if (train_state != NULL) {
+	if (bidib_get_train_state_data_ref(train, &query.data, &query.received_ns) != NULL) {
 		query.known = true;
-		query.data.on_track = train_state->on_track;
-		query.data.orientation = train_state->orientation;
-		query.data.set_speed_step = train_state->set_speed_step;
-		query.data.set_is_forwards = train_state->set_is_forwards;
-		query.data.detected_kmh_speed = train_state->detected_kmh_speed;
-		query.data.ack = train_state->ack;
-		query.data.peripheral_cnt = train_state->peripherals->len;
-		query.data.peripherals = malloc(
-		        sizeof(t_bidib_train_peripheral_state) * query.data.peripheral_cnt);
-		for (size_t i = 0; i < query.data.peripheral_cnt; i++) {
-			const t_bidib_train_peripheral_state peripheral_state_i = g_array_index(
-			        train_state->peripherals, t_bidib_train_peripheral_state, i);
-			query.data.peripherals[i].id = strdup(peripheral_state_i.id);
-			query.data.peripherals[i].state = peripheral_state_i.state;
+		// The peripherals and their ids are placed in one block
+		const t_bidib_train_peripheral_state *const peripherals = query.data.peripherals;
+		t_bidib_query_block block = {NULL, 0, 0};
+		do {
+			query.data.peripherals = bidib_get_state_train_peripherals(
+					&block, peripherals, query.data.peripheral_cnt);
+		} while (bidib_query_block_next(&block));
+	}
+	pthread_mutex_unlock(&trackstate_trains_mutex);
+	return query;
+}
+
+// Shall only be called with trackstate_trains_mutex acquired
+static t_bidib_train_state_query *bidib_get_train_states_block(
+		t_bidib_query_block *block, const char *const *trains, size_t count) {
+	t_bidib_train_state_query *states =
+			bidib_query_block_array(block, t_bidib_train_state_query, count);
+	for (size_t i = 0; i < count; i++) {
+		t_bidib_train_state_query state;
+		state.known = false;
+		state.received_ns = 0;
+		state.data.peripherals = NULL;
+		if (trains[i] != NULL && bidib_get_train_state_data_ref(trains[i], &state.data,
+		                                                        &state.received_ns) != NULL) {
+			state.known = true;
+			state.data.peripherals = bidib_get_state_train_peripherals(
+					block, state.data.peripherals, state.data.peripheral_cnt);
+		}
+		if (states != NULL) {
+			states[i] = state;
 		}
-		query.data.decoder_state = train_state->decoder_state;
 	}
+	return states;
+}
+
+t_bidib_train_state_list_query bidib_get_train_states(const char *const *trains, size_t count) {
+	t_bidib_train_state_list_query query = {0, NULL};
+	if (trains == NULL || count == 0) {
+		return query;
+	}
+	t_bidib_query_block block = {NULL, 0, 0};
+	// For bidib_get_train_states_block
+	pthread_mutex_lock(&trackstate_trains_mutex);
+	do {
+		query.states = bidib_get_train_states_block(&block, trains, count);
+	} while (bidib_query_block_next(&block));
 	pthread_mutex_unlock(&trackstate_trains_mutex);
+	query.length = count;
 	return query;
 }
 
+bool bidib_visit_train_state(const char *train, t_bidib_train_state_visitor visitor, void *ctx) {
+	if (train == NULL || visitor == NULL) {
+		return false;
+	}
+	t_bidib_train_state_data data;
+	// For bidib_state_get_train_state_ref
+	pthread_mutex_lock(&trackstate_trains_mutex);
+	const char *id = bidib_get_train_state_data_ref(train, &data, NULL);
+	if (id != NULL) {
+		visitor(id, &data, ctx);
+	}
+	pthread_mutex_unlock(&trackstate_trains_mutex);
+	return id != NULL;
+}
+
+bool bidib_get_train_state_buf(const char *train, t_bidib_train_state_data *data,
+                               t_bidib_train_peripheral_state *peripherals,
+                               size_t peripheral_capacity) {
+	if (train == NULL || data == NULL) {
+		return false;
+	}
+	// For bidib_state_get_train_state_ref
+	pthread_mutex_lock(&trackstate_trains_mutex);
+	bool known = bidib_get_train_state_data_ref(train, data, NULL) != NULL;
+	if (known) {
+		size_t copied = data->peripheral_cnt < peripheral_capacity
+		                ? data->peripheral_cnt : peripheral_capacity;
+		if (copied > 0) {
+			memcpy(peripherals, data->peripherals,
+			       sizeof(t_bidib_train_peripheral_state) * copied);
+		}
+		data->peripherals = peripherals;
+	}
+	pthread_mutex_unlock(&trackstate_trains_mutex);
+	return known;
+}
+
 t_bidib_train_peripheral_state_query bidib_get_train_peripheral_state(const char *train,
                                                                       const char *peripheral) {
 	t_bidib_train_peripheral_state_query query = {false, 0x00};
@@ -1218,6 +1942,39 @@ bool bidib_get_train_on_track(const char *train) {
 	return res;
 }
 
+// Copies the segments that detect the address of a train into the block.
+// Shall only be called with bidib_trains_rwlock >= read acquired,
+// and with trackstate_segments_mutex acquired.
+static t_bidib_train_position_query bidib_get_train_position_block(
+		t_bidib_query_block *block, const t_bidib_train *train_ref) {
+	t_bidib_train_position_query query = {0, NULL, true};
+	// Only visit the segments that detect the address of the train
+	const size_t count = bidib_state_get_train_detections(train_ref, &query.orientation_is_left);
+	if (count == 0) {
+		return query;
+	}
+	const GArray *const segments = bidib_state_index_get_address_segments(train_ref->dcc_addr);
+	query.segments = bidib_query_block_array(block, char *, count);
+	for (size_t i = 0; i < segments->len && query.length < count; i++) {
+		const t_bidib_segment_state_intern *const segment_state = 
+		        &g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern,
+		                       g_array_index(segments, guint, i));
+		t_bidib_dcc_address dcc_address;
+		for (size_t j = 0; j < segment_state->dcc_addresses->len && query.length < count; j++) {
+			dcc_address = g_array_index(segment_state->dcc_addresses, t_bidib_dcc_address, j);
+			if (train_ref->dcc_addr.addrh == dcc_address.addrh && 
+			    train_ref->dcc_addr.addrl == dcc_address.addrl) {
+				char *id = bidib_query_block_strdup(block, segment_state->id);
+				if (query.segments != NULL) {
+					query.segments[query.length] = id;
+				}
+				query.length++;
+			}
+		}
+	}
+	return query;
+}
+
 t_bidib_train_position_query bidib_get_train_position_intern(const char *train) {
 	t_bidib_train_position_query query = {0, NULL, true};
 	if (train == NULL) {
@@ -1231,38 +1988,11 @@ t_bidib_train_position_query bidib_get_train_position_intern(const char *train)
 	const t_bidib_train_state_intern *const train_state_ref = bidib_state_get_train_state_ref(train);
 	const t_bidib_train *const train_ref = bidib_state_get_train_ref(train);
 	if (train_state_ref != NULL && train_ref != NULL) {
-		size_t count = 0;
-		for (size_t i = 0; i < bidib_track_state.segments->len; i++) {
-			const t_bidib_segment_state_intern *const segment_state = 
-			        &g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern, i);
-			t_bidib_dcc_address dcc_address;
-			for (size_t j = 0; j < segment_state->dcc_addresses->len; j++) {
-				dcc_address = g_array_index(segment_state->dcc_addresses, t_bidib_dcc_address, j);
-				if (train_ref->dcc_addr.addrh == dcc_address.addrh && 
-				    train_ref->dcc_addr.addrl == dcc_address.addrl) {
-					count++;
-				}
-			}
-		}
-		if (count > 0) {
-			query.length = count;
-			query.segments = malloc(sizeof(char *) * count);
-			size_t current_index = 0;
-			for (size_t i = 0; i < bidib_track_state.segments->len && current_index < count; i++) {
-				const t_bidib_segment_state_intern *const segment_state = 
-				        &g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern, i);
-				t_bidib_dcc_address dcc_address;
-				for (size_t j = 0; j < segment_state->dcc_addresses->len && current_index < count; j++) {
-					dcc_address = g_array_index(segment_state->dcc_addresses, t_bidib_dcc_address, j);
-					if (train_ref->dcc_addr.addrh == dcc_address.addrh && 
-					    train_ref->dcc_addr.addrl == dcc_address.addrl) {
-						query.segments[current_index] = strdup(segment_state->id->str);
-						query.orientation_is_left = (dcc_address.type == 0);
-						current_index++;
-					}
-				}
-			}
-		}
+		// The table of segments and their ids are placed in one block
+		t_bidib_query_block block = {NULL, 0, 0};
+		do {
+			query = bidib_get_train_position_block(&block, train_ref);
+		} while (bidib_query_block_next(&block));
 	}
 	return query;
 }
@@ -1282,6 +2012,57 @@ t_bidib_train_position_query bidib_get_train_position(const char *train) {
 	return query;
 }
 
+// Shall only be called with bidib_trains_rwlock >= read acquired,
+// and with trackstate_segments_mutex and trackstate_trains_mutex acquired.
+static void bidib_get_train_positions_block(t_bidib_query_block *block,
+                                            t_bidib_train_position_list_query *query) {
+	query->length = 0;
+	for (size_t i = 0; i < bidib_track_state.trains->len; i++) {
+		const t_bidib_train_state_intern *const train_state =
+		        &g_array_index(bidib_track_state.trains, t_bidib_train_state_intern, i);
+		if (train_state->on_track) {
+			query->length++;
+		}
+	}
+	query->trains = bidib_query_block_array(block, char *, query->length);
+	query->positions = bidib_query_block_array(block, t_bidib_train_position_query, query->length);
+	size_t n = 0;
+	for (size_t i = 0; i < bidib_track_state.trains->len; i++) {
+		const t_bidib_train_state_intern *const train_state =
+		        &g_array_index(bidib_track_state.trains, t_bidib_train_state_intern, i);
+		if (!train_state->on_track) {
+			continue;
+		}
+		const t_bidib_train *const train_ref = bidib_state_get_train_ref(train_state->id);
+		char *id = bidib_query_block_strdup(block, train_state->id);
+		t_bidib_train_position_query position = {0, NULL, true};
+		if (train_ref != NULL) {
+			position = bidib_get_train_position_block(block, train_ref);
+		}
+		if (query->trains != NULL && query->positions != NULL) {
+			query->trains[n] = id;
+			query->positions[n] = position;
+		}
+		n++;
+	}
+}
+
+t_bidib_train_position_list_query bidib_get_train_positions_all(void) {
+	t_bidib_train_position_list_query query = {0, NULL, NULL};
+	t_bidib_query_block block = {NULL, 0, 0};
+	// All for bidib_get_train_positions_block
+	pthread_rwlock_rdlock(&bidib_trains_rwlock);
+	pthread_mutex_lock(&trackstate_segments_mutex);
+	pthread_mutex_lock(&trackstate_trains_mutex);
+	do {
+		bidib_get_train_positions_block(&block, &query);
+	} while (bidib_query_block_next(&block));
+	pthread_mutex_unlock(&trackstate_trains_mutex);
+	pthread_mutex_unlock(&trackstate_segments_mutex);
+	pthread_rwlock_unlock(&bidib_trains_rwlock);
+	return query;
+}
+
 t_bidib_train_speed_step_query bidib_get_train_speed_step(const char *train) {
 	t_bidib_train_speed_step_query query = {false, 0, true};
 	if (train == NULL) {
@@ -1320,6 +2101,7 @@ static t_bidib_id_list_query bidib_get_accessory_aspects(const char *accessory,
 	if (accessory == NULL) {
 		return query;
 	}
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For bidib_state_get_board_accessory_mapping_ref, bidib_state_get_dcc_accessory_mapping_ref
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	const t_bidib_board_accessory_mapping *const board_mapping =
@@ -1331,24 +2113,26 @@ static t_bidib_id_list_query bidib_get_accessory_aspects(const char *accessory,
 			pthread_rwlock_unlock(&bidib_boards_rwlock);
 			return query;
 		} else {
-			query.length = dcc_mapping->aspects->len;
-			query.ids = malloc(sizeof(char *) * query.length);
-			for (size_t i = 0; i < dcc_mapping->aspects->len; i++) {
-				const t_bidib_dcc_aspect *const aspect_mapping = 
-				        &g_array_index(dcc_mapping->aspects, t_bidib_dcc_aspect, i);
-				query.ids[i] = strdup(aspect_mapping->id->str);
-			}
+			do {
+				for (size_t i = 0; i < dcc_mapping->aspects->len; i++) {
+					const t_bidib_dcc_aspect *const aspect_mapping = 
+					        &g_array_index(dcc_mapping->aspects, t_bidib_dcc_aspect, i);
+					bidib_id_list_add(&list, aspect_mapping->id);
+				}
+			} while (bidib_id_list_next(&list));
 		}
 	} else {
-		query.length = board_mapping->aspects->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		for (size_t i = 0; i < board_mapping->aspects->len; i++) {
-			const t_bidib_aspect *const aspect_mapping = 
-			        &g_array_index(board_mapping->aspects, t_bidib_aspect, i);
-			query.ids[i] = strdup(aspect_mapping->id->str);
-		}
+		do {
+			for (size_t i = 0; i < board_mapping->aspects->len; i++) {
+				const t_bidib_aspect *const aspect_mapping = 
+				        &g_array_index(board_mapping->aspects, t_bidib_aspect, i);
+				bidib_id_list_add(&list, aspect_mapping->id);
+			}
+		} while (bidib_id_list_next(&list));
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
@@ -1365,73 +2149,33 @@ t_bidib_id_list_query bidib_get_peripheral_aspects(const char *peripheral) {
 	if (peripheral == NULL) {
 		return query;
 	}
+	t_bidib_id_list_builder list = BIDIB_ID_LIST_BUILDER(false);
 	// For bidib_state_get_peripheral_mapping_ref
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	const t_bidib_peripheral_mapping *const peripheral_mapping =
 	       bidib_state_get_peripheral_mapping_ref(peripheral);
 	if (peripheral_mapping != NULL) {
-		query.length = peripheral_mapping->aspects->len;
-		query.ids = malloc(sizeof(char *) * query.length);
-		for (size_t i = 0; i < peripheral_mapping->aspects->len; i++) {
-			const t_bidib_aspect *const aspect_mapping = 
-			        &g_array_index(peripheral_mapping->aspects, t_bidib_aspect, i);
-			query.ids[i] = strdup(aspect_mapping->id->str);
-		}
+		do {
+			for (size_t i = 0; i < peripheral_mapping->aspects->len; i++) {
+				const t_bidib_aspect *const aspect_mapping = 
+				        &g_array_index(peripheral_mapping->aspects, t_bidib_aspect, i);
+				bidib_id_list_add(&list, aspect_mapping->id);
+			}
+		} while (bidib_id_list_next(&list));
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	query.length = list.length;
+	query.ids = list.ids;
 	return query;
 }
 
 void bidib_free_track_state(t_bidib_track_state track_state) {
-	for (size_t i = 0; i < track_state.points_board_count; i++) {
-		bidib_state_free_single_board_accessory_state(track_state.points_board[i]);
-	}
-	free(track_state.points_board);
-
-	for (size_t i = 0; i < track_state.points_dcc_count; i++) {
-		bidib_state_free_single_dcc_accessory_state(track_state.points_dcc[i]);
-	}
-	free(track_state.points_dcc);
-
-	for (size_t i = 0; i < track_state.signals_board_count; i++) {
-		bidib_state_free_single_board_accessory_state(track_state.signals_board[i]);
-	}
-	free(track_state.signals_board);
-
-	for (size_t i = 0; i < track_state.signals_dcc_count; i++) {
-		bidib_state_free_single_dcc_accessory_state(track_state.signals_dcc[i]);
-	}
-	free(track_state.signals_dcc);
-
-	for (size_t i = 0; i < track_state.peripherals_count; i++) {
-		bidib_state_free_single_peripheral_state(track_state.peripherals[i]);
-	}
-	free(track_state.peripherals);
-	
-	for (size_t i = 0; i < track_state.reversers_count; i++) {
-		bidib_state_free_single_reverser_state(track_state.reversers[i]);
-	}
-	free(track_state.reversers);
-
-	for (size_t i = 0; i < track_state.segments_count; i++) {
-		bidib_state_free_single_segment_state(track_state.segments[i]);
-	}
-	free(track_state.segments);
-
-	for (size_t i = 0; i < track_state.trains_count; i++) {
-		bidib_state_free_single_train_state(track_state.trains[i]);
-	}
-	free(track_state.trains);
-
-	for (size_t i = 0; i < track_state.booster_count; i++) {
-		bidib_state_free_single_booster_state(track_state.booster[i]);
-	}
-	free(track_state.booster);
+	// The arrays and strings are placed in the block
+	free(track_state.block);
+}
 
-	for (size_t i = 0; i < track_state.track_outputs_count; i++) {
-		bidib_state_free_single_track_output_state(track_state.track_outputs[i]);
-	}
-	free(track_state.track_outputs);
+void bidib_free_track_state_changes(t_bidib_track_state_changes changes) {
+	bidib_free_track_state(changes.state);
 }
 
 void bidib_free_unified_accessory_state_query(t_bidib_unified_accessory_state_query query) {
@@ -1471,16 +2215,19 @@ void bidib_free_reverser_state_query(t_bidib_reverser_state_query query) {
 
 void bidib_free_id_list_query(t_bidib_id_list_query query) {
 	if (query.ids != NULL) {
-		for (size_t i = 0; i < query.length; i++) {
-			if (query.ids[i] != NULL) {
-				free(query.ids[i]);
-			}
-		}
+		// The ids are placed in the same block as the table
 		free(query.ids);
 		query.ids = NULL;
 	}
 }
 
+void bidib_free_id_ref_list_query(t_bidib_id_ref_list_query query) {
+	if (query.ids != NULL) {
+		free((void *) query.ids);
+		query.ids = NULL;
+	}
+}
+
 void bidib_free_board_features_query(t_bidib_board_features_query query) {
 	if (query.features != NULL) {
 		free(query.features);
@@ -1504,11 +2251,7 @@ void bidib_free_unique_id_list_query(t_bidib_unique_id_list_query query) {
 
 void bidib_free_train_state_query(t_bidib_train_state_query query) {
 	if (query.data.peripherals != NULL) {
-		for (size_t i = 0; i < query.data.peripheral_cnt; i++) {
-			if (query.data.peripherals[i].id != NULL) {
-				free(query.data.peripherals[i].id);
-			}
-		}
+		// The ids are placed in the same block as the peripherals
 		free(query.data.peripherals);
 		query.data.peripherals = NULL;
 	}
@@ -1516,12 +2259,42 @@ void bidib_free_train_state_query(t_bidib_train_state_query query) {
 
 void bidib_free_train_position_query(t_bidib_train_position_query query) {
 	if (query.segments != NULL) {
-		for (size_t i = 0; i < query.length; i++) {
-			if (query.segments[i] != NULL) {
-				free(query.segments[i]);
-			}
-		}
+		// The ids are placed in the same block as the table
 		free(query.segments);
 		query.segments = NULL;
 	}
 }
+
+void bidib_free_unified_accessory_state_list_query(
+		t_bidib_unified_accessory_state_list_query query) {
+	if (query.states != NULL) {
+		// The state ids are placed in the same block as the states
+		free(query.states);
+		query.states = NULL;
+	}
+}
+
+void bidib_free_segment_state_list_query(t_bidib_segment_state_list_query query) {
+	if (query.states != NULL) {
+		// The dcc addresses are placed in the same block as the states
+		free(query.states);
+		query.states = NULL;
+	}
+}
+
+void bidib_free_train_state_list_query(t_bidib_train_state_list_query query) {
+	if (query.states != NULL) {
+		// The peripherals are placed in the same block as the states
+		free(query.states);
+		query.states = NULL;
+	}
+}
+
+void bidib_free_train_position_list_query(t_bidib_train_position_list_query query) {
+	if (query.trains != NULL) {
+		// The positions and all ids are placed in the same block as the trains
+		free(query.trains);
+		query.trains = NULL;
+		query.positions = NULL;
+	}
+}
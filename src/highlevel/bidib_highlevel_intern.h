@@ -33,6 +33,7 @@
 #include <pthread.h>
 
 #include "../../include/definitions/bidib_definitions_custom.h"
+#include "../state/bidib_state_intern.h"
 
 
 extern pthread_rwlock_t bidib_trains_rwlock;
@@ -46,6 +47,7 @@ extern pthread_mutex_t trackstate_reversers_mutex;
 extern pthread_mutex_t trackstate_trains_mutex;
 extern pthread_mutex_t trackstate_boosters_mutex;
 extern pthread_mutex_t trackstate_track_outputs_mutex;
+extern pthread_mutex_t trackstate_snapshot_mutex;
 
 /**
  * Returns the next action id and increments it afterwards.
@@ -54,6 +56,42 @@ extern pthread_mutex_t trackstate_track_outputs_mutex;
  */
 unsigned int bidib_get_and_incr_action_id(void);
 
+/**
+ * Computes the CLOCK_MONOTONIC deadline of a wait function.
+ *
+ * @param timeout_ms the maximum time to wait in milliseconds.
+ * @param deadline the deadline (out-parameter).
+ */
+void bidib_wait_deadline(unsigned int timeout_ms, struct timespec *deadline);
+
+/**
+ * Checks whether the deadline of a wait function passed.
+ *
+ * @param deadline the deadline.
+ * @return true if the deadline passed, otherwise false.
+ */
+bool bidib_wait_deadline_passed(const struct timespec *deadline);
+
+/**
+ * Frees the routes set by bidib_set_route whose handles were not freed.
+ */
+void bidib_routes_free(void);
+
+/**
+ * Copies categories of the track state into a track state query, whose arrays
+ * and strings are placed in one block. Acquires the trackstate mutex of each
+ * category in turn.
+ *
+ * @param categories the categories to copy, bit i stands for category i.
+ * @param since only entries stamped with a change sequence number greater than
+ * this are copied, 0 copies all entries.
+ * @param query the track state query whose fields of the categories and whose
+ * block are set. Must be freed with bidib_free_track_state.
+ * @return the size of the block.
+ */
+size_t bidib_get_state_categories(unsigned int categories, uint64_t since,
+                                  t_bidib_track_state *query);
+
 /**
  * Used only internally in bidib_state_update_train_available and
  * bidib_get_train_position to avoid the usage of a recursive mutex.
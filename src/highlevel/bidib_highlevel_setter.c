@@ -47,7 +47,7 @@ static t_bidib_aspect *bidib_get_aspect_by_id(GArray *aspects, const char *aspec
 	t_bidib_aspect *aspect_mapping;
 	for (size_t i = 0; i < aspects->len; i++) {
 		aspect_mapping = &g_array_index(aspects, t_bidib_aspect, i);
-		if (!strcmp(aspect_mapping->id->str, aspect_id)) {
+		if (!strcmp(aspect_mapping->id, aspect_id)) {
 			return aspect_mapping;
 		}
 	}
@@ -58,7 +58,7 @@ static t_bidib_dcc_aspect *bidib_get_dcc_aspect_by_id(GArray *aspects, const cha
 	t_bidib_dcc_aspect *aspect_mapping;
 	for (size_t i = 0; i < aspects->len; i++) {
 		aspect_mapping = &g_array_index(aspects, t_bidib_dcc_aspect, i);
-		if (!strcmp(aspect_mapping->id->str, aspect_id)) {
+		if (!strcmp(aspect_mapping->id, aspect_id)) {
 			return aspect_mapping;
 		}
 	}
@@ -85,10 +85,10 @@ int bidib_switch_point(const char *point, const char *aspect) {
 			const t_bidib_board_accessory_mapping *const board_mapping = 
 			           &g_array_index(board_i->points_board, t_bidib_board_accessory_mapping, j);
 			
-			if (!strcmp(point, board_mapping->id->str)) {
+			if (!strcmp(point, board_mapping->id)) {
 				if (!board_i->connected) {
 					syslog_libbidib(LOG_ERR, "Switch point %s: board %s is not connected",
-					                point, board_i->id->str);
+					                point, board_i->id);
 					pthread_rwlock_unlock(&bidib_boards_rwlock);
 					pthread_mutex_unlock(&trackstate_accessories_mutex);
 					return 1;
@@ -102,11 +102,18 @@ int bidib_switch_point(const char *point, const char *aspect) {
 					unsigned int action_id = bidib_get_and_incr_action_id();
 					syslog_libbidib(LOG_NOTICE, "Switch point: %s on board: %s (0x%02x 0x%02x "
 					                "0x%02x 0x00) to aspect: %s (0x%02x) with action id: %d",
-					                point, board_i->id->str, tmp_addr.top, tmp_addr.sub,
+					                point, board_i->id, tmp_addr.top, tmp_addr.sub,
 					                tmp_addr.subsub, aspect, aspect_mapping->value, action_id);
-					bidib_send_accessory_set(tmp_addr, board_mapping->number,
-					                         aspect_mapping->value, action_id);
-					ret = 0;
+					if (bidib_send_accessory_set_intern(tmp_addr, board_mapping->number,
+					                                    aspect_mapping->value, action_id)
+					    == BIDIB_NODE_SEND_REJECTED) {
+						syslog_libbidib(LOG_ERR, "Switch point %s: command with action id: %d "
+						                "rejected, message queue of board %s full",
+						                point, action_id, board_i->id);
+						ret = 1;
+					} else {
+						ret = 0;
+					}
 				} else {
 					syslog_libbidib(LOG_ERR, "Switch point %s: aspect %s doesn't exist", 
 					               point, aspect);
@@ -122,10 +129,10 @@ int bidib_switch_point(const char *point, const char *aspect) {
 			const t_bidib_dcc_accessory_mapping *const dcc_mapping = 
 			          &g_array_index(board_i->points_dcc, t_bidib_dcc_accessory_mapping, j);
 			
-			if (!strcmp(point, dcc_mapping->id->str)) {
+			if (!strcmp(point, dcc_mapping->id)) {
 				if (!board_i->connected) {
 					syslog_libbidib(LOG_ERR, "Switch point %s: board %s is not connected", 
-					                point, board_i->id->str);
+					                point, board_i->id);
 					pthread_rwlock_unlock(&bidib_boards_rwlock);
 					pthread_mutex_unlock(&trackstate_accessories_mutex);
 					return 1;
@@ -139,6 +146,7 @@ int bidib_switch_point(const char *point, const char *aspect) {
 					params.dcc_address = dcc_mapping->dcc_addr;
 					params.time = 0x00;
 					unsigned int action_id = bidib_get_and_incr_action_id();
+					bool rejected = false;
 					
 					for (size_t k = 0; k < aspect_mapping->port_values->len; k++) {
 						const t_bidib_dcc_aspect_port_value *const aspect_port_value = 
@@ -147,27 +155,36 @@ int bidib_switch_point(const char *point, const char *aspect) {
 						params.data = (uint8_t) (aspect_port_value->port & 0x1F);
 						params.data = params.data | (aspect_port_value->value << 5);
 						params.data = params.data | (dcc_mapping->extended_accessory << 7);
-						bidib_send_cs_accessory_intern(tmp_addr, params, action_id);
+						if (bidib_send_cs_accessory_intern(tmp_addr, params, action_id)
+						    == BIDIB_NODE_SEND_REJECTED) {
+							rejected = true;
+						}
 					}
 					
 					t_bidib_dcc_accessory_state *accessory_state = 
 					                      bidib_state_get_dcc_accessory_state_ref(point, true);
 					int ret = 0;
-					if (accessory_state != NULL) {
-						if (accessory_state->data.state_id != NULL) {
-							free(accessory_state->data.state_id);
-						}
-						accessory_state->data.state_id = strdup(aspect_mapping->id->str);
+					if (rejected) {
+						// The point did not get the aspect
+						syslog_libbidib(LOG_ERR, "Switch point: %s on board: %s (0x%02x 0x%02x "
+						                "0x%02x 0x00) to aspect: %s with action id: %d failed,"
+						                " message queue full",
+						                point, board_i->id, tmp_addr.top, tmp_addr.sub,
+						                tmp_addr.subsub, aspect, action_id);
+						ret = 1;
+					} else if (accessory_state != NULL) {
+						accessory_state->data.state_id = (char *) aspect_mapping->id;
+						bidib_state_stamp(BIDIB_STATE_INDEX_POINTS_DCC, accessory_state);
 						syslog_libbidib(LOG_NOTICE, "Switch point: %s on board: %s (0x%02x 0x%02x "
 						                "0x%02x 0x00) to aspect: %s with action id: %d",
-						                point, board_i->id->str, tmp_addr.top, tmp_addr.sub,
+						                point, board_i->id, tmp_addr.top, tmp_addr.sub,
 						                tmp_addr.subsub, aspect, action_id);
 						ret = 0;
 					} else {
 						syslog_libbidib(LOG_ERR, "Switch point: %s on board: %s (0x%02x 0x%02x "
 						                "0x%02x 0x00) to aspect: %s with action id: %d failed,"
 						                " internal point state invalid",
-						                point, board_i->id->str, tmp_addr.top, tmp_addr.sub,
+						                point, board_i->id, tmp_addr.top, tmp_addr.sub,
 						                tmp_addr.subsub, aspect, action_id);
 						ret = 1;
 					}
@@ -207,10 +224,10 @@ int bidib_set_signal(const char *signal, const char *aspect) {
 		for (size_t j = 0; j < board_i->signals_board->len; j++) {
 			const t_bidib_board_accessory_mapping *const board_mapping = &g_array_index(
 					board_i->signals_board, t_bidib_board_accessory_mapping, j);
-			if (!strcmp(signal, board_mapping->id->str)) {
+			if (!strcmp(signal, board_mapping->id)) {
 				if (!board_i->connected) {
 					syslog_libbidib(LOG_ERR, "Set signal %s: board %s is not connected",
-					                signal, board_i->id->str);
+					                signal, board_i->id);
 					pthread_rwlock_unlock(&bidib_boards_rwlock);
 					pthread_mutex_unlock(&trackstate_accessories_mutex);
 					return 1;
@@ -223,11 +240,18 @@ int bidib_set_signal(const char *signal, const char *aspect) {
 					unsigned int action_id = bidib_get_and_incr_action_id();
 					syslog_libbidib(LOG_NOTICE, "Set signal: %s on board: %s (0x%02x 0x%02x "
 					                "0x%02x 0x00) to aspect: %s (0x%02x) with action id: %d",
-					                signal, board_i->id->str, tmp_addr.top, tmp_addr.sub, tmp_addr.subsub,
-					                aspect_mapping->id->str, aspect_mapping->value, action_id);
-					bidib_send_accessory_set(tmp_addr, board_mapping->number,
-					                         aspect_mapping->value, action_id);
-					ret = 0;
+					                signal, board_i->id, tmp_addr.top, tmp_addr.sub, tmp_addr.subsub,
+					                aspect_mapping->id, aspect_mapping->value, action_id);
+					if (bidib_send_accessory_set_intern(tmp_addr, board_mapping->number,
+					                                    aspect_mapping->value, action_id)
+					    == BIDIB_NODE_SEND_REJECTED) {
+						syslog_libbidib(LOG_ERR, "Set signal %s: command with action id: %d "
+						                "rejected, message queue of board %s full",
+						                signal, action_id, board_i->id);
+						ret = 1;
+					} else {
+						ret = 0;
+					}
 				} else {
 					syslog_libbidib(LOG_ERR, "Set signal %s: aspect %s doesn't exist",
 					                signal, aspect);
@@ -242,10 +266,10 @@ int bidib_set_signal(const char *signal, const char *aspect) {
 		for (size_t j = 0; j < board_i->signals_dcc->len; j++) {
 			const t_bidib_dcc_accessory_mapping *const dcc_mapping = 
 			            &g_array_index(board_i->signals_dcc, t_bidib_dcc_accessory_mapping, j);
-			if (!strcmp(signal, dcc_mapping->id->str)) {
+			if (!strcmp(signal, dcc_mapping->id)) {
 				if (!board_i->connected) {
 					syslog_libbidib(LOG_ERR, "Set signal %s: board %s is not connected",
-					                signal, board_i->id->str);
+					                signal, board_i->id);
 					pthread_rwlock_unlock(&bidib_boards_rwlock);
 					pthread_mutex_unlock(&trackstate_accessories_mutex);
 					return 1;
@@ -259,6 +283,7 @@ int bidib_set_signal(const char *signal, const char *aspect) {
 					params.dcc_address = dcc_mapping->dcc_addr;
 					params.time = 0x00;
 					unsigned int action_id = bidib_get_and_incr_action_id();
+					bool rejected = false;
 					t_bidib_dcc_aspect_port_value *aspect_port_value;
 					for (size_t k = 0; k < aspect_mapping->port_values->len; k++) {
 						aspect_port_value = &g_array_index(aspect_mapping->port_values, 
@@ -266,25 +291,34 @@ int bidib_set_signal(const char *signal, const char *aspect) {
 						params.data = (uint8_t) (aspect_port_value->port & 0x1F);
 						params.data = params.data | (uint8_t) (aspect_port_value->value << 5);
 						params.data = params.data | (dcc_mapping->extended_accessory << 7);
-						bidib_send_cs_accessory_intern(tmp_addr, params, action_id);
+						if (bidib_send_cs_accessory_intern(tmp_addr, params, action_id)
+						    == BIDIB_NODE_SEND_REJECTED) {
+							rejected = true;
+						}
 					}
 					t_bidib_dcc_accessory_state *accessory_state = 
 					                     bidib_state_get_dcc_accessory_state_ref(signal, false);
-					if (accessory_state != NULL) {
-						if (accessory_state->data.state_id != NULL) {
-							free(accessory_state->data.state_id);
-						}
-						accessory_state->data.state_id = strdup(aspect_mapping->id->str);
+					if (rejected) {
+						// The signal did not get the aspect
+						syslog_libbidib(LOG_ERR, "Set signal: %s on board: %s (0x%02x 0x%02x "
+						                "0x%02x 0x00) to aspect: %s with action id: %d"
+						                " failed, message queue full",
+						                signal, board_i->id, tmp_addr.top, tmp_addr.sub,
+						                tmp_addr.subsub, aspect, action_id);
+						ret = 1;
+					} else if (accessory_state != NULL) {
+						accessory_state->data.state_id = (char *) aspect_mapping->id;
+						bidib_state_stamp(BIDIB_STATE_INDEX_SIGNALS_DCC, accessory_state);
 						syslog_libbidib(LOG_NOTICE, "Set signal: %s on board: %s (0x%02x 0x%02x "
 						                "0x%02x 0x00) to aspect: %s with action id: %d",
-						                signal, board_i->id->str, tmp_addr.top, tmp_addr.sub,
+						                signal, board_i->id, tmp_addr.top, tmp_addr.sub,
 						                tmp_addr.subsub, aspect, action_id);
 						ret = 0;
 					} else {
 						syslog_libbidib(LOG_ERR, "Set signal: %s on board: %s (0x%02x 0x%02x "
 						                "0x%02x 0x00) to aspect: %s with action id: %d"
 						                " failed, internal signal state invalid",
-						                signal, board_i->id->str, tmp_addr.top, tmp_addr.sub,
+						                signal, board_i->id, tmp_addr.top, tmp_addr.sub,
 						                tmp_addr.subsub, aspect, action_id);
 						ret = 1;
 					}
@@ -317,10 +351,10 @@ int bidib_set_peripheral(const char *peripheral, const char *aspect) {
 		for (size_t j = 0; j < board_i->peripherals->len; j++) {
 			const t_bidib_peripheral_mapping *const peripheral_mapping = &g_array_index(
 					board_i->peripherals, t_bidib_peripheral_mapping, j);
-			if (!strcmp(peripheral, peripheral_mapping->id->str)) {
+			if (!strcmp(peripheral, peripheral_mapping->id)) {
 				if (!board_i->connected) {
 					syslog_libbidib(LOG_ERR, "Set peripheral %s: board %s is not connected",
-					                peripheral, board_i->id->str);
+					                peripheral, board_i->id);
 					pthread_rwlock_unlock(&bidib_boards_rwlock);
 					return 1;
 				}
@@ -330,13 +364,19 @@ int bidib_set_peripheral(const char *peripheral, const char *aspect) {
 					unsigned int action_id = bidib_get_and_incr_action_id();
 					syslog_libbidib(LOG_NOTICE, "Set peripheral: %s on board: %s (0x%02x 0x%02x "
 					                "0x%02x 0x00) to aspect: %s (0x%02x) with action id: %d",
-					                peripheral, board_i->id->str, board_i->node_addr.top,
+					                peripheral, board_i->id, board_i->node_addr.top,
 					                board_i->node_addr.sub, board_i->node_addr.subsub,
-					                aspect_mapping->id->str, aspect_mapping->value, action_id);
-					bidib_send_lc_output(board_i->node_addr, peripheral_mapping->port.port0,
-					                     peripheral_mapping->port.port1, aspect_mapping->value, action_id);
+					                aspect_mapping->id, aspect_mapping->value, action_id);
+					const t_bidib_node_send_result result = bidib_send_lc_output_intern(
+							board_i->node_addr, peripheral_mapping->port.port0,
+							peripheral_mapping->port.port1, aspect_mapping->value, action_id);
+					if (result == BIDIB_NODE_SEND_REJECTED) {
+						syslog_libbidib(LOG_ERR, "Set peripheral %s: command with action id: %d "
+						                "rejected, message queue of board %s full",
+						                peripheral, action_id, board_i->id);
+					}
 					pthread_rwlock_unlock(&bidib_boards_rwlock);
-					return 0;
+					return result == BIDIB_NODE_SEND_REJECTED ? 1 : 0;
 				} else {
 					pthread_rwlock_unlock(&bidib_boards_rwlock);
 					syslog_libbidib(LOG_ERR, "Set peripheral %s: aspect %s doesn't exist",
@@ -434,7 +474,7 @@ int bidib_set_train_speed_internal(const char *train, int speed, const char *tra
 		unsigned int action_id = bidib_get_and_incr_action_id();
 		syslog_libbidib(LOG_NOTICE, "Set train: %s to speed: %d via board: %s (0x%02x "
 		                "0x%02x 0x%02x 0x00) with action id: %d",
-		                train, speed, board->id->str, board->node_addr.top,
+		                train, speed, board->id, board->node_addr.top,
 		                board->node_addr.sub, board->node_addr.subsub, action_id);
 		t_bidib_node_address tmp_addr = board->node_addr;
 		pthread_rwlock_unlock(&bidib_boards_rwlock);
@@ -473,7 +513,7 @@ int bidib_set_calibrated_train_speed(const char *train, int speed, const char *t
 
 	if (tmp_train->calibration == NULL) {
 		syslog_libbidib(LOG_ERR, "Set calibrated train speed: no calibration for train %s", 
-		                tmp_train->id->str);
+		                tmp_train->id);
 		pthread_rwlock_unlock(&bidib_trains_rwlock);
 		return 1;
 	}
@@ -481,13 +521,13 @@ int bidib_set_calibrated_train_speed(const char *train, int speed, const char *t
 	int error = 0;
 	if (speed < 0) {
 		error = bidib_set_train_speed_internal(
-			train, g_array_index(tmp_train->calibration, int, (speed * -1) - 1) * -1,
+			train, tmp_train->calibration[(speed * -1) - 1] * -1,
 			track_output);
 	} else if (speed == 0) {
 		error = bidib_set_train_speed_internal(train, 0, track_output);
 	} else {
 		error = bidib_set_train_speed_internal(
-			train, g_array_index(tmp_train->calibration, int, speed - 1),
+			train, tmp_train->calibration[speed - 1],
 			track_output);
 	}
 	pthread_rwlock_unlock(&bidib_trains_rwlock);
@@ -547,7 +587,7 @@ int bidib_emergency_stop_train(const char *train, const char *track_output) {
 		unsigned int action_id = bidib_get_and_incr_action_id();
 		syslog_libbidib(LOG_CRIT, "Emergency stop train: %s via board: %s (0x%02x "
 		                "0x%02x 0x%02x 0x00) with action id: %d",
-		                train, board->id->str, board->node_addr.top,
+		                train, board->id, board->node_addr.top,
 		                board->node_addr.sub, board->node_addr.subsub, action_id);
 		t_bidib_node_address tmp_addr = board->node_addr;
 		pthread_rwlock_unlock(&bidib_boards_rwlock);
@@ -570,7 +610,7 @@ int bidib_emergency_stop_train(const char *train, const char *track_output) {
 static void bidib_get_current_train_peripheral_bits(const t_bidib_train *const train, size_t start,
                                                     size_t end, uint8_t *bits) {
 	const t_bidib_train_state_intern *train_state = 
-	                              bidib_state_get_train_state_ref(train->id->str);
+	                              bidib_state_get_train_state_ref(train->id);
 	for (size_t i = 0; i < train->peripherals->len; i++) {
 		const t_bidib_train_peripheral_mapping *const mapping_i = 
 		               &g_array_index(train->peripherals, t_bidib_train_peripheral_mapping, i);
@@ -625,7 +665,7 @@ int bidib_set_train_peripheral(const char *train, const char *peripheral, uint8_
 	for (size_t i = 0; i < tmp_train->peripherals->len; i++) {
 		const t_bidib_train_peripheral_mapping *const mapping_i = &g_array_index(
 				tmp_train->peripherals, t_bidib_train_peripheral_mapping, i);
-		if (strcmp(peripheral, mapping_i->id->str) == 0) {
+		if (strcmp(peripheral, mapping_i->id) == 0) {
 			t_bidib_cs_drive_mod params;
 			params.dcc_address = tmp_train->dcc_addr;
 			switch (tmp_train->dcc_speed_steps) {
@@ -673,7 +713,7 @@ int bidib_set_train_peripheral(const char *train, const char *peripheral, uint8_
 			syslog_libbidib(LOG_NOTICE, "Set train peripheral: %s of train: %s to "
 			                "state: 0x%02x via board: %s (0x%02x 0x%02x "
 			                "0x%02x 0x00) with action id: %d",
-			                peripheral, train, state, board->id->str, board->node_addr.top,
+			                peripheral, train, state, board->id, board->node_addr.top,
 			                board->node_addr.sub, board->node_addr.subsub, action_id);
 			t_bidib_node_address tmp_addr = board->node_addr;
 			pthread_rwlock_unlock(&bidib_boards_rwlock);
@@ -712,7 +752,7 @@ int bidib_set_booster_power_state(const char *booster, bool on) {
 		if (on) {
 			syslog_libbidib(LOG_NOTICE, "Set booster: %s (0x%02x 0x%02x "
 			                "0x%02x 0x00) to state: %s with action id: %d",
-			                board->id->str, board->node_addr.top, board->node_addr.sub,
+			                board->id, board->node_addr.top, board->node_addr.sub,
 			                board->node_addr.subsub, "on", action_id);
 			t_bidib_node_address tmp_addr = board->node_addr;
 			pthread_rwlock_unlock(&bidib_boards_rwlock);
@@ -720,7 +760,7 @@ int bidib_set_booster_power_state(const char *booster, bool on) {
 		} else {
 			syslog_libbidib(LOG_NOTICE, "Set booster: %s (0x%02x 0x%02x "
 			                "0x%02x 0x00) to state: %s with action id: %d",
-			                board->id->str, board->node_addr.top, board->node_addr.sub,
+			                board->id, board->node_addr.top, board->node_addr.sub,
 			                board->node_addr.subsub, "off", action_id);
 			t_bidib_node_address tmp_addr = board->node_addr;
 			pthread_rwlock_unlock(&bidib_boards_rwlock);
@@ -753,7 +793,7 @@ int bidib_set_track_output_state(const char *track_output, t_bidib_cs_state stat
 		unsigned int action_id = bidib_get_and_incr_action_id();
 		syslog_libbidib(LOG_NOTICE, "Set track output: %s (0x%02x 0x%02x "
 		                "0x%02x 0x00) to state: 0x%02x with action id: %d",
-		                board->id->str, board->node_addr.top, board->node_addr.sub,
+		                board->id, board->node_addr.top, board->node_addr.sub,
 		                board->node_addr.subsub, state, action_id);
 		t_bidib_node_address tmp_addr = board->node_addr;
 		pthread_rwlock_unlock(&bidib_boards_rwlock);
@@ -806,15 +846,434 @@ int bidib_request_reverser_state(const char *reverser, const char *board) {
 		return 1;
 	}
 	state_ref->data.state_value = BIDIB_REV_EXEC_STATE_UNKNOWN;
+	bidib_state_stamp(BIDIB_STATE_INDEX_REVERSERS, state_ref);
 	syslog_libbidib(LOG_NOTICE, "Request reverser state: %s (0x%02x 0x%02x "
 					"0x%02x 0x00) to reverser: %s (%s) with action id: %d",
-					board_ref->id->str, board_ref->node_addr.top, board_ref->node_addr.sub,
-					board_ref->node_addr.subsub, mapping_ref->id->str, mapping_ref->cv->str,
+					board_ref->id, board_ref->node_addr.top, board_ref->node_addr.sub,
+					board_ref->node_addr.subsub, mapping_ref->id, mapping_ref->cv,
 					0);
-	bidib_send_vendor_get(board_ref->node_addr, (uint8_t)mapping_ref->cv->len, 
-						  (uint8_t *)mapping_ref->cv->str, 0);
+	bidib_send_vendor_get(board_ref->node_addr, (uint8_t)strlen(mapping_ref->cv), 
+						  (uint8_t *)mapping_ref->cv, 0);
 	
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
 	pthread_mutex_unlock(&trackstate_reversers_mutex);
 	return 0;
 }
+
+// An element of a route whose final state is awaited
+typedef struct {
+	t_bidib_state_index index; // POINTS_BOARD, SIGNALS_BOARD or PERIPHERALS
+	size_t position;           // of the state in its state array
+	uint8_t value;             // aspect value the element has to report
+	bool reported;
+} t_bidib_route_target;
+
+typedef struct {
+	uint64_t sent_seq;         // change sequence number before the route was sent
+	t_bidib_route_status status;
+	GArray *targets;           // of t_bidib_route_target, DCC elements are not awaited
+} t_bidib_route_progress;
+
+// An element of a route resolved to its board, mapping and state
+typedef struct {
+	size_t order;              // position of the element in the route
+	size_t board;              // position of the board in bidib_boards
+	t_bidib_state_index index; // the state array of the element
+	size_t position;           // of the state in its state array
+	const void *mapping;       // t_bidib_board_accessory_mapping, t_bidib_dcc_accessory_mapping
+	                           // or t_bidib_peripheral_mapping, depending on index
+	const void *aspect;        // t_bidib_dcc_aspect for DCC accessories, otherwise t_bidib_aspect
+} t_bidib_route_message;
+
+// Routes whose handles were not freed yet, by handle. Lock order: bidib_route_mutex,
+// then the trackstate mutexes.
+static pthread_mutex_t bidib_route_mutex = PTHREAD_MUTEX_INITIALIZER;
+static GHashTable *bidib_routes = NULL;
+static unsigned int bidib_route_next = 0;
+
+static const char *bidib_route_element_name(t_bidib_route_element_type type) {
+	switch (type) {
+		case BIDIB_ROUTE_ELEMENT_POINT:
+			return "point";
+		case BIDIB_ROUTE_ELEMENT_SIGNAL:
+			return "signal";
+		default:
+			return "peripheral";
+	}
+}
+
+// Looks up the board mapping or else the DCC mapping of an element in the mapping
+// indexes. Returns the state index of the element, BIDIB_STATE_INDEX_COUNT if not found.
+// Shall only be called with bidib_boards_rwlock >= read acquired.
+static t_bidib_state_index bidib_route_lookup_mapping(const t_bidib_route_element *element,
+                                                      size_t *board, size_t *position) {
+	switch (element->type) {
+		case BIDIB_ROUTE_ELEMENT_POINT:
+			if (bidib_state_index_lookup(BIDIB_STATE_INDEX_POINT_BOARD_MAPPINGS, element->id,
+			                             board, position)) {
+				return BIDIB_STATE_INDEX_POINTS_BOARD;
+			} else if (bidib_state_index_lookup(BIDIB_STATE_INDEX_POINT_DCC_MAPPINGS,
+			                                    element->id, board, position)) {
+				return BIDIB_STATE_INDEX_POINTS_DCC;
+			}
+			break;
+		case BIDIB_ROUTE_ELEMENT_SIGNAL:
+			if (bidib_state_index_lookup(BIDIB_STATE_INDEX_SIGNAL_BOARD_MAPPINGS, element->id,
+			                             board, position)) {
+				return BIDIB_STATE_INDEX_SIGNALS_BOARD;
+			} else if (bidib_state_index_lookup(BIDIB_STATE_INDEX_SIGNAL_DCC_MAPPINGS,
+			                                    element->id, board, position)) {
+				return BIDIB_STATE_INDEX_SIGNALS_DCC;
+			}
+			break;
+		case BIDIB_ROUTE_ELEMENT_PERIPHERAL:
+			if (bidib_state_index_lookup(BIDIB_STATE_INDEX_PERIPHERAL_MAPPINGS, element->id,
+			                             board, position)) {
+				return BIDIB_STATE_INDEX_PERIPHERALS;
+			}
+			break;
+	}
+	return BIDIB_STATE_INDEX_COUNT;
+}
+
+// Resolves an element of a route without sending anything. Returns false if the
+// element is invalid.
+// Shall only be called with trackstate_accessories_mutex, trackstate_peripherals_mutex
+// and bidib_boards_rwlock >= read acquired.
+static bool bidib_route_resolve(const t_bidib_route_element *element, size_t order,
+                                t_bidib_route_message *message) {
+	const char *name = bidib_route_element_name(element->type);
+	if (element->id == NULL || element->aspect == NULL) {
+		syslog_libbidib(LOG_ERR, "Set route: %s parameters must not be NULL", name);
+		return false;
+	}
+	size_t mapping_position;
+	message->order = order;
+	message->index = bidib_route_lookup_mapping(element, &message->board, &mapping_position);
+	if (message->index == BIDIB_STATE_INDEX_COUNT) {
+		syslog_libbidib(LOG_ERR, "Set route: %s %s not found", name, element->id);
+		return false;
+	}
+	const t_bidib_board *const board = &g_array_index(bidib_boards, t_bidib_board,
+	                                                  message->board);
+	if (!board->connected) {
+		syslog_libbidib(LOG_ERR, "Set route: board %s of %s %s is not connected",
+		                board->id, name, element->id);
+		return false;
+	}
+	switch (message->index) {
+		case BIDIB_STATE_INDEX_POINTS_BOARD:
+		case BIDIB_STATE_INDEX_SIGNALS_BOARD: {
+			const t_bidib_board_accessory_mapping *const mapping = &g_array_index(
+					message->index == BIDIB_STATE_INDEX_POINTS_BOARD
+					? board->points_board : board->signals_board,
+					t_bidib_board_accessory_mapping, mapping_position);
+			message->mapping = mapping;
+			message->aspect = bidib_get_aspect_by_id(mapping->aspects, element->aspect);
+			break;
+		}
+		case BIDIB_STATE_INDEX_POINTS_DCC:
+		case BIDIB_STATE_INDEX_SIGNALS_DCC: {
+			const t_bidib_dcc_accessory_mapping *const mapping = &g_array_index(
+					message->index == BIDIB_STATE_INDEX_POINTS_DCC
+					? board->points_dcc : board->signals_dcc,
+					t_bidib_dcc_accessory_mapping, mapping_position);
+			message->mapping = mapping;
+			message->aspect = bidib_get_dcc_aspect_by_id(mapping->aspects, element->aspect);
+			break;
+		}
+		default: {
+			const t_bidib_peripheral_mapping *const mapping = &g_array_index(
+					board->peripherals, t_bidib_peripheral_mapping, mapping_position);
+			message->mapping = mapping;
+			message->aspect = bidib_get_aspect_by_id(mapping->aspects, element->aspect);
+			break;
+		}
+	}
+	if (message->aspect == NULL) {
+		syslog_libbidib(LOG_ERR, "Set route: aspect %s of %s %s doesn't exist",
+		                element->aspect, name, element->id);
+		return false;
+	}
+	if (!bidib_state_index_lookup(message->index, element->id, NULL, &message->position)) {
+		syslog_libbidib(LOG_ERR, "Set route: internal state of %s %s invalid",
+		                name, element->id);
+		return false;
+	}
+	return true;
+}
+
+// Checks whether a resolved element was already resolved earlier in the route. A
+// later aspect would supersede an earlier one, so the earlier one is never reached.
+static bool bidib_route_is_duplicate(const GArray *messages, size_t resolved,
+                                     const t_bidib_route_element *element) {
+	const t_bidib_route_message *const message =
+			&g_array_index(messages, t_bidib_route_message, resolved);
+	for (size_t i = 0; i < resolved; i++) {
+		const t_bidib_route_message *const other =
+				&g_array_index(messages, t_bidib_route_message, i);
+		if (other->index == message->index && other->position == message->position) {
+			syslog_libbidib(LOG_ERR, "Set route: %s %s is contained more than once",
+			                bidib_route_element_name(element->type), element->id);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Orders the messages by board, and within a board as given in the route
+static gint bidib_route_message_compare(gconstpointer a, gconstpointer b) {
+	const t_bidib_route_message *const message_a = a;
+	const t_bidib_route_message *const message_b = b;
+	if (message_a->board != message_b->board) {
+		return message_a->board < message_b->board ? -1 : 1;
+	}
+	return message_a->order < message_b->order ? -1 : (message_a->order > message_b->order);
+}
+
+// Sends the message of a resolved element and adds the element to the awaited
+// targets if it reports its final state. Returns false if a message was rejected
+// because the message queue of the node is full.
+// Shall only be called with trackstate_accessories_mutex, trackstate_peripherals_mutex
+// and bidib_boards_rwlock >= read acquired.
+static bool bidib_route_send(const t_bidib_route_message *message, unsigned int action_id,
+                             GArray *targets) {
+	const t_bidib_board *const board = &g_array_index(bidib_boards, t_bidib_board,
+	                                                  message->board);
+	t_bidib_route_target target = {message->index, message->position, 0, false};
+	if (message->index == BIDIB_STATE_INDEX_POINTS_BOARD ||
+	    message->index == BIDIB_STATE_INDEX_SIGNALS_BOARD) {
+		const t_bidib_board_accessory_mapping *const mapping = message->mapping;
+		const t_bidib_aspect *const aspect = message->aspect;
+		if (bidib_send_accessory_set_intern(board->node_addr, mapping->number, aspect->value,
+		                                    action_id) == BIDIB_NODE_SEND_REJECTED) {
+			return false;
+		}
+		target.value = aspect->value;
+		g_array_append_val(targets, target);
+	} else if (message->index == BIDIB_STATE_INDEX_PERIPHERALS) {
+		const t_bidib_peripheral_mapping *const mapping = message->mapping;
+		const t_bidib_aspect *const aspect = message->aspect;
+		if (bidib_send_lc_output_intern(board->node_addr, mapping->port.port0,
+		                                mapping->port.port1, aspect->value, action_id)
+		    == BIDIB_NODE_SEND_REJECTED) {
+			return false;
+		}
+		target.value = aspect->value;
+		g_array_append_val(targets, target);
+	} else {
+		const t_bidib_dcc_accessory_mapping *const mapping = message->mapping;
+		const t_bidib_dcc_aspect *const aspect = message->aspect;
+		t_bidib_cs_accessory_mod params;
+		params.dcc_address = mapping->dcc_addr;
+		params.time = 0x00;
+		bool rejected = false;
+		for (size_t k = 0; k < aspect->port_values->len; k++) {
+			const t_bidib_dcc_aspect_port_value *const aspect_port_value =
+					&g_array_index(aspect->port_values, t_bidib_dcc_aspect_port_value, k);
+			params.data = (uint8_t) (aspect_port_value->port & 0x1F);
+			params.data = params.data | (uint8_t) (aspect_port_value->value << 5);
+			params.data = params.data | (mapping->extended_accessory << 7);
+			if (bidib_send_cs_accessory_intern(board->node_addr, params, action_id)
+			    == BIDIB_NODE_SEND_REJECTED) {
+				rejected = true;
+			}
+		}
+		if (rejected) {
+			return false;
+		}
+		// DCC accessories report no state, their state is the one last sent
+		GArray *states = message->index == BIDIB_STATE_INDEX_POINTS_DCC
+		                 ? bidib_track_state.points_dcc : bidib_track_state.signals_dcc;
+		t_bidib_dcc_accessory_state *accessory_state =
+				&g_array_index(states, t_bidib_dcc_accessory_state, message->position);
+		accessory_state->data.state_id = (char *) aspect->id;
+		bidib_state_stamp(message->index, accessory_state);
+	}
+	return true;
+}
+
+unsigned int bidib_set_route(const t_bidib_route_element *elements, size_t count) {
+	if (elements == NULL || count == 0) {
+		syslog_libbidib(LOG_ERR, "Set route: parameters must not be NULL or empty");
+		return 0;
+	}
+	GArray *messages = g_array_sized_new(FALSE, FALSE, sizeof(t_bidib_route_message), count);
+	g_array_set_size(messages, count);
+
+	// For bidib_send_cs_accessory_intern and the DCC accessory states (devnote: write)
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	// For the lookup of the peripheral states
+	pthread_mutex_lock(&trackstate_peripherals_mutex);
+	// For accessing bidib_boards and the mapping indexes
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+
+	for (size_t i = 0; i < count; i++) {
+		if (!bidib_route_resolve(&elements[i], i,
+		                         &g_array_index(messages, t_bidib_route_message, i)) ||
+		    bidib_route_is_duplicate(messages, i, &elements[i])) {
+			pthread_rwlock_unlock(&bidib_boards_rwlock);
+			pthread_mutex_unlock(&trackstate_peripherals_mutex);
+			pthread_mutex_unlock(&trackstate_accessories_mutex);
+			g_array_free(messages, TRUE);
+			return 0;
+		}
+	}
+	g_array_sort(messages, bidib_route_message_compare);
+
+	t_bidib_route_progress *progress = malloc(sizeof(t_bidib_route_progress));
+	progress->targets = g_array_sized_new(FALSE, FALSE, sizeof(t_bidib_route_target), count);
+	progress->status = BIDIB_ROUTE_PENDING;
+	// Reports stamped before the route was sent do not count
+	progress->sent_seq = bidib_state_get_change_seq();
+	const unsigned int action_id = bidib_get_and_incr_action_id();
+	size_t node_count = 0;
+	size_t rejected_count = 0;
+	bidib_hold_flush();
+	for (size_t i = 0; i < messages->len; i++) {
+		const t_bidib_route_message *const message =
+				&g_array_index(messages, t_bidib_route_message, i);
+		if (i == 0 ||
+		    message->board != g_array_index(messages, t_bidib_route_message, i - 1).board) {
+			node_count++;
+		}
+		if (!bidib_route_send(message, action_id, progress->targets)) {
+			syslog_libbidib(LOG_ERR, "Set route: %s %s with action id: %d rejected, "
+			                "message queue of its board full",
+			                bidib_route_element_name(elements[message->order].type),
+			                elements[message->order].id, action_id);
+			rejected_count++;
+		}
+	}
+	bidib_release_flush();
+	if (rejected_count > 0) {
+		// The rejected elements would never report their aspect
+		progress->status = BIDIB_ROUTE_FAILED;
+	}
+
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	pthread_mutex_unlock(&trackstate_peripherals_mutex);
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+	g_array_free(messages, TRUE);
+
+	pthread_mutex_lock(&bidib_route_mutex);
+	if (bidib_routes == NULL) {
+		bidib_routes = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+	unsigned int route;
+	do {
+		route = ++bidib_route_next;
+	} while (route == 0 || g_hash_table_contains(bidib_routes, GUINT_TO_POINTER(route)));
+	g_hash_table_insert(bidib_routes, GUINT_TO_POINTER(route), progress);
+	pthread_mutex_unlock(&bidib_route_mutex);
+	syslog_libbidib(LOG_NOTICE, "Set route: %zu elements on %zu nodes with action id: %d "
+	                "as route %u", count, node_count, action_id, route);
+	return route;
+}
+
+// Marks the targets whose state was reported after the route was sent.
+// Shall only be called with bidib_route_mutex acquired.
+static t_bidib_route_status bidib_route_update(t_bidib_route_progress *progress) {
+	if (progress->status != BIDIB_ROUTE_PENDING) {
+		return progress->status;
+	}
+	bool pending = false;
+	// For the accessory and peripheral states and their change stamps
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	pthread_mutex_lock(&trackstate_peripherals_mutex);
+	for (size_t i = 0; i < progress->targets->len; i++) {
+		t_bidib_route_target *target = &g_array_index(progress->targets,
+		                                              t_bidib_route_target, i);
+		if (target->reported ||
+		    bidib_state_get_stamp(target->index, target->position) <= progress->sent_seq) {
+			pending = pending || !target->reported;
+			continue;
+		}
+		if (target->index == BIDIB_STATE_INDEX_PERIPHERALS) {
+			const t_bidib_peripheral_state *const state = &g_array_index(
+					bidib_track_state.peripherals, t_bidib_peripheral_state, target->position);
+			target->reported = state->data.state_value == target->value;
+		} else {
+			const t_bidib_board_accessory_state *const state = &g_array_index(
+					target->index == BIDIB_STATE_INDEX_POINTS_BOARD
+					? bidib_track_state.points_board : bidib_track_state.signals_board,
+					t_bidib_board_accessory_state, target->position);
+			if (state->data.execution_state == BIDIB_EXEC_STATE_ERROR) {
+				progress->status = BIDIB_ROUTE_FAILED;
+				break;
+			}
+			// Not reached yet is followed by a MSG_ACCESSORY_NOTIFY once reached
+			target->reported = state->data.state_value == target->value &&
+			                   (state->data.execution_state & 0x01) == 0x00;
+		}
+		pending = pending || !target->reported;
+	}
+	pthread_mutex_unlock(&trackstate_peripherals_mutex);
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+	if (progress->status == BIDIB_ROUTE_PENDING && !pending) {
+		progress->status = BIDIB_ROUTE_COMPLETE;
+	}
+	return progress->status;
+}
+
+t_bidib_route_status bidib_get_route_status(unsigned int route) {
+	t_bidib_route_status status = BIDIB_ROUTE_UNKNOWN;
+	pthread_mutex_lock(&bidib_route_mutex);
+	t_bidib_route_progress *progress = bidib_routes == NULL ? NULL
+	        : g_hash_table_lookup(bidib_routes, GUINT_TO_POINTER(route));
+	if (progress != NULL) {
+		status = bidib_route_update(progress);
+	}
+	pthread_mutex_unlock(&bidib_route_mutex);
+	return status;
+}
+
+t_bidib_route_status bidib_wait_route(unsigned int route, unsigned int timeout_ms) {
+	struct timespec deadline;
+	bidib_wait_deadline(timeout_ms, &deadline);
+	while (bidib_running) {
+		// Read before the status, so that no change in between is missed
+		const uint64_t seq = bidib_state_get_change_seq();
+		const t_bidib_route_status status = bidib_get_route_status(route);
+		if (status != BIDIB_ROUTE_PENDING) {
+			return status;
+		}
+		if (bidib_wait_deadline_passed(&deadline)) {
+			break;
+		}
+		bidib_state_wait_change(seq, &deadline);
+	}
+	return BIDIB_ROUTE_PENDING;
+}
+
+static void bidib_route_progress_free(gpointer data) {
+	t_bidib_route_progress *progress = data;
+	g_array_free(progress->targets, TRUE);
+	free(progress);
+}
+
+void bidib_free_route(unsigned int route) {
+	pthread_mutex_lock(&bidib_route_mutex);
+	t_bidib_route_progress *progress = bidib_routes == NULL ? NULL
+	        : g_hash_table_lookup(bidib_routes, GUINT_TO_POINTER(route));
+	if (progress != NULL) {
+		g_hash_table_remove(bidib_routes, GUINT_TO_POINTER(route));
+		bidib_route_progress_free(progress);
+	}
+	pthread_mutex_unlock(&bidib_route_mutex);
+}
+
+void bidib_routes_free(void) {
+	pthread_mutex_lock(&bidib_route_mutex);
+	if (bidib_routes != NULL) {
+		GHashTableIter iter;
+		gpointer progress;
+		g_hash_table_iter_init(&iter, bidib_routes);
+		while (g_hash_table_iter_next(&iter, NULL, &progress)) {
+			bidib_route_progress_free(progress);
+		}
+		g_hash_table_destroy(bidib_routes);
+		bidib_routes = NULL;
+	}
+	pthread_mutex_unlock(&bidib_route_mutex);
+}
@@ -47,6 +47,8 @@
 static pthread_t bidib_receiver_thread = 0;
 static pthread_t bidib_autoflush_thread = 0;
 static pthread_t bidib_heartbeat_thread = 0;
+static pthread_t bidib_export_thread = 0;
+static pthread_t bidib_server_thread = 0;
 
 // Pthread locks that protect read/write access to the bidib_boards,
 // bidib_track_state, bidib_trains data structures. 
@@ -62,6 +64,8 @@ pthread_mutex_t trackstate_reversers_mutex;
 pthread_mutex_t trackstate_trains_mutex;
 pthread_mutex_t trackstate_boosters_mutex;
 pthread_mutex_t trackstate_track_outputs_mutex;
+// Serialises the publishing of track state snapshots
+pthread_mutex_t trackstate_snapshot_mutex;
 
 
 volatile bool bidib_running = false;
@@ -82,6 +86,7 @@ static void bidib_init_mutexes(void) {
 	pthread_mutex_init(&trackstate_trains_mutex, NULL);
 	pthread_mutex_init(&trackstate_boosters_mutex, NULL);
 	pthread_mutex_init(&trackstate_track_outputs_mutex, NULL);
+	pthread_mutex_init(&trackstate_snapshot_mutex, NULL);
 	
 	
 	pthread_mutex_lock(&trackstate_accessories_mutex);
@@ -127,6 +132,12 @@ static void bidib_init_mutexes(void) {
 static void bidib_init_threads(unsigned int flush_interval) {
 	pthread_create(&bidib_receiver_thread, NULL, bidib_auto_receive, NULL);
 	pthread_create(&bidib_heartbeat_thread, NULL, bidib_heartbeat_log, NULL);
+	if (bidib_state_export_enabled()) {
+		pthread_create(&bidib_export_thread, NULL, bidib_state_export_run, NULL);
+	}
+	if (bidib_state_server_enabled()) {
+		pthread_create(&bidib_server_thread, NULL, bidib_state_server_run, NULL);
+	}
 	if (flush_interval > 0) {
 		unsigned int *arg = malloc(sizeof(unsigned int));
 		*arg = flush_interval;
@@ -134,6 +145,30 @@ static void bidib_init_threads(unsigned int flush_interval) {
 	}
 }
 
+int bidib_set_state_file(const char *path) {
+	if (bidib_running) {
+		return 1;
+	}
+	bidib_state_persist_set_path(path);
+	return 0;
+}
+
+int bidib_set_state_export(const char *name) {
+	if (bidib_running) {
+		return 1;
+	}
+	bidib_state_export_set_name(name);
+	return 0;
+}
+
+int bidib_set_state_server(const char *path) {
+	if (bidib_running) {
+		return 1;
+	}
+	bidib_state_server_set_path(path);
+	return 0;
+}
+
 int bidib_start_pointer(uint8_t (*read)(int *), void (*write_n)(uint8_t*, int32_t), 
                         const char *config_dir, unsigned int flush_interval) {
 	if (read == NULL || write_n == NULL || (!bidib_lowlevel_debug_mode && config_dir == NULL)) {
@@ -233,6 +268,8 @@ void bidib_stop(void) {
 		// time to process last expected packet (reply to setting track output to off)
 		usleep(300000); // 0.3s
 		bidib_running = false;
+		// Release the threads blocked in the wait functions
+		bidib_state_changes_wake_all();
 		syslog_libbidib(LOG_NOTICE, "libbidib stopping: waiting for threads to join");
 		if (bidib_receiver_thread != 0) {
 			pthread_join(bidib_receiver_thread, NULL);
@@ -243,6 +280,14 @@ void bidib_stop(void) {
 		if (bidib_heartbeat_thread != 0) {
 			pthread_join(bidib_heartbeat_thread, NULL);
 		}
+		if (bidib_export_thread != 0) {
+			pthread_join(bidib_export_thread, NULL);
+			bidib_export_thread = 0;
+		}
+		if (bidib_server_thread != 0) {
+			pthread_join(bidib_server_thread, NULL);
+			bidib_server_thread = 0;
+		}
 		syslog_libbidib(LOG_NOTICE, "libbidib stopping: threads have joined");
 		bidib_serial_port_close();
 		syslog_libbidib(LOG_NOTICE, "libbidib stopping: Serial port closed");
@@ -254,7 +299,12 @@ void bidib_stop(void) {
 		syslog_libbidib(LOG_NOTICE, "libbidib stopping: Uplink error queue freed");
 		bidib_uplink_intern_queue_free();
 		syslog_libbidib(LOG_NOTICE, "libbidib stopping: Uplink intern queue freed");
+		// The routes refer to the state arrays
+		bidib_routes_free();
 		bidib_state_free();
+		bidib_state_persist_set_path(NULL);
+		bidib_state_export_set_name(NULL);
+		bidib_state_server_set_path(NULL);
 		syslog_libbidib(LOG_NOTICE, "libbidib stopping: State freed");
 		syslog_libbidib(LOG_NOTICE, "libbidib stopped");
 		closelog();
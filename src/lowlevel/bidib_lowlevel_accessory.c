@@ -32,22 +32,29 @@
 #include "../../include/lowlevel/bidib_lowlevel_accessory.h"
 #include "../../include/highlevel/bidib_highlevel_util.h"
 #include "../transmission/bidib_transmission_intern.h"
+#include "bidib_lowlevel_intern.h"
 #include "../../include/definitions/bidib_messages.h"
 #include "../../include/definitions/bidib_definitions_custom.h"
 
 
-void bidib_send_accessory_set(t_bidib_node_address node_address, uint8_t anum,
-                              uint8_t aspect, unsigned int action_id) {
+t_bidib_node_send_result bidib_send_accessory_set_intern(t_bidib_node_address node_address,
+                                                         uint8_t anum, uint8_t aspect,
+                                                         unsigned int action_id) {
 	if (anum > 127) {
 		syslog_libbidib(LOG_ERR, "MSG_ACCESSORY_SET called with invalid parameter anum = %02x", anum);
-		return;
+		return BIDIB_NODE_SEND_REJECTED;
 	} else if (aspect > 127) {
 		syslog_libbidib(LOG_ERR, "MSG_ACCESSORY_SET called with invalid parameter aspect = %02x", aspect);
-		return;
+		return BIDIB_NODE_SEND_REJECTED;
 	}
 	uint8_t addr_stack[] = {node_address.top, node_address.sub, node_address.subsub, 0x00};
 	uint8_t data[] = {anum, aspect};
-	bidib_buffer_message_with_data(addr_stack, MSG_ACCESSORY_SET, 2, data, action_id);
+	return bidib_buffer_message_with_data(addr_stack, MSG_ACCESSORY_SET, 2, data, action_id);
+}
+
+void bidib_send_accessory_set(t_bidib_node_address node_address, uint8_t anum,
+                              uint8_t aspect, unsigned int action_id) {
+	bidib_send_accessory_set_intern(node_address, anum, aspect, action_id);
 }
 
 void bidib_send_accessory_get(t_bidib_node_address node_address, uint8_t anum,
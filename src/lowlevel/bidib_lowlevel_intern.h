@@ -32,6 +32,7 @@
 
 
 #include "../../include/definitions/bidib_definitions_custom.h"
+#include "../transmission/bidib_transmission_intern.h"
 #include <pthread.h>
 
 /**
@@ -58,9 +59,41 @@ void bidib_send_cs_drive_intern(t_bidib_node_address node_address,
  * @param cs_accessory_params the parameters.
  * @param action_id reference number to a high level function call, 0 to signal
  * no reference.
+ * @return whether the command was sent, queued or rejected. The accessory state
+ * is only updated if it was not rejected.
  */
-void bidib_send_cs_accessory_intern(t_bidib_node_address node_address,
-                                    t_bidib_cs_accessory_mod cs_accessory_params,
-                                    unsigned int action_id);
+t_bidib_node_send_result bidib_send_cs_accessory_intern(
+		t_bidib_node_address node_address, t_bidib_cs_accessory_mod cs_accessory_params,
+		unsigned int action_id);
+
+/**
+ * Applies a setting to an accessory, see bidib_send_accessory_set.
+ *
+ * @param node_address the three bytes on top of the address stack.
+ * @param anum the object identifier at the node, range 0...127.
+ * @param aspect the state of the object, range 0...127.
+ * @param action_id reference number to a high level function call, 0 to signal
+ * no reference.
+ * @return whether the message was sent, queued or rejected. Invalid parameters
+ * are rejected.
+ */
+t_bidib_node_send_result bidib_send_accessory_set_intern(t_bidib_node_address node_address,
+                                                         uint8_t anum, uint8_t aspect,
+                                                         unsigned int action_id);
+
+/**
+ * Sets an output port, see bidib_send_lc_output.
+ *
+ * @param node_address the three bytes on top of the address stack.
+ * @param port0 the first byte of the port.
+ * @param port1 the second byte of the port.
+ * @param portstat the new port status.
+ * @param action_id reference number to a high level function call, 0 to signal
+ * no reference.
+ * @return whether the message was sent, queued or rejected.
+ */
+t_bidib_node_send_result bidib_send_lc_output_intern(t_bidib_node_address node_address,
+                                                     uint8_t port0, uint8_t port1,
+                                                     uint8_t portstat, unsigned int action_id);
 
 #endif
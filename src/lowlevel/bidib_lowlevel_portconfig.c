@@ -32,17 +32,24 @@
 #include "../../include/lowlevel/bidib_lowlevel_portconfig.h"
 #include "../../include/highlevel/bidib_highlevel_util.h"
 #include "../transmission/bidib_transmission_intern.h"
+#include "bidib_lowlevel_intern.h"
 #include "../../include/definitions/bidib_messages.h"
 #include "../../include/definitions/bidib_definitions_custom.h"
 
 
-void bidib_send_lc_output(t_bidib_node_address node_address, uint8_t port0,
-                          uint8_t port1, uint8_t portstat,
-                          unsigned int action_id) {
+t_bidib_node_send_result bidib_send_lc_output_intern(t_bidib_node_address node_address,
+                                                     uint8_t port0, uint8_t port1,
+                                                     uint8_t portstat, unsigned int action_id) {
 	uint8_t addr_stack[] = {node_address.top, node_address.sub,
 	                              node_address.subsub, 0x00};
 	uint8_t data[] = {port0, port1, portstat};
-	bidib_buffer_message_with_data(addr_stack, MSG_LC_OUTPUT, 3, data, action_id);
+	return bidib_buffer_message_with_data(addr_stack, MSG_LC_OUTPUT, 3, data, action_id);
+}
+
+void bidib_send_lc_output(t_bidib_node_address node_address, uint8_t port0,
+                          uint8_t port1, uint8_t portstat,
+                          unsigned int action_id) {
+	bidib_send_lc_output_intern(node_address, port0, port1, portstat, action_id);
 }
 
 void bidib_send_lc_port_query(t_bidib_node_address node_address, uint8_t port0,
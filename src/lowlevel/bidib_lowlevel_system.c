@@ -114,6 +114,10 @@ void bidib_send_sys_reset(unsigned int action_id) {
 	bidib_uplink_error_queue_reset(true);
 	bidib_uplink_intern_queue_reset(true);
 	bidib_state_reset();
+	// Pre-populates the states with the ones confirmed before the last stop
+	const bool warm_start = bidib_state_persist_restore();
+	// Only states reported by the boards after the restore can skip their initial value
+	const uint64_t restore_seq = bidib_state_get_change_seq();
 	bidib_state_init_allocation_table();
 	t_bidib_node_address interface = {0x00, 0x00, 0x00};
 	bidib_send_get_pkt_capacity(interface, 0);
@@ -125,10 +129,14 @@ void bidib_send_sys_reset(unsigned int action_id) {
 	usleep(500000); // wait for track output so it can receive initial values, 0.5s
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	bidib_state_query_occupancy();
+	if (warm_start) {
+		// The reports correct the restored states that differ from the hardware
+		bidib_state_query_accessories();
+	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
 	bidib_flush();
-	usleep(500000); // wait for occupancy data, 0.5s
-	bidib_state_set_initial_values();
+	usleep(500000); // wait for occupancy data and accessory states, 0.5s
+	bidib_state_set_initial_values(warm_start, restore_seq);
 }
 
 void bidib_send_nodetab_getall(t_bidib_node_address node_address,
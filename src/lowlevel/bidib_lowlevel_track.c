@@ -97,16 +97,20 @@ void bidib_send_cs_drive(t_bidib_node_address node_address,
 }
 
 
-void bidib_send_cs_accessory_intern(t_bidib_node_address node_address,
-                             t_bidib_cs_accessory_mod cs_accessory_params,
-                             unsigned int action_id) {
+t_bidib_node_send_result bidib_send_cs_accessory_intern(
+		t_bidib_node_address node_address, t_bidib_cs_accessory_mod cs_accessory_params,
+		unsigned int action_id) {
 	uint8_t addr_stack[] = {node_address.top, node_address.sub,
 	                        node_address.subsub, 0x00};
 	uint8_t data[] = {cs_accessory_params.dcc_address.addrl,
 	                  cs_accessory_params.dcc_address.addrh, cs_accessory_params.data,
 	                  cs_accessory_params.time};
-	bidib_buffer_message_with_data(addr_stack, MSG_CS_ACCESSORY, 4, data, action_id);
-	bidib_state_cs_accessory(node_address, cs_accessory_params);
+	const t_bidib_node_send_result result =
+			bidib_buffer_message_with_data(addr_stack, MSG_CS_ACCESSORY, 4, data, action_id);
+	if (result != BIDIB_NODE_SEND_REJECTED) {
+		bidib_state_cs_accessory(node_address, cs_accessory_params);
+	}
+	return result;
 }
 
 void bidib_send_cs_accessory(t_bidib_node_address node_address,
@@ -102,7 +102,7 @@ static bool bidib_config_parse_single_board_features(yaml_parser_t *parser) {
 						board.features = g_array_append_val(board.features, feature);
 						if (feature.number == 0x03 && feature.value > 0) {
 							board.secack_on = true;
-							syslog_libbidib(LOG_INFO, "SecAck on for board %s", board.id->str);
+							syslog_libbidib(LOG_INFO, "SecAck on for board %s", board.id);
 						}
 						feature_ready = true;
 					} else {
@@ -134,7 +134,7 @@ static bool bidib_config_parse_single_board_features(yaml_parser_t *parser) {
 									tmp = g_array_index(board.features, t_bidib_board_feature, i);
 									if (tmp.number == feature.number) {
 										syslog_libbidib(LOG_ERR, "Two board features with same number "
-										                "configured for board %s", board.id->str);
+										                "configured for board %s", board.id);
 										error = true;
 									}
 								}
@@ -180,7 +180,7 @@ static bool bidib_config_parse_single_board_features(yaml_parser_t *parser) {
 							}
 							break;
 						case BOARD_CONFIG_ID_KEY:
-							board.id = g_string_new((char *) event.data.scalar.value);
+							board.id = bidib_state_arena_strdup((char *) event.data.scalar.value);
 							board.connected = false;
 							board.node_addr.top = 0x00;
 							board.node_addr.sub = 0x00;
@@ -215,12 +215,12 @@ static bool bidib_config_parse_single_board_features(yaml_parser_t *parser) {
 							if (bidib_string_to_uid((char *) event.data.scalar.value, &board.unique_id)) {
 								error = true;
 								syslog_libbidib(LOG_ERR, "Unique id of board %s is in wrong format", 
-								                board.id->str);
+								                board.id);
 							} else {
 								if (board.unique_id.class_id & (1 << 1)) {
 									// board has booster functionality
 									t_bidib_booster_state booster_state;
-									booster_state.id = strdup(board.id->str);
+									booster_state.id = strdup(board.id);
 									booster_state.data.power_state = BIDIB_BSTR_OFF;
 									booster_state.data.power_state_simple = bidib_booster_normal_to_simple(
 											booster_state.data.power_state);
@@ -232,7 +232,7 @@ static bool bidib_config_parse_single_board_features(yaml_parser_t *parser) {
 								if (board.unique_id.class_id & (1 << 4)) {
 									// board has dcc functionality
 									t_bidib_track_output_state track_output_state;
-									track_output_state.id = strdup(board.id->str);
+									track_output_state.id = strdup(board.id);
 									track_output_state.cs_state = BIDIB_CS_OFF;
 									bidib_state_add_track_output(track_output_state);
 								}
@@ -261,7 +261,7 @@ static bool bidib_config_parse_single_board_features(yaml_parser_t *parser) {
 	} else {
 		if ((error = bidib_state_add_board(board))) {
 			syslog_libbidib(LOG_ERR, "Board %s configured with same id or unique id as another board",
-			                board.id->str);
+			                board.id);
 			bidib_state_free_single_board(board);
 		}
 	}
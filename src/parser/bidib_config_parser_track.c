@@ -41,12 +41,12 @@ static bool initial_value_valid(GArray *aspect_list, const char *value,
 	}
 	for (size_t i = 0; i < aspect_list->len; i++) {
 		if (dcc_aspects) {
-			if (!strcmp(g_array_index(aspect_list, t_bidib_dcc_aspect, i).id->str,
+			if (!strcmp(g_array_index(aspect_list, t_bidib_dcc_aspect, i).id,
 			            value)) {
 				return true;
 			}
 		} else {
-			if (!strcmp(g_array_index(aspect_list, t_bidib_aspect, i).id->str,
+			if (!strcmp(g_array_index(aspect_list, t_bidib_aspect, i).id,
 			            value)) {
 				return true;
 			}
@@ -120,7 +120,7 @@ static bool bidib_config_parse_aspect(yaml_parser_t *parser, GArray *aspect_list
 						}
 						break;
 					case ASPECT_ID_KEY:
-						aspect.id = g_string_new((const gchar *) event.data.scalar.value);
+						aspect.id = bidib_state_arena_strdup((char *) event.data.scalar.value);
 						last_scalar = ASPECT_ID_VALUE;
 						break;
 					case ASPECT_ID_VALUE:
@@ -135,7 +135,7 @@ static bool bidib_config_parse_aspect(yaml_parser_t *parser, GArray *aspect_list
 						                         &aspect.value)) {
 							error = true;
 							syslog_libbidib(LOG_ERR, "Value of aspect %s is in wrong format",
-							                aspect.id->str);
+							                aspect.id);
 						} else {
 							last_scalar = ASPECT_VALUE_VALUE;
 						}
@@ -152,9 +152,9 @@ static bool bidib_config_parse_aspect(yaml_parser_t *parser, GArray *aspect_list
 	t_bidib_aspect tmp;
 	for (size_t i = 0; i < aspect_list->len; i++) {
 		tmp = g_array_index(aspect_list, t_bidib_aspect, i);
-		if (tmp.value == aspect.value || !strcmp(tmp.id->str, aspect.id->str)) {
+		if (tmp.value == aspect.value || !strcmp(tmp.id, aspect.id)) {
 			syslog_libbidib(LOG_ERR, "Aspect %s configured with same id or value "
-			                "as another aspect", aspect.id->str);
+			                "as another aspect", aspect.id);
 			error = true;
 			break;
 		}
@@ -231,7 +231,7 @@ static bool bidib_config_parse_single_board_accessory(yaml_parser_t *parser,
 					if (mapping.aspects->len == 0) {
 						error = true;
 						syslog_libbidib(LOG_ERR, "No aspect configured for board point/signal %s",
-						                mapping.id->str);
+						                mapping.id);
 					}
 				} else {
 					error = true;
@@ -242,7 +242,7 @@ static bool bidib_config_parse_single_board_accessory(yaml_parser_t *parser,
 					error = bidib_config_parse_aspect(parser, mapping.aspects);
 					if (error) {
 						syslog_libbidib(LOG_ERR, "Error while parsing an aspect of board point/signal %s",
-						                mapping.id->str);
+						                mapping.id);
 					}
 				} else {
 					error = true;
@@ -270,7 +270,7 @@ static bool bidib_config_parse_single_board_accessory(yaml_parser_t *parser,
 						break;
 					case BOARD_ACCESSORY_ID_KEY:
 						accessory_state.id = strdup((char *) event.data.scalar.value);
-						mapping.id = g_string_new(accessory_state.id);
+						mapping.id = bidib_state_arena_strdup(accessory_state.id);
 						mapping.aspects = g_array_sized_new(FALSE, FALSE, sizeof(t_bidib_aspect), 3);
 						last_scalar = BOARD_ACCESSORY_ID_VALUE;
 						break;
@@ -286,7 +286,7 @@ static bool bidib_config_parse_single_board_accessory(yaml_parser_t *parser,
 						                         &mapping.number)) {
 							error = true;
 							syslog_libbidib(LOG_ERR, "Number of board point/signal %s is in wrong format",
-							                mapping.id->str);
+							                mapping.id);
 						} else {
 							last_scalar = BOARD_ACCESSORY_NUMBER_VALUE;
 						}
@@ -309,20 +309,20 @@ static bool bidib_config_parse_single_board_accessory(yaml_parser_t *parser,
 						}
 						break;
 					case BOARD_ACCESSORY_INITIAL_KEY:
-						initial_value.id = g_string_new(accessory_state.id);
-						initial_value.value = g_string_new((const gchar *) event.data.scalar.value);
+						initial_value.id = bidib_state_arena_strdup(accessory_state.id);
+						initial_value.value = bidib_state_arena_strdup((char *) event.data.scalar.value);
 						if (type == BOARD_SETUP_POINTS_BOARD_KEY) {
 							bidib_state_add_initial_point_value(initial_value);
 						} else {
 							bidib_state_add_initial_signal_value(initial_value);
 						}
 						last_scalar = BOARD_ACCESSORY_INITIAL_VALUE;
-						if (!initial_value_valid(mapping.aspects, initial_value.value->str, false)) {
+						if (!initial_value_valid(mapping.aspects, initial_value.value, false)) {
 							error = true;
 							syslog_libbidib(LOG_ERR, 
 							                "Initial value %s of board point/signal %s "
 							                "is not defined in aspects",
-							                initial_value.value->str, mapping.id->str);
+							                initial_value.value, mapping.id);
 						}
 						break;
 					case BOARD_ACCESSORY_INITIAL_VALUE:
@@ -340,7 +340,7 @@ static bool bidib_config_parse_single_board_accessory(yaml_parser_t *parser,
 			tmp = g_array_index(board->points_board, t_bidib_board_accessory_mapping, i);
 			if (tmp.number == mapping.number) {
 				syslog_libbidib(LOG_ERR, "Point %s configured with same number "
-				                "as point %s", mapping.id->str, tmp.id->str);
+				                "as point %s", mapping.id, tmp.id);
 				error = true;
 				break;
 			}
@@ -351,7 +351,7 @@ static bool bidib_config_parse_single_board_accessory(yaml_parser_t *parser,
 			tmp = g_array_index(board->signals_board, t_bidib_board_accessory_mapping, i);
 			if (tmp.number == mapping.number) {
 				syslog_libbidib(LOG_ERR, "Signal %s configured with same number "
-				                "as signal %s", mapping.id->str, tmp.id->str);
+				                "as signal %s", mapping.id, tmp.id);
 				error = true;
 				break;
 			}
@@ -368,7 +368,7 @@ static bool bidib_config_parse_single_board_accessory(yaml_parser_t *parser,
 			case BOARD_SETUP_POINTS_BOARD_KEY:
 				if (bidib_state_add_board_point_state(accessory_state)) {
 					syslog_libbidib(LOG_ERR, "Point %s configured with same id "
-					                "as another point", mapping.id->str);
+					                "as another point", mapping.id);
 					bidib_state_free_single_board_accessory_state(accessory_state);
 					error = true;
 				}
@@ -376,7 +376,7 @@ static bool bidib_config_parse_single_board_accessory(yaml_parser_t *parser,
 			case BOARD_SETUP_SIGNALS_BOARD_KEY:
 				if (bidib_state_add_board_signal_state(accessory_state)) {
 					syslog_libbidib(LOG_ERR, "Signal %s configured with same id "
-					                "as another signal", mapping.id->str);
+					                "as another signal", mapping.id);
 					bidib_state_free_single_board_accessory_state(accessory_state);
 					error = true;
 				}
@@ -501,7 +501,7 @@ static bool bidib_config_parse_dcc_aspect_port(yaml_parser_t *parser, GArray *po
 }
 
 static bool dcc_aspects_equal(t_bidib_dcc_aspect *aspect1, t_bidib_dcc_aspect *aspect2) {
-	if (!strcmp(aspect1->id->str, aspect2->id->str)) {
+	if (!strcmp(aspect1->id, aspect2->id)) {
 		return true;
 	}
 	t_bidib_dcc_aspect_port_value *port_value1;
@@ -577,7 +577,7 @@ static bool bidib_config_parse_dcc_aspect(yaml_parser_t *parser, GArray *aspect_
 					if (aspect.port_values->len == 0) {
 						error = true;
 						syslog_libbidib(LOG_ERR, "No port values configured for aspect %s",
-						                aspect.id->str);
+						                aspect.id);
 					}
 				} else {
 					error = true;
@@ -588,7 +588,7 @@ static bool bidib_config_parse_dcc_aspect(yaml_parser_t *parser, GArray *aspect_
 					error = bidib_config_parse_dcc_aspect_port(parser, aspect.port_values);
 					if (error) {
 						syslog_libbidib(LOG_ERR, "Error while parsing a port value for aspect %s",
-						                aspect.id->str);
+						                aspect.id);
 					}
 				} else {
 					error = true;
@@ -614,7 +614,7 @@ static bool bidib_config_parse_dcc_aspect(yaml_parser_t *parser, GArray *aspect_
 						}
 						break;
 					case DCC_ASPECT_ID_KEY:
-						aspect.id = g_string_new((const gchar *) event.data.scalar.value);
+						aspect.id = bidib_state_arena_strdup((char *) event.data.scalar.value);
 						aspect.port_values = g_array_sized_new(FALSE, FALSE,
 						                                       sizeof(t_bidib_dcc_aspect_port_value), 3);
 						last_scalar = DCC_ASPECT_ID_VALUE;
@@ -641,7 +641,7 @@ static bool bidib_config_parse_dcc_aspect(yaml_parser_t *parser, GArray *aspect_
 		tmp = g_array_index(aspect_list, t_bidib_dcc_aspect, i);
 		if (dcc_aspects_equal(&aspect, &tmp)) {
 			syslog_libbidib(LOG_ERR, "Dcc aspect %s configured with same id or port "
-			                "combination as aspect %s", aspect.id->str, tmp.id->str);
+			                "combination as aspect %s", aspect.id, tmp.id);
 			error = true;
 			break;
 		}
@@ -709,7 +709,7 @@ static bool bidib_config_parse_single_dcc_accessory(yaml_parser_t *parser,
 						error = true;
 						syslog_libbidib(LOG_ERR, 
 						                "No aspect configured for dcc point/signal %s",
-						                mapping.id->str);
+						                mapping.id);
 					}
 				} else {
 					error = true;
@@ -721,7 +721,7 @@ static bool bidib_config_parse_single_dcc_accessory(yaml_parser_t *parser,
 					if (error) {
 						syslog_libbidib(LOG_ERR, 
 						                "Error while parsing a dcc aspect of dcc "
-						                "point/signal %s", mapping.id->str);
+						                "point/signal %s", mapping.id);
 					}
 				} else {
 					error = true;
@@ -749,7 +749,7 @@ static bool bidib_config_parse_single_dcc_accessory(yaml_parser_t *parser,
 						break;
 					case DCC_ACCESSORY_ID_KEY:
 						accessory_state.id = strdup((char *) event.data.scalar.value);
-						mapping.id = g_string_new(accessory_state.id);
+						mapping.id = bidib_state_arena_strdup(accessory_state.id);
 						mapping.aspects = g_array_sized_new(FALSE, FALSE, sizeof(t_bidib_dcc_aspect), 3);
 						last_scalar = DCC_ACCESSORY_ID_VALUE;
 						break;
@@ -766,7 +766,7 @@ static bool bidib_config_parse_single_dcc_accessory(yaml_parser_t *parser,
 							error = true;
 							syslog_libbidib(LOG_ERR, 
 							                "Dcc address of dcc point/signal %s is in wrong format",
-							                mapping.id->str);
+							                mapping.id);
 						} else {
 							last_scalar = DCC_ACCESSORY_ADDR_VALUE;
 						}
@@ -785,7 +785,7 @@ static bool bidib_config_parse_single_dcc_accessory(yaml_parser_t *parser,
 							error = true;
 							syslog_libbidib(LOG_ERR, 
 							                "Extended bit of dcc point/signal %s must be 0 or 1",
-							                mapping.id->str);
+							                mapping.id);
 						} else {
 							last_scalar = DCC_ACCESSORY_EXTENDED_VALUE;
 						}
@@ -808,20 +808,20 @@ static bool bidib_config_parse_single_dcc_accessory(yaml_parser_t *parser,
 						}
 						break;
 					case DCC_ACCESSORY_INITIAL_KEY:
-						initial_value.id = g_string_new(accessory_state.id);
-						initial_value.value = g_string_new((const gchar *) event.data.scalar.value);
+						initial_value.id = bidib_state_arena_strdup(accessory_state.id);
+						initial_value.value = bidib_state_arena_strdup((char *) event.data.scalar.value);
 						if (type == BOARD_SETUP_POINTS_DCC_KEY) {
 							bidib_state_add_initial_point_value(initial_value);
 						} else {
 							bidib_state_add_initial_signal_value(initial_value);
 						}
 						last_scalar = DCC_ACCESSORY_INITIAL_VALUE;
-						if (!initial_value_valid(mapping.aspects, initial_value.value->str, true)) {
+						if (!initial_value_valid(mapping.aspects, initial_value.value, true)) {
 							error = true;
 							syslog_libbidib(LOG_ERR, 
 							                "Initial value %s of dcc point/signal %s "
 							                "is not defined in aspects",
-							                initial_value.value->str, mapping.id->str);
+							                initial_value.value, mapping.id);
 						}
 						break;
 					case DCC_ACCESSORY_INITIAL_VALUE:
@@ -842,7 +842,7 @@ static bool bidib_config_parse_single_dcc_accessory(yaml_parser_t *parser,
 			case BOARD_SETUP_POINTS_DCC_KEY:
 				if (bidib_state_add_dcc_point_state(accessory_state, mapping.dcc_addr)) {
 					syslog_libbidib(LOG_ERR, "Point %s configured with same id or dcc address "
-					                "as another point", mapping.id->str);
+					                "as another point", mapping.id);
 					bidib_state_free_single_dcc_accessory_state(accessory_state);
 					error = true;
 				}
@@ -850,7 +850,7 @@ static bool bidib_config_parse_single_dcc_accessory(yaml_parser_t *parser,
 			case BOARD_SETUP_SIGNALS_DCC_KEY:
 				if (bidib_state_add_dcc_signal_state(accessory_state, mapping.dcc_addr)) {
 					syslog_libbidib(LOG_ERR, "Signal %s configured with same id or dcc address "
-					                "as another signal", mapping.id->str);
+					                "as another signal", mapping.id);
 					bidib_state_free_single_dcc_accessory_state(accessory_state);
 					error = true;
 				}
@@ -927,7 +927,7 @@ static bool bidib_config_parse_single_board_peripheral(yaml_parser_t *parser,
 					if (mapping.aspects->len == 0) {
 						error = true;
 						syslog_libbidib(LOG_ERR, "No aspect configured for peripheral %s",
-						                mapping.id->str);
+						                mapping.id);
 					}
 				} else {
 					error = true;
@@ -938,7 +938,7 @@ static bool bidib_config_parse_single_board_peripheral(yaml_parser_t *parser,
 					error = bidib_config_parse_aspect(parser, mapping.aspects);
 					if (error) {
 						syslog_libbidib(LOG_ERR, "Error while parsing an aspect of peripheral %s",
-						                mapping.id->str);
+						                mapping.id);
 					}
 				} else {
 					error = true;
@@ -966,7 +966,7 @@ static bool bidib_config_parse_single_board_peripheral(yaml_parser_t *parser,
 						break;
 					case PERIPHERAL_ID_KEY:
 						peripheral_state.id = strdup((char *) event.data.scalar.value);
-						mapping.id = g_string_new(peripheral_state.id);
+						mapping.id = bidib_state_arena_strdup(peripheral_state.id);
 						mapping.aspects = g_array_sized_new(FALSE, FALSE, sizeof(t_bidib_aspect), 3);
 						last_scalar = PERIPHERAL_ID_VALUE;
 						break;
@@ -982,7 +982,7 @@ static bool bidib_config_parse_single_board_peripheral(yaml_parser_t *parser,
 						                         &mapping.number)) {
 							error = true;
 							syslog_libbidib(LOG_ERR, "Number of peripheral %s is in wrong format",
-							                mapping.id->str);
+							                mapping.id);
 						} else {
 							last_scalar = PERIPHERAL_NUMBER_VALUE;
 						}
@@ -999,7 +999,7 @@ static bool bidib_config_parse_single_board_peripheral(yaml_parser_t *parser,
 						                         &mapping.port)) {
 							error = true;
 							syslog_libbidib(LOG_ERR, "Port of peripheral %s is in wrong format", 
-							                mapping.id->str);
+							                mapping.id);
 						} else {
 							last_scalar = PERIPHERAL_PORT_VALUE;
 						}
@@ -1022,15 +1022,15 @@ static bool bidib_config_parse_single_board_peripheral(yaml_parser_t *parser,
 						}
 						break;
 					case PERIPHERAL_INITIAL_KEY:
-						initial_value.id = g_string_new(peripheral_state.id);
-						initial_value.value = g_string_new((const gchar *) event.data.scalar.value);
+						initial_value.id = bidib_state_arena_strdup(peripheral_state.id);
+						initial_value.value = bidib_state_arena_strdup((char *) event.data.scalar.value);
 						bidib_state_add_initial_peripheral_value(initial_value);
 						last_scalar = PERIPHERAL_INITIAL_VALUE;
-						if (!initial_value_valid(mapping.aspects, initial_value.value->str, false)) {
+						if (!initial_value_valid(mapping.aspects, initial_value.value, false)) {
 							error = true;
 							syslog_libbidib(LOG_ERR, 
 							                "Initial value %s of peripheral %s is not defined in aspects",
-							                initial_value.value->str, mapping.id->str);
+							                initial_value.value, mapping.id);
 						}
 						break;
 					case PERIPHERAL_INITIAL_VALUE:
@@ -1048,14 +1048,14 @@ static bool bidib_config_parse_single_board_peripheral(yaml_parser_t *parser,
 		if (tmp.port.port0 == mapping.port.port0 &&
 		    tmp.port.port1 == mapping.port.port1) {
 			syslog_libbidib(LOG_ERR, "Peripheral %s configured with same port "
-			                "as peripheral %s", mapping.id->str, tmp.id->str);
+			                "as peripheral %s", mapping.id, tmp.id);
 			error = true;
 			break;
 		}
 		
 		if (tmp.number == mapping.number) {
 			syslog_libbidib(LOG_ERR, "Peripheral %s configured with same number "
-			                "as peripheral %s", mapping.id->str, tmp.id->str);
+			                "as peripheral %s", mapping.id, tmp.id);
 			error = true;
 			break;
 		}
@@ -1069,7 +1069,7 @@ static bool bidib_config_parse_single_board_peripheral(yaml_parser_t *parser,
 	} else {
 		if (bidib_state_add_peripheral_state(peripheral_state)) {
 			syslog_libbidib(LOG_ERR, "Peripheral %s configured with same id "
-			                "as another peripheral", mapping.id->str);
+			                "as another peripheral", mapping.id);
 			bidib_state_free_single_peripheral_state(peripheral_state);
 			error = true;
 		}
@@ -1146,8 +1146,8 @@ static bool bidib_config_parse_single_board_segment(yaml_parser_t *parser,
 						}
 						break;
 					case SEGMENT_ID_KEY:
-						segment_state.id = g_string_new((char *) event.data.scalar.value);
-						mapping.id = g_string_new(segment_state.id->str);
+						segment_state.id = bidib_state_arena_strdup((char *) event.data.scalar.value);
+						mapping.id = segment_state.id;
 						segment_state.occupied = false;
 						segment_state.confidence.conf_void = false;
 						segment_state.confidence.freeze = false;
@@ -1182,7 +1182,7 @@ static bool bidib_config_parse_single_board_segment(yaml_parser_t *parser,
 						}
 						break;
 					case SEGMENT_LENGTH_KEY:
-						segment_state.length = g_string_new((char *) event.data.scalar.value);
+						segment_state.length = bidib_state_arena_strdup((char *) event.data.scalar.value);
 						last_scalar = SEGMENT_LENGTH_VALUE;
 						break;
 					case SEGMENT_LENGTH_VALUE:
@@ -1199,7 +1199,7 @@ static bool bidib_config_parse_single_board_segment(yaml_parser_t *parser,
 		tmp = g_array_index(board->segments, t_bidib_segment_mapping, i);
 		if (tmp.addr == mapping.addr) {
 			syslog_libbidib(LOG_ERR, "Segment %s configured with same address "
-			                "as segment %s", mapping.id->str, tmp.id->str);
+			                "as segment %s", mapping.id, tmp.id);
 			error = true;
 			break;
 		}
@@ -1211,7 +1211,7 @@ static bool bidib_config_parse_single_board_segment(yaml_parser_t *parser,
 	} else {
 		if (bidib_state_add_segment_state(segment_state)) {
 			syslog_libbidib(LOG_ERR, "Segment %s configured with same id "
-			                "as another segment", mapping.id->str);
+			                "as another segment", mapping.id);
 			bidib_state_free_single_segment_state_intern(segment_state);
 			error = true;
 		}
@@ -1286,7 +1286,7 @@ static bool bidib_config_parse_single_board_reverser(yaml_parser_t *parser,
 						break;
 					case REVERSER_ID_KEY:
 						reverser_state.id = strdup((char *) event.data.scalar.value);
-						mapping.id = g_string_new(reverser_state.id);
+						mapping.id = bidib_state_arena_strdup(reverser_state.id);
 						last_scalar = REVERSER_ID_VALUE;
 						break;
 					case REVERSER_ID_VALUE:
@@ -1297,7 +1297,7 @@ static bool bidib_config_parse_single_board_reverser(yaml_parser_t *parser,
 						}
 						break;
 					case REVERSER_CV_KEY:
-						mapping.cv = g_string_new((char *) event.data.scalar.value);
+						mapping.cv = bidib_state_arena_strdup((char *) event.data.scalar.value);
 						last_scalar = REVERSER_CV_VALUE;
 						break;
 					case REVERSER_CV_VALUE:
@@ -1311,9 +1311,9 @@ static bool bidib_config_parse_single_board_reverser(yaml_parser_t *parser,
 	t_bidib_reverser_mapping tmp;
 	for (size_t i = 0; i < board->reversers->len; i++) {
 		tmp = g_array_index(board->reversers, t_bidib_reverser_mapping, i);
-		if (strcmp(tmp.cv->str, mapping.cv->str) == 0) {
+		if (strcmp(tmp.cv, mapping.cv) == 0) {
 			syslog_libbidib(LOG_ERR, "Reverser %s configured with same CV "
-			                "as reverser %s", mapping.id->str, tmp.id->str);
+			                "as reverser %s", mapping.id, tmp.id);
 			error = true;
 			break;
 		}
@@ -1327,7 +1327,7 @@ static bool bidib_config_parse_single_board_reverser(yaml_parser_t *parser,
 	} else {
 		if (bidib_state_add_reverser_state(reverser_state)) {
 			syslog_libbidib(LOG_ERR, "Reverser %s configured with same id "
-			                "as another reverser", mapping.id->str);
+			                "as another reverser", mapping.id);
 			bidib_state_free_single_reverser_state(reverser_state);
 			error = true;
 		}
@@ -1420,7 +1420,7 @@ static bool bidib_config_parse_single_board_setup(yaml_parser_t *parser) {
 									parser, board, last_scalar);
 							if (error) {
 								syslog_libbidib(LOG_ERR, "Error while parsing a board point of board %s",
-								                board->id->str);
+								                board->id);
 							}
 							break;
 						case BOARD_SETUP_POINTS_DCC_KEY:
@@ -1428,7 +1428,7 @@ static bool bidib_config_parse_single_board_setup(yaml_parser_t *parser) {
 									parser, board, last_scalar);
 							if (error) {
 								syslog_libbidib(LOG_ERR, "Error while parsing a dcc point of board %s",
-								                board->id->str);
+								                board->id);
 							}
 							break;
 						case BOARD_SETUP_SIGNALS_BOARD_KEY:
@@ -1436,7 +1436,7 @@ static bool bidib_config_parse_single_board_setup(yaml_parser_t *parser) {
 									parser, board, last_scalar);
 							if (error) {
 								syslog_libbidib(LOG_ERR, "Error while parsing a board signal of board %s",
-								                board->id->str);
+								                board->id);
 							}
 							break;
 						case BOARD_SETUP_SIGNALS_DCC_KEY:
@@ -1444,7 +1444,7 @@ static bool bidib_config_parse_single_board_setup(yaml_parser_t *parser) {
 									parser, board, last_scalar);
 							if (error) {
 								syslog_libbidib(LOG_ERR, "Error while parsing a dcc signal of board %s",
-								                board->id->str);
+								                board->id);
 							}
 							break;
 						case BOARD_SETUP_PERIPHERALS_KEY:
@@ -1452,7 +1452,7 @@ static bool bidib_config_parse_single_board_setup(yaml_parser_t *parser) {
 									parser, board);
 							if (error) {
 								syslog_libbidib(LOG_ERR, "Error while parsing a peripheral of board %s",
-								                board->id->str);
+								                board->id);
 							}
 							break;
 						case BOARD_SETUP_SEGMENTS_KEY:
@@ -1460,7 +1460,7 @@ static bool bidib_config_parse_single_board_setup(yaml_parser_t *parser) {
 									parser, board);
 							if (error) {
 								syslog_libbidib(LOG_ERR, "Error while parsing a segment of board %s",
-								                board->id->str);
+								                board->id);
 							}
 							break;
 						case BOARD_SETUP_REVERSERS_KEY:
@@ -1468,7 +1468,7 @@ static bool bidib_config_parse_single_board_setup(yaml_parser_t *parser) {
 									parser, board);
 							if (error) {
 								syslog_libbidib(LOG_ERR, "Error while parsing a reverser of board %s",
-								                board->id->str);
+								                board->id);
 							}
 							break;
 						default:
@@ -29,6 +29,7 @@
 #include <yaml.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "../../include/highlevel/bidib_highlevel_util.h"
 #include "../state/bidib_state_intern.h"
@@ -40,7 +41,7 @@ static bool bidib_config_parse_single_train_calibration(yaml_parser_t *parser,
 	yaml_event_t event;
 	bool error = false;
 	bool done = false;
-	train->calibration = g_array_sized_new(FALSE, FALSE, sizeof(int), 9);
+	int calibration[9];
 	size_t counter = 0;
 	uint8_t value;
 
@@ -87,8 +88,7 @@ static bool bidib_config_parse_single_train_calibration(yaml_parser_t *parser,
 					error = true;
 					syslog_libbidib(LOG_ERR, "Calibration values must be smaller than 127");
 				} else {
-					int tmp = value;
-					g_array_append_val(train->calibration, tmp);
+					calibration[counter] = value;
 					counter++;
 					if (counter == 9) {
 						done = true;
@@ -99,9 +99,14 @@ static bool bidib_config_parse_single_train_calibration(yaml_parser_t *parser,
 		yaml_event_delete(&event);
 	}
 
-	if (error) {
-		g_array_free(train->calibration, TRUE);
-		train->calibration = NULL;
+	if (!error) {
+		int *values = bidib_state_arena_alloc(sizeof(calibration));
+		if (values == NULL) {
+			error = true;
+		} else {
+			memcpy(values, calibration, sizeof(calibration));
+			train->calibration = values;
+		}
 	}
 	return error;
 }
@@ -190,21 +195,21 @@ static bool bidib_config_parse_single_train_peripheral(yaml_parser_t *parser,
 						}
 						break;
 					case TRAIN_PERIPHERAL_BIT_KEY:
-						mapping.id = g_string_new(peripheral_state.id);
+						mapping.id = bidib_state_arena_strdup(peripheral_state.id);
 						if (bidib_string_to_byte((char *) event.data.scalar.value,
 						                         &mapping.bit) || mapping.bit > 31) {
 							error = true;
 							syslog_libbidib(LOG_ERR, "Bit of peripheral %s must be smaller than 31",
-							                mapping.id->str);
+							                mapping.id);
 						} else {
 							t_bidib_train_peripheral_mapping tmp;
 							for (size_t i = 0; i < train->peripherals->len; i++) {
 								tmp = g_array_index(train->peripherals,
 								                    t_bidib_train_peripheral_mapping, i);
-								if (tmp.bit == mapping.bit || !strcmp(tmp.id->str, mapping.id->str)) {
+								if (tmp.bit == mapping.bit || !strcmp(tmp.id, mapping.id)) {
 									syslog_libbidib(LOG_ERR, 
 									                "Two train peripherals with same bit or same "
-									                "id configured for train %s", train->id->str);
+									                "id configured for train %s", train->id);
 									error = true;
 								}
 							}
@@ -225,10 +230,10 @@ static bool bidib_config_parse_single_train_peripheral(yaml_parser_t *parser,
 							error = true;
 							syslog_libbidib(LOG_ERR, 
 							                "Initial value of peripheral %s must be 0 or 1",
-							                mapping.id->str);
+							                mapping.id);
 						} else {
-							initial_value.train = g_string_new(train_state->id->str);
-							initial_value.id = g_string_new(peripheral_state.id);
+							initial_value.train = train_state->id;
+							initial_value.id = bidib_state_arena_strdup(peripheral_state.id);
 							bidib_state_add_initial_train_value(initial_value);
 							last_scalar = TRAIN_PERIPHERAL_INITIAL_VALUE;
 						}
@@ -317,7 +322,7 @@ static bool bidib_config_parse_single_train(yaml_parser_t *parser) {
 						error = bidib_config_parse_single_train_calibration(parser, &train);
 						if (error) {
 							syslog_libbidib(LOG_ERR, "Error while parsing the calibration values "
-							                "for train %s", train.id->str);
+							                "for train %s", train.id);
 						}
 					}
 					in_seq = true;
@@ -342,7 +347,7 @@ static bool bidib_config_parse_single_train(yaml_parser_t *parser) {
 					                                                   &train_state);
 					if (error) {
 						syslog_libbidib(LOG_ERR, "Error while parsing a peripheral of train %s",
-						                train.id->str);
+						                train.id);
 					}
 				} else {
 					error = true;
@@ -372,10 +377,10 @@ static bool bidib_config_parse_single_train(yaml_parser_t *parser) {
 							}
 							break;
 						case TRAIN_ID_KEY:
-							train.id = g_string_new((char *) event.data.scalar.value);
+							train.id = bidib_state_arena_strdup((char *) event.data.scalar.value);
 							train.peripherals = g_array_sized_new(FALSE, FALSE, sizeof(
 									t_bidib_train_peripheral_mapping), 4);
-							train_state.id = g_string_new((char *) event.data.scalar.value);
+							train_state.id = train.id;
 							train_state.on_track = false;
 							train_state.orientation = BIDIB_TRAIN_ORIENTATION_LEFT;
 							train_state.set_speed_step = 0;
@@ -402,7 +407,7 @@ static bool bidib_config_parse_single_train(yaml_parser_t *parser) {
 							if (bidib_string_to_dccaddr((char *) event.data.scalar.value, &train.dcc_addr)) {
 								error = true;
 								syslog_libbidib(LOG_ERR, "Dcc address of train %s is in wrong format",
-								                train.id->str);
+								                train.id);
 							} else {
 								last_scalar = TRAIN_DCC_ADDR_VALUE;
 							}
@@ -418,12 +423,12 @@ static bool bidib_config_parse_single_train(yaml_parser_t *parser) {
 							if (bidib_string_to_byte((char *) event.data.scalar.value, &train.dcc_speed_steps)) {
 								error = true;
 								syslog_libbidib(LOG_ERR, "Speed steps value of train %s is in wrong format",
-								                train.id->str);
+								                train.id);
 							} else if (train.dcc_speed_steps != 14 && train.dcc_speed_steps != 28 &&
 							           train.dcc_speed_steps != 126) {
 								error = true;
 								syslog_libbidib(LOG_ERR, "Train %s has invalid speed steps value", 
-								                train.id->str);
+								                train.id);
 							} else {
 								last_scalar = TRAIN_DCC_STEPS_VALUE;
 							}
@@ -462,7 +467,7 @@ static bool bidib_config_parse_single_train(yaml_parser_t *parser) {
 	} else {
 		if ((error = bidib_state_add_train(train))) {
 			syslog_libbidib(LOG_ERR, "Train %s configured with same id or dcc address as another train",
-			                train.id->str);
+			                train.id);
 			bidib_state_free_single_train(train);
 			bidib_state_free_single_train_state_intern(train_state);
 		} else {
@@ -29,6 +29,7 @@
 
 #include <stdlib.h>
 #include <memory.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <time.h>
@@ -41,6 +42,8 @@
 #include "../../include/lowlevel/bidib_lowlevel_system.h"
 #include "../../include/lowlevel/bidib_lowlevel_feature.h"
 #include "../../include/lowlevel/bidib_lowlevel_occupancy.h"
+#include "../../include/lowlevel/bidib_lowlevel_accessory.h"
+#include "../../include/lowlevel/bidib_lowlevel_portconfig.h"
 #include "../highlevel/bidib_highlevel_intern.h"
 #include "../lowlevel/bidib_lowlevel_intern.h"
 #include "../transmission/bidib_transmission_intern.h"
@@ -86,9 +89,34 @@ int bidib_state_init(const char *config_dir) {
 	bidib_boards = g_array_sized_new(FALSE, FALSE, sizeof(t_bidib_board), 32);
 	bidib_trains = g_array_sized_new(FALSE, FALSE, sizeof(t_bidib_train), 16);
 
+	bidib_state_index_init();
+
 	if (bidib_config_parse(config_dir)) {
 		return 1;
 	}
+
+	// For bidib_state_index_build_routes
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	pthread_mutex_lock(&trackstate_peripherals_mutex);
+	pthread_mutex_lock(&trackstate_segments_mutex);
+	pthread_mutex_lock(&trackstate_boosters_mutex);
+	pthread_mutex_lock(&trackstate_track_outputs_mutex);
+	// The parser adds the mappings directly to the boards (devnote: write)
+	pthread_rwlock_wrlock(&bidib_boards_rwlock);
+	bidib_state_index_build_mappings();
+	bidib_state_index_build_routes();
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	pthread_mutex_unlock(&trackstate_track_outputs_mutex);
+	pthread_mutex_unlock(&trackstate_boosters_mutex);
+	pthread_mutex_unlock(&trackstate_segments_mutex);
+	pthread_mutex_unlock(&trackstate_peripherals_mutex);
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+
+	bidib_state_changes_init();
+	bidib_state_persist_open();
+	bidib_state_snapshot_publish();
+	bidib_state_export_open();
+	bidib_state_server_open();
 	return 0;
 }
 
@@ -192,8 +220,9 @@ static bool bidib_state_query_nodetab(t_bidib_node_address node_address,
 				board_i->connected = true;
 				board_i->node_addr = node_address_i;
 				syslog_libbidib(LOG_INFO, "Board %s connected with address 0x%02x 0x%02x 0x%02x 0x00",
-				                board_i->id->str, board_i->node_addr.top, board_i->node_addr.sub,
+				                board_i->id, board_i->node_addr.top, board_i->node_addr.sub,
 				                board_i->node_addr.subsub);
+				bidib_state_index_update_node_routes();
 			}
 			pthread_rwlock_unlock(&bidib_boards_rwlock);
 			if (i > 0 && unique_id_i.class_id & (1 << 7)) {
@@ -255,6 +284,30 @@ void bidib_state_query_occupancy(void) {
 	}
 }
 
+void bidib_state_query_accessories(void) {
+	for (size_t i = 0; i < bidib_boards->len; i++) {
+		const t_bidib_board *const board_i = &g_array_index(bidib_boards, t_bidib_board, i);
+		if (!board_i->connected) {
+			continue;
+		}
+		const GArray *accessories[] = {board_i->points_board, board_i->signals_board};
+		for (size_t j = 0; j < 2; j++) {
+			for (size_t k = 0; k < accessories[j]->len; k++) {
+				const t_bidib_board_accessory_mapping *const mapping =
+						&g_array_index(accessories[j], t_bidib_board_accessory_mapping, k);
+				bidib_send_accessory_get(board_i->node_addr, mapping->number, 0);
+			}
+		}
+		for (size_t j = 0; j < board_i->peripherals->len; j++) {
+			const t_bidib_peripheral_mapping *const mapping =
+					&g_array_index(board_i->peripherals, t_bidib_peripheral_mapping, j);
+			bidib_send_lc_port_query(board_i->node_addr, mapping->port.port0,
+			                         mapping->port.port1, 0);
+		}
+		bidib_flush();
+	}
+}
+
 void bidib_state_set_board_features(void) {
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	for (size_t i = 0; i < bidib_boards->len; i++) {
@@ -309,7 +362,36 @@ void bidib_state_set_board_features(void) {
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
 }
 
-void bidib_state_set_initial_values(void) {
+bool bidib_state_initial_value_reached(t_bidib_state_index index,
+                                       const t_bidib_state_initial_value *value,
+                                       uint64_t reported_after) {
+	bool reached = false;
+	if (index == BIDIB_STATE_INDEX_PERIPHERALS) {
+		// For bidib_state_get_peripheral_state_ref
+		pthread_mutex_lock(&trackstate_peripherals_mutex);
+		const t_bidib_peripheral_state *const state =
+				bidib_state_get_peripheral_state_ref(value->id);
+		reached = state != NULL && state->data.state_id != NULL &&
+		          !strcmp(state->data.state_id, value->value) &&
+		          bidib_state_get_entry_stamp(index, state) > reported_after;
+		pthread_mutex_unlock(&trackstate_peripherals_mutex);
+	} else {
+		// For bidib_state_get_board_accessory_state_ref
+		pthread_mutex_lock(&trackstate_accessories_mutex);
+		const t_bidib_board_accessory_state *const state =
+				bidib_state_get_board_accessory_state_ref(
+						value->id, index == BIDIB_STATE_INDEX_POINTS_BOARD);
+		reached = state != NULL && state->data.state_id != NULL &&
+		          (state->data.execution_state == BIDIB_EXEC_STATE_REACHED ||
+		           state->data.execution_state == BIDIB_EXEC_STATE_REACHED_VERIFIED) &&
+		          !strcmp(state->data.state_id, value->value) &&
+		          bidib_state_get_entry_stamp(index, state) > reported_after;
+		pthread_mutex_unlock(&trackstate_accessories_mutex);
+	}
+	return reached;
+}
+
+void bidib_state_set_initial_values(bool skip_reached, uint64_t reported_after) {
 	t_bidib_state_initial_value *initial_value;
 	t_bidib_state_train_initial_value *train_initial_value;
 	t_bidib_track_output_state *track_output_state;
@@ -317,7 +399,12 @@ void bidib_state_set_initial_values(void) {
 	for (size_t i = 0; i < bidib_initial_values.points->len; i++) {
 		initial_value = 
 				&g_array_index(bidib_initial_values.points, t_bidib_state_initial_value, i);
-		bidib_switch_point(initial_value->id->str, initial_value->value->str);
+		if (skip_reached &&
+		    bidib_state_initial_value_reached(BIDIB_STATE_INDEX_POINTS_BOARD, initial_value,
+		                                      reported_after)) {
+			continue;
+		}
+		bidib_switch_point(initial_value->id, initial_value->value);
 		// Heuristic: Flush after every 4th point and wait a little, so as not to overload the boards
 		if (i % 4 == 0) {
 			bidib_flush();
@@ -330,7 +417,12 @@ void bidib_state_set_initial_values(void) {
 	for (size_t i = 0; i < bidib_initial_values.signals->len; i++) {
 		initial_value = 
 				&g_array_index(bidib_initial_values.signals, t_bidib_state_initial_value, i);
-		bidib_set_signal(initial_value->id->str, initial_value->value->str);
+		if (skip_reached &&
+		    bidib_state_initial_value_reached(BIDIB_STATE_INDEX_SIGNALS_BOARD, initial_value,
+		                                      reported_after)) {
+			continue;
+		}
+		bidib_set_signal(initial_value->id, initial_value->value);
 		// Heuristic: Flush after every 6th signal and wait a little, so as not to overload the boards
 		// less often than for points because set-signal causes only one response, not two
 		if (i % 6 == 0) {
@@ -344,7 +436,12 @@ void bidib_state_set_initial_values(void) {
 	for (size_t i = 0; i < bidib_initial_values.peripherals->len; i++) {
 		initial_value = 
 				&g_array_index(bidib_initial_values.peripherals, t_bidib_state_initial_value, i);
-		bidib_set_peripheral(initial_value->id->str, initial_value->value->str);
+		if (skip_reached &&
+		    bidib_state_initial_value_reached(BIDIB_STATE_INDEX_PERIPHERALS, initial_value,
+		                                      reported_after)) {
+			continue;
+		}
+		bidib_set_peripheral(initial_value->id, initial_value->value);
 		// there tend to be few peripherals, so do not add extra flushes and waits here
 	}
 	bidib_flush();
@@ -363,10 +460,10 @@ void bidib_state_set_initial_values(void) {
 			track_output_state = 
 					&g_array_index(bidib_track_state.track_outputs, t_bidib_track_output_state, j);
 			if (track_output_state != NULL) {
-				bidib_set_train_peripheral(train_initial_value->train->str,
-				                           train_initial_value->id->str, train_initial_value->value,
+				bidib_set_train_peripheral(train_initial_value->train,
+				                           train_initial_value->id, train_initial_value->value,
 				                           track_output_state->id);
-				bidib_set_train_speed(train_initial_value->train->str, 0, track_output_state->id);
+				bidib_set_train_speed(train_initial_value->train, 0, track_output_state->id);
 			}
 		}
 	}
@@ -444,11 +541,13 @@ bool bidib_state_add_board(t_bidib_board board) {
 	bool error = false;
 	// For bidib_state_get_board_ref, bidib_state_get_board_ref_by_uniqueid, and accessing bidib_boards
 	pthread_rwlock_wrlock(&bidib_boards_rwlock);
-	if (bidib_state_get_board_ref(board.id->str) != NULL ||
+	if (bidib_state_get_board_ref(board.id) != NULL ||
 	    bidib_state_get_board_ref_by_uniqueid(board.unique_id) != NULL) {
 		error = true;
 	} else {
 		g_array_append_val(bidib_boards, board);
+		bidib_state_index_insert(BIDIB_STATE_INDEX_BOARDS, board.id,
+		                         0, bidib_boards->len - 1);
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
 	return error;
@@ -494,105 +593,79 @@ bool bidib_state_dcc_addr_in_use(t_bidib_dcc_address dcc_address) {
 bool bidib_state_add_train(t_bidib_train train) {
 	bool error = bidib_state_dcc_addr_in_use(train.dcc_addr);
 	if (!error) {
-		if (bidib_state_get_train_ref(train.id->str) != NULL) {
+		if (bidib_state_get_train_ref(train.id) != NULL) {
 			error = true;
 		} else {
 			g_array_append_val(bidib_trains, train);
+			bidib_state_index_insert(BIDIB_STATE_INDEX_TRAINS, train.id,
+			                         0, bidib_trains->len - 1);
+			bidib_state_index_insert_train(train.dcc_addr, bidib_trains->len - 1);
 		}
 	}
 	return error;
 }
 
 static bool bidib_state_point_exists(const char *id) {
+	size_t position;
 	// For accessing bidib_track_state.points_board and .points_dcc
 	pthread_mutex_lock(&trackstate_accessories_mutex);
-	for (size_t i = 0; i < bidib_track_state.points_board->len; i++) {
-		if (!strcmp(id, g_array_index(bidib_track_state.points_board,
-		                              t_bidib_board_accessory_state, i).id)) {
-			pthread_mutex_unlock(&trackstate_accessories_mutex);
-			return true;
-		}
-	}
-	for (size_t i = 0; i < bidib_track_state.points_dcc->len; i++) {
-		if (!strcmp(id, g_array_index(bidib_track_state.points_dcc,
-		                              t_bidib_dcc_accessory_state, i).id)) {
-			pthread_mutex_unlock(&trackstate_accessories_mutex);
-			return true;
-		}
-	}
+	bool exists =
+		bidib_state_index_lookup(BIDIB_STATE_INDEX_POINTS_BOARD, id, NULL, &position) ||
+		bidib_state_index_lookup(BIDIB_STATE_INDEX_POINTS_DCC, id, NULL, &position);
 	pthread_mutex_unlock(&trackstate_accessories_mutex);
-	return false;
+	return exists;
 }
 
 static bool bidib_state_signal_exists(const char *id) {
+	size_t position;
 	// For accessing bidib_track_state.signals_board, .signals_dcc
 	pthread_mutex_lock(&trackstate_accessories_mutex);
-	for (size_t i = 0; i < bidib_track_state.signals_board->len; i++) {
-		if (!strcmp(id, g_array_index(bidib_track_state.signals_board,
-		                              t_bidib_board_accessory_state, i).id)) {
-			pthread_mutex_unlock(&trackstate_accessories_mutex);
-			return true;
-		}
-	}
-	for (size_t i = 0; i < bidib_track_state.signals_dcc->len; i++) {
-		if (!strcmp(id, g_array_index(bidib_track_state.signals_dcc,
-		                              t_bidib_dcc_accessory_state, i).id)) {
-			pthread_mutex_unlock(&trackstate_accessories_mutex);
-			return true;
-		}
-	}
+	bool exists =
+		bidib_state_index_lookup(BIDIB_STATE_INDEX_SIGNALS_BOARD, id, NULL, &position) ||
+		bidib_state_index_lookup(BIDIB_STATE_INDEX_SIGNALS_DCC, id, NULL, &position);
 	pthread_mutex_unlock(&trackstate_accessories_mutex);
-	return false;
+	return exists;
 }
 
 static bool bidib_state_peripheral_exists(const char *id) {
+	size_t position;
 	// For accessing bidib_track_state.peripherals
 	pthread_mutex_lock(&trackstate_peripherals_mutex);
-	
-	for (size_t i = 0; i < bidib_track_state.peripherals->len; i++) {
-		if (!strcmp(id, g_array_index(bidib_track_state.peripherals,
-		                              t_bidib_peripheral_state, i).id)) {
-			pthread_mutex_unlock(&trackstate_peripherals_mutex);
-			return true;
-		}
-	}
+	bool exists =
+		bidib_state_index_lookup(BIDIB_STATE_INDEX_PERIPHERALS, id, NULL, &position);
 	pthread_mutex_unlock(&trackstate_peripherals_mutex);
-	return false;
+	return exists;
 }
 
 static bool bidib_state_segment_exists(const char *id) {
+	size_t position;
 	// For accessing bidib_track_state.segments
 	pthread_mutex_lock(&trackstate_segments_mutex);
-	for (size_t i = 0; i < bidib_track_state.segments->len; i++) {
-		if (!strcmp(id, g_array_index(bidib_track_state.segments,
-		                              t_bidib_segment_state_intern, i).id->str)) {
-			pthread_mutex_unlock(&trackstate_segments_mutex);
-			return true;
-		}
-	}
+	bool exists =
+		bidib_state_index_lookup(BIDIB_STATE_INDEX_SEGMENTS, id, NULL, &position);
 	pthread_mutex_unlock(&trackstate_segments_mutex);
-	return false;
+	return exists;
 }
 
 static bool bidib_state_reverser_exists(const char *id) {
+	size_t position;
 	// For accessing bidib_track_state.reversers
 	pthread_mutex_lock(&trackstate_reversers_mutex);
-	
-	for (size_t i = 0; i < bidib_track_state.reversers->len; i++) {
-		if (!strcmp(id, g_array_index(bidib_track_state.reversers,
-		                              t_bidib_reverser_state, i).id)) {
-			pthread_mutex_unlock(&trackstate_reversers_mutex);
-			return true;
-		}
-	}
+	bool exists =
+		bidib_state_index_lookup(BIDIB_STATE_INDEX_REVERSERS, id, NULL, &position);
 	pthread_mutex_unlock(&trackstate_reversers_mutex);
-	return false;
+	return exists;
 }
 
 void bidib_state_add_booster(t_bidib_booster_state booster_state) {
 	// For accessing bidib_track_state.boosters (devnote: write)
 	pthread_mutex_lock(&trackstate_boosters_mutex);
 	g_array_append_val(bidib_track_state.boosters, booster_state);
+	bidib_state_index_insert(BIDIB_STATE_INDEX_BOOSTERS, booster_state.id,
+	                         0, bidib_track_state.boosters->len - 1);
+	bidib_state_stamp(BIDIB_STATE_INDEX_BOOSTERS,
+	                  &g_array_index(bidib_track_state.boosters, t_bidib_booster_state,
+	                                 bidib_track_state.boosters->len - 1));
 	pthread_mutex_unlock(&trackstate_boosters_mutex);
 }
 
@@ -600,6 +673,11 @@ void bidib_state_add_track_output(t_bidib_track_output_state track_output_state)
 	// For accessing bidib_track_state.track_outputs (devnote: write)
 	pthread_mutex_lock(&trackstate_track_outputs_mutex);
 	g_array_append_val(bidib_track_state.track_outputs, track_output_state);
+	bidib_state_index_insert(BIDIB_STATE_INDEX_TRACK_OUTPUTS, track_output_state.id,
+	                         0, bidib_track_state.track_outputs->len - 1);
+	bidib_state_stamp(BIDIB_STATE_INDEX_TRACK_OUTPUTS,
+	                  &g_array_index(bidib_track_state.track_outputs, t_bidib_track_output_state,
+	                                 bidib_track_state.track_outputs->len - 1));
 	pthread_mutex_unlock(&trackstate_track_outputs_mutex);
 }
 
@@ -607,8 +685,13 @@ void bidib_state_add_train_state(t_bidib_train_state_intern train_state) {
 	// For bidib_state_get_train_state_ref and for accessing bidib_track_state.trains (devnote: write)
 	pthread_mutex_lock(&trackstate_trains_mutex);
 	
-	if (bidib_state_get_train_state_ref(train_state.id->str) == NULL) {
+	if (bidib_state_get_train_state_ref(train_state.id) == NULL) {
 		g_array_append_val(bidib_track_state.trains, train_state);
+		bidib_state_index_insert(BIDIB_STATE_INDEX_TRAIN_STATES, train_state.id,
+		                         0, bidib_track_state.trains->len - 1);
+		bidib_state_stamp(BIDIB_STATE_INDEX_TRAIN_STATES,
+		                  &g_array_index(bidib_track_state.trains, t_bidib_train_state_intern,
+		                                 bidib_track_state.trains->len - 1));
 	}
 	pthread_mutex_unlock(&trackstate_trains_mutex);
 }
@@ -620,6 +703,11 @@ bool bidib_state_add_board_point_state(t_bidib_board_accessory_state point_state
 	// For accessing bidib_track_state.points_board (devnote: write)
 	pthread_mutex_lock(&trackstate_accessories_mutex);
 	g_array_append_val(bidib_track_state.points_board, point_state);
+	bidib_state_index_insert(BIDIB_STATE_INDEX_POINTS_BOARD, point_state.id,
+	                         0, bidib_track_state.points_board->len - 1);
+	bidib_state_stamp(BIDIB_STATE_INDEX_POINTS_BOARD,
+	                  &g_array_index(bidib_track_state.points_board, t_bidib_board_accessory_state,
+	                                 bidib_track_state.points_board->len - 1));
 	pthread_mutex_unlock(&trackstate_accessories_mutex);
 	return false;
 }
@@ -631,6 +719,11 @@ bool bidib_state_add_board_signal_state(t_bidib_board_accessory_state signal_sta
 	// For accessing bidib_track_state.signals_board (devnote: write)
 	pthread_mutex_lock(&trackstate_accessories_mutex);
 	g_array_append_val(bidib_track_state.signals_board, signal_state);
+	bidib_state_index_insert(BIDIB_STATE_INDEX_SIGNALS_BOARD, signal_state.id,
+	                         0, bidib_track_state.signals_board->len - 1);
+	bidib_state_stamp(BIDIB_STATE_INDEX_SIGNALS_BOARD,
+	                  &g_array_index(bidib_track_state.signals_board, t_bidib_board_accessory_state,
+	                                 bidib_track_state.signals_board->len - 1));
 	pthread_mutex_unlock(&trackstate_accessories_mutex);
 	return false;
 }
@@ -647,6 +740,11 @@ bool bidib_state_add_dcc_point_state(t_bidib_dcc_accessory_state point_state,
 	// For accessing bidib_track_state.points_dcc (devnote: write)
 	pthread_mutex_lock(&trackstate_accessories_mutex);
 	g_array_append_val(bidib_track_state.points_dcc, point_state);
+	bidib_state_index_insert(BIDIB_STATE_INDEX_POINTS_DCC, point_state.id,
+	                         0, bidib_track_state.points_dcc->len - 1);
+	bidib_state_stamp(BIDIB_STATE_INDEX_POINTS_DCC,
+	                  &g_array_index(bidib_track_state.points_dcc, t_bidib_dcc_accessory_state,
+	                                 bidib_track_state.points_dcc->len - 1));
 	pthread_mutex_unlock(&trackstate_accessories_mutex);
 	return false;
 }
@@ -663,6 +761,11 @@ bool bidib_state_add_dcc_signal_state(t_bidib_dcc_accessory_state signal_state,
 	// For accessing bidib_track_state.signals_dcc (devnote: write)
 	pthread_mutex_lock(&trackstate_accessories_mutex);
 	g_array_append_val(bidib_track_state.signals_dcc, signal_state);
+	bidib_state_index_insert(BIDIB_STATE_INDEX_SIGNALS_DCC, signal_state.id,
+	                         0, bidib_track_state.signals_dcc->len - 1);
+	bidib_state_stamp(BIDIB_STATE_INDEX_SIGNALS_DCC,
+	                  &g_array_index(bidib_track_state.signals_dcc, t_bidib_dcc_accessory_state,
+	                                 bidib_track_state.signals_dcc->len - 1));
 	pthread_mutex_unlock(&trackstate_accessories_mutex);
 	return false;
 }
@@ -674,17 +777,27 @@ bool bidib_state_add_peripheral_state(t_bidib_peripheral_state peripheral_state)
 	// For accessing bidib_track_state.peripherals (devnote: write)
 	pthread_mutex_lock(&trackstate_peripherals_mutex);
 	g_array_append_val(bidib_track_state.peripherals, peripheral_state);
+	bidib_state_index_insert(BIDIB_STATE_INDEX_PERIPHERALS, peripheral_state.id,
+	                         0, bidib_track_state.peripherals->len - 1);
+	bidib_state_stamp(BIDIB_STATE_INDEX_PERIPHERALS,
+	                  &g_array_index(bidib_track_state.peripherals, t_bidib_peripheral_state,
+	                                 bidib_track_state.peripherals->len - 1));
 	pthread_mutex_unlock(&trackstate_peripherals_mutex);
 	return false;
 }
 
 bool bidib_state_add_segment_state(t_bidib_segment_state_intern segment_state) {
-	if (bidib_state_segment_exists(segment_state.id->str)) {
+	if (bidib_state_segment_exists(segment_state.id)) {
 		return true;
 	}
 	// For accessing bidib_track_state.segments (devnote: write)
 	pthread_mutex_lock(&trackstate_segments_mutex);
 	g_array_append_val(bidib_track_state.segments, segment_state);
+	bidib_state_index_insert(BIDIB_STATE_INDEX_SEGMENTS, segment_state.id,
+	                         0, bidib_track_state.segments->len - 1);
+	bidib_state_stamp(BIDIB_STATE_INDEX_SEGMENTS,
+	                  &g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern,
+	                                 bidib_track_state.segments->len - 1));
 	pthread_mutex_unlock(&trackstate_segments_mutex);
 	return false;
 }
@@ -696,6 +809,11 @@ bool bidib_state_add_reverser_state(t_bidib_reverser_state reverser_state) {
 	// For accessing bidib_track_state.reversers (devnote: write)
 	pthread_mutex_lock(&trackstate_reversers_mutex);
 	g_array_append_val(bidib_track_state.reversers, reverser_state);
+	bidib_state_index_insert(BIDIB_STATE_INDEX_REVERSERS, reverser_state.id,
+	                         0, bidib_track_state.reversers->len - 1);
+	bidib_state_stamp(BIDIB_STATE_INDEX_REVERSERS,
+	                  &g_array_index(bidib_track_state.reversers, t_bidib_reverser_state,
+	                                 bidib_track_state.reversers->len - 1));
 	pthread_mutex_unlock(&trackstate_reversers_mutex);
 	return false;
 }
@@ -716,38 +834,72 @@ void bidib_state_add_initial_train_value(t_bidib_state_train_initial_value value
 	g_array_append_val(bidib_initial_values.trains, value);
 }
 
-void bidib_state_update_train_available(void) {
+void bidib_state_update_train_available(const GArray *dcc_addresses) {
 	// Notes regarding mutexes/locks:
 	// - accessing bidib_track_state.trains: trackstate_trains_mutex
-	// - bidib_get_train_position_intern: 
-	//       trackstate_segments_mutex, trackstate_trains_mutex, bidib_trains_rwlock >= read
+	// - bidib_state_index_lookup_train: bidib_trains_rwlock >= read
+	// - bidib_state_get_train_detections: 
+	//       trackstate_segments_mutex, bidib_trains_rwlock >= read
+	if (dcc_addresses == NULL || dcc_addresses->len == 0) {
+		return;
+	}
+	
+	// Collect the affected train states in the order of bidib_track_state.trains,
+	// so that the log events are in the same order as for an update of all trains
+	GArray *affected = g_array_sized_new(FALSE, FALSE, sizeof(size_t), dcc_addresses->len);
+	for (size_t i = 0; i < dcc_addresses->len; i++) {
+		size_t train_position, state_position;
+		if (!bidib_state_index_lookup_train(
+				g_array_index(dcc_addresses, t_bidib_dcc_address, i), &train_position)) {
+			continue;
+		}
+		const t_bidib_train *const train = 
+				&g_array_index(bidib_trains, t_bidib_train, train_position);
+		if (!bidib_state_index_lookup(BIDIB_STATE_INDEX_TRAIN_STATES, train->id,
+		                              NULL, &state_position)) {
+			continue;
+		}
+		size_t j = 0;
+		while (j < affected->len && g_array_index(affected, size_t, j) < state_position) {
+			j++;
+		}
+		if (j == affected->len || g_array_index(affected, size_t, j) != state_position) {
+			g_array_insert_val(affected, j, state_position);
+		}
+	}
+	
 	t_bidib_train_state_intern *train_state;
-	t_bidib_train_position_query query;
 	struct timespec tv;
 	clock_gettime(CLOCK_MONOTONIC, &tv);
-	for (size_t i = 0; i < bidib_track_state.trains->len; i++) {
-		train_state = 
-				&g_array_index(bidib_track_state.trains, t_bidib_train_state_intern, i);
-		query = bidib_get_train_position_intern(train_state->id->str);
-		if (query.length > 0) {
+	for (size_t i = 0; i < affected->len; i++) {
+		train_state = &g_array_index(bidib_track_state.trains, t_bidib_train_state_intern,
+		                             g_array_index(affected, size_t, i));
+		const t_bidib_train *const train = bidib_state_get_train_ref(train_state->id);
+		const bool was_on_track = train_state->on_track;
+		const t_bidib_train_orientation orientation = train_state->orientation;
+		bool orientation_is_left = true;
+		if (train != NULL && bidib_state_get_train_detections(train, &orientation_is_left) > 0) {
 			train_state->orientation = 
-				(query.orientation_is_left ? BIDIB_TRAIN_ORIENTATION_LEFT 
-				                           : BIDIB_TRAIN_ORIENTATION_RIGHT);
+				(orientation_is_left ? BIDIB_TRAIN_ORIENTATION_LEFT 
+				                     : BIDIB_TRAIN_ORIENTATION_RIGHT);
 			if (train_state->on_track == false) {
 				syslog_libbidib(LOG_NOTICE, "Train %s detected, orientated %s, at time %ld.%06ld",
-				                train_state->id->str, query.orientation_is_left ? "left" : "right",
+				                train_state->id, orientation_is_left ? "left" : "right",
 				                tv.tv_sec, tv.tv_nsec/1000);
 			}
 			train_state->on_track = true;
 		} else {
 			if (train_state->on_track == true) {
 				syslog_libbidib(LOG_WARNING, "Train %s lost, at time %ld.%06ld",
-				                train_state->id->str, tv.tv_sec, tv.tv_nsec/1000);
+				                train_state->id, tv.tv_sec, tv.tv_nsec/1000);
 			}
 			train_state->on_track = false;
 		}
-		bidib_free_train_position_query(query);
+		if (train_state->on_track != was_on_track || train_state->orientation != orientation) {
+			bidib_state_stamp(BIDIB_STATE_INDEX_TRAIN_STATES, train_state);
+		}
 	}
+	g_array_free(affected, TRUE);
 }
 
 void bidib_state_reset(void) {
@@ -798,6 +950,10 @@ void bidib_state_reset(void) {
 		dcc_accessory_state->data.time_unit = BIDIB_TIMEUNIT_MILLISECONDS;
 		dcc_accessory_state->data.switch_time = 0x00;
 	}
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_POINTS_BOARD);
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_POINTS_DCC);
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_SIGNALS_BOARD);
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_SIGNALS_DCC);
 	pthread_mutex_unlock(&trackstate_accessories_mutex);
 
 	// For accessing bidib_track_state.peripherals (devnote: write)
@@ -811,10 +967,12 @@ void bidib_state_reset(void) {
 		peripheral_state->data.time_unit = BIDIB_TIMEUNIT_MILLISECONDS;
 		peripheral_state->data.wait = 0x00;
 	}
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_PERIPHERALS);
 	pthread_mutex_unlock(&trackstate_peripherals_mutex);
 
 	// For accessing bidib_track_state.segments (devnote: write)
 	pthread_mutex_lock(&trackstate_segments_mutex);
+	bidib_state_index_lock_segment_shards();
 	t_bidib_segment_state_intern *segment_state;
 	for (size_t i = 0; i < bidib_track_state.segments->len; i++) {
 		segment_state = &g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern, i);
@@ -826,10 +984,14 @@ void bidib_state_reset(void) {
 		segment_state->power_consumption.overcurrent = false;
 		segment_state->power_consumption.current = 0;
 		if (segment_state->dcc_addresses->len > 0) {
+			bidib_state_index_unlink_segment(segment_state);
 			g_array_remove_range(segment_state->dcc_addresses, 0,
 			                     segment_state->dcc_addresses->len);
 		}
 	}
+	bidib_state_index_clear_occupancy();
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_SEGMENTS);
+	bidib_state_index_unlock_segment_shards();
 	pthread_mutex_unlock(&trackstate_segments_mutex);
 
 	// For accessing bidib_track_state.reversers (devnote: write)
@@ -840,6 +1002,7 @@ void bidib_state_reset(void) {
 		reverser_state->data.state_id = NULL;
 		reverser_state->data.state_value = BIDIB_REV_EXEC_STATE_UNKNOWN;
 	}
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_REVERSERS);
 	pthread_mutex_unlock(&trackstate_reversers_mutex);
 
 	// For accessing bidib_track_state.trains (devnote: write)
@@ -862,6 +1025,7 @@ void bidib_state_reset(void) {
 		train_state->decoder_state.container2_storage_known = false;
 		train_state->decoder_state.container3_storage_known = false;
 	}
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_TRAIN_STATES);
 	pthread_mutex_unlock(&trackstate_trains_mutex);
 
 	// For accessing bidib_track_state.boosters (devnote: write)
@@ -876,6 +1040,7 @@ void bidib_state_reset(void) {
 		booster_state->data.voltage_known = false;
 		booster_state->data.temp_known = false;
 	}
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_BOOSTERS);
 	pthread_mutex_unlock(&trackstate_boosters_mutex);
 
 	// For accessing bidib_track_state.track_outputs (devnote: write)
@@ -886,6 +1051,7 @@ void bidib_state_reset(void) {
 				&g_array_index(bidib_track_state.track_outputs, t_bidib_track_output_state, i);
 		track_output_state->cs_state = BIDIB_CS_OFF;
 	}
+	bidib_state_stamp_all(BIDIB_STATE_INDEX_TRACK_OUTPUTS);
 	pthread_mutex_unlock(&trackstate_track_outputs_mutex);
 }
 
@@ -928,3 +1094,126 @@ void bidib_state_reset_train_params(void) {
 	}
 	pthread_rwlock_unlock(&bidib_trains_rwlock);
 }
+
+// Adds the bytes of the nested arrays of the entries of a state array
+static void bidib_state_measure_nested(const GArray *array, size_t elem_size,
+                                       size_t member_offset, size_t *bytes) {
+	for (size_t i = 0; array != NULL && i < array->len; i++) {
+		GArray *nested = *(GArray **) (array->data + i * elem_size + member_offset);
+		if (nested != NULL) {
+			*bytes += nested->len * g_array_get_element_size(nested);
+		}
+	}
+}
+
+void bidib_state_measure(size_t *bytes, size_t *objects) {
+	*bytes = 0;
+	*objects = 0;
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_POINTS_BOARD, bytes, objects);
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_POINTS_DCC, bytes, objects);
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_SIGNALS_BOARD, bytes, objects);
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_SIGNALS_DCC, bytes, objects);
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+
+	pthread_mutex_lock(&trackstate_peripherals_mutex);
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_PERIPHERALS, bytes, objects);
+	pthread_mutex_unlock(&trackstate_peripherals_mutex);
+
+	pthread_mutex_lock(&trackstate_segments_mutex);
+	// For the change stamps of the segments
+	bidib_state_index_lock_segment_shards();
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_SEGMENTS, bytes, objects);
+	bidib_state_index_unlock_segment_shards();
+	bidib_state_measure_nested(bidib_track_state.segments, sizeof(t_bidib_segment_state_intern),
+	                           offsetof(t_bidib_segment_state_intern, dcc_addresses), bytes);
+	pthread_mutex_unlock(&trackstate_segments_mutex);
+
+	pthread_mutex_lock(&trackstate_reversers_mutex);
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_REVERSERS, bytes, objects);
+	pthread_mutex_unlock(&trackstate_reversers_mutex);
+
+	pthread_mutex_lock(&trackstate_trains_mutex);
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_TRAIN_STATES, bytes, objects);
+	bidib_state_measure_nested(bidib_track_state.trains, sizeof(t_bidib_train_state_intern),
+	                           offsetof(t_bidib_train_state_intern, peripherals), bytes);
+	pthread_mutex_unlock(&trackstate_trains_mutex);
+
+	pthread_mutex_lock(&trackstate_boosters_mutex);
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_BOOSTERS, bytes, objects);
+	pthread_mutex_unlock(&trackstate_boosters_mutex);
+
+	pthread_mutex_lock(&trackstate_track_outputs_mutex);
+	bidib_state_changes_measure(BIDIB_STATE_INDEX_TRACK_OUTPUTS, bytes, objects);
+	pthread_mutex_unlock(&trackstate_track_outputs_mutex);
+}
+
+static void bidib_state_measure_array(GArray *array, size_t *bytes, size_t *objects) {
+	if (array != NULL) {
+		*bytes += array->len * g_array_get_element_size(array);
+		(*objects)++;
+	}
+}
+
+// Measures the aspects of accessory or peripheral mappings and, for DCC accessories,
+// the port values of the aspects
+static void bidib_state_measure_aspects(const GArray *mappings, size_t elem_size,
+                                        size_t aspects_offset, bool dcc,
+                                        size_t *bytes, size_t *objects) {
+	for (size_t i = 0; mappings != NULL && i < mappings->len; i++) {
+		GArray *aspects = *(GArray **) (mappings->data + i * elem_size + aspects_offset);
+		bidib_state_measure_array(aspects, bytes, objects);
+		for (size_t j = 0; dcc && aspects != NULL && j < aspects->len; j++) {
+			bidib_state_measure_array(g_array_index(aspects, t_bidib_dcc_aspect, j).port_values,
+			                          bytes, objects);
+		}
+	}
+}
+
+void bidib_state_measure_config(size_t *bytes, size_t *objects) {
+	*bytes = 0;
+	*objects = 0;
+	// The initial values are not modified after the configs were parsed
+	bidib_state_measure_array(bidib_initial_values.points, bytes, objects);
+	bidib_state_measure_array(bidib_initial_values.signals, bytes, objects);
+	bidib_state_measure_array(bidib_initial_values.peripherals, bytes, objects);
+	bidib_state_measure_array(bidib_initial_values.trains, bytes, objects);
+
+	pthread_rwlock_rdlock(&bidib_trains_rwlock);
+	bidib_state_measure_array(bidib_trains, bytes, objects);
+	for (size_t i = 0; bidib_trains != NULL && i < bidib_trains->len; i++) {
+		bidib_state_measure_array(g_array_index(bidib_trains, t_bidib_train, i).peripherals,
+		                          bytes, objects);
+	}
+	pthread_rwlock_unlock(&bidib_trains_rwlock);
+
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+	bidib_state_measure_array(bidib_boards, bytes, objects);
+	for (size_t i = 0; bidib_boards != NULL && i < bidib_boards->len; i++) {
+		const t_bidib_board *const board = &g_array_index(bidib_boards, t_bidib_board, i);
+		bidib_state_measure_array(board->features, bytes, objects);
+		bidib_state_measure_array(board->points_board, bytes, objects);
+		bidib_state_measure_aspects(board->points_board, sizeof(t_bidib_board_accessory_mapping),
+		                            offsetof(t_bidib_board_accessory_mapping, aspects), false,
+		                            bytes, objects);
+		bidib_state_measure_array(board->points_dcc, bytes, objects);
+		bidib_state_measure_aspects(board->points_dcc, sizeof(t_bidib_dcc_accessory_mapping),
+		                            offsetof(t_bidib_dcc_accessory_mapping, aspects), true,
+		                            bytes, objects);
+		bidib_state_measure_array(board->signals_board, bytes, objects);
+		bidib_state_measure_aspects(board->signals_board, sizeof(t_bidib_board_accessory_mapping),
+		                            offsetof(t_bidib_board_accessory_mapping, aspects), false,
+		                            bytes, objects);
+		bidib_state_measure_array(board->signals_dcc, bytes, objects);
+		bidib_state_measure_aspects(board->signals_dcc, sizeof(t_bidib_dcc_accessory_mapping),
+		                            offsetof(t_bidib_dcc_accessory_mapping, aspects), true,
+		                            bytes, objects);
+		bidib_state_measure_array(board->peripherals, bytes, objects);
+		bidib_state_measure_aspects(board->peripherals, sizeof(t_bidib_peripheral_mapping),
+		                            offsetof(t_bidib_peripheral_mapping, aspects), false,
+		                            bytes, objects);
+		bidib_state_measure_array(board->segments, bytes, objects);
+		bidib_state_measure_array(board->reversers, bytes, objects);
+	}
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+}
@@ -0,0 +1,103 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdalign.h>
+
+#include "bidib_state_intern.h"
+#include "../transmission/bidib_transmission_intern.h"
+
+
+#define BIDIB_STATE_ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct t_bidib_state_arena_block {
+	struct t_bidib_state_arena_block *next;
+	size_t size;
+	size_t used;
+	max_align_t data[];
+} t_bidib_state_arena_block;
+
+// Blocks holding the data derived from the configs, newest first. The data is
+// laid out in the order it was allocated, i.e. in the order of the configs.
+static t_bidib_state_arena_block *arena_blocks = NULL;
+
+
+static void *bidib_state_arena_reserve(size_t size, size_t alignment) {
+	size_t offset = 0;
+	if (arena_blocks != NULL) {
+		offset = (arena_blocks->used + alignment - 1) & ~(alignment - 1);
+	}
+	if (arena_blocks == NULL || offset > arena_blocks->size ||
+	    arena_blocks->size - offset < size) {
+		const size_t block_size = size > BIDIB_STATE_ARENA_BLOCK_SIZE
+		                          ? size : BIDIB_STATE_ARENA_BLOCK_SIZE;
+		t_bidib_state_arena_block *block =
+				malloc(offsetof(t_bidib_state_arena_block, data) + block_size);
+		if (block == NULL) {
+			return NULL;
+		}
+		bidib_memory_alloc(BIDIB_MEMORY_CONFIG,
+		                   offsetof(t_bidib_state_arena_block, data) + block_size);
+		block->next = arena_blocks;
+		block->size = block_size;
+		block->used = 0;
+		arena_blocks = block;
+		offset = 0;
+	}
+	arena_blocks->used = offset + size;
+	return (char *) arena_blocks->data + offset;
+}
+
+void *bidib_state_arena_alloc(size_t size) {
+	return bidib_state_arena_reserve(size, alignof(max_align_t));
+}
+
+char *bidib_state_arena_strdup(const char *string) {
+	if (string == NULL) {
+		return NULL;
+	}
+	const size_t size = strlen(string) + 1;
+	char *copy = bidib_state_arena_reserve(size, 1);
+	if (copy != NULL) {
+		memcpy(copy, string, size);
+	}
+	return copy;
+}
+
+void bidib_state_arena_free(void) {
+	while (arena_blocks != NULL) {
+		t_bidib_state_arena_block *next = arena_blocks->next;
+		bidib_memory_free(BIDIB_MEMORY_CONFIG,
+		                  offsetof(t_bidib_state_arena_block, data) + arena_blocks->size);
+		free(arena_blocks);
+		arena_blocks = next;
+	}
+}
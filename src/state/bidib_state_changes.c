@@ -0,0 +1,322 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "bidib_state_intern.h"
+
+
+// Last handed out change sequence number. Never reset, so that a client that
+// still holds a number of a previous run does not miss changes.
+static _Atomic uint64_t change_seq = 0;
+
+// Change sequence numbers of the entries of the state arrays, parallel to the
+// arrays. Each one is guarded by the lock of its state array, the ones of the
+// segments by their shard locks.
+static GArray *change_stamps[BIDIB_STATE_INDEX_COUNT] = {NULL};
+
+// CLOCK_MONOTONIC times in ns of the packets that last updated the entries of the
+// state arrays, parallel to the arrays and guarded like the change stamps. Allocated
+// together with the change stamps by bidib_state_changes_init, so that stamping a
+// segment under its shard lock only writes existing slots.
+static GArray *receive_times[BIDIB_STATE_INDEX_COUNT] = {NULL};
+
+// Receive time of the packet whose messages the current thread handles, 0 if the
+// thread does not handle a packet
+static _Thread_local uint64_t receive_time = 0;
+
+// Threads waiting for the change sequence number to move on. The condition is
+// only signalled if somebody waits, so that stamping stays cheap otherwise.
+static pthread_mutex_t change_wait_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t change_wait_cond;
+static pthread_once_t change_wait_once = PTHREAD_ONCE_INIT;
+static atomic_uint change_waiters = 0;
+
+// Write end of the pipe of bidib_state_changes_set_wake_fd. The pending flag
+// limits the writes to one per rearm, so that stamping stays cheap.
+static atomic_int change_wake_fd = -1;
+static atomic_bool change_wake_pending = false;
+
+
+static const GArray *bidib_state_changes_array(t_bidib_state_index index, size_t *elem_size,
+                                               t_bidib_state_category *category) {
+	switch (index) {
+		case BIDIB_STATE_INDEX_POINTS_BOARD:
+			*elem_size = sizeof(t_bidib_board_accessory_state);
+			*category = BIDIB_STATE_CATEGORY_ACCESSORIES;
+			return bidib_track_state.points_board;
+		case BIDIB_STATE_INDEX_POINTS_DCC:
+			*elem_size = sizeof(t_bidib_dcc_accessory_state);
+			*category = BIDIB_STATE_CATEGORY_ACCESSORIES;
+			return bidib_track_state.points_dcc;
+		case BIDIB_STATE_INDEX_SIGNALS_BOARD:
+			*elem_size = sizeof(t_bidib_board_accessory_state);
+			*category = BIDIB_STATE_CATEGORY_ACCESSORIES;
+			return bidib_track_state.signals_board;
+		case BIDIB_STATE_INDEX_SIGNALS_DCC:
+			*elem_size = sizeof(t_bidib_dcc_accessory_state);
+			*category = BIDIB_STATE_CATEGORY_ACCESSORIES;
+			return bidib_track_state.signals_dcc;
+		case BIDIB_STATE_INDEX_PERIPHERALS:
+			*elem_size = sizeof(t_bidib_peripheral_state);
+			*category = BIDIB_STATE_CATEGORY_PERIPHERALS;
+			return bidib_track_state.peripherals;
+		case BIDIB_STATE_INDEX_SEGMENTS:
+			*elem_size = sizeof(t_bidib_segment_state_intern);
+			*category = BIDIB_STATE_CATEGORY_SEGMENTS;
+			return bidib_track_state.segments;
+		case BIDIB_STATE_INDEX_REVERSERS:
+			*elem_size = sizeof(t_bidib_reverser_state);
+			*category = BIDIB_STATE_CATEGORY_REVERSERS;
+			return bidib_track_state.reversers;
+		case BIDIB_STATE_INDEX_TRAIN_STATES:
+			*elem_size = sizeof(t_bidib_train_state_intern);
+			*category = BIDIB_STATE_CATEGORY_TRAINS;
+			return bidib_track_state.trains;
+		case BIDIB_STATE_INDEX_BOOSTERS:
+			*elem_size = sizeof(t_bidib_booster_state);
+			*category = BIDIB_STATE_CATEGORY_BOOSTERS;
+			return bidib_track_state.boosters;
+		case BIDIB_STATE_INDEX_TRACK_OUTPUTS:
+			*elem_size = sizeof(t_bidib_track_output_state);
+			*category = BIDIB_STATE_CATEGORY_TRACK_OUTPUTS;
+			return bidib_track_state.track_outputs;
+		default:
+			return NULL;
+	}
+}
+
+static void bidib_state_changes_init_wait(void) {
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&change_wait_cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+static void bidib_state_changes_notify(void) {
+	// A waiter registers before it reads the change sequence number, and the
+	// number is incremented before this check, so either the waiter sees the
+	// new number or the waiter is seen here
+	if (atomic_load(&change_waiters) > 0) {
+		bidib_state_changes_wake_all();
+	}
+	const int wake_fd = atomic_load(&change_wake_fd);
+	if (wake_fd != -1 && !atomic_exchange(&change_wake_pending, true)) {
+		const char byte = 0;
+		// The pipe is non-blocking, if it is full the reader is awake anyway
+		const ssize_t written = write(wake_fd, &byte, 1);
+		(void) written;
+	}
+}
+
+// Shall only be called with the lock of the indexed array acquired
+static GArray *bidib_state_changes_stamps(GArray **arrays, t_bidib_state_index index,
+                                          size_t len) {
+	if (arrays[index] == NULL) {
+		arrays[index] = g_array_sized_new(FALSE, TRUE, sizeof(uint64_t), len);
+	}
+	if (arrays[index]->len < len) {
+		// New entries are cleared, they are stamped by whoever appended them
+		g_array_set_size(arrays[index], len);
+	}
+	return arrays[index];
+}
+
+// Returns the position of an entry in its state array, or the length of the array
+// if the entry is not an element of it
+static size_t bidib_state_changes_position(t_bidib_state_index index, const void *entry,
+                                           const GArray **array,
+                                           t_bidib_state_category *category) {
+	size_t elem_size;
+	*array = bidib_state_changes_array(index, &elem_size, category);
+	if (*array == NULL) {
+		return 0;
+	}
+	if (entry == NULL || (const gchar *) entry < (*array)->data) {
+		return (*array)->len;
+	}
+	const size_t position = (size_t) ((const gchar *) entry - (*array)->data) / elem_size;
+	return position < (*array)->len ? position : (*array)->len;
+}
+
+void bidib_state_stamp(t_bidib_state_index index, const void *entry) {
+	const GArray *array;
+	t_bidib_state_category category;
+	const size_t position = bidib_state_changes_position(index, entry, &array, &category);
+	if (array == NULL || position >= array->len) {
+		return;
+	}
+	GArray *stamps = bidib_state_changes_stamps(change_stamps, index, array->len);
+	g_array_index(stamps, uint64_t, position) = atomic_fetch_add(&change_seq, 1) + 1;
+	// Only grows if entries were appended, which never happens to the segments
+	GArray *times = bidib_state_changes_stamps(receive_times, index, array->len);
+	if (receive_time != 0) {
+		g_array_index(times, uint64_t, position) = receive_time;
+	}
+	bidib_state_mark_changed(category);
+	bidib_state_changes_notify();
+}
+
+void bidib_state_stamp_all(t_bidib_state_index index) {
+	size_t elem_size;
+	t_bidib_state_category category;
+	const GArray *array = bidib_state_changes_array(index, &elem_size, &category);
+	if (array == NULL) {
+		return;
+	}
+	GArray *stamps = bidib_state_changes_stamps(change_stamps, index, array->len);
+	const uint64_t seq = atomic_fetch_add(&change_seq, 1) + 1;
+	for (size_t i = 0; i < array->len; i++) {
+		g_array_index(stamps, uint64_t, i) = seq;
+	}
+	GArray *times = bidib_state_changes_stamps(receive_times, index, array->len);
+	if (receive_time != 0) {
+		for (size_t i = 0; i < array->len; i++) {
+			g_array_index(times, uint64_t, i) = receive_time;
+		}
+	}
+	bidib_state_mark_changed(category);
+	bidib_state_changes_notify();
+}
+
+uint64_t bidib_state_get_stamp(t_bidib_state_index index, size_t position) {
+	const GArray *stamps = change_stamps[index];
+	if (stamps == NULL || position >= stamps->len) {
+		return 0;
+	}
+	return g_array_index(stamps, uint64_t, position);
+}
+
+uint64_t bidib_state_get_entry_stamp(t_bidib_state_index index, const void *entry) {
+	const GArray *array;
+	t_bidib_state_category category;
+	const size_t position = bidib_state_changes_position(index, entry, &array, &category);
+	if (array == NULL) {
+		return 0;
+	}
+	return bidib_state_get_stamp(index, position);
+}
+
+void bidib_state_set_receive_time(uint64_t time_ns) {
+	receive_time = time_ns;
+}
+
+uint64_t bidib_state_get_receive_time(t_bidib_state_index index, const void *entry) {
+	const GArray *array;
+	t_bidib_state_category category;
+	const size_t position = bidib_state_changes_position(index, entry, &array, &category);
+	if (array == NULL || receive_times[index] == NULL || position >= receive_times[index]->len) {
+		return 0;
+	}
+	return g_array_index(receive_times[index], uint64_t, position);
+}
+
+void bidib_state_changes_measure(t_bidib_state_index index, size_t *bytes, size_t *objects) {
+	size_t elem_size;
+	t_bidib_state_category category;
+	const GArray *array = bidib_state_changes_array(index, &elem_size, &category);
+	if (array == NULL) {
+		return;
+	}
+	*bytes += array->len * elem_size;
+	*objects += array->len;
+	if (change_stamps[index] != NULL) {
+		*bytes += change_stamps[index]->len * sizeof(uint64_t);
+	}
+	if (receive_times[index] != NULL) {
+		*bytes += receive_times[index]->len * sizeof(uint64_t);
+	}
+}
+
+uint64_t bidib_state_get_change_seq(void) {
+	return atomic_load(&change_seq);
+}
+
+uint64_t bidib_state_wait_change(uint64_t seq, const struct timespec *deadline) {
+	pthread_once(&change_wait_once, bidib_state_changes_init_wait);
+	pthread_mutex_lock(&change_wait_mutex);
+	atomic_fetch_add(&change_waiters, 1);
+	uint64_t current = atomic_load(&change_seq);
+	if (current == seq) {
+		pthread_cond_timedwait(&change_wait_cond, &change_wait_mutex, deadline);
+		current = atomic_load(&change_seq);
+	}
+	atomic_fetch_sub(&change_waiters, 1);
+	pthread_mutex_unlock(&change_wait_mutex);
+	return current;
+}
+
+void bidib_state_changes_wake_all(void) {
+	pthread_once(&change_wait_once, bidib_state_changes_init_wait);
+	pthread_mutex_lock(&change_wait_mutex);
+	pthread_cond_broadcast(&change_wait_cond);
+	pthread_mutex_unlock(&change_wait_mutex);
+}
+
+void bidib_state_changes_set_wake_fd(int fd) {
+	atomic_store(&change_wake_fd, fd);
+	atomic_store(&change_wake_pending, false);
+}
+
+void bidib_state_changes_rearm_wake(void) {
+	atomic_store(&change_wake_pending, false);
+}
+
+void bidib_state_changes_init(void) {
+	for (size_t i = 0; i < BIDIB_STATE_INDEX_COUNT; i++) {
+		size_t elem_size;
+		t_bidib_state_category category;
+		const GArray *array = bidib_state_changes_array((t_bidib_state_index) i, &elem_size,
+		                                                &category);
+		if (array != NULL) {
+			bidib_state_changes_stamps(change_stamps, (t_bidib_state_index) i, array->len);
+			bidib_state_changes_stamps(receive_times, (t_bidib_state_index) i, array->len);
+		}
+	}
+}
+
+void bidib_state_changes_free(void) {
+	for (size_t i = 0; i < BIDIB_STATE_INDEX_COUNT; i++) {
+		if (change_stamps[i] != NULL) {
+			g_array_free(change_stamps[i], TRUE);
+			change_stamps[i] = NULL;
+		}
+		if (receive_times[i] != NULL) {
+			g_array_free(receive_times[i], TRUE);
+			receive_times[i] = NULL;
+		}
+	}
+}
@@ -0,0 +1,488 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <glib.h>
+
+#include "bidib_state_intern.h"
+#include "bidib_state_getter_intern.h"
+#include "../transmission/bidib_transmission_intern.h"
+#include "../../include/highlevel/bidib_highlevel_export.h"
+#include "../../include/highlevel/bidib_highlevel_util.h"
+
+
+// How long the export thread waits for a change before it checks whether the
+// library is still running
+#define BIDIB_STATE_EXPORT_WAIT_MS 100
+
+// Where the aspects of an exported accessory are configured, cached when the
+// export is opened as the configs do not change afterwards
+typedef struct {
+	const GArray *aspects;
+	bool dcc;
+} t_bidib_state_export_aspects;
+
+struct t_bidib_state_image_builder {
+	t_bidib_export_header header;
+	t_bidib_state_export_aspects *aspects;
+	const t_bidib_train **trains;
+};
+
+static char *export_name = NULL;
+static t_bidib_state_image_builder *export_builder = NULL;
+// The image is built here and then copied into the segment under the seqlock,
+// so that the seqlock is only held for the copy
+static uint64_t *export_staging = NULL;
+static t_bidib_export_header *export_header = NULL;
+// Serialises the writers of the image
+static pthread_mutex_t export_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+void bidib_state_export_set_name(const char *name) {
+	free(export_name);
+	export_name = name != NULL ? strdup(name) : NULL;
+}
+
+bool bidib_state_export_enabled(void) {
+	return export_header != NULL;
+}
+
+static size_t bidib_state_export_align(size_t size) {
+	return (size + 7) & ~(size_t) 7;
+}
+
+// bidib_state_export_ids reads the id at the start of each state struct
+_Static_assert(offsetof(t_bidib_segment_state_intern, id) == 0, "id has to be the first member");
+_Static_assert(offsetof(t_bidib_board_accessory_state, id) == 0, "id has to be the first member");
+_Static_assert(offsetof(t_bidib_dcc_accessory_state, id) == 0, "id has to be the first member");
+_Static_assert(offsetof(t_bidib_train_state_intern, id) == 0, "id has to be the first member");
+_Static_assert(offsetof(t_bidib_booster_state, id) == 0, "id has to be the first member");
+
+static size_t bidib_state_export_ids(char *segment, uint32_t *offsets, size_t offset,
+                                     const GArray *states, size_t elem_size) {
+	for (size_t i = 0; i < states->len; i++) {
+		const char *id = *(const char *const *) (states->data + i * elem_size);
+		const size_t len = strlen(id) + 1;
+		if (segment != NULL) {
+			offsets[i] = (uint32_t) offset;
+			memcpy(segment + offset, id, len);
+		}
+		offset += len;
+	}
+	return offset;
+}
+
+// Writes the ids of all entries behind the header, returns the end of the ids.
+// Only computes the size if segment is NULL.
+static size_t bidib_state_export_id_table(char *segment, size_t entry_count) {
+	const size_t ids_offset = sizeof(t_bidib_export_header);
+	uint32_t *offsets = segment != NULL ? (uint32_t *) (segment + ids_offset) : NULL;
+	const GArray *const arrays[] = {
+		bidib_track_state.segments, bidib_track_state.points_board,
+		bidib_track_state.points_dcc, bidib_track_state.signals_board,
+		bidib_track_state.signals_dcc, bidib_track_state.trains, bidib_track_state.boosters
+	};
+	// Each state struct starts with its id
+	const size_t elem_sizes[] = {
+		sizeof(t_bidib_segment_state_intern), sizeof(t_bidib_board_accessory_state),
+		sizeof(t_bidib_dcc_accessory_state), sizeof(t_bidib_board_accessory_state),
+		sizeof(t_bidib_dcc_accessory_state), sizeof(t_bidib_train_state_intern),
+		sizeof(t_bidib_booster_state)
+	};
+	size_t offset = ids_offset + sizeof(uint32_t) * entry_count;
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+		offset = bidib_state_export_ids(segment, offsets, offset, arrays[i], elem_sizes[i]);
+		if (offsets != NULL) {
+			offsets += arrays[i]->len;
+		}
+	}
+	return offset;
+}
+
+static void bidib_state_export_cache_aspects(t_bidib_state_export_aspects *aspects,
+                                             const GArray *board_states,
+                                             const GArray *dcc_states, bool point) {
+	for (size_t i = 0; i < board_states->len; i++) {
+		const t_bidib_board_accessory_mapping *const mapping =
+				bidib_state_get_board_accessory_mapping_ref(
+						g_array_index(board_states, t_bidib_board_accessory_state, i).id, point);
+		aspects[i].aspects = mapping != NULL ? mapping->aspects : NULL;
+		aspects[i].dcc = false;
+	}
+	aspects += board_states->len;
+	for (size_t i = 0; i < dcc_states->len; i++) {
+		const t_bidib_dcc_accessory_mapping *const mapping =
+				bidib_state_get_dcc_accessory_mapping_ref(
+						g_array_index(dcc_states, t_bidib_dcc_accessory_state, i).id, point);
+		aspects[i].aspects = mapping != NULL ? mapping->aspects : NULL;
+		aspects[i].dcc = true;
+	}
+}
+
+t_bidib_state_image_builder *bidib_state_image_builder_new(void) {
+	t_bidib_state_image_builder *builder = malloc(sizeof(t_bidib_state_image_builder));
+	t_bidib_export_header *const header = &builder->header;
+	memset(header, 0, sizeof(t_bidib_export_header));
+	header->magic = BIDIB_EXPORT_MAGIC;
+	header->version = BIDIB_EXPORT_VERSION;
+	header->segment_count = bidib_track_state.segments->len;
+	header->point_count = bidib_track_state.points_board->len +
+	                      bidib_track_state.points_dcc->len;
+	header->signal_count = bidib_track_state.signals_board->len +
+	                       bidib_track_state.signals_dcc->len;
+	header->train_count = bidib_track_state.trains->len;
+	header->booster_count = bidib_track_state.boosters->len;
+	const size_t entry_count = header->segment_count + header->point_count +
+	                           header->signal_count + header->train_count +
+	                           header->booster_count;
+	header->ids_offset = sizeof(t_bidib_export_header);
+	header->image_offset = bidib_state_export_align(
+			bidib_state_export_id_table(NULL, entry_count));
+	header->image_size = bidib_export_locate(header, NULL, NULL);
+	header->size = header->image_offset + header->image_size;
+
+	builder->aspects = malloc(sizeof(t_bidib_state_export_aspects) *
+	                          (header->point_count + header->signal_count));
+	builder->trains = malloc(sizeof(t_bidib_train *) * header->train_count);
+	// For bidib_state_get_board_accessory_mapping_ref, bidib_state_get_dcc_accessory_mapping_ref
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+	bidib_state_export_cache_aspects(builder->aspects, bidib_track_state.points_board,
+	                                 bidib_track_state.points_dcc, true);
+	bidib_state_export_cache_aspects(builder->aspects + header->point_count,
+	                                 bidib_track_state.signals_board,
+	                                 bidib_track_state.signals_dcc, false);
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	// For bidib_state_get_train_ref
+	pthread_rwlock_rdlock(&bidib_trains_rwlock);
+	for (size_t i = 0; i < header->train_count; i++) {
+		builder->trains[i] = bidib_state_get_train_ref(
+				g_array_index(bidib_track_state.trains, t_bidib_train_state_intern, i).id);
+	}
+	pthread_rwlock_unlock(&bidib_trains_rwlock);
+	return builder;
+}
+
+const t_bidib_export_header *bidib_state_image_builder_header(
+		const t_bidib_state_image_builder *builder) {
+	return &builder->header;
+}
+
+void bidib_state_image_builder_free(t_bidib_state_image_builder *builder) {
+	if (builder != NULL) {
+		free(builder->aspects);
+		free(builder->trains);
+		free(builder);
+	}
+}
+
+const char *bidib_state_image_id(t_bidib_export_kind kind, size_t position) {
+	const GArray *board_states = NULL;
+	const GArray *dcc_states = NULL;
+	switch (kind) {
+		case BIDIB_EXPORT_SEGMENTS:
+			return position < bidib_track_state.segments->len
+			       ? g_array_index(bidib_track_state.segments,
+			                       t_bidib_segment_state_intern, position).id
+			       : NULL;
+		case BIDIB_EXPORT_POINTS:
+			board_states = bidib_track_state.points_board;
+			dcc_states = bidib_track_state.points_dcc;
+			break;
+		case BIDIB_EXPORT_SIGNALS:
+			board_states = bidib_track_state.signals_board;
+			dcc_states = bidib_track_state.signals_dcc;
+			break;
+		case BIDIB_EXPORT_TRAINS:
+			return position < bidib_track_state.trains->len
+			       ? g_array_index(bidib_track_state.trains,
+			                       t_bidib_train_state_intern, position).id
+			       : NULL;
+		case BIDIB_EXPORT_BOOSTERS:
+			return position < bidib_track_state.boosters->len
+			       ? g_array_index(bidib_track_state.boosters,
+			                       t_bidib_booster_state, position).id
+			       : NULL;
+		default:
+			return NULL;
+	}
+	// The board accessories come before the DCC accessories, as in the image
+	if (position < board_states->len) {
+		return g_array_index(board_states, t_bidib_board_accessory_state, position).id;
+	}
+	position -= board_states->len;
+	return position < dcc_states->len
+	       ? g_array_index(dcc_states, t_bidib_dcc_accessory_state, position).id
+	       : NULL;
+}
+
+void bidib_state_export_open(void) {
+	if (export_name == NULL || export_header != NULL) {
+		return;
+	}
+	t_bidib_state_image_builder *const builder = bidib_state_image_builder_new();
+	t_bidib_export_header header = builder->header;
+	const size_t entry_count = header.segment_count + header.point_count +
+	                           header.signal_count + header.train_count + header.booster_count;
+
+	// An object left behind by a crashed run may still be mapped by readers, truncating
+	// it would make them fault. Unlinking keeps their mapping valid.
+	shm_unlink(export_name);
+	int fd = shm_open(export_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd == -1) {
+		syslog_libbidib(LOG_ERR, "State export %s could not be opened", export_name);
+		bidib_state_image_builder_free(builder);
+		return;
+	}
+	if (ftruncate(fd, header.size) != 0) {
+		syslog_libbidib(LOG_ERR, "State export %s could not be resized", export_name);
+		close(fd);
+		shm_unlink(export_name);
+		bidib_state_image_builder_free(builder);
+		return;
+	}
+	void *mapped = mmap(NULL, header.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	// The mapping stays valid after the object is closed
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		syslog_libbidib(LOG_ERR, "State export %s could not be mapped", export_name);
+		shm_unlink(export_name);
+		bidib_state_image_builder_free(builder);
+		return;
+	}
+
+	export_builder = builder;
+	export_staging = malloc(bidib_state_export_align(header.image_size));
+	// The magic is written last, readers reject the segment until then
+	header.magic = 0;
+	memcpy(mapped, &header, sizeof(header));
+	bidib_state_export_id_table(mapped, entry_count);
+	export_header = mapped;
+	bidib_state_export_publish();
+	atomic_thread_fence(memory_order_release);
+	export_header->magic = BIDIB_EXPORT_MAGIC;
+	syslog_libbidib(LOG_NOTICE, "State export %s opened, %u bytes", export_name, header.size);
+}
+
+static int16_t bidib_state_export_aspect(const t_bidib_state_export_aspects *aspects,
+                                         const char *state_id) {
+	if (aspects->aspects == NULL || state_id == NULL) {
+		return -1;
+	}
+	for (size_t i = 0; i < aspects->aspects->len; i++) {
+		const char *id = aspects->dcc
+		                 ? g_array_index(aspects->aspects, t_bidib_dcc_aspect, i).id
+		                 : g_array_index(aspects->aspects, t_bidib_aspect, i).id;
+		// The state ids are borrowed from the aspects of the config
+		if (id == state_id || strcmp(id, state_id) == 0) {
+			return (int16_t) i;
+		}
+	}
+	return -1;
+}
+
+// Shall only be called with trackstate_accessories_mutex acquired
+static void bidib_state_export_accessories(t_bidib_export_accessory *exported,
+                                           const t_bidib_state_export_aspects *aspects,
+                                           const GArray *board_states,
+                                           const GArray *dcc_states) {
+	for (size_t i = 0; i < board_states->len; i++) {
+		const t_bidib_board_accessory_state *const state =
+				&g_array_index(board_states, t_bidib_board_accessory_state, i);
+		exported[i].aspect = bidib_state_export_aspect(&aspects[i], state->data.state_id);
+		exported[i].execution_state = (uint8_t) state->data.execution_state;
+		exported[i].reserved = 0;
+	}
+	exported += board_states->len;
+	aspects += board_states->len;
+	for (size_t i = 0; i < dcc_states->len; i++) {
+		const t_bidib_dcc_accessory_state *const state =
+				&g_array_index(dcc_states, t_bidib_dcc_accessory_state, i);
+		exported[i].aspect = bidib_state_export_aspect(&aspects[i], state->data.state_id);
+		exported[i].execution_state = 0xFF;
+		exported[i].reserved = 0;
+	}
+}
+
+// Shall only be called with bidib_trains_rwlock >= read acquired,
+// and with trackstate_segments_mutex and trackstate_trains_mutex acquired.
+static void bidib_state_export_train(t_bidib_export_train *exported,
+                                     const t_bidib_train_state_intern *state,
+                                     const t_bidib_train *train) {
+	exported->on_track = state->on_track;
+	exported->is_forwards = state->set_is_forwards;
+	exported->speed_step = (int16_t) state->set_speed_step;
+	exported->speed_kmh = state->detected_kmh_speed > INT16_MAX
+	                      ? -1 : (int16_t) state->detected_kmh_speed;
+	exported->segment = -1;
+	exported->segment_cnt = 0;
+	bool orientation_is_left = true;
+	if (train != NULL) {
+		const size_t count = bidib_state_get_train_detections(train, &orientation_is_left);
+		const GArray *const segments = bidib_state_index_get_address_segments(train->dcc_addr);
+		if (count > 0 && segments != NULL && segments->len > 0) {
+			// The segments that detect the address are in ascending order
+			exported->segment = (int32_t) g_array_index(segments, guint, 0);
+		}
+		exported->segment_cnt = count > UINT8_MAX ? UINT8_MAX : (uint8_t) count;
+	}
+	exported->orientation_is_left = orientation_is_left;
+}
+
+// Shall only be called with trackstate_boosters_mutex acquired
+static void bidib_state_export_booster(t_bidib_export_booster *exported,
+                                       const t_bidib_booster_state *state) {
+	exported->power_state = (uint8_t) state->data.power_state;
+	exported->power_state_simple = (uint8_t) state->data.power_state_simple;
+	exported->current_known = state->data.power_consumption.known;
+	exported->overcurrent = state->data.power_consumption.overcurrent;
+	exported->current = state->data.power_consumption.current > UINT16_MAX
+	                    ? UINT16_MAX : (uint16_t) state->data.power_consumption.current;
+	exported->voltage_known = state->data.voltage_known;
+	exported->voltage = state->data.voltage;
+	exported->temp_known = state->data.temp_known;
+	exported->temp_celsius = state->data.temp_celsius;
+	exported->reserved = 0;
+}
+
+uint64_t bidib_state_image_build(const t_bidib_state_image_builder *builder, void *data) {
+	const t_bidib_export_header *const header = &builder->header;
+	t_bidib_export_image image;
+	bidib_export_locate(header, data, &image);
+	// Taken first, so that changes during the build cause another build
+	const uint64_t change_seq = bidib_state_get_change_seq();
+	memcpy(data, &change_seq, sizeof(change_seq));
+
+	// For accessing bidib_track_state.points_* and bidib_track_state.signals_*
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	bidib_state_export_accessories((t_bidib_export_accessory *) image.points, builder->aspects,
+	                               bidib_track_state.points_board,
+	                               bidib_track_state.points_dcc);
+	bidib_state_export_accessories((t_bidib_export_accessory *) image.signals,
+	                               builder->aspects + header->point_count,
+	                               bidib_track_state.signals_board,
+	                               bidib_track_state.signals_dcc);
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+
+	// For bidib_state_get_train_detections and bidib_state_index_get_address_segments
+	pthread_rwlock_rdlock(&bidib_trains_rwlock);
+	pthread_mutex_lock(&trackstate_segments_mutex);
+	// For the occupancy of the segments
+	bidib_state_index_lock_segment_shards();
+	uint64_t *occupied = (uint64_t *) image.occupied;
+	memset(occupied, 0, sizeof(uint64_t) * ((header->segment_count + 63) / 64));
+	for (size_t i = 0; i < bidib_track_state.segments->len; i++) {
+		if (g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern, i).occupied) {
+			occupied[i / 64] |= (uint64_t) 1 << (i % 64);
+		}
+	}
+	bidib_state_index_unlock_segment_shards();
+	// For accessing bidib_track_state.trains
+	pthread_mutex_lock(&trackstate_trains_mutex);
+	for (size_t i = 0; i < bidib_track_state.trains->len; i++) {
+		bidib_state_export_train((t_bidib_export_train *) &image.trains[i],
+		                         &g_array_index(bidib_track_state.trains,
+		                                        t_bidib_train_state_intern, i),
+		                         builder->trains[i]);
+	}
+	pthread_mutex_unlock(&trackstate_trains_mutex);
+	pthread_mutex_unlock(&trackstate_segments_mutex);
+	pthread_rwlock_unlock(&bidib_trains_rwlock);
+
+	// For accessing bidib_track_state.boosters
+	pthread_mutex_lock(&trackstate_boosters_mutex);
+	for (size_t i = 0; i < bidib_track_state.boosters->len; i++) {
+		bidib_state_export_booster((t_bidib_export_booster *) &image.boosters[i],
+		                           &g_array_index(bidib_track_state.boosters,
+		                                          t_bidib_booster_state, i));
+	}
+	pthread_mutex_unlock(&trackstate_boosters_mutex);
+	return change_seq;
+}
+
+void bidib_state_export_publish(void) {
+	if (export_header == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&export_mutex);
+	bidib_state_image_build(export_builder, export_staging);
+
+	// Seqlock with a single writer: odd while the image is inconsistent
+	_Atomic uint64_t *const seq = (_Atomic uint64_t *) &export_header->seq;
+	const uint64_t seq_value = atomic_load_explicit(seq, memory_order_relaxed);
+	atomic_store_explicit(seq, seq_value + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy((char *) export_header + export_header->image_offset, export_staging,
+	       export_header->image_size);
+	atomic_store_explicit(seq, seq_value + 2, memory_order_release);
+	pthread_mutex_unlock(&export_mutex);
+}
+
+void *bidib_state_export_run(void *par __attribute__((unused))) {
+	uint64_t seq = bidib_state_get_change_seq();
+	while (bidib_running) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_nsec += BIDIB_STATE_EXPORT_WAIT_MS * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		const uint64_t current = bidib_state_wait_change(seq, &deadline);
+		if (current != seq) {
+			// Changes that arrive while publishing are coalesced into the next image
+			seq = current;
+			bidib_state_export_publish();
+		}
+	}
+	return NULL;
+}
+
+void bidib_state_export_close(void) {
+	if (export_header != NULL) {
+		pthread_mutex_lock(&export_mutex);
+		// Tells mapped readers that the image is no longer updated
+		export_header->magic = 0;
+		munmap(export_header, export_header->size);
+		export_header = NULL;
+		shm_unlink(export_name);
+		bidib_state_image_builder_free(export_builder);
+		export_builder = NULL;
+		free(export_staging);
+		export_staging = NULL;
+		pthread_mutex_unlock(&export_mutex);
+	}
+}
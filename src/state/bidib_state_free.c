@@ -35,28 +35,6 @@
 #include "../transmission/bidib_transmission_intern.h"
 
 
-void bidib_state_free_single_initial_value(t_bidib_state_initial_value value) {
-	if (value.id != NULL) {
-		g_string_free(value.id, TRUE);
-		value.id = NULL;
-	}
-	if (value.value != NULL) {
-		g_string_free(value.value, TRUE);
-		value.value = NULL;
-	}
-}
-
-void bidib_state_free_single_train_initial_value(t_bidib_state_train_initial_value value) {
-	if (value.id != NULL) {
-		g_string_free(value.id, TRUE);
-		value.id = NULL;
-	}
-	if (value.train != NULL) {
-		g_string_free(value.train, TRUE);
-		value.train = NULL;
-	}
-}
-
 void bidib_state_free_single_board_accessory_state(t_bidib_board_accessory_state accessory_state) {
 	if (accessory_state.id != NULL) {
 		free(accessory_state.id);
@@ -113,14 +91,6 @@ void bidib_state_free_single_segment_state(t_bidib_segment_state segment_state)
 }
 
 void bidib_state_free_single_segment_state_intern(t_bidib_segment_state_intern segment_state) {
-	if (segment_state.id != NULL) {
-		g_string_free(segment_state.id, TRUE);
-		segment_state.id = NULL;
-	}
-	if (segment_state.length != NULL) {
-		g_string_free(segment_state.length, TRUE);
-		segment_state.length = NULL;
-	}
 	if (segment_state.dcc_addresses != NULL) {
 		g_array_free(segment_state.dcc_addresses, TRUE);
 		segment_state.dcc_addresses = NULL;
@@ -144,10 +114,6 @@ void bidib_state_free_single_train_state(t_bidib_train_state train_state) {
 }
 
 void bidib_state_free_single_train_state_intern(t_bidib_train_state_intern train_state) {
-	if (train_state.id != NULL) {
-		g_string_free(train_state.id, TRUE);
-		train_state.id = NULL;
-	}
 	if (train_state.peripherals != NULL) {
 		t_bidib_train_peripheral_state state_i;
 		for (size_t i = 0; i < train_state.peripherals->len; i++) {
@@ -177,11 +143,6 @@ void bidib_state_free_single_track_output_state(t_bidib_track_output_state to_st
 }
 
 void bidib_state_free_single_board(t_bidib_board board) {
-	if (board.id != NULL) {
-		g_string_free(board.id, TRUE);
-		board.id = NULL;
-	}
-	
 	if (board.features != NULL) {
 		g_array_free(board.features, TRUE);
 		board.features = NULL;
@@ -191,22 +152,11 @@ void bidib_state_free_single_board(t_bidib_board board) {
 	t_bidib_board_accessory_mapping tmp_board_acc_mapping;
 	t_bidib_dcc_accessory_mapping tmp_dcc_acc_mapping;
 	t_bidib_peripheral_mapping tmp_peripheral_mapping;
-	t_bidib_aspect tmp_aspect;
 	t_bidib_dcc_aspect tmp_dcc_aspect;
 
 	for (size_t i = 0; i < board.points_board->len; i++) {
 		tmp_board_acc_mapping = g_array_index(board.points_board,
 		                                      t_bidib_board_accessory_mapping, i);
-		if (tmp_board_acc_mapping.id != NULL) {
-			g_string_free(tmp_board_acc_mapping.id, TRUE);
-		}
-		for (size_t j = 0; j < tmp_board_acc_mapping.aspects->len; j++) {
-			tmp_aspect = g_array_index(tmp_board_acc_mapping.aspects,
-			                           t_bidib_aspect, j);
-			if (tmp_aspect.id != NULL) {
-				g_string_free(tmp_aspect.id, TRUE);
-			}
-		}
 		g_array_free(tmp_board_acc_mapping.aspects, TRUE);
 	}
 	g_array_free(board.points_board, TRUE);
@@ -215,15 +165,9 @@ void bidib_state_free_single_board(t_bidib_board board) {
 	for (size_t i = 0; i < board.points_dcc->len; i++) {
 		tmp_dcc_acc_mapping = g_array_index(board.points_dcc,
 		                                    t_bidib_dcc_accessory_mapping, i);
-		if (tmp_dcc_acc_mapping.id != NULL) {
-			g_string_free(tmp_dcc_acc_mapping.id, TRUE);
-		}
 		for (size_t j = 0; j < tmp_dcc_acc_mapping.aspects->len; j++) {
 			tmp_dcc_aspect = g_array_index(tmp_dcc_acc_mapping.aspects,
 			                               t_bidib_dcc_aspect, j);
-			if (tmp_dcc_aspect.id != NULL) {
-				g_string_free(tmp_dcc_aspect.id, TRUE);
-			}
 			if (tmp_dcc_aspect.port_values != NULL) {
 				g_array_free(tmp_dcc_aspect.port_values, TRUE);
 			}
@@ -236,16 +180,6 @@ void bidib_state_free_single_board(t_bidib_board board) {
 	for (size_t i = 0; i < board.signals_board->len; i++) {
 		tmp_board_acc_mapping = g_array_index(board.signals_board,
 		                                      t_bidib_board_accessory_mapping, i);
-		if (tmp_board_acc_mapping.id != NULL) {
-			g_string_free(tmp_board_acc_mapping.id, TRUE);
-		}
-		for (size_t j = 0; j < tmp_board_acc_mapping.aspects->len; j++) {
-			tmp_aspect = g_array_index(tmp_board_acc_mapping.aspects,
-			                           t_bidib_aspect, j);
-			if (tmp_aspect.id != NULL) {
-				g_string_free(tmp_aspect.id, TRUE);
-			}
-		}
 		g_array_free(tmp_board_acc_mapping.aspects, TRUE);
 	}
 	g_array_free(board.signals_board, TRUE);
@@ -254,15 +188,9 @@ void bidib_state_free_single_board(t_bidib_board board) {
 	for (size_t i = 0; i < board.signals_dcc->len; i++) {
 		tmp_dcc_acc_mapping = g_array_index(board.signals_dcc,
 		                                    t_bidib_dcc_accessory_mapping, i);
-		if (tmp_dcc_acc_mapping.id != NULL) {
-			g_string_free(tmp_dcc_acc_mapping.id, TRUE);
-		}
 		for (size_t j = 0; j < tmp_dcc_acc_mapping.aspects->len; j++) {
 			tmp_dcc_aspect = g_array_index(tmp_dcc_acc_mapping.aspects,
 			                               t_bidib_dcc_aspect, j);
-			if (tmp_dcc_aspect.id != NULL) {
-				g_string_free(tmp_dcc_aspect.id, TRUE);
-			}
 			if (tmp_dcc_aspect.port_values != NULL) {
 				g_array_free(tmp_dcc_aspect.port_values, TRUE);
 			}
@@ -275,60 +203,20 @@ void bidib_state_free_single_board(t_bidib_board board) {
 	for (size_t i = 0; i < board.peripherals->len; i++) {
 		tmp_peripheral_mapping = g_array_index(board.peripherals,
 		                                       t_bidib_peripheral_mapping, i);
-		if (tmp_peripheral_mapping.id != NULL) {
-			g_string_free(tmp_peripheral_mapping.id, TRUE);
-		}
-		for (size_t j = 0; j < tmp_peripheral_mapping.aspects->len; j++) {
-			tmp_aspect = g_array_index(tmp_peripheral_mapping.aspects,
-			                           t_bidib_aspect, j);
-			if (tmp_aspect.id != NULL) {
-				g_string_free(tmp_aspect.id, TRUE);
-			}
-		}
 		g_array_free(tmp_peripheral_mapping.aspects, TRUE);
 	}
 	g_array_free(board.peripherals, TRUE);
 	board.peripherals = NULL;
 
-	for (size_t i = 0; i < board.segments->len; i++) {
-		t_bidib_segment_mapping tmp = g_array_index(board.segments, t_bidib_segment_mapping, i);
-		if (tmp.id != NULL) {
-			g_string_free(tmp.id, TRUE);
-		}
-	}
 	g_array_free(board.segments, TRUE);
 	board.segments = NULL;
 
-	for (size_t i = 0; i < board.reversers->len; i++) {
-		t_bidib_reverser_mapping tmp = g_array_index(board.reversers, t_bidib_reverser_mapping, i);
-		if (tmp.id != NULL) {
-			g_string_free(tmp.id, TRUE);
-		}
-		if (tmp.cv != NULL) {
-			g_string_free(tmp.cv, TRUE);
-		}
-	}
 	g_array_free(board.reversers, TRUE);
 	board.reversers = NULL;
 }
 
 void bidib_state_free_single_train(t_bidib_train train) {
-	if (train.id != NULL) {
-		g_string_free(train.id, TRUE);
-		train.id = NULL;
-	}
-	if (train.calibration != NULL) {
-		g_array_free(train.calibration, TRUE);
-		train.calibration = NULL;
-	}
 	if (train.peripherals != NULL) {
-		for (size_t i = 0; i < train.peripherals->len; i++) {
-			t_bidib_train_peripheral_mapping tmp = 
-					g_array_index(train.peripherals, t_bidib_train_peripheral_mapping, i);
-			if (tmp.id != NULL) {
-				g_string_free(tmp.id, TRUE);
-			}
-		}
 		g_array_free(train.peripherals, TRUE);
 		train.peripherals = NULL;
 	}
@@ -337,80 +225,75 @@ void bidib_state_free_single_train(t_bidib_train train) {
 
 void bidib_state_free(void) {
 	if (!bidib_running) {
+		bidib_state_snapshot_free();
+		bidib_state_changes_free();
+		// The slots of the state file refer to the state arrays
+		bidib_state_persist_close();
+		// The export and the server cache the mappings of the accessories and the trains
+		bidib_state_export_close();
+		bidib_state_server_close();
+		// The indexes are keyed by the ids of the entries
+		bidib_state_index_free();
 		if (bidib_initial_values.points != NULL) {
-			for (size_t i = 0; i < bidib_initial_values.points->len; i++) {
-				bidib_state_free_single_initial_value(
-						g_array_index(bidib_initial_values.points,
-						              t_bidib_state_initial_value, i));
-			}
 			g_array_free(bidib_initial_values.points, TRUE);
 			bidib_initial_values.points = NULL;
 		}
 		if (bidib_initial_values.signals != NULL) {
-			for (size_t i = 0; i < bidib_initial_values.signals->len; i++) {
-				bidib_state_free_single_initial_value(
-						g_array_index(bidib_initial_values.signals,
-						              t_bidib_state_initial_value, i));
-			}
 			g_array_free(bidib_initial_values.signals, TRUE);
 			bidib_initial_values.signals = NULL;
 		}
 		if (bidib_initial_values.peripherals != NULL) {
-			for (size_t i = 0; i < bidib_initial_values.peripherals->len; i++) {
-				bidib_state_free_single_initial_value(
-						g_array_index(bidib_initial_values.peripherals,
-						              t_bidib_state_initial_value, i));
-			}
 			g_array_free(bidib_initial_values.peripherals, TRUE);
 			bidib_initial_values.peripherals = NULL;
 		}
 		if (bidib_initial_values.trains != NULL) {
-			for (size_t i = 0; i < bidib_initial_values.trains->len; i++) {
-				bidib_state_free_single_train_initial_value(
-						g_array_index(bidib_initial_values.trains,
-						              t_bidib_state_train_initial_value, i));
-			}
 			g_array_free(bidib_initial_values.trains, TRUE);
 			bidib_initial_values.trains = NULL;
 		}
 
 		if (bidib_track_state.points_board != NULL) {
+			// The state ids are borrowed from the board configs, they are not freed
 			for (size_t i = 0; i < bidib_track_state.points_board->len; i++) {
-				bidib_state_free_single_board_accessory_state(
-						g_array_index(bidib_track_state.points_board,
-						              t_bidib_board_accessory_state, i));
+				t_bidib_board_accessory_state *state = &g_array_index(
+						bidib_track_state.points_board, t_bidib_board_accessory_state, i);
+				state->data.state_id = NULL;
+				bidib_state_free_single_board_accessory_state(*state);
 			}
 			g_array_free(bidib_track_state.points_board, TRUE);
 			bidib_track_state.points_board = NULL;
 
 			for (size_t i = 0; i < bidib_track_state.points_dcc->len; i++) {
-				bidib_state_free_single_dcc_accessory_state(
-						g_array_index(bidib_track_state.points_dcc,
-						              t_bidib_dcc_accessory_state, i));
+				t_bidib_dcc_accessory_state *state = &g_array_index(
+						bidib_track_state.points_dcc, t_bidib_dcc_accessory_state, i);
+				state->data.state_id = NULL;
+				bidib_state_free_single_dcc_accessory_state(*state);
 			}
 			g_array_free(bidib_track_state.points_dcc, TRUE);
 			bidib_track_state.points_dcc = NULL;
 
 			for (size_t i = 0; i < bidib_track_state.signals_board->len; i++) {
-				bidib_state_free_single_board_accessory_state(
-						g_array_index(bidib_track_state.signals_board,
-						              t_bidib_board_accessory_state, i));
+				t_bidib_board_accessory_state *state = &g_array_index(
+						bidib_track_state.signals_board, t_bidib_board_accessory_state, i);
+				state->data.state_id = NULL;
+				bidib_state_free_single_board_accessory_state(*state);
 			}
 			g_array_free(bidib_track_state.signals_board, TRUE);
 			bidib_track_state.signals_board = NULL;
 
 			for (size_t i = 0; i < bidib_track_state.signals_dcc->len; i++) {
-				bidib_state_free_single_dcc_accessory_state(
-						g_array_index(bidib_track_state.signals_dcc,
-						              t_bidib_dcc_accessory_state, i));
+				t_bidib_dcc_accessory_state *state = &g_array_index(
+						bidib_track_state.signals_dcc, t_bidib_dcc_accessory_state, i);
+				state->data.state_id = NULL;
+				bidib_state_free_single_dcc_accessory_state(*state);
 			}
 			g_array_free(bidib_track_state.signals_dcc, TRUE);
 			bidib_track_state.signals_dcc = NULL;
 
 			for (size_t i = 0; i < bidib_track_state.peripherals->len; i++) {
-				bidib_state_free_single_peripheral_state(
-						g_array_index(bidib_track_state.peripherals,
-						              t_bidib_peripheral_state, i));
+				t_bidib_peripheral_state *state = &g_array_index(
+						bidib_track_state.peripherals, t_bidib_peripheral_state, i);
+				state->data.state_id = NULL;
+				bidib_state_free_single_peripheral_state(*state);
 			}
 			g_array_free(bidib_track_state.peripherals, TRUE);
 			bidib_track_state.peripherals = NULL;
@@ -424,9 +307,10 @@ void bidib_state_free(void) {
 			bidib_track_state.segments = NULL;
 
 			for (size_t i = 0; i < bidib_track_state.reversers->len; i++) {
-				bidib_state_free_single_reverser_state(
-						g_array_index(bidib_track_state.reversers,
-						              t_bidib_reverser_state, i));
+				t_bidib_reverser_state *state = &g_array_index(
+						bidib_track_state.reversers, t_bidib_reverser_state, i);
+				state->data.state_id = NULL;
+				bidib_state_free_single_reverser_state(*state);
 			}
 			g_array_free(bidib_track_state.reversers, TRUE);
 			bidib_track_state.reversers = NULL;
@@ -473,5 +357,8 @@ void bidib_state_free(void) {
 			g_array_free(bidib_trains, TRUE);
 			bidib_trains = NULL;
 		}
+
+		// Releases the ids and other strings of the boards and trains
+		bidib_state_arena_free();
 	}
 }
@@ -33,23 +33,17 @@
 #include "bidib_state_getter_intern.h"
 
 t_bidib_board *bidib_state_get_board_ref(const char *board) {
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		t_bidib_board *searched = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (searched != NULL && !strcmp(board, searched->id->str)) {
-			return searched;
-		}
+	size_t position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_BOARDS, board, NULL, &position)) {
+		return &g_array_index(bidib_boards, t_bidib_board, position);
 	}
 	return NULL;
 }
 
 t_bidib_board *bidib_state_get_board_ref_by_nodeaddr(t_bidib_node_address node_address) {
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		t_bidib_board *board_i = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (board_i != NULL && board_i->connected && board_i->node_addr.top == node_address.top &&
-		    board_i->node_addr.sub == node_address.sub &&
-		    board_i->node_addr.subsub == node_address.subsub) {
-			return board_i;
-		}
+	size_t position;
+	if (bidib_state_index_route_board(node_address, &position)) {
+		return &g_array_index(bidib_boards, t_bidib_board, position);
 	}
 	return NULL;
 }
@@ -66,100 +60,78 @@ t_bidib_board *bidib_state_get_board_ref_by_uniqueid(t_bidib_unique_id_mod uniqu
 }
 
 t_bidib_booster_state *bidib_state_get_booster_state_ref(const char *booster) {
-	t_bidib_booster_state *booster_state_i;
-	for (size_t i = 0; i < bidib_track_state.boosters->len; i++) {
-		booster_state_i = &g_array_index(bidib_track_state.boosters,
-		                                 t_bidib_booster_state, i);
-		if (!strcmp(booster, booster_state_i->id)) {
-			return booster_state_i;
-		}
+	size_t position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_BOOSTERS, booster, NULL, &position)) {
+		return &g_array_index(bidib_track_state.boosters, t_bidib_booster_state, position);
 	}
 	return NULL;
 }
 
 t_bidib_track_output_state *bidib_state_get_track_output_state_ref(const char *track_output) {
-	t_bidib_track_output_state *track_output_i;
-	for (size_t i = 0; i < bidib_track_state.track_outputs->len; i++) {
-		track_output_i = &g_array_index(bidib_track_state.track_outputs,
-		                                t_bidib_track_output_state, i);
-		if (!strcmp(track_output_i->id, track_output)) {
-			return track_output_i;
-		}
+	size_t position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_TRACK_OUTPUTS, track_output,
+	                             NULL, &position)) {
+		return &g_array_index(bidib_track_state.track_outputs,
+		                      t_bidib_track_output_state, position);
 	}
 	return NULL;
 }
 
 t_bidib_board_accessory_mapping *bidib_state_get_board_accessory_mapping_ref(
 		const char *accessory, bool point) {
-	t_bidib_board *tmp_board;
-	t_bidib_board_accessory_mapping *mapping;
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		tmp_board = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (point) {
-			for (size_t j = 0; j < tmp_board->points_board->len; j++) {
-				mapping = &g_array_index(tmp_board->points_board,
-				                         t_bidib_board_accessory_mapping, j);
-				if (!strcmp(mapping->id->str, accessory)) {
-					return mapping;
-				}
-			}
-		} else {
-			for (size_t j = 0; j < tmp_board->signals_board->len; j++) {
-				mapping = &g_array_index(tmp_board->signals_board,
-				                         t_bidib_board_accessory_mapping, j);
-				if (!strcmp(mapping->id->str, accessory)) {
-					return mapping;
-				}
-			}
-		}
+	size_t board_i, position;
+	if (bidib_state_index_lookup(point ? BIDIB_STATE_INDEX_POINT_BOARD_MAPPINGS
+	                                   : BIDIB_STATE_INDEX_SIGNAL_BOARD_MAPPINGS,
+	                             accessory, &board_i, &position)) {
+		t_bidib_board *tmp_board = &g_array_index(bidib_boards, t_bidib_board, board_i);
+		return &g_array_index(point ? tmp_board->points_board : tmp_board->signals_board,
+		                      t_bidib_board_accessory_mapping, position);
 	}
 	return NULL;
 }
 
 t_bidib_board_accessory_mapping *bidib_state_get_board_accessory_mapping_ref_by_number(
 		t_bidib_node_address node_address, uint8_t number, bool *point) {
-	t_bidib_board *sender = bidib_state_get_board_ref_by_nodeaddr(node_address);
-	if (sender == NULL) {
+	size_t board;
+	const t_bidib_board_routes *const routes = bidib_state_index_get_routes(node_address);
+	if (routes == NULL || routes->accessories[number].mapping == 0 ||
+	    !bidib_state_index_route_board(node_address, &board)) {
 		return NULL;
 	}
-	t_bidib_board_accessory_mapping *mapping;
-	for (size_t i = 0; i < sender->points_board->len; i++) {
-		mapping = &g_array_index(sender->points_board,
-		                         t_bidib_board_accessory_mapping, i);
-		if (mapping->number == number) {
-			*point = true;
-			return mapping;
-		}
-	}
-	for (size_t i = 0; i < sender->signals_board->len; i++) {
-		mapping = &g_array_index(sender->signals_board,
-		                         t_bidib_board_accessory_mapping, i);
-		if (mapping->number == number) {
-			*point = false;
-			return mapping;
-		}
+	t_bidib_board *sender = &g_array_index(bidib_boards, t_bidib_board, board);
+	*point = routes->accessory_is_point[number];
+	return &g_array_index(*point ? sender->points_board : sender->signals_board,
+	                      t_bidib_board_accessory_mapping,
+	                      routes->accessories[number].mapping - 1);
+}
+
+t_bidib_board_accessory_state *bidib_state_get_board_accessory_state_ref_by_number(
+		t_bidib_node_address node_address, uint8_t number) {
+	const t_bidib_board_routes *const routes = bidib_state_index_get_routes(node_address);
+	if (routes == NULL || routes->accessories[number].state == 0) {
+		return NULL;
 	}
-	return NULL;
+	return &g_array_index(routes->accessory_is_point[number]
+	                      ? bidib_track_state.points_board
+	                      : bidib_track_state.signals_board,
+	                      t_bidib_board_accessory_state,
+	                      routes->accessories[number].state - 1);
 }
 
 t_bidib_board_accessory_state *bidib_state_get_board_accessory_state_ref(const char *accessory,
                                                                          bool point) {
-	t_bidib_board_accessory_state *accessory_state = NULL;
+	size_t position;
 	if (point) {
-		for (size_t i = 0; i < bidib_track_state.points_board->len; i++) {
-			accessory_state = &g_array_index(bidib_track_state.points_board,
-			                                 t_bidib_board_accessory_state, i);
-			if (!strcmp(accessory_state->id, accessory)) {
-				return accessory_state;
-			}
+		if (bidib_state_index_lookup(BIDIB_STATE_INDEX_POINTS_BOARD, accessory,
+		                             NULL, &position)) {
+			return &g_array_index(bidib_track_state.points_board,
+			                      t_bidib_board_accessory_state, position);
 		}
 	} else {
-		for (size_t i = 0; i < bidib_track_state.signals_board->len; i++) {
-			accessory_state = &g_array_index(bidib_track_state.signals_board,
-			                                 t_bidib_board_accessory_state, i);
-			if (!strcmp(accessory_state->id, accessory)) {
-				return accessory_state;
-			}
+		if (bidib_state_index_lookup(BIDIB_STATE_INDEX_SIGNALS_BOARD, accessory,
+		                             NULL, &position)) {
+			return &g_array_index(bidib_track_state.signals_board,
+			                      t_bidib_board_accessory_state, position);
 		}
 	}
 	return NULL;
@@ -167,27 +139,13 @@ t_bidib_board_accessory_state *bidib_state_get_board_accessory_state_ref(const c
 
 t_bidib_dcc_accessory_mapping *bidib_state_get_dcc_accessory_mapping_ref(
 		const char *accessory, bool point) {
-	t_bidib_board *tmp_board;
-	t_bidib_dcc_accessory_mapping *mapping;
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		tmp_board = &g_array_index(bidib_boards, t_bidib_board, i);
-		if (point) {
-			for (size_t j = 0; j < tmp_board->points_dcc->len; j++) {
-				mapping = &g_array_index(tmp_board->points_dcc,
-				                         t_bidib_dcc_accessory_mapping, j);
-				if (!strcmp(mapping->id->str, accessory)) {
-					return mapping;
-				}
-			}
-		} else {
-			for (size_t j = 0; j < tmp_board->signals_dcc->len; j++) {
-				mapping = &g_array_index(tmp_board->signals_dcc,
-				                         t_bidib_dcc_accessory_mapping, j);
-				if (!strcmp(mapping->id->str, accessory)) {
-					return mapping;
-				}
-			}
-		}
+	size_t board_i, position;
+	if (bidib_state_index_lookup(point ? BIDIB_STATE_INDEX_POINT_DCC_MAPPINGS
+	                                   : BIDIB_STATE_INDEX_SIGNAL_DCC_MAPPINGS,
+	                             accessory, &board_i, &position)) {
+		t_bidib_board *tmp_board = &g_array_index(bidib_boards, t_bidib_board, board_i);
+		return &g_array_index(point ? tmp_board->points_dcc : tmp_board->signals_dcc,
+		                      t_bidib_dcc_accessory_mapping, position);
 	}
 	return NULL;
 }
@@ -219,83 +177,76 @@ t_bidib_dcc_accessory_mapping *bidib_state_get_dcc_accessory_mapping_ref_by_dcca
 
 t_bidib_dcc_accessory_state *bidib_state_get_dcc_accessory_state_ref(const char *accessory,
                                                                      bool point) {
-	t_bidib_dcc_accessory_state *accessory_state;
+	size_t position;
 	if (point) {
-		for (size_t i = 0; i < bidib_track_state.points_dcc->len; i++) {
-			accessory_state = &g_array_index(bidib_track_state.points_dcc,
-			                                 t_bidib_dcc_accessory_state, i);
-			if (!strcmp(accessory_state->id, accessory)) {
-				return accessory_state;
-			}
+		if (bidib_state_index_lookup(BIDIB_STATE_INDEX_POINTS_DCC, accessory,
+		                             NULL, &position)) {
+			return &g_array_index(bidib_track_state.points_dcc,
+			                      t_bidib_dcc_accessory_state, position);
 		}
 	} else {
-		for (size_t i = 0; i < bidib_track_state.signals_dcc->len; i++) {
-			accessory_state = &g_array_index(bidib_track_state.signals_dcc,
-			                                 t_bidib_dcc_accessory_state, i);
-			if (!strcmp(accessory_state->id, accessory)) {
-				return accessory_state;
-			}
+		if (bidib_state_index_lookup(BIDIB_STATE_INDEX_SIGNALS_DCC, accessory,
+		                             NULL, &position)) {
+			return &g_array_index(bidib_track_state.signals_dcc,
+			                      t_bidib_dcc_accessory_state, position);
 		}
 	}
 	return NULL;
 }
 
 t_bidib_peripheral_mapping *bidib_state_get_peripheral_mapping_ref(const char *peripheral) {
-	t_bidib_board *tmp_board;
-	t_bidib_peripheral_mapping *mapping;
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		tmp_board = &g_array_index(bidib_boards, t_bidib_board, i);
-		for (size_t j = 0; j < tmp_board->peripherals->len; j++) {
-			mapping = &g_array_index(tmp_board->peripherals,
-			                         t_bidib_peripheral_mapping, j);
-			if (!strcmp(mapping->id->str, peripheral)) {
-				return mapping;
-			}
-		}
+	size_t board_i, position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_PERIPHERAL_MAPPINGS, peripheral,
+	                             &board_i, &position)) {
+		t_bidib_board *tmp_board = &g_array_index(bidib_boards, t_bidib_board, board_i);
+		return &g_array_index(tmp_board->peripherals, t_bidib_peripheral_mapping, position);
 	}
 	return NULL;
 }
 
 t_bidib_peripheral_mapping *bidib_state_get_peripheral_mapping_ref_by_port(
 		t_bidib_node_address node_address, t_bidib_peripheral_port port) {
-	t_bidib_board *board = bidib_state_get_board_ref_by_nodeaddr(node_address);
-	if (board != NULL) {
-		t_bidib_peripheral_mapping *mapping;
-		for (size_t i = 0; i < board->peripherals->len; i++) {
-			mapping = &g_array_index(
-					board->peripherals, t_bidib_peripheral_mapping, i);
-			if (mapping->port.port0 == port.port0 &&
-			    mapping->port.port1 == port.port1) {
-				return mapping;
-			}
-		}
+	size_t board;
+	const t_bidib_board_routes *const routes = bidib_state_index_get_routes(node_address);
+	if (routes == NULL || !bidib_state_index_route_board(node_address, &board)) {
+		return NULL;
 	}
-	return NULL;
+	const t_bidib_route_entry *const route = bidib_state_index_route_peripheral(routes, port);
+	if (route == NULL || route->mapping == 0) {
+		return NULL;
+	}
+	t_bidib_board *sender = &g_array_index(bidib_boards, t_bidib_board, board);
+	return &g_array_index(sender->peripherals, t_bidib_peripheral_mapping, route->mapping - 1);
+}
+
+t_bidib_peripheral_state *bidib_state_get_peripheral_state_ref_by_port(
+		t_bidib_node_address node_address, t_bidib_peripheral_port port) {
+	const t_bidib_board_routes *const routes = bidib_state_index_get_routes(node_address);
+	if (routes == NULL) {
+		return NULL;
+	}
+	const t_bidib_route_entry *const route = bidib_state_index_route_peripheral(routes, port);
+	if (route == NULL || route->state == 0) {
+		return NULL;
+	}
+	return &g_array_index(bidib_track_state.peripherals, t_bidib_peripheral_state,
+	                      route->state - 1);
 }
 
 t_bidib_peripheral_state *bidib_state_get_peripheral_state_ref(const char *peripheral) {
-	t_bidib_peripheral_state *peripheral_state_i;
-	for (size_t i = 0; i < bidib_track_state.peripherals->len; i++) {
-		peripheral_state_i = &g_array_index(bidib_track_state.peripherals,
-		                                    t_bidib_peripheral_state, i);
-		if (!strcmp(peripheral_state_i->id, peripheral)) {
-			return peripheral_state_i;
-		}
+	size_t position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_PERIPHERALS, peripheral, NULL, &position)) {
+		return &g_array_index(bidib_track_state.peripherals,
+		                      t_bidib_peripheral_state, position);
 	}
 	return NULL;
 }
 
 t_bidib_segment_state_intern *bidib_state_get_segment_state_ref(const char *segment) {
-	if (segment == NULL) {
-		return NULL;
-	}
-	t_bidib_segment_state_intern *segment_state_i;
-	for (size_t i = 0; i < bidib_track_state.segments->len; i++) {
-		segment_state_i = &g_array_index(bidib_track_state.segments,
-		                                 t_bidib_segment_state_intern, i);
-		if (!strcmp(segment_state_i->id->str, segment)) {
-			return segment_state_i;
-		}
+	size_t position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_SEGMENTS, segment, NULL, &position)) {
+		return &g_array_index(bidib_track_state.segments,
+		                      t_bidib_segment_state_intern, position);
 	}
 	return NULL;
 }
@@ -303,8 +254,9 @@ t_bidib_segment_state_intern *bidib_state_get_segment_state_ref(const char *segm
 t_bidib_segment_state_intern bidib_state_get_segment_state(
 		const t_bidib_segment_state_intern *const segment_state) {
 	t_bidib_segment_state_intern query;
-	query.id = g_string_new(segment_state->id->str);
-	query.length = g_string_new(segment_state->length->str);
+	// The id and length are immutable config strings, the copy borrows them
+	query.id = segment_state->id;
+	query.length = segment_state->length;
 	query.occupied = segment_state->occupied;
 	query.confidence = segment_state->confidence;
 	query.power_consumption = segment_state->power_consumption;
@@ -321,35 +273,23 @@ t_bidib_segment_state_intern bidib_state_get_segment_state(
 
 t_bidib_segment_state_intern *bidib_state_get_segment_state_ref_by_nodeaddr(
 		t_bidib_node_address node_address, uint8_t number) {
-	// For bidib_state_get_board_ref_by_nodeaddr
+	t_bidib_segment_state_intern *ret = NULL;
+	// For bidib_state_index_get_routes
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	const t_bidib_board *const board = bidib_state_get_board_ref_by_nodeaddr(node_address);
-	if (board != NULL) {
-		for (size_t i = 0; i < board->segments->len; i++) {
-			const t_bidib_segment_mapping mapping_i = g_array_index(board->segments, 
-			                                                        t_bidib_segment_mapping, i);
-			if (mapping_i.addr == number) {
-				t_bidib_segment_state_intern *ret = bidib_state_get_segment_state_ref(mapping_i.id->str);
-				pthread_rwlock_unlock(&bidib_boards_rwlock);
-				return ret;
-			}
-		}
+	const t_bidib_board_routes *const routes = bidib_state_index_get_routes(node_address);
+	if (routes != NULL && routes->segments[number].state != 0) {
+		ret = &g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern,
+		                     routes->segments[number].state - 1);
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
-	return NULL;
+	return ret;
 }
 
 t_bidib_reverser_state *bidib_state_get_reverser_state_ref(const char *reverser) {
-	if (reverser == NULL) {
-		return NULL;
-	}
-	t_bidib_reverser_state *reverser_state_i;
-	for (size_t i = 0; i < bidib_track_state.reversers->len; i++) {
-		reverser_state_i = &g_array_index(bidib_track_state.reversers,
-		                                  t_bidib_reverser_state, i);
-		if (strcmp(reverser_state_i->id, reverser) == 0) {
-			return reverser_state_i;
-		}
+	size_t position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_REVERSERS, reverser, NULL, &position)) {
+		return &g_array_index(bidib_track_state.reversers,
+		                      t_bidib_reverser_state, position);
 	}
 	return NULL;
 }
@@ -361,7 +301,7 @@ t_bidib_reverser_mapping *bidib_state_get_reverser_mapping_ref_by_cv(
 		for (size_t i = 0; i < board->reversers->len; i++) {
 			t_bidib_reverser_mapping *mapping = &g_array_index(
 					board->reversers, t_bidib_reverser_mapping, i);
-			if (strcmp(cv, mapping->cv->str) == 0) {
+			if (strcmp(cv, mapping->cv) == 0) {
 				return mapping;
 			}
 		}
@@ -370,59 +310,69 @@ t_bidib_reverser_mapping *bidib_state_get_reverser_mapping_ref_by_cv(
 }
 
 t_bidib_reverser_mapping *bidib_state_get_reverser_mapping_ref(const char *reverser) {
-	t_bidib_board *tmp_board;
-	t_bidib_reverser_mapping *mapping;
-	for (size_t i = 0; i < bidib_boards->len; i++) {
-		tmp_board = &g_array_index(bidib_boards, t_bidib_board, i);
-		for (size_t j = 0; j < tmp_board->reversers->len; j++) {
-			mapping = &g_array_index(tmp_board->reversers,
-			                         t_bidib_reverser_mapping, j);
-			if (!strcmp(mapping->id->str, reverser)) {
-				return mapping;
-			}
-		}
+	size_t board_i, position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_REVERSER_MAPPINGS, reverser,
+	                             &board_i, &position)) {
+		t_bidib_board *tmp_board = &g_array_index(bidib_boards, t_bidib_board, board_i);
+		return &g_array_index(tmp_board->reversers, t_bidib_reverser_mapping, position);
 	}
 	return NULL;
 }
 
 t_bidib_train *bidib_state_get_train_ref(const char *train) {
-	for (size_t i = 0; i < bidib_trains->len; i++) {
-		t_bidib_train *train_i = &g_array_index(bidib_trains, t_bidib_train, i);
-		if (!strcmp(train, train_i->id->str)) {
-			return train_i;
-		}
+	size_t position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_TRAINS, train, NULL, &position)) {
+		return &g_array_index(bidib_trains, t_bidib_train, position);
 	}
 	return NULL;
 }
 
 t_bidib_train_state_intern *bidib_state_get_train_state_ref(const char *train) {
-	t_bidib_train_state_intern *train_state_i;
-	for (size_t i = 0; i < bidib_track_state.trains->len; i++) {
-		train_state_i = &g_array_index(bidib_track_state.trains,
-		                               t_bidib_train_state_intern, i);
-		if (!strcmp(train, train_state_i->id->str)) {
-			return train_state_i;
-		}
+	size_t position;
+	if (bidib_state_index_lookup(BIDIB_STATE_INDEX_TRAIN_STATES, train, NULL, &position)) {
+		return &g_array_index(bidib_track_state.trains,
+		                      t_bidib_train_state_intern, position);
 	}
 	return NULL;
 }
 
 t_bidib_train_state_intern *bidib_state_get_train_state_ref_by_dccaddr(
 		t_bidib_dcc_address dcc_address) {
-	for (size_t i = 0; i < bidib_trains->len; i++) {
-		const t_bidib_train *train_i = &g_array_index(bidib_trains, t_bidib_train, i);
-		// ignore orientation 
-		if (dcc_address.addrl == train_i->dcc_addr.addrl &&
-		    (dcc_address.addrh & 0x3F) == train_i->dcc_addr.addrh) {
-			return bidib_state_get_train_state_ref(train_i->id->str);
-		}
+	size_t position;
+	// ignore orientation 
+	if (bidib_state_index_lookup_train(dcc_address, &position)) {
+		const t_bidib_train *train = &g_array_index(bidib_trains, t_bidib_train, position);
+		return bidib_state_get_train_state_ref(train->id);
 	}
 	return NULL;
 }
 
+size_t bidib_state_get_train_detections(const t_bidib_train *train, bool *orientation_is_left) {
+	size_t count = 0;
+	const GArray *const segments = bidib_state_index_get_address_segments(train->dcc_addr);
+	if (segments == NULL) {
+		return count;
+	}
+	for (size_t i = 0; i < segments->len; i++) {
+		const t_bidib_segment_state_intern *const segment_state = 
+				&g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern,
+				               g_array_index(segments, guint, i));
+		for (size_t j = 0; j < segment_state->dcc_addresses->len; j++) {
+			const t_bidib_dcc_address dcc_address = 
+					g_array_index(segment_state->dcc_addresses, t_bidib_dcc_address, j);
+			if (train->dcc_addr.addrh == dcc_address.addrh && 
+			    train->dcc_addr.addrl == dcc_address.addrl) {
+				*orientation_is_left = (dcc_address.type == 0);
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
 t_bidib_train_peripheral_state *bidib_state_get_train_peripheral_state_by_bit(
 		const t_bidib_train_state_intern *train_state, uint8_t bit) {
-	const t_bidib_train *const train = bidib_state_get_train_ref(train_state->id->str);
+	const t_bidib_train *const train = bidib_state_get_train_ref(train_state->id);
 	bool found = false;
 	if (train != NULL) {
 		t_bidib_train_peripheral_mapping *mapping_i = NULL;
@@ -439,7 +389,7 @@ t_bidib_train_peripheral_state *bidib_state_get_train_peripheral_state_by_bit(
 			for (size_t i = 0; i < train_state->peripherals->len; i++) {
 				peripheral_state = &g_array_index(train_state->peripherals,
 				                                  t_bidib_train_peripheral_state, i);
-				if (!strcmp(mapping_i->id->str, peripheral_state->id)) {
+				if (!strcmp(mapping_i->id, peripheral_state->id)) {
 					return peripheral_state;
 				}
 			}
@@ -451,11 +401,12 @@ t_bidib_train_peripheral_state *bidib_state_get_train_peripheral_state_by_bit(
 t_bidib_booster_state *bidib_state_get_booster_state_ref_by_nodeaddr(
 		t_bidib_node_address node_address) {
 	t_bidib_booster_state *booster_state = NULL;
-	// For bidib_state_get_board_ref_by_nodeaddr
+	// For bidib_state_index_get_routes
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	const t_bidib_board *sender = bidib_state_get_board_ref_by_nodeaddr(node_address);
-	if (sender != NULL) {
-		booster_state = bidib_state_get_booster_state_ref(sender->id->str);
+	const t_bidib_board_routes *const routes = bidib_state_index_get_routes(node_address);
+	if (routes != NULL && routes->booster != 0) {
+		booster_state = &g_array_index(bidib_track_state.boosters, t_bidib_booster_state,
+		                               routes->booster - 1);
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
 	return booster_state;
@@ -464,11 +415,13 @@ t_bidib_booster_state *bidib_state_get_booster_state_ref_by_nodeaddr(
 t_bidib_track_output_state *bidib_state_get_track_output_state_ref_by_nodeaddr(
 		t_bidib_node_address node_address) {
 	t_bidib_track_output_state *track_output_state = NULL;
-	// For bidib_state_get_board_ref_by_nodeaddr
+	// For bidib_state_index_get_routes
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
-	const t_bidib_board *sender = bidib_state_get_board_ref_by_nodeaddr(node_address);
-	if (sender != NULL) {
-		track_output_state = bidib_state_get_track_output_state_ref(sender->id->str);
+	const t_bidib_board_routes *const routes = bidib_state_index_get_routes(node_address);
+	if (routes != NULL && routes->track_output != 0) {
+		track_output_state = &g_array_index(bidib_track_state.track_outputs,
+		                                    t_bidib_track_output_state,
+		                                    routes->track_output - 1);
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
 	return track_output_state;
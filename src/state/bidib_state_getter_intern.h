@@ -95,6 +95,18 @@ t_bidib_board_accessory_mapping *bidib_state_get_board_accessory_mapping_ref(
 t_bidib_board_accessory_mapping *bidib_state_get_board_accessory_mapping_ref_by_number(
 		t_bidib_node_address node_address, uint8_t number, bool *point);
 
+/**
+ * Returns the reference to the board accessory state with the given number.
+ * Shall only be called with trackstate_accessories_mutex and bidib_boards_rwlock
+ * >= read acquired.
+ *
+ * @param node_address the node address of the board.
+ * @param number the number of the accessory.
+ * @return NULL if not found, otherwise the reference to the board accessory state.
+ */
+t_bidib_board_accessory_state *bidib_state_get_board_accessory_state_ref_by_number(
+		t_bidib_node_address node_address, uint8_t number);
+
 /**
  * Returns the reference to the board accessory state with the given id.
  * Shall only be called with trackstate_accessories_mutex acquired.
@@ -161,6 +173,18 @@ t_bidib_peripheral_mapping *bidib_state_get_peripheral_mapping_ref(const char *p
 t_bidib_peripheral_mapping *bidib_state_get_peripheral_mapping_ref_by_port(
 		t_bidib_node_address node_address, t_bidib_peripheral_port port);
 
+/**
+ * Returns the reference to the peripheral state with the given port.
+ * Shall only be called with trackstate_peripherals_mutex and bidib_boards_rwlock
+ * >= read acquired.
+ *
+ * @param node_address the node address of the board.
+ * @param port the port of the peripheral.
+ * @return NULL if not found, otherwise the reference to the peripheral state.
+ */
+t_bidib_peripheral_state *bidib_state_get_peripheral_state_ref_by_port(
+		t_bidib_node_address node_address, t_bidib_peripheral_port port);
+
 /**
  * Returns the reference to the peripheral state with the given id.
  * Shall only be called with trackstate_peripherals_mutex acquired.
@@ -171,8 +195,9 @@ t_bidib_peripheral_mapping *bidib_state_get_peripheral_mapping_ref_by_port(
 t_bidib_peripheral_state *bidib_state_get_peripheral_state_ref(const char *peripheral);
 
 /**
- * Returns the reference to the segment state with the given id.
- * Shall only be called with trackstate_segments_mutex acquired.
+ * Returns the reference to the segment state with the given id. The segment
+ * states do not change once the config is loaded, so the lookup needs no lock,
+ * but the state shall only be accessed with its locks acquired.
  * 
  * @param segment the id of the segment.
  * @return NULL if not found, otherwise the reference to the segment state.
@@ -189,8 +214,9 @@ t_bidib_segment_state_intern bidib_state_get_segment_state(
 		const t_bidib_segment_state_intern *const segment);
 
 /**
- * Returns the reference to the segment state with the given id.
- * Shall only be called with trackstate_segments_mutex acquired.
+ * Returns the reference to the segment state with the given number on a board.
+ * The lookup needs no lock, but the state shall only be accessed with its locks
+ * acquired.
  * Note: uses bidib_boards_rwlock internally, so shall not be called
  * with bidib_boards_rwlock already acquired.
  *
@@ -259,6 +285,18 @@ t_bidib_train *bidib_state_get_train_ref(const char *train);
 t_bidib_train_state_intern *bidib_state_get_train_state_ref_by_dccaddr(
 		t_bidib_dcc_address dcc_address);
 
+/**
+ * Counts how often the DCC address of a train is detected by the segments.
+ * Shall only be called with trackstate_segments_mutex acquired.
+ *
+ * @param train the train.
+ * @param orientation_is_left used as return value for the orientation of the
+ * train in the last segment (in configuration order) that detects it. Unchanged
+ * if the train is not detected.
+ * @return the number of detections.
+ */
+size_t bidib_state_get_train_detections(const t_bidib_train *train, bool *orientation_is_left);
+
 /**
  * Returns the reference to the train peripheral state with the given bit.
  * Shall only be called with bidib_trains_rwlock >= read acquired.
@@ -0,0 +1,536 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <glib.h>
+
+#include "bidib_state_intern.h"
+#include "../transmission/bidib_transmission_intern.h"
+
+
+// Size of the routes of a board, including its occupancy words and shard lock
+#define BIDIB_BOARD_ROUTES_BYTES \
+	(sizeof(t_bidib_board_routes) + BIDIB_BOARD_OCCUPANCY_WORDS * sizeof(_Atomic uint64_t) + \
+	 sizeof(pthread_mutex_t))
+
+
+typedef struct {
+	size_t board;
+	size_t position;
+} t_bidib_state_index_entry;
+
+// Keys are the id strings of the indexed entries, they stay valid when the
+// arrays are reallocated. Values are positions, not pointers, for the same reason.
+static GHashTable *state_indexes[BIDIB_STATE_INDEX_COUNT] = {NULL};
+
+// Routes of the boards, parallel to bidib_boards. Built once after the configs
+// were parsed, because the boards, mappings and states do not change afterwards.
+static GArray *board_routes = NULL;
+
+// Shard lock of each segment state, parallel to bidib_track_state.segments. Points
+// to the segments_mutex of the routes of the board that maps the segment.
+static GArray *segment_locks = NULL;
+
+// Packed node address of each connected board -> position + 1 in bidib_boards.
+// Rebuilt whenever nodes are detected or lost.
+static GHashTable *node_routes = NULL;
+
+// DCC address (without orientation) -> position + 1 in bidib_trains.
+// Guarded by bidib_trains_rwlock.
+static GHashTable *train_dcc_addresses = NULL;
+
+// DCC address (without orientation) -> sorted GArray of the positions of the
+// segments that currently detect the address. Guarded by trackstate_segments_mutex.
+static GHashTable *address_segments = NULL;
+
+
+static void bidib_state_index_free_entry(gpointer entry) {
+	bidib_memory_free(BIDIB_MEMORY_INDEXES, sizeof(t_bidib_state_index_entry));
+	free(entry);
+}
+
+static void bidib_state_index_free_route_entry(gpointer entry) {
+	bidib_memory_free(BIDIB_MEMORY_INDEXES, sizeof(t_bidib_route_entry));
+	free(entry);
+}
+
+static void bidib_state_index_free_routes(void) {
+	if (board_routes != NULL) {
+		for (size_t i = 0; i < board_routes->len; i++) {
+			t_bidib_board_routes *routes = g_array_index(board_routes, t_bidib_board_routes *, i);
+			g_hash_table_destroy(routes->peripherals);
+			free(routes->occupancy);
+			pthread_mutex_destroy(routes->segments_mutex);
+			free(routes->segments_mutex);
+			free(routes);
+			bidib_memory_free(BIDIB_MEMORY_INDEXES, BIDIB_BOARD_ROUTES_BYTES);
+		}
+		bidib_memory_free(BIDIB_MEMORY_INDEXES,
+		                  board_routes->len * sizeof(t_bidib_board_routes *));
+		g_array_free(board_routes, TRUE);
+		board_routes = NULL;
+	}
+	if (segment_locks != NULL) {
+		bidib_memory_free(BIDIB_MEMORY_INDEXES, segment_locks->len * sizeof(pthread_mutex_t *));
+		g_array_free(segment_locks, TRUE);
+		segment_locks = NULL;
+	}
+	if (node_routes != NULL) {
+		g_hash_table_destroy(node_routes);
+		node_routes = NULL;
+	}
+}
+
+static void bidib_state_index_free_segment_set(gpointer segment_set) {
+	bidib_memory_free(BIDIB_MEMORY_INDEXES, ((GArray *) segment_set)->len * sizeof(guint));
+	g_array_free(segment_set, TRUE);
+}
+
+static void bidib_state_index_free_addresses(void) {
+	if (train_dcc_addresses != NULL) {
+		g_hash_table_destroy(train_dcc_addresses);
+		train_dcc_addresses = NULL;
+	}
+	if (address_segments != NULL) {
+		g_hash_table_destroy(address_segments);
+		address_segments = NULL;
+	}
+}
+
+void bidib_state_index_init(void) {
+	for (size_t i = 0; i < BIDIB_STATE_INDEX_COUNT; i++) {
+		if (state_indexes[i] != NULL) {
+			g_hash_table_destroy(state_indexes[i]);
+		}
+		state_indexes[i] = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		                                         bidib_state_index_free_entry);
+	}
+	bidib_state_index_free_routes();
+	node_routes = g_hash_table_new(g_direct_hash, g_direct_equal);
+	bidib_state_index_free_addresses();
+	train_dcc_addresses = g_hash_table_new(g_direct_hash, g_direct_equal);
+	address_segments = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+	                                         bidib_state_index_free_segment_set);
+}
+
+void bidib_state_index_free(void) {
+	for (size_t i = 0; i < BIDIB_STATE_INDEX_COUNT; i++) {
+		if (state_indexes[i] != NULL) {
+			g_hash_table_destroy(state_indexes[i]);
+			state_indexes[i] = NULL;
+		}
+	}
+	bidib_state_index_free_routes();
+	bidib_state_index_free_addresses();
+}
+
+void bidib_state_index_insert(t_bidib_state_index index, const char *id,
+                              size_t board, size_t position) {
+	GHashTable *table = state_indexes[index];
+	if (table == NULL || id == NULL || g_hash_table_contains(table, id)) {
+		// Keep the first entry, like the linear search did
+		return;
+	}
+	t_bidib_state_index_entry *entry = malloc(sizeof(t_bidib_state_index_entry));
+	if (entry == NULL) {
+		return;
+	}
+	bidib_memory_alloc(BIDIB_MEMORY_INDEXES, sizeof(t_bidib_state_index_entry));
+	entry->board = board;
+	entry->position = position;
+	g_hash_table_insert(table, (gpointer) id, entry);
+}
+
+bool bidib_state_index_lookup(t_bidib_state_index index, const char *id,
+                              size_t *board, size_t *position) {
+	GHashTable *table = state_indexes[index];
+	if (table == NULL || id == NULL) {
+		return false;
+	}
+	const t_bidib_state_index_entry *entry = g_hash_table_lookup(table, id);
+	if (entry == NULL) {
+		return false;
+	}
+	if (board != NULL) {
+		*board = entry->board;
+	}
+	*position = entry->position;
+	return true;
+}
+
+static void bidib_state_index_add_mappings(t_bidib_state_index index, size_t board,
+                                           const GArray *mappings, size_t elem_size,
+                                           size_t id_offset) {
+	for (size_t i = 0; i < mappings->len; i++) {
+		const char *id =
+			*(const char *const *) (mappings->data + i * elem_size + id_offset);
+		bidib_state_index_insert(index, id, board, i);
+	}
+}
+
+void bidib_state_index_build_mappings(void) {
+	for (size_t i = BIDIB_STATE_INDEX_POINT_BOARD_MAPPINGS; i < BIDIB_STATE_INDEX_COUNT; i++) {
+		if (state_indexes[i] == NULL) {
+			return;
+		}
+		g_hash_table_remove_all(state_indexes[i]);
+	}
+	for (size_t i = 0; i < bidib_boards->len; i++) {
+		const t_bidib_board *const board = &g_array_index(bidib_boards, t_bidib_board, i);
+		bidib_state_index_add_mappings(BIDIB_STATE_INDEX_POINT_BOARD_MAPPINGS, i,
+		                               board->points_board,
+		                               sizeof(t_bidib_board_accessory_mapping),
+		                               offsetof(t_bidib_board_accessory_mapping, id));
+		bidib_state_index_add_mappings(BIDIB_STATE_INDEX_POINT_DCC_MAPPINGS, i,
+		                               board->points_dcc,
+		                               sizeof(t_bidib_dcc_accessory_mapping),
+		                               offsetof(t_bidib_dcc_accessory_mapping, id));
+		bidib_state_index_add_mappings(BIDIB_STATE_INDEX_SIGNAL_BOARD_MAPPINGS, i,
+		                               board->signals_board,
+		                               sizeof(t_bidib_board_accessory_mapping),
+		                               offsetof(t_bidib_board_accessory_mapping, id));
+		bidib_state_index_add_mappings(BIDIB_STATE_INDEX_SIGNAL_DCC_MAPPINGS, i,
+		                               board->signals_dcc,
+		                               sizeof(t_bidib_dcc_accessory_mapping),
+		                               offsetof(t_bidib_dcc_accessory_mapping, id));
+		bidib_state_index_add_mappings(BIDIB_STATE_INDEX_PERIPHERAL_MAPPINGS, i,
+		                               board->peripherals,
+		                               sizeof(t_bidib_peripheral_mapping),
+		                               offsetof(t_bidib_peripheral_mapping, id));
+		bidib_state_index_add_mappings(BIDIB_STATE_INDEX_REVERSER_MAPPINGS, i,
+		                               board->reversers,
+		                               sizeof(t_bidib_reverser_mapping),
+		                               offsetof(t_bidib_reverser_mapping, id));
+	}
+}
+
+static unsigned int bidib_state_index_state_position(t_bidib_state_index index,
+                                                     const char *id) {
+	size_t position;
+	if (bidib_state_index_lookup(index, id, NULL, &position)) {
+		return (unsigned int) position + 1;
+	}
+	return 0;
+}
+
+static void bidib_state_index_route_accessories(t_bidib_board_routes *routes,
+                                                const GArray *mappings, bool point) {
+	for (size_t i = 0; i < mappings->len; i++) {
+		const t_bidib_board_accessory_mapping *const mapping =
+			&g_array_index(mappings, t_bidib_board_accessory_mapping, i);
+		t_bidib_route_entry *entry = &routes->accessories[mapping->number];
+		if (entry->mapping == 0) {
+			entry->mapping = (unsigned int) i + 1;
+			entry->state = bidib_state_index_state_position(
+				point ? BIDIB_STATE_INDEX_POINTS_BOARD : BIDIB_STATE_INDEX_SIGNALS_BOARD,
+				mapping->id);
+			routes->accessory_is_point[mapping->number] = point;
+		}
+	}
+}
+
+void bidib_state_index_build_routes(void) {
+	bidib_state_index_free_routes();
+	board_routes = g_array_sized_new(FALSE, FALSE, sizeof(t_bidib_board_routes *),
+	                                 bidib_boards->len);
+	node_routes = g_hash_table_new(g_direct_hash, g_direct_equal);
+	segment_locks = g_array_sized_new(FALSE, TRUE, sizeof(pthread_mutex_t *),
+	                                  bidib_track_state.segments->len);
+	g_array_set_size(segment_locks, bidib_track_state.segments->len);
+	bidib_memory_alloc(BIDIB_MEMORY_INDEXES, segment_locks->len * sizeof(pthread_mutex_t *));
+	bidib_memory_alloc(BIDIB_MEMORY_INDEXES, bidib_boards->len * sizeof(t_bidib_board_routes *));
+	for (size_t i = 0; i < bidib_boards->len; i++) {
+		const t_bidib_board *const board = &g_array_index(bidib_boards, t_bidib_board, i);
+		t_bidib_board_routes *routes = calloc(1, sizeof(t_bidib_board_routes));
+		routes->peripherals = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+		                                            bidib_state_index_free_route_entry);
+		routes->occupancy = calloc(BIDIB_BOARD_OCCUPANCY_WORDS, sizeof(_Atomic uint64_t));
+		routes->segments_mutex = malloc(sizeof(pthread_mutex_t));
+		pthread_mutex_init(routes->segments_mutex, NULL);
+		bidib_memory_alloc(BIDIB_MEMORY_INDEXES, BIDIB_BOARD_ROUTES_BYTES);
+
+		for (size_t j = 0; j < board->segments->len; j++) {
+			const t_bidib_segment_mapping *const mapping =
+				&g_array_index(board->segments, t_bidib_segment_mapping, j);
+			t_bidib_route_entry *entry = &routes->segments[mapping->addr];
+			if (entry->mapping == 0) {
+				entry->mapping = (unsigned int) j + 1;
+				entry->state = bidib_state_index_state_position(BIDIB_STATE_INDEX_SEGMENTS,
+				                                                mapping->id);
+				if (entry->state != 0) {
+					g_array_index(segment_locks, pthread_mutex_t *, entry->state - 1) =
+							routes->segments_mutex;
+				}
+			}
+		}
+
+		// Points take precedence over signals with the same number
+		bidib_state_index_route_accessories(routes, board->points_board, true);
+		bidib_state_index_route_accessories(routes, board->signals_board, false);
+
+		for (size_t j = 0; j < board->peripherals->len; j++) {
+			const t_bidib_peripheral_mapping *const mapping =
+				&g_array_index(board->peripherals, t_bidib_peripheral_mapping, j);
+			gpointer port = GUINT_TO_POINTER((mapping->port.port0 << 8) | mapping->port.port1);
+			if (!g_hash_table_contains(routes->peripherals, port)) {
+				t_bidib_route_entry *entry = malloc(sizeof(t_bidib_route_entry));
+				bidib_memory_alloc(BIDIB_MEMORY_INDEXES, sizeof(t_bidib_route_entry));
+				entry->mapping = (unsigned int) j + 1;
+				entry->state = bidib_state_index_state_position(BIDIB_STATE_INDEX_PERIPHERALS,
+				                                                mapping->id);
+				g_hash_table_insert(routes->peripherals, port, entry);
+			}
+		}
+
+		routes->booster = bidib_state_index_state_position(BIDIB_STATE_INDEX_BOOSTERS,
+		                                                   board->id);
+		routes->track_output = bidib_state_index_state_position(BIDIB_STATE_INDEX_TRACK_OUTPUTS,
+		                                                        board->id);
+		g_array_append_val(board_routes, routes);
+	}
+	bidib_state_index_update_node_routes();
+}
+
+static gpointer bidib_state_index_node_key(t_bidib_node_address node_address) {
+	// The interface has the address 0x00 0x00 0x00, so mark the key as used
+	return GUINT_TO_POINTER((1u << 24) | (node_address.top << 16) |
+	                        (node_address.sub << 8) | node_address.subsub);
+}
+
+void bidib_state_index_update_node_routes(void) {
+	if (node_routes == NULL) {
+		return;
+	}
+	g_hash_table_remove_all(node_routes);
+	for (size_t i = 0; i < bidib_boards->len; i++) {
+		const t_bidib_board *const board = &g_array_index(bidib_boards, t_bidib_board, i);
+		gpointer key = bidib_state_index_node_key(board->node_addr);
+		if (board->connected && !g_hash_table_contains(node_routes, key)) {
+			g_hash_table_insert(node_routes, key, GSIZE_TO_POINTER(i + 1));
+		}
+	}
+}
+
+bool bidib_state_index_route_board(t_bidib_node_address node_address, size_t *board) {
+	if (node_routes == NULL) {
+		return false;
+	}
+	const size_t position = GPOINTER_TO_SIZE(
+		g_hash_table_lookup(node_routes, bidib_state_index_node_key(node_address)));
+	if (position == 0) {
+		return false;
+	}
+	*board = position - 1;
+	return true;
+}
+
+const t_bidib_board_routes *bidib_state_index_get_routes(t_bidib_node_address node_address) {
+	size_t board;
+	if (board_routes == NULL || !bidib_state_index_route_board(node_address, &board) ||
+	    board >= board_routes->len) {
+		return NULL;
+	}
+	return g_array_index(board_routes, t_bidib_board_routes *, board);
+}
+
+const t_bidib_board_routes *bidib_state_index_get_board_routes(size_t board) {
+	if (board_routes == NULL || board >= board_routes->len) {
+		return NULL;
+	}
+	return g_array_index(board_routes, t_bidib_board_routes *, board);
+}
+
+void bidib_state_index_store_occupancy(const t_bidib_board_routes *routes,
+                                       const uint64_t mask[BIDIB_BOARD_OCCUPANCY_WORDS],
+                                       const uint64_t occupied[BIDIB_BOARD_OCCUPANCY_WORDS]) {
+	for (size_t i = 0; i < BIDIB_BOARD_OCCUPANCY_WORDS; i++) {
+		if (mask[i] == 0) {
+			continue;
+		}
+		// Writers are serialized by the shard lock of the board (routes->segments_mutex)
+		const uint64_t word = atomic_load_explicit(&routes->occupancy[i], memory_order_relaxed);
+		atomic_store_explicit(&routes->occupancy[i], (word & ~mask[i]) | (occupied[i] & mask[i]),
+		                      memory_order_release);
+	}
+}
+
+void bidib_state_index_clear_occupancy(void) {
+	if (board_routes == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < board_routes->len; i++) {
+		const t_bidib_board_routes *routes = g_array_index(board_routes, t_bidib_board_routes *, i);
+		for (size_t j = 0; j < BIDIB_BOARD_OCCUPANCY_WORDS; j++) {
+			atomic_store_explicit(&routes->occupancy[j], 0, memory_order_release);
+		}
+	}
+}
+
+pthread_mutex_t *bidib_state_index_segment_lock(
+		const t_bidib_segment_state_intern *segment_state) {
+	if (segment_locks == NULL || segment_state == NULL) {
+		return NULL;
+	}
+	const size_t position = (size_t) (segment_state - (const t_bidib_segment_state_intern *)
+	                                                  (void *) bidib_track_state.segments->data);
+	if (position >= segment_locks->len) {
+		return NULL;
+	}
+	return g_array_index(segment_locks, pthread_mutex_t *, position);
+}
+
+void bidib_state_index_lock_segment_shards(void) {
+	if (board_routes == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < board_routes->len; i++) {
+		pthread_mutex_lock(g_array_index(board_routes, t_bidib_board_routes *, i)->segments_mutex);
+	}
+}
+
+void bidib_state_index_unlock_segment_shards(void) {
+	if (board_routes == NULL) {
+		return;
+	}
+	for (size_t i = board_routes->len; i > 0; i--) {
+		pthread_mutex_unlock(
+				g_array_index(board_routes, t_bidib_board_routes *, i - 1)->segments_mutex);
+	}
+}
+
+const t_bidib_route_entry *bidib_state_index_route_peripheral(
+		const t_bidib_board_routes *routes, t_bidib_peripheral_port port) {
+	return g_hash_table_lookup(routes->peripherals,
+	                           GUINT_TO_POINTER((port.port0 << 8) | port.port1));
+}
+
+static gpointer bidib_state_index_dcc_key(t_bidib_dcc_address dcc_address) {
+	return GUINT_TO_POINTER(((dcc_address.addrh & 0x3F) << 8) | dcc_address.addrl);
+}
+
+void bidib_state_index_insert_train(t_bidib_dcc_address dcc_address, size_t position) {
+	gpointer key = bidib_state_index_dcc_key(dcc_address);
+	if (train_dcc_addresses != NULL && !g_hash_table_contains(train_dcc_addresses, key)) {
+		g_hash_table_insert(train_dcc_addresses, key, GSIZE_TO_POINTER(position + 1));
+	}
+}
+
+bool bidib_state_index_lookup_train(t_bidib_dcc_address dcc_address, size_t *position) {
+	if (train_dcc_addresses == NULL) {
+		return false;
+	}
+	const size_t entry = GPOINTER_TO_SIZE(
+		g_hash_table_lookup(train_dcc_addresses, bidib_state_index_dcc_key(dcc_address)));
+	if (entry == 0) {
+		return false;
+	}
+	*position = entry - 1;
+	return true;
+}
+
+// Returns the position of the segment set where the segment is or would be
+static guint bidib_state_index_segment_set_find(const GArray *segment_set,
+                                                guint segment, bool *found) {
+	guint low = 0;
+	guint high = segment_set->len;
+	while (low < high) {
+		const guint middle = low + (high - low) / 2;
+		const guint value = g_array_index(segment_set, guint, middle);
+		if (value == segment) {
+			*found = true;
+			return middle;
+		} else if (value < segment) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	*found = false;
+	return low;
+}
+
+static guint bidib_state_index_segment_position(
+		const t_bidib_segment_state_intern *segment_state) {
+	return (guint) (segment_state - (t_bidib_segment_state_intern *) bidib_track_state.segments->data);
+}
+
+void bidib_state_index_link_segment(const t_bidib_segment_state_intern *segment_state) {
+	if (address_segments == NULL) {
+		return;
+	}
+	const guint segment = bidib_state_index_segment_position(segment_state);
+	for (size_t i = 0; i < segment_state->dcc_addresses->len; i++) {
+		gpointer key = bidib_state_index_dcc_key(
+			g_array_index(segment_state->dcc_addresses, t_bidib_dcc_address, i));
+		GArray *segment_set = g_hash_table_lookup(address_segments, key);
+		if (segment_set == NULL) {
+			segment_set = g_array_sized_new(FALSE, FALSE, sizeof(guint), 4);
+			bidib_memory_alloc(BIDIB_MEMORY_INDEXES, 0);
+			g_hash_table_insert(address_segments, key, segment_set);
+		}
+		bool found;
+		const guint at = bidib_state_index_segment_set_find(segment_set, segment, &found);
+		if (!found) {
+			g_array_insert_val(segment_set, at, segment);
+			bidib_memory_resize(BIDIB_MEMORY_INDEXES, 0, sizeof(guint));
+		}
+	}
+}
+
+void bidib_state_index_unlink_segment(const t_bidib_segment_state_intern *segment_state) {
+	if (address_segments == NULL) {
+		return;
+	}
+	const guint segment = bidib_state_index_segment_position(segment_state);
+	for (size_t i = 0; i < segment_state->dcc_addresses->len; i++) {
+		GArray *segment_set = g_hash_table_lookup(address_segments, bidib_state_index_dcc_key(
+			g_array_index(segment_state->dcc_addresses, t_bidib_dcc_address, i)));
+		if (segment_set != NULL) {
+			// A segment can report the same address more than once
+			bool found;
+			const guint at = bidib_state_index_segment_set_find(segment_set, segment, &found);
+			if (found) {
+				g_array_remove_index(segment_set, at);
+				bidib_memory_resize(BIDIB_MEMORY_INDEXES, sizeof(guint), 0);
+			}
+		}
+	}
+}
+
+const GArray *bidib_state_index_get_address_segments(t_bidib_dcc_address dcc_address) {
+	if (address_segments == NULL) {
+		return NULL;
+	}
+	return g_hash_table_lookup(address_segments, bidib_state_index_dcc_key(dcc_address));
+}
@@ -32,25 +32,33 @@
 
 #include <glib.h>
 #include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
 
 #include "../../include/definitions/bidib_definitions_custom.h"
+#include "../../include/highlevel/bidib_highlevel_export.h"
 
 
+// The state ids of the accessories, peripherals and reversers point to the ids of
+// the aspects and mappings in the board configs. They are not owned by the states,
+// so that a state report only has to update a pointer.
 typedef struct {
 	GArray *points_board;   // guarded by trackstate_accessories_mutex
 	GArray *points_dcc;     // guarded by trackstate_accessories_mutex
 	GArray *signals_board;  // guarded by trackstate_accessories_mutex
 	GArray *signals_dcc;    // guarded by trackstate_accessories_mutex
 	GArray *peripherals;    // guarded by trackstate_peripherals_mutex
-	GArray *segments;       // guarded by trackstate_segments_mutex
+	GArray *segments;       // guarded by trackstate_segments_mutex and the shard locks
 	GArray *reversers;      // guarded by trackstate_reversers_mutex
 	GArray *trains;         // guarded by trackstate_trains_mutex
 	GArray *boosters;       // guarded by trackstate_boosters_mutex
 	GArray *track_outputs;  // guarded by trackstate_track_outputs_mutex
 } t_bidib_track_state_intern;
 
+// The strings of the configuration below are allocated in the configuration arena
+// (see bidib_state_arena_alloc) and stay valid until bidib_state_free.
 typedef struct {
-	GString *id;
+	const char *id;
 	bool on_track;
 	t_bidib_train_orientation orientation;
 	int set_speed_step;
@@ -62,8 +70,8 @@ typedef struct {
 } t_bidib_train_state_intern;
 
 typedef struct {
-	GString *id;
-	GString *length;
+	const char *id;
+	const char *length;
 	bool occupied;
 	t_bidib_segment_state_confidence confidence;
 	t_bidib_power_consumption power_consumption;
@@ -71,20 +79,20 @@ typedef struct {
 } t_bidib_segment_state_intern;
 
 typedef struct {
-	GString *id;
+	const char *id;
 	uint8_t bit;
 } t_bidib_train_peripheral_mapping;
 
 typedef struct {
-	GString *id;
+	const char *id;
 	t_bidib_dcc_address dcc_addr;
 	uint8_t dcc_speed_steps;
-	GArray *calibration;
+	const int *calibration;   // nine values, or NULL
 	GArray *peripherals;
 } t_bidib_train;
 
 typedef struct {
-	GString *id;
+	const char *id;
 	uint8_t value;
 } t_bidib_aspect;
 
@@ -94,18 +102,18 @@ typedef struct {
 } t_bidib_dcc_aspect_port_value;
 
 typedef struct {
-	GString *id;
+	const char *id;
 	GArray *port_values;
 } t_bidib_dcc_aspect;
 
 typedef struct {
-	GString *id;
+	const char *id;
 	uint8_t number;
 	GArray *aspects;
 } t_bidib_board_accessory_mapping;
 
 typedef struct {
-	GString *id;
+	const char *id;
 	t_bidib_dcc_address dcc_addr;
 	uint8_t extended_accessory;
 	GArray *aspects;
@@ -117,24 +125,24 @@ typedef struct {
 } t_bidib_peripheral_port;
 
 typedef struct {
-	GString *id;
+	const char *id;
 	uint8_t number;
 	t_bidib_peripheral_port port;
 	GArray *aspects;
 } t_bidib_peripheral_mapping;
 
 typedef struct {
-	GString *id;
+	const char *id;
 	uint8_t addr;
 } t_bidib_segment_mapping;
 
 typedef struct {
-	GString *id;
-	GString *cv;
+	const char *id;
+	const char *cv;
 } t_bidib_reverser_mapping;
 
 typedef struct {
-	GString *id;
+	const char *id;
 	t_bidib_unique_id_mod unique_id;
 	bool connected;
 	t_bidib_node_address node_addr;
@@ -150,13 +158,13 @@ typedef struct {
 } t_bidib_board;
 
 typedef struct {
-	GString *id;
-	GString *value;
+	const char *id;
+	const char *value;
 } t_bidib_state_initial_value;
 
 typedef struct {
-	GString *train;
-	GString *id;
+	const char *train;
+	const char *id;
 	uint8_t value;
 } t_bidib_state_train_initial_value;
 
@@ -172,12 +180,78 @@ extern pthread_rwlock_t bidib_boards_rwlock;
 
 extern pthread_mutex_t trackstate_accessories_mutex;
 extern pthread_mutex_t trackstate_peripherals_mutex;
+// The segment states are sharded by the board that maps them. The shard lock of a
+// board guards the states of its segments. trackstate_segments_mutex guards the
+// array and the detected dcc addresses of all segments, so writing the addresses
+// needs both locks, reading them needs either. Lock order: bidib_trains_rwlock,
+// trackstate_segments_mutex, the shard locks by ascending board position,
+// trackstate_trains_mutex, bidib_boards_rwlock.
 extern pthread_mutex_t trackstate_segments_mutex;
 extern pthread_mutex_t trackstate_reversers_mutex;
 extern pthread_mutex_t trackstate_trains_mutex;
 extern pthread_mutex_t trackstate_boosters_mutex;
 extern pthread_mutex_t trackstate_track_outputs_mutex;
+extern pthread_mutex_t trackstate_snapshot_mutex;
+
+
+// Indexes from ids to entries of the state arrays. Each index is guarded by the
+// lock of the array it indexes, the mapping indexes by bidib_boards_rwlock.
+typedef enum {
+	BIDIB_STATE_INDEX_BOARDS,                // bidib_boards
+	BIDIB_STATE_INDEX_TRAINS,                // bidib_trains
+	BIDIB_STATE_INDEX_POINTS_BOARD,          // bidib_track_state.points_board
+	BIDIB_STATE_INDEX_POINTS_DCC,            // bidib_track_state.points_dcc
+	BIDIB_STATE_INDEX_SIGNALS_BOARD,         // bidib_track_state.signals_board
+	BIDIB_STATE_INDEX_SIGNALS_DCC,           // bidib_track_state.signals_dcc
+	BIDIB_STATE_INDEX_PERIPHERALS,           // bidib_track_state.peripherals
+	BIDIB_STATE_INDEX_SEGMENTS,              // bidib_track_state.segments
+	BIDIB_STATE_INDEX_REVERSERS,             // bidib_track_state.reversers
+	BIDIB_STATE_INDEX_TRAIN_STATES,          // bidib_track_state.trains
+	BIDIB_STATE_INDEX_BOOSTERS,              // bidib_track_state.boosters
+	BIDIB_STATE_INDEX_TRACK_OUTPUTS,         // bidib_track_state.track_outputs
+	BIDIB_STATE_INDEX_POINT_BOARD_MAPPINGS,  // points_board of all boards
+	BIDIB_STATE_INDEX_POINT_DCC_MAPPINGS,    // points_dcc of all boards
+	BIDIB_STATE_INDEX_SIGNAL_BOARD_MAPPINGS, // signals_board of all boards
+	BIDIB_STATE_INDEX_SIGNAL_DCC_MAPPINGS,   // signals_dcc of all boards
+	BIDIB_STATE_INDEX_PERIPHERAL_MAPPINGS,   // peripherals of all boards
+	BIDIB_STATE_INDEX_REVERSER_MAPPINGS,     // reversers of all boards
+	BIDIB_STATE_INDEX_COUNT
+} t_bidib_state_index;
+
+// Parts of the track state that are guarded by the same trackstate mutex
+typedef enum {
+	BIDIB_STATE_CATEGORY_ACCESSORIES,   // trackstate_accessories_mutex
+	BIDIB_STATE_CATEGORY_PERIPHERALS,   // trackstate_peripherals_mutex
+	BIDIB_STATE_CATEGORY_SEGMENTS,      // trackstate_segments_mutex and the shard locks
+	BIDIB_STATE_CATEGORY_REVERSERS,     // trackstate_reversers_mutex
+	BIDIB_STATE_CATEGORY_TRAINS,        // trackstate_trains_mutex
+	BIDIB_STATE_CATEGORY_BOOSTERS,      // trackstate_boosters_mutex
+	BIDIB_STATE_CATEGORY_TRACK_OUTPUTS, // trackstate_track_outputs_mutex
+	BIDIB_STATE_CATEGORY_COUNT
+} t_bidib_state_category;
+
+#define BIDIB_STATE_CATEGORIES_ALL ((1u << BIDIB_STATE_CATEGORY_COUNT) - 1)
+
+// Positions + 1 of a mapping in its board and of its state, 0 if there is none
+typedef struct {
+	unsigned int mapping;
+	unsigned int state;
+} t_bidib_route_entry;
 
+// Routes from the numbers used in uplink messages of a board to its entries
+typedef struct {
+	t_bidib_route_entry segments[256];     // by BM number, board->segments and segment states
+	t_bidib_route_entry accessories[256];  // by accessory number, board->points_board or
+	                                       // board->signals_board and their states
+	bool accessory_is_point[256];
+	GHashTable *peripherals;               // by port (port0 << 8 | port1), board->peripherals
+	                                       // and peripheral states
+	unsigned int booster;                  // position + 1 of the booster state
+	unsigned int track_output;             // position + 1 of the track output state
+	_Atomic uint64_t *occupancy;           // BIDIB_BOARD_OCCUPANCY_WORDS words, occupied
+	                                       // segments by BM number, readable without lock
+	pthread_mutex_t *segments_mutex;       // shard lock of the segment states of the board
+} t_bidib_board_routes;
 
 extern t_bidib_state_initial_values bidib_initial_values;
 extern t_bidib_track_state_intern bidib_track_state;
@@ -198,11 +272,359 @@ int bidib_state_init(const char *config_dir);
  */
 void bidib_state_init_allocation_table(void);
 
+/**
+ * Creates the empty id indexes.
+ */
+void bidib_state_index_init(void);
+
+/**
+ * (Re)builds the indexes of the mappings of all boards. Has to be called after the
+ * configs were parsed, because the parser adds the mappings directly to the boards.
+ * Shall only be called with bidib_boards_rwlock write acquired.
+ */
+void bidib_state_index_build_mappings(void);
+
+/**
+ * Frees the id indexes.
+ */
+void bidib_state_index_free(void);
+
+/**
+ * Adds an entry to an index. If the id is already indexed, the existing entry is kept.
+ * Shall only be called with the lock of the indexed array acquired (write).
+ *
+ * @param index the index.
+ * @param id the id of the entry, must live as long as the entry.
+ * @param board the position of the board in bidib_boards (only for mapping indexes).
+ * @param position the position of the entry in the indexed array.
+ */
+void bidib_state_index_insert(t_bidib_state_index index, const char *id,
+                              size_t board, size_t position);
+
+/**
+ * Looks up the position of an entry in an index.
+ * Shall only be called with the lock of the indexed array acquired (>= read).
+ *
+ * @param index the index.
+ * @param id the id of the entry.
+ * @param board the position of the board in bidib_boards (out-parameter, only for
+ * mapping indexes, may be NULL).
+ * @param position the position of the entry in the indexed array (out-parameter).
+ * @return true if the id is indexed, otherwise false.
+ */
+bool bidib_state_index_lookup(t_bidib_state_index index, const char *id,
+                              size_t *board, size_t *position);
+
+/**
+ * Builds the routes from the numbers and ports of every board to its mappings
+ * and states, and the routes of the connected node addresses. Has to be called
+ * after bidib_state_index_build_mappings.
+ * Shall only be called with trackstate_accessories_mutex, trackstate_peripherals_mutex,
+ * trackstate_segments_mutex, trackstate_boosters_mutex, trackstate_track_outputs_mutex,
+ * and bidib_boards_rwlock write acquired.
+ */
+void bidib_state_index_build_routes(void);
+
+/**
+ * Rebuilds the routes of the connected node addresses to their boards. Has to be
+ * called whenever a board gets connected or disconnected.
+ * Shall only be called with bidib_boards_rwlock write acquired.
+ */
+void bidib_state_index_update_node_routes(void);
+
+/**
+ * Looks up the board connected with a node address.
+ * Shall only be called with bidib_boards_rwlock >= read acquired.
+ *
+ * @param node_address the node address.
+ * @param board the position of the board in bidib_boards (out-parameter).
+ * @return true if a board is connected with the node address, otherwise false.
+ */
+bool bidib_state_index_route_board(t_bidib_node_address node_address, size_t *board);
+
+/**
+ * Returns the routes of the board connected with a node address.
+ * Shall only be called with bidib_boards_rwlock >= read acquired.
+ *
+ * @param node_address the node address.
+ * @return NULL if no board is connected with the node address, otherwise the routes.
+ */
+const t_bidib_board_routes *bidib_state_index_get_routes(t_bidib_node_address node_address);
+
+/**
+ * Returns the routes of a board.
+ * Shall only be called with bidib_boards_rwlock >= read acquired.
+ *
+ * @param board the position of the board in bidib_boards.
+ * @return NULL if the routes were not built, otherwise the routes.
+ */
+const t_bidib_board_routes *bidib_state_index_get_board_routes(size_t board);
+
+/**
+ * Stores the occupancy of some segments of a board. The words are replaced
+ * atomically, so lock-free readers never see a partially applied update.
+ * Shall only be called with the shard lock of the board acquired.
+ *
+ * @param routes the routes of the board.
+ * @param mask the BM numbers that are stored, one bit per number.
+ * @param occupied the occupancy of the stored BM numbers, one bit per number.
+ */
+void bidib_state_index_store_occupancy(const t_bidib_board_routes *routes,
+                                       const uint64_t mask[BIDIB_BOARD_OCCUPANCY_WORDS],
+                                       const uint64_t occupied[BIDIB_BOARD_OCCUPANCY_WORDS]);
+
+/**
+ * Marks the segments of all boards as free.
+ * Shall only be called with the shard locks of all boards acquired.
+ */
+void bidib_state_index_clear_occupancy(void);
+
+/**
+ * Returns the shard lock of a segment state. The segment states do not move
+ * once the routes are built, so the lock can be looked up without a lock.
+ *
+ * @param segment_state the segment state.
+ * @return NULL if the routes were not built or no board maps the segment,
+ * otherwise the shard lock of the board that maps the segment.
+ */
+pthread_mutex_t *bidib_state_index_segment_lock(
+		const t_bidib_segment_state_intern *segment_state);
+
+/**
+ * Acquires the shard locks of the segment states of all boards, in the
+ * documented lock order.
+ */
+void bidib_state_index_lock_segment_shards(void);
+
+/**
+ * Releases the shard locks acquired by bidib_state_index_lock_segment_shards.
+ */
+void bidib_state_index_unlock_segment_shards(void);
+
+/**
+ * Returns the route of a peripheral port of a board.
+ * Shall only be called with bidib_boards_rwlock >= read acquired.
+ *
+ * @param routes the routes of the board.
+ * @param port the port.
+ * @return NULL if the port is not mapped, otherwise the route.
+ */
+const t_bidib_route_entry *bidib_state_index_route_peripheral(
+		const t_bidib_board_routes *routes, t_bidib_peripheral_port port);
+
+/**
+ * Adds a train to the index of the train DCC addresses. If the address is
+ * already indexed, the existing entry is kept.
+ * Shall only be called with bidib_trains_rwlock write acquired.
+ *
+ * @param dcc_address the DCC address of the train.
+ * @param position the position of the train in bidib_trains.
+ */
+void bidib_state_index_insert_train(t_bidib_dcc_address dcc_address, size_t position);
+
+/**
+ * Looks up the train with a DCC address, ignoring the orientation bits.
+ * Shall only be called with bidib_trains_rwlock >= read acquired.
+ *
+ * @param dcc_address the DCC address.
+ * @param position the position of the train in bidib_trains (out-parameter).
+ * @return true if a train has the DCC address, otherwise false.
+ */
+bool bidib_state_index_lookup_train(t_bidib_dcc_address dcc_address, size_t *position);
+
+/**
+ * Adds a segment to the segment sets of all the DCC addresses it detects. Has to
+ * be called after DCC addresses were added to the segment state.
+ * Shall only be called with trackstate_segments_mutex acquired.
+ *
+ * @param segment_state the segment state, an element of bidib_track_state.segments.
+ */
+void bidib_state_index_link_segment(const t_bidib_segment_state_intern *segment_state);
+
+/**
+ * Removes a segment from the segment sets of all the DCC addresses it detects.
+ * Has to be called before DCC addresses are removed from the segment state.
+ * Shall only be called with trackstate_segments_mutex acquired.
+ *
+ * @param segment_state the segment state, an element of bidib_track_state.segments.
+ */
+void bidib_state_index_unlink_segment(const t_bidib_segment_state_intern *segment_state);
+
+/**
+ * Returns the positions of the segments that detect a DCC address, in ascending
+ * order. The orientation bits of the address are ignored.
+ * Shall only be called with trackstate_segments_mutex acquired.
+ *
+ * @param dcc_address the DCC address.
+ * @return NULL or an empty array if no segment detects the address, otherwise
+ * the positions in bidib_track_state.segments. Must not be modified or freed.
+ */
+const GArray *bidib_state_index_get_address_segments(t_bidib_dcc_address dcc_address);
+
+/**
+ * Stamps an entry of a state array with the next change sequence number and
+ * marks its category as changed.
+ * Shall only be called with the lock of the indexed array acquired, after the
+ * modification.
+ *
+ * @param index the index of the state array, one of the non-mapping indexes of
+ * bidib_track_state.
+ * @param entry the modified entry, an element of the state array.
+ */
+void bidib_state_stamp(t_bidib_state_index index, const void *entry);
+
+/**
+ * Stamps all entries of a state array with the next change sequence number.
+ * Shall only be called with the lock of the indexed array acquired, after the
+ * modification.
+ *
+ * @param index the index of the state array.
+ */
+void bidib_state_stamp_all(t_bidib_state_index index);
+
+/**
+ * Returns the change sequence number an entry of a state array was last
+ * stamped with.
+ * Shall only be called with the lock of the indexed array acquired.
+ *
+ * @param index the index of the state array.
+ * @param position the position of the entry in the state array.
+ * @return the change sequence number, 0 if the entry was never stamped.
+ */
+uint64_t bidib_state_get_stamp(t_bidib_state_index index, size_t position);
+
+/**
+ * Returns the change sequence number an entry of a state array was last
+ * stamped with.
+ * Shall only be called with the lock of the indexed array acquired.
+ *
+ * @param index the index of the state array.
+ * @param entry the entry, an element of the state array.
+ * @return the change sequence number, 0 if the entry was never stamped.
+ */
+uint64_t bidib_state_get_entry_stamp(t_bidib_state_index index, const void *entry);
+
+/**
+ * Sets the receive time of the packet whose messages the calling thread handles.
+ * Entries stamped by the thread afterwards record it as their receive time.
+ *
+ * @param time_ns the CLOCK_MONOTONIC time in ns at which the packet was received,
+ * 0 once the messages of the packet are handled.
+ */
+void bidib_state_set_receive_time(uint64_t time_ns);
+
+/**
+ * Returns the receive time of the packet that last updated an entry of a state
+ * array.
+ * Shall only be called with the lock of the indexed array acquired.
+ *
+ * @param index the index of the state array.
+ * @param entry the entry, an element of the state array.
+ * @return the CLOCK_MONOTONIC time in ns, 0 if no received message updated the
+ * entry.
+ */
+uint64_t bidib_state_get_receive_time(t_bidib_state_index index, const void *entry);
+
+/**
+ * Adds the memory held by a state array, i.e. its entries and their change
+ * stamps and receive times.
+ * Shall only be called with the lock of the indexed array acquired.
+ *
+ * @param index the index of the state array.
+ * @param bytes the byte count to which the bytes of the array are added.
+ * @param objects the object count to which the entries of the array are added.
+ */
+void bidib_state_changes_measure(t_bidib_state_index index, size_t *bytes, size_t *objects);
+
+/**
+ * Returns the last change sequence number that was handed out.
+ *
+ * @return the change sequence number.
+ */
+uint64_t bidib_state_get_change_seq(void);
+
+/**
+ * Blocks until the change sequence number differs from seq, the deadline passed,
+ * or the waiters are woken up. Callers have to re-check their condition, the
+ * wait may also end spuriously.
+ * Shall not be called with any trackstate mutex acquired.
+ *
+ * @param seq the change sequence number the caller has seen.
+ * @param deadline the absolute deadline on CLOCK_MONOTONIC.
+ * @return the current change sequence number.
+ */
+uint64_t bidib_state_wait_change(uint64_t seq, const struct timespec *deadline);
+
+/**
+ * Wakes up all threads blocked in bidib_state_wait_change, e.g. when the
+ * library is stopped.
+ */
+void bidib_state_changes_wake_all(void);
+
+/**
+ * Sets a file descriptor that a byte is written to when the change sequence
+ * number moves on, so that a thread can wait for changes in poll together with
+ * other file descriptors. After the first byte, no further bytes are written
+ * until bidib_state_changes_rearm_wake is called.
+ *
+ * @param fd the non-blocking write end of a pipe, -1 to write to none.
+ */
+void bidib_state_changes_set_wake_fd(int fd);
+
+/**
+ * Allows the next change to write to the wake file descriptor again. Has to be
+ * called before the change sequence number is read, so that no change is missed.
+ */
+void bidib_state_changes_rearm_wake(void);
+
+/**
+ * Allocates the change stamps and receive times of all state arrays. Has to be
+ * called after the configs are parsed, before any entry is stamped.
+ */
+void bidib_state_changes_init(void);
+
+/**
+ * Frees the change stamps. The change sequence number is kept, so that it keeps
+ * increasing if the library is started again.
+ */
+void bidib_state_changes_free(void);
+
+/**
+ * Records that a category of the track state was modified, so that the next
+ * published snapshot contains a fresh copy of it.
+ * Shall only be called with the trackstate mutex of the category acquired,
+ * after the modification.
+ *
+ * @param category the modified category.
+ */
+void bidib_state_mark_changed(t_bidib_state_category category);
+
+/**
+ * Publishes a new snapshot of the track state if the state was modified since
+ * the last snapshot. Only the modified categories are copied, the others are
+ * shared with the previous snapshot. The previous snapshot is retired, it is
+ * freed as soon as the last reader released it.
+ * Shall not be called with any trackstate mutex acquired.
+ */
+void bidib_state_snapshot_publish(void);
+
+/**
+ * Retires the current snapshot.
+ */
+void bidib_state_snapshot_free(void);
+
 /**
  * Queries the occupancy states of all segments.
  */
 void bidib_state_query_occupancy(void);
 
+/**
+ * Queries the states of the board accessories and peripherals of all connected
+ * boards, e.g. to verify the states restored from the state file.
+ * Shall only be called with bidib_boards_rwlock >= read acquired.
+ */
+void bidib_state_query_accessories(void);
+
 /**
  * Converts a booster power state to a simple booster power state.
  *
@@ -243,10 +665,32 @@ t_bidib_bm_confidence_level bidib_bm_confidence_to_level(t_bidib_segment_state_c
  */
 void bidib_state_set_board_features(void);
 
+/**
+ * Returns whether the state of a board point, board signal or peripheral was
+ * reported with its initial value after a change sequence number, so that the
+ * initial value does not have to be sent again.
+ *
+ * @param index BIDIB_STATE_INDEX_POINTS_BOARD, BIDIB_STATE_INDEX_SIGNALS_BOARD
+ * or BIDIB_STATE_INDEX_PERIPHERALS.
+ * @param value the initial value.
+ * @param reported_after the change sequence number after which the state must
+ * have been reported.
+ * @return whether the state was reported with the initial value.
+ */
+bool bidib_state_initial_value_reached(t_bidib_state_index index,
+                                       const t_bidib_state_initial_value *value,
+                                       uint64_t reported_after);
+
 /**
  * Sets the initial values for all accessories and peripherals.
+ *
+ * @param skip_reached whether the board points, board signals and peripherals
+ * whose state was reported with the initial value are skipped.
+ * @param reported_after the change sequence number after which the skipped
+ * states must have been reported, so that states restored from the state file
+ * do not count.
  */
-void bidib_state_set_initial_values(void);
+void bidib_state_set_initial_values(bool skip_reached, uint64_t reported_after);
 
 /**
  * Resets the track state to default/initial values.
@@ -258,6 +702,214 @@ void bidib_state_reset(void);
  */
 void bidib_state_free(void);
 
+/**
+ * Measures the memory held by the track state.
+ * Shall not be called with any trackstate mutex acquired.
+ *
+ * @param bytes the bytes of the state arrays and their nested arrays.
+ * @param objects the entries of the state arrays.
+ */
+void bidib_state_measure(size_t *bytes, size_t *objects);
+
+/**
+ * Measures the memory held by the arrays of the configs, i.e. the boards, their
+ * mappings and aspects, the trains and the initial values. Their ids are
+ * accounted by the arena.
+ * Shall not be called with bidib_trains_rwlock or bidib_boards_rwlock acquired.
+ *
+ * @param bytes the bytes of the arrays.
+ * @param objects the arrays.
+ */
+void bidib_state_measure_config(size_t *bytes, size_t *objects);
+
+/**
+ * Allocates memory for configuration-derived data that stays unchanged until
+ * bidib_state_free. The memory must not be freed individually.
+ *
+ * @param size the number of bytes to allocate.
+ * @return the allocated memory, suitably aligned for any type, or NULL.
+ */
+void *bidib_state_arena_alloc(size_t size);
+
+/**
+ * Copies a string into the configuration arena.
+ *
+ * @param string the string to copy.
+ * @return the copy, or NULL if string is NULL or allocation failed.
+ */
+char *bidib_state_arena_strdup(const char *string);
+
+/**
+ * Releases all memory of the configuration arena at once.
+ */
+void bidib_state_arena_free(void);
+
+/**
+ * Sets the path of the state file, see bidib_set_state_file.
+ *
+ * @param path the path of the state file, NULL to use none.
+ */
+void bidib_state_persist_set_path(const char *path);
+
+/**
+ * Opens and maps the state file, if a path is set. If the file was not written
+ * for the current configs, its stored states are discarded. Has to be called
+ * after the configs are parsed.
+ */
+void bidib_state_persist_open(void);
+
+/**
+ * Stores the state of a board point, board signal or peripheral in the state file.
+ * Shall only be called with the lock of the state array acquired.
+ *
+ * @param index BIDIB_STATE_INDEX_POINTS_BOARD, BIDIB_STATE_INDEX_SIGNALS_BOARD or
+ * BIDIB_STATE_INDEX_PERIPHERALS, other indexes are ignored.
+ * @param entry the state, an element of the state array.
+ * @param confirmed whether the board reported that the state has the aspect value.
+ * @param value the aspect value.
+ */
+void bidib_state_persist_store(t_bidib_state_index index, const void *entry,
+                               bool confirmed, uint8_t value);
+
+/**
+ * Pre-populates the board point, board signal and peripheral states with the
+ * states stored in the state file. Restored accessory states are marked as
+ * reached, but not verified.
+ *
+ * @return true if the state file was written for the current configs, otherwise
+ * false.
+ */
+bool bidib_state_persist_restore(void);
+
+/**
+ * Writes the state file back and unmaps it.
+ */
+void bidib_state_persist_close(void);
+
+/**
+ * Sets the name of the shared memory object the track state is exported to.
+ *
+ * @param name the name of the shared memory object, NULL to export nothing.
+ */
+void bidib_state_export_set_name(const char *name);
+
+/**
+ * Creates and maps the shared memory object of the export, if a name is set,
+ * and publishes the first image. Has to be called after the configs are parsed.
+ */
+void bidib_state_export_open(void);
+
+/**
+ * Returns whether the track state is exported.
+ *
+ * @return true if the export is open, otherwise false.
+ */
+bool bidib_state_export_enabled(void);
+
+/**
+ * Copies the current track state into the image of the export.
+ * Shall not be called with any trackstate mutex acquired.
+ */
+void bidib_state_export_publish(void);
+
+/**
+ * To be run in a separate thread while the library is running; publishes the
+ * track state whenever it changed.
+ *
+ * @param par unused.
+ * @return NULL.
+ */
+void *bidib_state_export_run(void *par);
+
+/**
+ * Marks the export as closed for its readers, unmaps and removes it.
+ */
+void bidib_state_export_close(void);
+
+// Encodes the track state into images in the layout of the export
+typedef struct t_bidib_state_image_builder t_bidib_state_image_builder;
+
+/**
+ * Creates an image builder for the current configs. Has to be called after the
+ * configs are parsed, the builder caches parts of them.
+ * Shall not be called with bidib_boards_rwlock or bidib_trains_rwlock acquired.
+ *
+ * @return the builder. Must be freed by the caller.
+ */
+t_bidib_state_image_builder *bidib_state_image_builder_new(void);
+
+/**
+ * Returns the layout of the images of a builder.
+ *
+ * @param builder the builder.
+ * @return the header, of which the counts, ids_offset, image_offset, image_size
+ * and size are set.
+ */
+const t_bidib_export_header *bidib_state_image_builder_header(
+		const t_bidib_state_image_builder *builder);
+
+/**
+ * Encodes the current track state into an image.
+ * Shall not be called with any trackstate mutex acquired.
+ *
+ * @param builder the builder.
+ * @param data the image, aligned to 8 bytes, of the image_size of the header.
+ * @return the change sequence number of the encoded state.
+ */
+uint64_t bidib_state_image_build(const t_bidib_state_image_builder *builder, void *data);
+
+/**
+ * Frees an image builder.
+ *
+ * @param builder the builder, may be NULL.
+ */
+void bidib_state_image_builder_free(t_bidib_state_image_builder *builder);
+
+/**
+ * Returns the id of an entry of an image. The ids stay valid until the configs
+ * are freed.
+ *
+ * @param kind the kind of the entry.
+ * @param position the position of the entry in the image.
+ * @return the id, or NULL if there is no such entry.
+ */
+const char *bidib_state_image_id(t_bidib_export_kind kind, size_t position);
+
+/**
+ * Sets the path of the Unix domain socket of the state server.
+ *
+ * @param path the path of the socket, NULL to serve no clients.
+ */
+void bidib_state_server_set_path(const char *path);
+
+/**
+ * Creates the listening socket of the state server, if a path is set, and
+ * encodes the first image. Has to be called after the configs are parsed.
+ */
+void bidib_state_server_open(void);
+
+/**
+ * Returns whether the state server is listening.
+ *
+ * @return true if the server is open, otherwise false.
+ */
+bool bidib_state_server_enabled(void);
+
+/**
+ * To be run in a separate thread while the library is running; accepts clients,
+ * sends them a snapshot of the track state and then the changes of the state.
+ *
+ * @param par unused.
+ * @return NULL.
+ */
+void *bidib_state_server_run(void *par);
+
+/**
+ * Disconnects all clients, closes and removes the socket of the state server.
+ * Shall only be called when bidib_state_server_run is not running.
+ */
+void bidib_state_server_close(void);
+
 /**
  * Checks whether two unique ids are equal.
  *
@@ -468,11 +1120,15 @@ void bidib_state_add_initial_peripheral_value(t_bidib_state_initial_value value)
 void bidib_state_add_initial_train_value(t_bidib_state_train_initial_value value);
 
 /**
- * Updates the available state for all trains.
+ * Updates the available state of the trains whose DCC addresses were added to or
+ * removed from segments. The other trains are not affected by the change.
  * Shall only be called with bidib_trains_rwlock >= read acquired,
  * and with trackstate_segments_mutex and trackstate_trains_mutex acquired.
+ *
+ * @param dcc_addresses the changed DCC addresses (t_bidib_dcc_address), may
+ * contain duplicates.
  */
-void bidib_state_update_train_available(void);
+void bidib_state_update_train_available(const GArray *dcc_addresses);
 
 /**
  * Frees the memory allocated by a train.
@@ -495,20 +1151,6 @@ void bidib_state_free_single_train_state(t_bidib_train_state train_state);
  */
 void bidib_state_free_single_train_state_intern(t_bidib_train_state_intern train_state);
 
-/**
- * Frees the memory allocated by a initial value.
- *
- * @param value the initial value.
- */
-void bidib_state_free_single_initial_value(t_bidib_state_initial_value value);
-
-/**
- * Frees the memory allocated by a initial train value.
- *
- * @param value the initial train value.
- */
-void bidib_state_free_single_train_initial_value(t_bidib_state_train_initial_value value);
-
 /**
  * Resets the parameters for all trains, e.g. speed and peripherals.
  */
@@ -0,0 +1,312 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <glib.h>
+
+#include "bidib_state_intern.h"
+#include "bidib_state_getter_intern.h"
+#include "../../include/highlevel/bidib_highlevel_util.h"
+
+
+// "BIDIBWS1" read as a little endian number
+#define BIDIB_STATE_PERSIST_MAGIC 0x3153574249444942ULL
+#define BIDIB_STATE_PERSIST_KNOWN 0x0100
+
+// The state file holds one slot per board point, board signal and peripheral state,
+// in the order of the state arrays. A slot is 0 if the state is unknown, otherwise
+// BIDIB_STATE_PERSIST_KNOWN | the last confirmed aspect value. The slots are only
+// valid for the configs the hash was computed from.
+typedef struct {
+	uint64_t magic;
+	uint64_t config_hash;
+	uint32_t slot_count;
+	uint32_t reserved;
+	uint16_t slots[];
+} t_bidib_state_persist_file;
+
+static char *persist_path = NULL;
+static t_bidib_state_persist_file *persist_file = NULL;
+static size_t persist_file_size = 0;
+// Whether the slots of the opened file were written for the current configs
+static bool persist_file_valid = false;
+
+
+void bidib_state_persist_set_path(const char *path) {
+	free(persist_path);
+	persist_path = path != NULL ? strdup(path) : NULL;
+}
+
+static uint64_t bidib_state_persist_hash(uint64_t hash, const void *data, size_t len) {
+	// FNV-1a
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static uint64_t bidib_state_persist_hash_string(uint64_t hash, const char *str) {
+	// Including the terminator keeps "ab" + "c" apart from "a" + "bc"
+	return bidib_state_persist_hash(hash, str, strlen(str) + 1);
+}
+
+static uint64_t bidib_state_persist_hash_aspects(uint64_t hash, const GArray *aspects) {
+	for (size_t i = 0; i < aspects->len; i++) {
+		const t_bidib_aspect *aspect = &g_array_index(aspects, t_bidib_aspect, i);
+		hash = bidib_state_persist_hash_string(hash, aspect->id);
+		hash = bidib_state_persist_hash(hash, &aspect->value, sizeof(aspect->value));
+	}
+	return hash;
+}
+
+static uint64_t bidib_state_persist_config_hash(void) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < bidib_boards->len; i++) {
+		const t_bidib_board *board = &g_array_index(bidib_boards, t_bidib_board, i);
+		hash = bidib_state_persist_hash_string(hash, board->id);
+		hash = bidib_state_persist_hash(hash, &board->unique_id, sizeof(board->unique_id));
+		const GArray *accessories[] = {board->points_board, board->signals_board};
+		for (size_t j = 0; j < 2; j++) {
+			for (size_t k = 0; k < accessories[j]->len; k++) {
+				const t_bidib_board_accessory_mapping *mapping =
+						&g_array_index(accessories[j], t_bidib_board_accessory_mapping, k);
+				hash = bidib_state_persist_hash_string(hash, mapping->id);
+				hash = bidib_state_persist_hash(hash, &mapping->number, sizeof(mapping->number));
+				hash = bidib_state_persist_hash_aspects(hash, mapping->aspects);
+			}
+		}
+		for (size_t j = 0; j < board->peripherals->len; j++) {
+			const t_bidib_peripheral_mapping *mapping =
+					&g_array_index(board->peripherals, t_bidib_peripheral_mapping, j);
+			hash = bidib_state_persist_hash_string(hash, mapping->id);
+			hash = bidib_state_persist_hash(hash, &mapping->port, sizeof(mapping->port));
+			hash = bidib_state_persist_hash_aspects(hash, mapping->aspects);
+		}
+	}
+	// The order of the states determines the slots
+	for (size_t i = 0; i < bidib_track_state.points_board->len; i++) {
+		hash = bidib_state_persist_hash_string(hash, g_array_index(
+				bidib_track_state.points_board, t_bidib_board_accessory_state, i).id);
+	}
+	for (size_t i = 0; i < bidib_track_state.signals_board->len; i++) {
+		hash = bidib_state_persist_hash_string(hash, g_array_index(
+				bidib_track_state.signals_board, t_bidib_board_accessory_state, i).id);
+	}
+	for (size_t i = 0; i < bidib_track_state.peripherals->len; i++) {
+		hash = bidib_state_persist_hash_string(hash, g_array_index(
+				bidib_track_state.peripherals, t_bidib_peripheral_state, i).id);
+	}
+	return hash;
+}
+
+void bidib_state_persist_open(void) {
+	if (persist_path == NULL || persist_file != NULL) {
+		return;
+	}
+	const size_t slot_count = bidib_track_state.points_board->len +
+	                          bidib_track_state.signals_board->len +
+	                          bidib_track_state.peripherals->len;
+	const size_t size = sizeof(t_bidib_state_persist_file) + slot_count * sizeof(uint16_t);
+	const uint64_t config_hash = bidib_state_persist_config_hash();
+
+	int fd = open(persist_path, O_RDWR | O_CREAT, 0644);
+	if (fd == -1) {
+		syslog_libbidib(LOG_ERR, "State file %s could not be opened", persist_path);
+		return;
+	}
+	off_t old_size = lseek(fd, 0, SEEK_END);
+	if (old_size != (off_t) size && ftruncate(fd, (off_t) size) != 0) {
+		syslog_libbidib(LOG_ERR, "State file %s could not be resized", persist_path);
+		close(fd);
+		return;
+	}
+	void *mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	// The mapping stays valid after the file is closed
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		syslog_libbidib(LOG_ERR, "State file %s could not be mapped", persist_path);
+		return;
+	}
+	persist_file = mapped;
+	persist_file_size = size;
+	persist_file_valid = old_size == (off_t) size &&
+	                     persist_file->magic == BIDIB_STATE_PERSIST_MAGIC &&
+	                     persist_file->config_hash == config_hash &&
+	                     persist_file->slot_count == slot_count;
+	if (!persist_file_valid) {
+		syslog_libbidib(LOG_NOTICE, "State file %s does not match the configs, "
+		                "starting without the stored states", persist_path);
+		memset(persist_file->slots, 0, slot_count * sizeof(uint16_t));
+		persist_file->config_hash = config_hash;
+		persist_file->slot_count = (uint32_t) slot_count;
+		persist_file->reserved = 0;
+		persist_file->magic = BIDIB_STATE_PERSIST_MAGIC;
+	}
+}
+
+static size_t bidib_state_persist_slot(t_bidib_state_index index, const void *entry,
+                                       const GArray **array) {
+	size_t first_slot = 0;
+	size_t elem_size = sizeof(t_bidib_board_accessory_state);
+	switch (index) {
+		case BIDIB_STATE_INDEX_POINTS_BOARD:
+			*array = bidib_track_state.points_board;
+			break;
+		case BIDIB_STATE_INDEX_SIGNALS_BOARD:
+			*array = bidib_track_state.signals_board;
+			first_slot = bidib_track_state.points_board->len;
+			break;
+		case BIDIB_STATE_INDEX_PERIPHERALS:
+			*array = bidib_track_state.peripherals;
+			first_slot = bidib_track_state.points_board->len +
+			             bidib_track_state.signals_board->len;
+			elem_size = sizeof(t_bidib_peripheral_state);
+			break;
+		default:
+			*array = NULL;
+			return 0;
+	}
+	return first_slot + (size_t) ((const gchar *) entry - (*array)->data) / elem_size;
+}
+
+void bidib_state_persist_store(t_bidib_state_index index, const void *entry,
+                               bool confirmed, uint8_t value) {
+	if (persist_file == NULL) {
+		return;
+	}
+	const GArray *array;
+	const size_t slot = bidib_state_persist_slot(index, entry, &array);
+	if (array != NULL && slot < persist_file->slot_count) {
+		persist_file->slots[slot] = confirmed ? (uint16_t) (BIDIB_STATE_PERSIST_KNOWN | value) : 0;
+	}
+}
+
+static bool bidib_state_persist_restore_aspect(const GArray *aspects, uint16_t slot,
+                                               char **state_id, uint8_t *state_value) {
+	if (!(slot & BIDIB_STATE_PERSIST_KNOWN)) {
+		return false;
+	}
+	const uint8_t value = (uint8_t) slot;
+	for (size_t i = 0; i < aspects->len; i++) {
+		const t_bidib_aspect *aspect = &g_array_index(aspects, t_bidib_aspect, i);
+		if (aspect->value == value) {
+			*state_id = (char *) aspect->id;
+			*state_value = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+static size_t bidib_state_persist_restore_accessories(GArray *states, bool point,
+                                                      size_t first_slot) {
+	size_t restored = 0;
+	for (size_t i = 0; i < states->len; i++) {
+		t_bidib_board_accessory_state *state =
+				&g_array_index(states, t_bidib_board_accessory_state, i);
+		const t_bidib_board_accessory_mapping *mapping =
+				bidib_state_get_board_accessory_mapping_ref(state->id, point);
+		if (mapping != NULL &&
+		    bidib_state_persist_restore_aspect(mapping->aspects,
+		                                       persist_file->slots[first_slot + i],
+		                                       &state->data.state_id,
+		                                       &state->data.state_value)) {
+			// Restored states are not verified by the board yet, their change stamp
+			// is older than any report after the restore
+			state->data.execution_state = BIDIB_EXEC_STATE_REACHED;
+			state->data.wait_details = 0x00;
+			bidib_state_stamp(point ? BIDIB_STATE_INDEX_POINTS_BOARD
+			                        : BIDIB_STATE_INDEX_SIGNALS_BOARD, state);
+			restored++;
+		}
+	}
+	return restored;
+}
+
+bool bidib_state_persist_restore(void) {
+	if (persist_file == NULL || !persist_file_valid) {
+		return false;
+	}
+	size_t restored = 0;
+	// For bidib_track_state.points_board and bidib_track_state.signals_board (devnote: write)
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	// For bidib_state_get_board_accessory_mapping_ref
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+	restored += bidib_state_persist_restore_accessories(bidib_track_state.points_board,
+	                                                    true, 0);
+	restored += bidib_state_persist_restore_accessories(bidib_track_state.signals_board,
+	                                                    false,
+	                                                    bidib_track_state.points_board->len);
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+
+	// For bidib_track_state.peripherals (devnote: write)
+	pthread_mutex_lock(&trackstate_peripherals_mutex);
+	// For bidib_state_get_peripheral_mapping_ref
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+	const size_t first_slot = bidib_track_state.points_board->len +
+	                          bidib_track_state.signals_board->len;
+	for (size_t i = 0; i < bidib_track_state.peripherals->len; i++) {
+		t_bidib_peripheral_state *state =
+				&g_array_index(bidib_track_state.peripherals, t_bidib_peripheral_state, i);
+		const t_bidib_peripheral_mapping *mapping =
+				bidib_state_get_peripheral_mapping_ref(state->id);
+		if (mapping != NULL &&
+		    bidib_state_persist_restore_aspect(mapping->aspects,
+		                                       persist_file->slots[first_slot + i],
+		                                       &state->data.state_id,
+		                                       &state->data.state_value)) {
+			bidib_state_stamp(BIDIB_STATE_INDEX_PERIPHERALS, state);
+			restored++;
+		}
+	}
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	pthread_mutex_unlock(&trackstate_peripherals_mutex);
+
+	syslog_libbidib(LOG_NOTICE, "Restored %zu states from state file %s",
+	                restored, persist_path);
+	return true;
+}
+
+void bidib_state_persist_close(void) {
+	if (persist_file != NULL) {
+		msync(persist_file, persist_file_size, MS_SYNC);
+		munmap(persist_file, persist_file_size);
+		persist_file = NULL;
+		persist_file_size = 0;
+		persist_file_valid = false;
+	}
+}
@@ -0,0 +1,436 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <glib.h>
+
+#include "bidib_state_intern.h"
+#include "../transmission/bidib_transmission_intern.h"
+#include "../../include/highlevel/bidib_highlevel_server.h"
+#include "../../include/highlevel/bidib_highlevel_util.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+
+// How long the server waits for its clients or a change before it checks
+// whether the library is still running
+#define BIDIB_STATE_SERVER_WAIT_MS 100
+#define BIDIB_STATE_SERVER_BACKLOG 64
+// Send buffer of the client sockets. Kept small, so that changes for a slow
+// client are coalesced by the server instead of queued in the socket.
+#define BIDIB_STATE_SERVER_SEND_BUFFER 16384
+// Largest payload of an entry record, t_bidib_export_train and t_bidib_export_booster
+#define BIDIB_STATE_SERVER_ENTRY_MAX 16
+
+typedef struct {
+	int fd;
+	GArray *pending;      // Records (uint8_t) the socket did not accept yet
+	size_t sent;          // Bytes of pending that were already sent
+	bool synced;          // Whether the snapshot was encoded
+	uint64_t seq;         // Change sequence number of the last encoded state
+} t_bidib_state_server_client;
+
+static const t_bidib_export_kind server_kinds[] = {
+	BIDIB_EXPORT_SEGMENTS, BIDIB_EXPORT_POINTS, BIDIB_EXPORT_SIGNALS,
+	BIDIB_EXPORT_TRAINS, BIDIB_EXPORT_BOOSTERS
+};
+
+static char *server_path = NULL;
+static int server_fd = -1;
+// Pipe that the setters write to on changes, see bidib_state_changes_set_wake_fd
+static int server_wake[2] = {-1, -1};
+static t_bidib_state_image_builder *server_builder = NULL;
+// The latest image and the one before, the entries that differ changed
+static uint64_t *server_image = NULL;
+static uint64_t *server_previous = NULL;
+static uint64_t server_image_seq = 0;
+// Change sequence number of the image in which each entry last changed, in the
+// order of the entries in the image
+static uint64_t *server_versions = NULL;
+static size_t server_entry_count = 0;
+static GArray *server_clients = NULL;
+
+
+void bidib_state_server_set_path(const char *path) {
+	free(server_path);
+	server_path = path != NULL ? strdup(path) : NULL;
+}
+
+bool bidib_state_server_enabled(void) {
+	return server_fd != -1;
+}
+
+static size_t bidib_state_server_count(const t_bidib_export_header *header,
+                                       t_bidib_export_kind kind) {
+	switch (kind) {
+		case BIDIB_EXPORT_SEGMENTS:
+			return header->segment_count;
+		case BIDIB_EXPORT_POINTS:
+			return header->point_count;
+		case BIDIB_EXPORT_SIGNALS:
+			return header->signal_count;
+		case BIDIB_EXPORT_TRAINS:
+			return header->train_count;
+		case BIDIB_EXPORT_BOOSTERS:
+			return header->booster_count;
+		default:
+			return 0;
+	}
+}
+
+// Writes the payload of an entry record, returns its size
+static uint16_t bidib_state_server_entry(const t_bidib_export_image *image,
+                                         t_bidib_export_kind kind, size_t position,
+                                         uint8_t *payload) {
+	switch (kind) {
+		case BIDIB_EXPORT_SEGMENTS:
+			payload[0] = (uint8_t) ((image->occupied[position / 64] >> (position % 64)) & 0x01);
+			return 1;
+		case BIDIB_EXPORT_POINTS:
+			memcpy(payload, &image->points[position], sizeof(t_bidib_export_accessory));
+			return sizeof(t_bidib_export_accessory);
+		case BIDIB_EXPORT_SIGNALS:
+			memcpy(payload, &image->signals[position], sizeof(t_bidib_export_accessory));
+			return sizeof(t_bidib_export_accessory);
+		case BIDIB_EXPORT_TRAINS:
+			memcpy(payload, &image->trains[position], sizeof(t_bidib_export_train));
+			return sizeof(t_bidib_export_train);
+		case BIDIB_EXPORT_BOOSTERS:
+			memcpy(payload, &image->boosters[position], sizeof(t_bidib_export_booster));
+			return sizeof(t_bidib_export_booster);
+		default:
+			return 0;
+	}
+}
+
+static void bidib_state_server_append(GArray *pending, t_bidib_server_record_type type,
+                                      t_bidib_export_kind kind, size_t position,
+                                      const void *payload, uint16_t size) {
+	const t_bidib_server_record record = {
+		(uint8_t) type, (uint8_t) kind, size, (uint32_t) position
+	};
+	g_array_append_vals(pending, &record, sizeof(record));
+	g_array_append_vals(pending, payload, size);
+}
+
+// Encodes the entries of the latest image that changed after seq, or all
+// entries with their ids if the client has no snapshot yet
+static void bidib_state_server_encode(t_bidib_state_server_client *client) {
+	const t_bidib_export_header *const header = bidib_state_image_builder_header(server_builder);
+	t_bidib_export_image image;
+	bidib_export_locate(header, server_image, &image);
+	if (!client->synced) {
+		const t_bidib_server_hello hello = {
+			BIDIB_SERVER_VERSION, header->segment_count, header->point_count,
+			header->signal_count, header->train_count, header->booster_count
+		};
+		bidib_state_server_append(client->pending, BIDIB_SERVER_HELLO, 0, 0,
+		                          &hello, sizeof(hello));
+		for (size_t i = 0; i < sizeof(server_kinds) / sizeof(server_kinds[0]); i++) {
+			const size_t count = bidib_state_server_count(header, server_kinds[i]);
+			for (size_t j = 0; j < count; j++) {
+				const char *id = bidib_state_image_id(server_kinds[i], j);
+				bidib_state_server_append(client->pending, BIDIB_SERVER_ID, server_kinds[i],
+				                          j, id, (uint16_t) (strlen(id) + 1));
+			}
+		}
+	}
+	bool changed = false;
+	size_t index = 0;
+	uint8_t payload[BIDIB_STATE_SERVER_ENTRY_MAX];
+	for (size_t i = 0; i < sizeof(server_kinds) / sizeof(server_kinds[0]); i++) {
+		const size_t count = bidib_state_server_count(header, server_kinds[i]);
+		for (size_t j = 0; j < count; j++, index++) {
+			if (client->synced && server_versions[index] <= client->seq) {
+				continue;
+			}
+			const uint16_t size = bidib_state_server_entry(&image, server_kinds[i], j, payload);
+			bidib_state_server_append(client->pending, BIDIB_SERVER_ENTRY, server_kinds[i],
+			                          j, payload, size);
+			changed = true;
+		}
+	}
+	if (changed || !client->synced) {
+		bidib_state_server_append(client->pending, BIDIB_SERVER_SYNC, 0, 0,
+		                          &server_image_seq, sizeof(server_image_seq));
+	}
+	client->synced = true;
+	client->seq = server_image_seq;
+}
+
+// Encodes the current state and records which entries changed
+static void bidib_state_server_refresh(void) {
+	uint64_t *const swap = server_previous;
+	server_previous = server_image;
+	server_image = swap;
+	server_image_seq = bidib_state_image_build(server_builder, server_image);
+
+	const t_bidib_export_header *const header = bidib_state_image_builder_header(server_builder);
+	t_bidib_export_image image, previous;
+	bidib_export_locate(header, server_image, &image);
+	bidib_export_locate(header, server_previous, &previous);
+	size_t index = 0;
+	uint8_t payload[BIDIB_STATE_SERVER_ENTRY_MAX];
+	uint8_t previous_payload[BIDIB_STATE_SERVER_ENTRY_MAX];
+	for (size_t i = 0; i < sizeof(server_kinds) / sizeof(server_kinds[0]); i++) {
+		const size_t count = bidib_state_server_count(header, server_kinds[i]);
+		for (size_t j = 0; j < count; j++, index++) {
+			const uint16_t size = bidib_state_server_entry(&image, server_kinds[i], j, payload);
+			bidib_state_server_entry(&previous, server_kinds[i], j, previous_payload);
+			if (memcmp(payload, previous_payload, size) != 0) {
+				server_versions[index] = server_image_seq;
+			}
+		}
+	}
+}
+
+// Sends as much of the pending records as the socket accepts, returns false if
+// the client disconnected
+static bool bidib_state_server_flush(t_bidib_state_server_client *client) {
+	while (client->sent < client->pending->len) {
+		const ssize_t sent = send(client->fd, (const uint8_t *) client->pending->data + client->sent,
+		                          client->pending->len - client->sent,
+		                          MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (sent > 0) {
+			client->sent += (size_t) sent;
+		} else if (sent == -1 && errno == EINTR) {
+			continue;
+		} else if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return true;
+		} else {
+			return false;
+		}
+	}
+	g_array_set_size(client->pending, 0);
+	client->sent = 0;
+	return true;
+}
+
+static void bidib_state_server_disconnect(size_t position) {
+	t_bidib_state_server_client *const client =
+			&g_array_index(server_clients, t_bidib_state_server_client, position);
+	close(client->fd);
+	g_array_free(client->pending, TRUE);
+	g_array_remove_index_fast(server_clients, position);
+}
+
+static void bidib_state_server_accept(void) {
+	while (true) {
+		const int fd = accept(server_fd, NULL, NULL);
+		if (fd == -1) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				syslog_libbidib(LOG_ERR, "State server could not accept a client: %s",
+				                strerror(errno));
+			}
+			return;
+		}
+		const int send_buffer = BIDIB_STATE_SERVER_SEND_BUFFER;
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &send_buffer, sizeof(send_buffer));
+#ifdef SO_NOSIGPIPE
+		const int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+		const t_bidib_state_server_client client = {
+			fd, g_array_new(FALSE, FALSE, sizeof(uint8_t)), 0, false, 0
+		};
+		g_array_append_val(server_clients, client);
+	}
+}
+
+// Reads and discards anything a client sent, returns false if it disconnected
+static bool bidib_state_server_receive(const t_bidib_state_server_client *client) {
+	uint8_t discarded[64];
+	while (true) {
+		const ssize_t received = recv(client->fd, discarded, sizeof(discarded), MSG_DONTWAIT);
+		if (received > 0) {
+			continue;
+		} else if (received == -1 && errno == EINTR) {
+			continue;
+		}
+		return received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+}
+
+static void bidib_state_server_set_nonblocking(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+void bidib_state_server_open(void) {
+	if (server_path == NULL || server_fd != -1) {
+		return;
+	}
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(server_path) >= sizeof(address.sun_path)) {
+		syslog_libbidib(LOG_ERR, "State server path %s is too long", server_path);
+		return;
+	}
+	strcpy(address.sun_path, server_path);
+	// Removes the socket of a previous run that was not stopped, but nothing else
+	struct stat existing;
+	if (stat(server_path, &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+		unlink(server_path);
+	}
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1 || bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+	    listen(fd, BIDIB_STATE_SERVER_BACKLOG) != 0 || pipe(server_wake) != 0) {
+		syslog_libbidib(LOG_ERR, "State server %s could not be opened: %s",
+		                server_path, strerror(errno));
+		if (fd != -1) {
+			close(fd);
+		}
+		return;
+	}
+	bidib_state_server_set_nonblocking(fd);
+	bidib_state_server_set_nonblocking(server_wake[0]);
+	bidib_state_server_set_nonblocking(server_wake[1]);
+
+	server_builder = bidib_state_image_builder_new();
+	const t_bidib_export_header *const header = bidib_state_image_builder_header(server_builder);
+	server_image = malloc((header->image_size + 7) & ~(size_t) 7);
+	server_previous = malloc((header->image_size + 7) & ~(size_t) 7);
+	server_entry_count = header->segment_count + header->point_count + header->signal_count +
+	                     header->train_count + header->booster_count;
+	server_versions = malloc(sizeof(uint64_t) * server_entry_count);
+	server_clients = g_array_new(FALSE, FALSE, sizeof(t_bidib_state_server_client));
+	bidib_state_changes_set_wake_fd(server_wake[1]);
+	server_image_seq = bidib_state_image_build(server_builder, server_image);
+	for (size_t i = 0; i < server_entry_count; i++) {
+		server_versions[i] = server_image_seq;
+	}
+	server_fd = fd;
+	syslog_libbidib(LOG_NOTICE, "State server listening on %s", server_path);
+}
+
+void *bidib_state_server_run(void *par __attribute__((unused))) {
+	GArray *fds = g_array_new(FALSE, FALSE, sizeof(struct pollfd));
+	while (bidib_running) {
+		g_array_set_size(fds, 0);
+		const struct pollfd wake = {server_wake[0], POLLIN, 0};
+		const struct pollfd listening = {server_fd, POLLIN, 0};
+		g_array_append_val(fds, wake);
+		g_array_append_val(fds, listening);
+		for (size_t i = 0; i < server_clients->len; i++) {
+			const t_bidib_state_server_client *const client =
+					&g_array_index(server_clients, t_bidib_state_server_client, i);
+			// Only wait for space in the socket if there is something to send
+			const struct pollfd polled = {
+				client->fd, (short) (POLLIN | (client->pending->len > 0 ? POLLOUT : 0)), 0
+			};
+			g_array_append_val(fds, polled);
+		}
+		if (poll((struct pollfd *) fds->data, fds->len, BIDIB_STATE_SERVER_WAIT_MS) == -1) {
+			if (errno != EINTR) {
+				syslog_libbidib(LOG_ERR, "State server could not poll: %s", strerror(errno));
+				break;
+			}
+			continue;
+		}
+		const struct pollfd *const polled = (const struct pollfd *) fds->data;
+		if (polled[0].revents & POLLIN) {
+			uint8_t drained[64];
+			while (read(server_wake[0], drained, sizeof(drained)) > 0) {
+			}
+		}
+		// Changes from here on write to the pipe again
+		bidib_state_changes_rearm_wake();
+
+		// Backwards, so that removed clients are replaced by already handled ones
+		for (size_t i = fds->len - 2; i > 0; i--) {
+			const short revents = polled[i + 1].revents;
+			const t_bidib_state_server_client *const client =
+					&g_array_index(server_clients, t_bidib_state_server_client, i - 1);
+			if ((revents & (POLLERR | POLLHUP | POLLNVAL)) ||
+			    ((revents & POLLIN) && !bidib_state_server_receive(client))) {
+				bidib_state_server_disconnect(i - 1);
+			}
+		}
+		if (polled[1].revents & POLLIN) {
+			bidib_state_server_accept();
+		}
+		if (bidib_state_get_change_seq() != server_image_seq) {
+			// All changes since the last image are coalesced into this one
+			bidib_state_server_refresh();
+		}
+		for (size_t i = server_clients->len; i > 0; i--) {
+			t_bidib_state_server_client *const client =
+					&g_array_index(server_clients, t_bidib_state_server_client, i - 1);
+			// A client gets the next changes only once it received the previous ones,
+			// so that the records pending for a slow client do not pile up
+			if (client->pending->len == 0 && (!client->synced || client->seq != server_image_seq)) {
+				bidib_state_server_encode(client);
+			}
+			if (!bidib_state_server_flush(client)) {
+				bidib_state_server_disconnect(i - 1);
+			}
+		}
+	}
+	g_array_free(fds, TRUE);
+	return NULL;
+}
+
+void bidib_state_server_close(void) {
+	if (server_fd == -1) {
+		return;
+	}
+	bidib_state_changes_set_wake_fd(-1);
+	while (server_clients->len > 0) {
+		bidib_state_server_disconnect(server_clients->len - 1);
+	}
+	g_array_free(server_clients, TRUE);
+	server_clients = NULL;
+	close(server_fd);
+	server_fd = -1;
+	unlink(server_path);
+	close(server_wake[0]);
+	close(server_wake[1]);
+	server_wake[0] = -1;
+	server_wake[1] = -1;
+	bidib_state_image_builder_free(server_builder);
+	server_builder = NULL;
+	free(server_image);
+	server_image = NULL;
+	free(server_previous);
+	server_previous = NULL;
+	free(server_versions);
+	server_versions = NULL;
+	server_entry_count = 0;
+}
@@ -54,7 +54,7 @@ void bidib_state_vendor(t_bidib_node_address node_address, uint8_t length,
 			bidib_state_get_reverser_mapping_ref_by_cv(node_address, name);
 	if (mapping != NULL) {
 		t_bidib_reverser_state *reverser_state =
-				bidib_state_get_reverser_state_ref(mapping->id->str);
+				bidib_state_get_reverser_state_ref(mapping->id);
 		if (reverser_state == NULL) {
 			pthread_rwlock_unlock(&bidib_boards_rwlock);
 			pthread_mutex_unlock(&trackstate_reversers_mutex);
@@ -69,10 +69,7 @@ void bidib_state_vendor(t_bidib_node_address node_address, uint8_t length,
 			return;
 		}
 		
-		if (reverser_state->data.state_id != NULL) {
-			free(reverser_state->data.state_id);
-		}
-		reverser_state->data.state_id = strdup(mapping->id->str);
+		reverser_state->data.state_id = (char *) mapping->id;
 		switch (value[0]) {
 			case '0':
 				reverser_state->data.state_value = BIDIB_REV_EXEC_STATE_OFF;
@@ -88,6 +85,7 @@ void bidib_state_vendor(t_bidib_node_address node_address, uint8_t length,
 		                "Feedback for action id %d: Reverser: %s state: %d",
 		                action_id, reverser_state->data.state_id, 
 		                reverser_state->data.state_value);
+		bidib_state_stamp(BIDIB_STATE_INDEX_REVERSERS, reverser_state);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "Feedback for vendor-specific configuration %s (value %s) "
@@ -113,6 +111,7 @@ void bidib_state_boost_state(t_bidib_node_address node_address, uint8_t power_st
 		booster_state->data.power_state = (t_bidib_booster_power_state) power_state;
 		booster_state->data.power_state_simple =
 				bidib_booster_normal_to_simple(booster_state->data.power_state);
+		bidib_state_stamp(BIDIB_STATE_INDEX_BOOSTERS, booster_state);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No booster configured with node address 0x%02x 0x%02x 0x%02x 0x00",
@@ -124,32 +123,30 @@ void bidib_state_boost_state(t_bidib_node_address node_address, uint8_t power_st
 void bidib_state_accessory_state(t_bidib_node_address node_address, uint8_t number,
                                  uint8_t aspect, uint8_t total, uint8_t execution,
                                  uint8_t wait, unsigned int action_id) {
-	// For bidib_state_get_board_accessory_state_ref (devnote: write)
+	// For bidib_state_get_board_accessory_state_ref_by_number (devnote: write)
 	pthread_mutex_lock(&trackstate_accessories_mutex);
-	// For bidib_state_get_board_accessory_mapping_ref_by_number
+	// For bidib_state_get_board_accessory_mapping_ref_by_number and
+	// bidib_state_get_board_accessory_state_ref_by_number
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	bool point;
 	const t_bidib_board_accessory_mapping *const accessory_mapping =
 			bidib_state_get_board_accessory_mapping_ref_by_number(node_address, number, &point);
 	t_bidib_board_accessory_state *accessory_state;
 	if (accessory_mapping != NULL &&
-	    (accessory_state = bidib_state_get_board_accessory_state_ref(accessory_mapping->id->str, point)) != NULL) {
-		if (accessory_state->data.state_id != NULL) {
-			free(accessory_state->data.state_id);
-		}
+	    (accessory_state = bidib_state_get_board_accessory_state_ref_by_number(node_address, number)) != NULL) {
 		accessory_state->data.state_id = NULL;
 		t_bidib_aspect *aspect_mapping = NULL;
 		for (size_t i = 0; i < accessory_mapping->aspects->len; i++) {
 			aspect_mapping = &g_array_index(accessory_mapping->aspects, t_bidib_aspect, i);
 			if (aspect_mapping->value == aspect) {
-				accessory_state->data.state_id = strdup(aspect_mapping->id->str);
+				accessory_state->data.state_id = (char *) aspect_mapping->id;
 				break;
 			}
 		}
 		if (aspect_mapping == NULL) {
 			syslog_libbidib(LOG_ERR,
 			                "bidib_state_accessory_state: aspect mapping for accessory %s is NULL",
-			                accessory_mapping->id->str);
+			                accessory_mapping->id);
 			pthread_rwlock_unlock(&bidib_boards_rwlock);
 			pthread_mutex_unlock(&trackstate_accessories_mutex);
 			return;
@@ -157,22 +154,30 @@ void bidib_state_accessory_state(t_bidib_node_address node_address, uint8_t numb
 		if (accessory_state->data.state_id == NULL) {
 			syslog_libbidib(LOG_WARNING,
 			                "Aspect 0x%02x of accessory %s is not mapped in config files",
-			                aspect, accessory_mapping->id->str);
+			                aspect, accessory_mapping->id);
 		}
 		accessory_state->data.state_value = aspect;
 		accessory_state->data.execution_state = (t_bidib_accessory_execution_state) execution;
 		accessory_state->data.wait_details = wait;
+		bidib_state_stamp(point ? BIDIB_STATE_INDEX_POINTS_BOARD : BIDIB_STATE_INDEX_SIGNALS_BOARD,
+		                  accessory_state);
+		bidib_state_persist_store(point ? BIDIB_STATE_INDEX_POINTS_BOARD
+		                                : BIDIB_STATE_INDEX_SIGNALS_BOARD, accessory_state,
+		                          accessory_state->data.state_id != NULL &&
+		                          (execution & BIDIB_ACC_STATE_ERROR) == 0x00 &&
+		                          (execution & 0x01) == 0x00,
+		                          aspect);
 		if (total < accessory_mapping->aspects->len) {
 			syslog_libbidib(LOG_ERR,
 			                "More aspects configured in track config than on bidib board for accessory %s",
-			                accessory_mapping->id->str);
+			                accessory_mapping->id);
 		}
 		
 		if (execution == BIDIB_ACC_STATE_ERROR) {
 			syslog_libbidib(LOG_ERR, 
 			                "Feedback for action id %d: %s accessory: %s aspect: %s error code: 0x%02x",
-			                action_id, (point) ? "Point" : "Signal", accessory_mapping->id->str, 
-			                aspect_mapping->id->str, wait);
+			                action_id, (point) ? "Point" : "Signal", accessory_mapping->id, 
+			                aspect_mapping->id, wait);
 		} else {
 			const bool target_state_reached = (execution & 0x01) == 0x00;
 			const bool target_state_verified = (execution & 0x02) == 0x00;
@@ -181,8 +186,8 @@ void bidib_state_accessory_state(t_bidib_node_address node_address, uint8_t numb
 			syslog_libbidib(LOG_INFO,
 			                "Feedback for action id %d: %s accessory: %s execution: %s%s reached%s "
 			                "verified with wait time: %.1fs",
-			                action_id, (point) ? "Point" : "Signal", accessory_mapping->id->str,
-			                aspect_mapping->id->str,
+			                action_id, (point) ? "Point" : "Signal", accessory_mapping->id,
+			                aspect_mapping->id,
 			                (target_state_reached) ? "" : " not",
 			                (target_state_verified) ? "" : " not",
 			                wait_time);
@@ -211,6 +216,7 @@ void bidib_state_node_new(t_bidib_node_address node_address, uint8_t local_addr,
 			node_address.subsub = local_addr;
 		}
 		board->node_addr = node_address;
+		bidib_state_index_update_node_routes();
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No board configured for unique id 0x%02x%02x%02x%02x%02x%02x%02x",
@@ -254,6 +260,7 @@ void bidib_state_node_lost(t_bidib_unique_id_mod unique_id) {
 				}
 			}
 		}
+		bidib_state_index_update_node_routes();
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No board configured for unique id 0x%02x%02x%02x%02x%02x%02x%02x",
@@ -273,6 +280,7 @@ void bidib_state_cs_state(t_bidib_node_address node_address, uint8_t state,
 			bidib_state_get_track_output_state_ref_by_nodeaddr(node_address);
 	if (track_output_state != NULL) {
 		track_output_state->cs_state = (t_bidib_cs_state) state;
+		bidib_state_stamp(BIDIB_STATE_INDEX_TRACK_OUTPUTS, track_output_state);
 		syslog_libbidib(LOG_INFO,
 		                "Feedback for action id %d: Track output: %s has state: %s",
 		                action_id, track_output_state->id,
@@ -296,8 +304,9 @@ void bidib_state_cs_drive_ack(t_bidib_dcc_address dcc_address, uint8_t ack, unsi
 			bidib_state_get_train_state_ref_by_dccaddr(dcc_address);
 	if (train_state != NULL) {
 		train_state->ack = (t_bidib_cs_ack) ack;
+		bidib_state_stamp(BIDIB_STATE_INDEX_TRAIN_STATES, train_state);
 		syslog_libbidib(LOG_INFO, "Feedback for action id %d: Train: %s acknowledgement level: %d",
-		                action_id, train_state->id->str, ack);
+		                action_id, train_state->id, ack);
 	} else {
 		syslog_libbidib(LOG_ERR, "No train configured for dcc address 0x%02x%02x",
 		                dcc_address.addrh, dcc_address.addrl);
@@ -318,8 +327,10 @@ void bidib_state_cs_accessory_ack(t_bidib_node_address node_address,
 			bidib_state_get_dcc_accessory_mapping_ref_by_dccaddr(node_address, dcc_address, &point);
 	t_bidib_dcc_accessory_state *accessory_state;
 	if (accessory_mapping != NULL &&
-	    (accessory_state = bidib_state_get_dcc_accessory_state_ref(accessory_mapping->id->str, point)) != NULL) {
+	    (accessory_state = bidib_state_get_dcc_accessory_state_ref(accessory_mapping->id, point)) != NULL) {
 		accessory_state->data.ack = (t_bidib_cs_ack) ack;
+		bidib_state_stamp(point ? BIDIB_STATE_INDEX_POINTS_DCC : BIDIB_STATE_INDEX_SIGNALS_DCC,
+		                  accessory_state);
 	} else {
 		syslog_libbidib(LOG_ERR, "No dcc accessory configured for dcc address 0x%02x%02x",
 		                dcc_address.addrh, dcc_address.addrl);
@@ -402,6 +413,7 @@ void bidib_state_cs_drive(t_bidib_cs_drive_mod params) {
 				}
 			}
 		}
+		bidib_state_stamp(BIDIB_STATE_INDEX_TRAIN_STATES, train_state);
 	} else {
 		syslog_libbidib(LOG_ERR, "No train configured for dcc address 0x%02x%02x",
 		                params.dcc_address.addrh, params.dcc_address.addrl);
@@ -423,7 +435,7 @@ void bidib_state_cs_accessory_manual(t_bidib_node_address node_address,
 	t_bidib_dcc_accessory_state *accessory_state;
 	if (accessory_mapping != NULL &&
 	    (accessory_state =
-				bidib_state_get_dcc_accessory_state_ref(accessory_mapping->id->str, point)) != NULL) {
+				bidib_state_get_dcc_accessory_state_ref(accessory_mapping->id, point)) != NULL) {
 		accessory_state->data.state_value = (uint8_t) (data & 0x1F);
 		if (data & (1 << 5)) {
 			accessory_state->data.coil_on = true;
@@ -431,6 +443,8 @@ void bidib_state_cs_accessory_manual(t_bidib_node_address node_address,
 			accessory_state->data.coil_on = false;
 		}
 		accessory_state->data.switch_time = 0;
+		bidib_state_stamp(point ? BIDIB_STATE_INDEX_POINTS_DCC : BIDIB_STATE_INDEX_SIGNALS_DCC,
+		                  accessory_state);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No dcc accessory configured for dcc address 0x%02x%02x",
@@ -446,10 +460,7 @@ void bidib_state_cs_accessory(t_bidib_node_address node_address,
 	t_bidib_dcc_accessory_state *accessory_state;
 	if (accessory_mapping != NULL &&
 	    (accessory_state = 
-				bidib_state_get_dcc_accessory_state_ref(accessory_mapping->id->str, point)) != NULL) {
-		if (accessory_state->data.state_id != NULL) {
-			free(accessory_state->data.state_id);
-		}
+				bidib_state_get_dcc_accessory_state_ref(accessory_mapping->id, point)) != NULL) {
 		accessory_state->data.state_id = NULL;
 		accessory_state->data.state_value = (uint8_t) (params.data & 0x1F);
 		if (params.data & (1 << 5)) {
@@ -468,6 +479,8 @@ void bidib_state_cs_accessory(t_bidib_node_address node_address,
 			accessory_state->data.time_unit = BIDIB_TIMEUNIT_MILLISECONDS;
 		}
 		accessory_state->data.switch_time = (uint8_t) (params.time & 0x7F);
+		bidib_state_stamp(point ? BIDIB_STATE_INDEX_POINTS_DCC : BIDIB_STATE_INDEX_SIGNALS_DCC,
+		                  accessory_state);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No dcc accessory configured for dcc address 0x%02x%02x",
@@ -479,37 +492,38 @@ void bidib_state_lc_stat(t_bidib_node_address node_address, t_bidib_peripheral_p
                          uint8_t portstat, unsigned int action_id) {
 	t_bidib_peripheral_state *peripheral_state;
 	
-	// For bidib_state_get_peripheral_state_ref (devnote: write)
+	// For bidib_state_get_peripheral_state_ref_by_port (devnote: write)
 	pthread_mutex_lock(&trackstate_peripherals_mutex);
-	// For bidib_state_get_peripheral_mapping_ref_by_port
+	// For bidib_state_get_peripheral_mapping_ref_by_port and
+	// bidib_state_get_peripheral_state_ref_by_port
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	
 	const t_bidib_peripheral_mapping *const peripheral_mapping =
 			bidib_state_get_peripheral_mapping_ref_by_port(node_address, port);
 	if (peripheral_mapping != NULL &&
-	    (peripheral_state = bidib_state_get_peripheral_state_ref(peripheral_mapping->id->str)) != NULL) {
-		if (peripheral_state->data.state_id != NULL) {
-			free(peripheral_state->data.state_id);
-		}
+	    (peripheral_state = bidib_state_get_peripheral_state_ref_by_port(node_address, port)) != NULL) {
 		peripheral_state->data.state_id = NULL;
 		t_bidib_aspect *aspect_mapping;
 		for (size_t i = 0; i < peripheral_mapping->aspects->len; i++) {
 			aspect_mapping = &g_array_index(peripheral_mapping->aspects, t_bidib_aspect, i);
 			if (aspect_mapping->value == portstat) {
-				peripheral_state->data.state_id = strdup(aspect_mapping->id->str);
+				peripheral_state->data.state_id = (char *) aspect_mapping->id;
 				break;
 			}
 		}
 		if (peripheral_state->data.state_id == NULL) {
 			syslog_libbidib(LOG_WARNING,
 			                "Aspect 0x%02x of peripheral %s is not mapped in config files",
-			                portstat, peripheral_mapping->id->str);
+			                portstat, peripheral_mapping->id);
 		} else {
 			syslog_libbidib(LOG_DEBUG,
 			                "Feedback for action id %d: Peripheral: %s has aspect: %s (0x%02x)",
-			                action_id, peripheral_mapping->id->str, aspect_mapping->id->str, portstat);
+			                action_id, peripheral_mapping->id, aspect_mapping->id, portstat);
 		}
 		peripheral_state->data.state_value = portstat;
+		bidib_state_stamp(BIDIB_STATE_INDEX_PERIPHERALS, peripheral_state);
+		bidib_state_persist_store(BIDIB_STATE_INDEX_PERIPHERALS, peripheral_state,
+		                          peripheral_state->data.state_id != NULL, portstat);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No peripheral on port 0x%02x 0x%02x configured for node address "
@@ -525,21 +539,23 @@ void bidib_state_lc_wait(t_bidib_node_address node_address, t_bidib_peripheral_p
                          uint8_t time) {
 	t_bidib_peripheral_state *peripheral_state;
 	
-	// For bidib_state_get_peripheral_state_ref (devnote: write)
+	// For bidib_state_get_peripheral_state_ref_by_port (devnote: write)
 	pthread_mutex_lock(&trackstate_peripherals_mutex);
-	// For bidib_state_get_peripheral_mapping_ref_by_port
+	// For bidib_state_get_peripheral_mapping_ref_by_port and
+	// bidib_state_get_peripheral_state_ref_by_port
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	
 	const t_bidib_peripheral_mapping *const peripheral_mapping =
 			bidib_state_get_peripheral_mapping_ref_by_port(node_address, port);
 	if (peripheral_mapping != NULL &&
-	    (peripheral_state = bidib_state_get_peripheral_state_ref(peripheral_mapping->id->str)) != NULL) {
+	    (peripheral_state = bidib_state_get_peripheral_state_ref_by_port(node_address, port)) != NULL) {
 		if (time & (1 << 7)) {
 			peripheral_state->data.time_unit = BIDIB_TIMEUNIT_SECONDS;
 		} else {
 			peripheral_state->data.time_unit = BIDIB_TIMEUNIT_MILLISECONDS;
 		}
 		peripheral_state->data.wait = (uint8_t) (time & 0x7F);
+		bidib_state_stamp(BIDIB_STATE_INDEX_PERIPHERALS, peripheral_state);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No peripheral on port 0x%02x 0x%02x configured for node address "
@@ -571,13 +587,13 @@ void bidib_state_log_train_detect(bool detected, const t_bidib_dcc_address *cons
 			syslog_libbidib(LOG_NOTICE,
 			                "Segment: %s is being entered by: unknown train (0x%02x%02x) "
 			                "with %s orientation, at time %ld.%06ld",
-			                segment_state->id->str, dcc_address->addrh, dcc_address->addrl,
+			                segment_state->id, dcc_address->addrh, dcc_address->addrl,
 			                dcc_address->type == 0 ? "left" : "right", tv.tv_sec, tv.tv_nsec/1000);
 		} else {
 			syslog_libbidib(LOG_NOTICE,
 			                "Segment: %s is being entered by: %s with %s "
 			                "orientation, at time %ld.%06ld",
-			                segment_state->id->str, train_state->id->str,
+			                segment_state->id, train_state->id,
 			                train_state->orientation == BIDIB_TRAIN_ORIENTATION_LEFT ? "left" : "right",
 			                tv.tv_sec, tv.tv_nsec/1000);
 		}
@@ -586,115 +602,171 @@ void bidib_state_log_train_detect(bool detected, const t_bidib_dcc_address *cons
 			syslog_libbidib(LOG_NOTICE,
 			                "Segment: %s is being exited by: unknown train (0x%02x%02x) "
 			                "with %s orientation, at time %ld.%06ld",
-			                segment_state->id->str, dcc_address->addrh, dcc_address->addrl,
+			                segment_state->id, dcc_address->addrh, dcc_address->addrl,
 			                dcc_address->type == 0 ? "left" : "right", tv.tv_sec, tv.tv_nsec/1000);
 		} else {
 			syslog_libbidib(LOG_NOTICE,
 			                "Segment: %s is being exited by: %s with %s "
 			                "orientation, at time %ld.%06ld",
-			                segment_state->id->str, train_state->id->str,
+			                segment_state->id, train_state->id,
 			                train_state->orientation == BIDIB_TRAIN_ORIENTATION_LEFT ? "left" : "right",
 			                tv.tv_sec, tv.tv_nsec/1000);
 		}
 	}
 }
 
-void bidib_state_bm_occ(t_bidib_node_address node_address, uint8_t number, bool occ) {
-	// For bidib_state_log_train_detect and bidib_state_update_train_available
-	pthread_rwlock_rdlock(&bidib_trains_rwlock);
-	
-	// For bidib_state_get_segment_state_ref_by_nodeaddr and bidib_state_update_train_available 
-	// (devnote: write)
-	pthread_mutex_lock(&trackstate_segments_mutex);
-	// For bidib_state_log_train_detect and bidib_state_update_train_available
-	pthread_mutex_lock(&trackstate_trains_mutex);
+// Returns whether storing the occupancy frees a segment that detects addresses.
+// Shall only be called with the shard lock of the board acquired.
+static bool bidib_state_bm_frees_addresses(const t_bidib_board_routes *routes,
+                                           const uint64_t mask[BIDIB_BOARD_OCCUPANCY_WORDS],
+                                           const uint64_t occupied[BIDIB_BOARD_OCCUPANCY_WORDS]) {
+	for (unsigned int number = 0; number < 256; number++) {
+		const uint64_t bit = UINT64_C(1) << (number % 64);
+		if ((mask[number / 64] & ~occupied[number / 64] & bit) &&
+		    routes->segments[number].state != 0) {
+			const t_bidib_segment_state_intern *const segment_state = &g_array_index(
+					bidib_track_state.segments, t_bidib_segment_state_intern,
+					routes->segments[number].state - 1);
+			if (segment_state->dcc_addresses->len > 0) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Stores the occupancy of the segments of a board whose BM numbers are set in
+// mask, and removes the detected addresses from the segments that are free.
+// Only the shard of the board is locked, unless detected addresses are removed.
+static void bidib_state_bm_store(t_bidib_node_address node_address,
+                                 const uint64_t mask[BIDIB_BOARD_OCCUPANCY_WORDS],
+                                 const uint64_t occupied[BIDIB_BOARD_OCCUPANCY_WORDS],
+                                 bool log_unconfigured_free) {
+	// For bidib_state_index_get_routes, the routes stay valid afterwards
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+	const t_bidib_board_routes *const routes = bidib_state_index_get_routes(node_address);
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
 	
-	t_bidib_segment_state_intern *segment_state =
-			bidib_state_get_segment_state_ref_by_nodeaddr(node_address, number);
-	if (segment_state != NULL) {
+	bool frees_addresses = false;
+	if (routes != NULL) {
+		// For accessing the segment states of the board (devnote: write)
+		pthread_mutex_lock(routes->segments_mutex);
+		frees_addresses = bidib_state_bm_frees_addresses(routes, mask, occupied);
+		if (frees_addresses) {
+			// Relock in lock order. Addresses detected meanwhile are removed as
+			// well, because the segments are only checked again below.
+			pthread_mutex_unlock(routes->segments_mutex);
+			// For bidib_state_log_train_detect and bidib_state_update_train_available
+			pthread_rwlock_rdlock(&bidib_trains_rwlock);
+			// For removing detected addresses and bidib_state_update_train_available
+			// (devnote: write)
+			pthread_mutex_lock(&trackstate_segments_mutex);
+			// For accessing the segment states of the board (devnote: write)
+			pthread_mutex_lock(routes->segments_mutex);
+			// For bidib_state_log_train_detect and bidib_state_update_train_available
+			pthread_mutex_lock(&trackstate_trains_mutex);
+		}
+		bidib_state_index_store_occupancy(routes, mask, occupied);
+	}
+	GArray *lost_addresses = g_array_new(FALSE, FALSE, sizeof(t_bidib_dcc_address));
+	for (unsigned int number = 0; number < 256; number++) {
+		const uint64_t bit = UINT64_C(1) << (number % 64);
+		if (!(mask[number / 64] & bit)) {
+			continue;
+		}
+		const bool occ = (occupied[number / 64] & bit) != 0;
+		if (routes == NULL || routes->segments[number].state == 0) {
+			if (occ || log_unconfigured_free) {
+				syslog_libbidib(LOG_ERR, "No segment with number 0x%02x configured for "
+				                "node address 0x%02x 0x%02x 0x%02x 0x00",
+				                number, node_address.top, node_address.sub,
+				                node_address.subsub);
+			}
+			continue;
+		}
+		t_bidib_segment_state_intern *segment_state = &g_array_index(
+				bidib_track_state.segments, t_bidib_segment_state_intern,
+				routes->segments[number].state - 1);
+		if (segment_state->occupied == occ && (occ || segment_state->dcc_addresses->len == 0)) {
+			continue;
+		}
 		segment_state->occupied = occ;
 		if (!occ && segment_state->dcc_addresses->len > 0) {
+			g_array_append_vals(lost_addresses, segment_state->dcc_addresses->data,
+			                    segment_state->dcc_addresses->len);
 			for (size_t j = 0; j < segment_state->dcc_addresses->len; j++) {
-				const t_bidib_dcc_address *const dcc_address = 
-						&g_array_index(segment_state->dcc_addresses, t_bidib_dcc_address, j);
+				const t_bidib_dcc_address *const dcc_address = &g_array_index(
+						segment_state->dcc_addresses, t_bidib_dcc_address, j);
 				bidib_state_log_train_detect(false, dcc_address, segment_state);
 			}
+			bidib_state_index_unlink_segment(segment_state);
 			g_array_remove_range(segment_state->dcc_addresses, 0,
 			                     segment_state->dcc_addresses->len);
 		}
-		bidib_state_update_train_available();
-	} else {
-		syslog_libbidib(LOG_ERR,
-		                "No segment with number 0x%02x configured for node address "
-		                "0x%02x 0x%02x 0x%02x 0x00",
-		                number, node_address.top, node_address.sub, node_address.subsub);
+		bidib_state_stamp(BIDIB_STATE_INDEX_SEGMENTS, segment_state);
 	}
-	pthread_mutex_unlock(&trackstate_trains_mutex);
-	pthread_mutex_unlock(&trackstate_segments_mutex);
-	pthread_rwlock_unlock(&bidib_trains_rwlock);
+	if (frees_addresses) {
+		bidib_state_update_train_available(lost_addresses);
+		pthread_mutex_unlock(&trackstate_trains_mutex);
+	}
+	g_array_free(lost_addresses, TRUE);
+	if (routes != NULL) {
+		pthread_mutex_unlock(routes->segments_mutex);
+	}
+	if (frees_addresses) {
+		pthread_mutex_unlock(&trackstate_segments_mutex);
+		pthread_rwlock_unlock(&bidib_trains_rwlock);
+	}
+}
+
+void bidib_state_bm_occ(t_bidib_node_address node_address, uint8_t number, bool occ) {
+	uint64_t mask[BIDIB_BOARD_OCCUPANCY_WORDS] = {0};
+	uint64_t occupied[BIDIB_BOARD_OCCUPANCY_WORDS] = {0};
+	mask[number / 64] = UINT64_C(1) << (number % 64);
+	if (occ) {
+		occupied[number / 64] = mask[number / 64];
+	}
+	bidib_state_bm_store(node_address, mask, occupied, true);
 }
 
 void bidib_state_bm_multiple(t_bidib_node_address node_address, uint8_t number,
                              uint8_t size, const uint8_t *const data) {
-	t_bidib_segment_state_intern *segment_state;
-	// For bidib_state_log_train_detect and bidib_state_update_train_available
-	pthread_rwlock_rdlock(&bidib_trains_rwlock);
-	
-	// For bidib_state_get_segment_state_ref_by_nodeaddr and bidib_state_update_train_available
-	// (devnote: write)
-	pthread_mutex_lock(&trackstate_segments_mutex);
-	// For bidib_state_log_train_detect and bidib_state_update_train_available
-	pthread_mutex_lock(&trackstate_trains_mutex);
-	for (size_t i = 0; i < size; i++) {
-		if (number + i < 255) {
-			segment_state = bidib_state_get_segment_state_ref_by_nodeaddr(
-			    node_address, (uint8_t) (number + i));
-			if (segment_state != NULL) {
-				if (data[i / 8] & (1 << i % 8)) {
-					segment_state->occupied = true;
-				} else {
-					segment_state->occupied = false;
-					if (segment_state->dcc_addresses->len > 0) {
-						for (size_t j = 0; j < segment_state->dcc_addresses->len; j++) {
-							const t_bidib_dcc_address *const dcc_address =  &g_array_index(
-							    segment_state->dcc_addresses, t_bidib_dcc_address, j);
-							bidib_state_log_train_detect(false, dcc_address, segment_state);
-						}
-						g_array_remove_range(segment_state->dcc_addresses, 0,
-						                     segment_state->dcc_addresses->len);
-					}
-				}
-			} else if (data[i / 8] & (1 << i % 8)) {
-				syslog_libbidib(LOG_ERR, "No segment with number 0x%02x configured for "
-				                "node address 0x%02x 0x%02x 0x%02x 0x00",
-				                (unsigned int) (number + i), node_address.top,
-				                node_address.sub, node_address.subsub);
-			}
+	uint64_t mask[BIDIB_BOARD_OCCUPANCY_WORDS] = {0};
+	uint64_t occupied[BIDIB_BOARD_OCCUPANCY_WORDS] = {0};
+	for (size_t i = 0; i < size && number + i < 255; i++) {
+		const size_t bm = number + i;
+		mask[bm / 64] |= UINT64_C(1) << (bm % 64);
+		if (data[i / 8] & (1 << i % 8)) {
+			occupied[bm / 64] |= UINT64_C(1) << (bm % 64);
 		}
 	}
-	bidib_state_update_train_available();
-	pthread_mutex_unlock(&trackstate_trains_mutex);
-	pthread_mutex_unlock(&trackstate_segments_mutex);
-	pthread_rwlock_unlock(&bidib_trains_rwlock);
+	bidib_state_bm_store(node_address, mask, occupied, false);
 }
 
 void bidib_state_bm_confidence(t_bidib_node_address node_address, uint8_t conf_void,
                                uint8_t freeze, uint8_t nosignal, unsigned int action_id) {
-	// For bidib_state_get_segment_state_ref (devnote: write)
-	pthread_mutex_lock(&trackstate_segments_mutex);
+	// For bidib_state_index_get_routes, the routes stay valid afterwards
+	pthread_rwlock_rdlock(&bidib_boards_rwlock);
+	const t_bidib_board_routes *const routes = bidib_state_index_get_routes(node_address);
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+	if (routes != NULL) {
+		// For accessing the segment states of the board (devnote: write)
+		pthread_mutex_lock(routes->segments_mutex);
+	}
 	// For bidib_state_get_board_ref_by_nodeaddr
 	pthread_rwlock_rdlock(&bidib_boards_rwlock);
 	
 	const t_bidib_board *const board = bidib_state_get_board_ref_by_nodeaddr(node_address);
-	if (board != NULL) {
+	if (board != NULL && routes != NULL) {
 		t_bidib_segment_state_intern *segment_state;
 		for (size_t i = 0; i < board->segments->len; i++) {
 			const t_bidib_segment_mapping *const segment_mapping = 
 					&g_array_index(board->segments, t_bidib_segment_mapping, i);
-			segment_state = bidib_state_get_segment_state_ref(segment_mapping->id->str);
+			segment_state = bidib_state_get_segment_state_ref(segment_mapping->id);
 			segment_state->confidence.conf_void = (conf_void != 0);
 			segment_state->confidence.freeze = (freeze != 0);
 			segment_state->confidence.nosignal = (nosignal != 0);
+			bidib_state_stamp(BIDIB_STATE_INDEX_SEGMENTS, segment_state);
 		}
 		
 		const t_bidib_bm_confidence_level confidence_level = bidib_bm_confidence_to_level(
@@ -717,14 +789,16 @@ void bidib_state_bm_confidence(t_bidib_node_address node_address, uint8_t conf_v
 		}
 		syslog_libbidib(LOG_INFO,
 		                "Feedback for action id %d: Board: %s has confidence: %s",
-		                action_id, board->id->str, confidence_name);
+		                action_id, board->id, confidence_name);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No board configured for node address 0x%02x 0x%02x 0x%02x 0x00",
 		                node_address.top, node_address.sub, node_address.subsub);
 	}
 	pthread_rwlock_unlock(&bidib_boards_rwlock);
-	pthread_mutex_unlock(&trackstate_segments_mutex);
+	if (routes != NULL) {
+		pthread_mutex_unlock(routes->segments_mutex);
+	}
 }
 
 /**
@@ -794,25 +868,55 @@ void bidib_state_bm_address_log_changes(
 	}
 }
 
+/**
+ * Appends the DCC addresses (including their orientation) that are in addresses
+ * but not in other_addresses to changed_addresses.
+ *
+ * @param addresses the DCC addresses to check.
+ * @param other_addresses the DCC addresses to compare with.
+ * @param changed_addresses the array the missing DCC addresses are appended to.
+ */
+static void bidib_state_dcc_addresses_diff(const GArray *addresses, const GArray *other_addresses,
+                                           GArray *changed_addresses) {
+	for (size_t i = 0; i < addresses->len; i++) {
+		const t_bidib_dcc_address *const dcc_address = 
+				&g_array_index(addresses, t_bidib_dcc_address, i);
+		bool found = false;
+		for (size_t j = 0; j < other_addresses->len && !found; j++) {
+			const t_bidib_dcc_address *const other_address = 
+					&g_array_index(other_addresses, t_bidib_dcc_address, j);
+			found = dcc_address->addrl == other_address->addrl &&
+			        dcc_address->addrh == other_address->addrh &&
+			        dcc_address->type == other_address->type;
+		}
+		if (!found) {
+			g_array_append_val(changed_addresses, *dcc_address);
+		}
+	}
+}
+
 void bidib_state_bm_address(t_bidib_node_address node_address, uint8_t number,
                             uint8_t address_count, const uint8_t *const addresses) {
 	// For bidib_state_update_train_available and bidib_state_bm_address_log_changes
 	pthread_rwlock_rdlock(&bidib_trains_rwlock);
 	
-	// For bidib_state_get_segment_state_ref_by_nodeaddr and bidib_state_update_train_available
-	// (devnote: write)
+	// For the detected addresses and bidib_state_update_train_available (devnote: write)
 	pthread_mutex_lock(&trackstate_segments_mutex);
-	// For bidib_state_update_train_available and bidib_state_bm_address_log_changes
-	pthread_mutex_lock(&trackstate_trains_mutex);
 	
 	t_bidib_segment_state_intern *segment_state =
 			bidib_state_get_segment_state_ref_by_nodeaddr(node_address, number);
 	if (segment_state != NULL) {
+		// For accessing the segment state (devnote: write)
+		pthread_mutex_t *const segment_lock = bidib_state_index_segment_lock(segment_state);
+		pthread_mutex_lock(segment_lock);
+		// For bidib_state_update_train_available and bidib_state_bm_address_log_changes
+		pthread_mutex_lock(&trackstate_trains_mutex);
 		// make a copy of the current decoder addresses,
 		// bidib_state_bm_address_log_changes uses this to detect and log the address changes
 		t_bidib_segment_state_intern segment_state_intern_query =
 				bidib_state_get_segment_state(segment_state);
 		if (segment_state->dcc_addresses->len > 0) {
+			bidib_state_index_unlink_segment(segment_state);
 			g_array_remove_range(segment_state->dcc_addresses, 0,
 			                     segment_state->dcc_addresses->len);
 		}
@@ -829,10 +933,20 @@ void bidib_state_bm_address(t_bidib_node_address node_address, uint8_t number,
 				}
 			}
 		}
-		bidib_state_update_train_available();
+		bidib_state_index_link_segment(segment_state);
+		bidib_state_stamp(BIDIB_STATE_INDEX_SEGMENTS, segment_state);
+		pthread_mutex_unlock(segment_lock);
+		GArray *changed_addresses = g_array_new(FALSE, FALSE, sizeof(t_bidib_dcc_address));
+		bidib_state_dcc_addresses_diff(segment_state_intern_query.dcc_addresses,
+		                               segment_state->dcc_addresses, changed_addresses);
+		bidib_state_dcc_addresses_diff(segment_state->dcc_addresses,
+		                               segment_state_intern_query.dcc_addresses, changed_addresses);
+		bidib_state_update_train_available(changed_addresses);
+		g_array_free(changed_addresses, TRUE);
 		bidib_state_bm_address_log_changes(&segment_state_intern_query,
 		                                   address_count, addresses);
 		bidib_state_free_single_segment_state_intern(segment_state_intern_query);
+		pthread_mutex_unlock(&trackstate_trains_mutex);
 	} else if (!(address_count == 1 && addresses[0] == 0x00 && addresses[1] == 0x00)) {
 		// ignore free messages for unconnected segments (happens after track output is turned on)
 		syslog_libbidib(LOG_ERR,
@@ -840,18 +954,18 @@ void bidib_state_bm_address(t_bidib_node_address node_address, uint8_t number,
 		                "0x%02x 0x%02x 0x%02x 0x00",
 		                number, node_address.top, node_address.sub, node_address.subsub);
 	}
-	pthread_mutex_unlock(&trackstate_trains_mutex);
 	pthread_mutex_unlock(&trackstate_segments_mutex);
 	pthread_rwlock_unlock(&bidib_trains_rwlock);
 }
 
 void bidib_state_bm_current(t_bidib_node_address node_address, uint8_t number,
                             uint8_t current) {
-	// For bidib_state_get_segment_state_ref_by_nodeaddr (devnote: write)
-	pthread_mutex_lock(&trackstate_segments_mutex);
 	t_bidib_segment_state_intern *segment_state =
 			bidib_state_get_segment_state_ref_by_nodeaddr(node_address, number);
 	if (segment_state != NULL) {
+		// For accessing the segment state (devnote: write)
+		pthread_mutex_t *const segment_lock = bidib_state_index_segment_lock(segment_state);
+		pthread_mutex_lock(segment_lock);
 		if (current == 0) {
 			segment_state->power_consumption.known = true;
 			segment_state->power_consumption.overcurrent = false;
@@ -884,13 +998,14 @@ void bidib_state_bm_current(t_bidib_node_address node_address, uint8_t number,
 		} else {
 			segment_state->power_consumption.known = false;
 		}
+		bidib_state_stamp(BIDIB_STATE_INDEX_SEGMENTS, segment_state);
+		pthread_mutex_unlock(segment_lock);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No segment with number 0x%02x configured for node address "
 		                "0x%02x 0x%02x 0x%02x 0x00",
 		                number, node_address.top, node_address.sub, node_address.subsub);
 	}
-	pthread_mutex_unlock(&trackstate_segments_mutex);
 }
 
 void bidib_state_bm_speed(t_bidib_dcc_address dcc_address, uint8_t speedl, uint8_t speedh) {
@@ -904,6 +1019,7 @@ void bidib_state_bm_speed(t_bidib_dcc_address dcc_address, uint8_t speedl, uint8
 			bidib_state_get_train_state_ref_by_dccaddr(dcc_address);
 	if (train_state != NULL) {
 		train_state->detected_kmh_speed = (speedh << 8) | speedl;
+		bidib_state_stamp(BIDIB_STATE_INDEX_TRAIN_STATES, train_state);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No train configured for dcc address 0x%02x 0x%02x",
@@ -962,8 +1078,9 @@ void bidib_state_bm_dyn_state(t_bidib_dcc_address dcc_address, uint8_t dyn_num,
 		
 		syslog_libbidib(LOG_INFO,
 		                "Feedback for action id %d: Train: %s has %s: %s",
-		                action_id, train_state->id->str, dyn_type, dyn_value->str);
+		                action_id, train_state->id, dyn_type, dyn_value->str);
 		g_string_free(dyn_value, true);
+		bidib_state_stamp(BIDIB_STATE_INDEX_TRAIN_STATES, train_state);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No train configured for dcc address 0x%02x 0x%02x",
@@ -1048,6 +1165,7 @@ void bidib_state_boost_diagnostic(t_bidib_node_address node_address, uint8_t len
 		                booster_state->data.power_consumption.current,
 		                booster_state->data.voltage * 100,
 		                booster_state->data.temp_celsius);
+		bidib_state_stamp(BIDIB_STATE_INDEX_BOOSTERS, booster_state);
 	} else {
 		syslog_libbidib(LOG_ERR,
 		                "No booster configured with node address "
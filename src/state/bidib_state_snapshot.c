@@ -0,0 +1,224 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "../../include/highlevel/bidib_highlevel_getter.h"
+#include "../highlevel/bidib_highlevel_intern.h"
+#include "bidib_state_intern.h"
+#include "../transmission/bidib_transmission_intern.h"
+
+
+// Copy of a single category of the track state. Shared by all snapshots that
+// were published while the category was not modified.
+typedef struct {
+	atomic_uint refs;
+	size_t bytes; // of the block including the arrays and strings of its state
+	t_bidib_track_state state;
+} t_bidib_state_snapshot_block;
+
+typedef struct {
+	atomic_uint refs;
+	t_bidib_state_snapshot_block *blocks[BIDIB_STATE_CATEGORY_COUNT];
+	t_bidib_track_state_snapshot snapshot;
+} t_bidib_state_snapshot;
+
+// Bit i is set if category i was modified since the last published snapshot
+static atomic_uint snapshot_changes = BIDIB_STATE_CATEGORIES_ALL;
+
+// Holds one reference to the current snapshot
+static _Atomic(t_bidib_state_snapshot *) snapshot_current = NULL;
+
+// Readers announce themselves in the counter of the epoch they started in, so
+// that the publisher can wait until nobody can still be acquiring the snapshot
+// it replaced
+static atomic_uint snapshot_epoch = 0;
+static atomic_uint snapshot_readers[2];
+
+static uint64_t snapshot_version = 0; // guarded by trackstate_snapshot_mutex
+
+
+static void bidib_state_snapshot_block_unref(t_bidib_state_snapshot_block *block) {
+	if (atomic_fetch_sub(&block->refs, 1) == 1) {
+		bidib_memory_free(BIDIB_MEMORY_SNAPSHOTS, block->bytes);
+		bidib_free_track_state(block->state);
+		free(block);
+	}
+}
+
+static void bidib_state_snapshot_unref(t_bidib_state_snapshot *snapshot) {
+	if (atomic_fetch_sub(&snapshot->refs, 1) == 1) {
+		for (size_t i = 0; i < BIDIB_STATE_CATEGORY_COUNT; i++) {
+			bidib_state_snapshot_block_unref(snapshot->blocks[i]);
+		}
+		bidib_memory_free(BIDIB_MEMORY_SNAPSHOTS, sizeof(t_bidib_state_snapshot));
+		free(snapshot);
+	}
+}
+
+// Shall only be called with trackstate_snapshot_mutex acquired, after the
+// snapshot was replaced
+static void bidib_state_snapshot_retire(t_bidib_state_snapshot *snapshot) {
+	// Readers of the old epoch may have loaded the replaced snapshot without
+	// having referenced it yet. Readers of the new epoch load the replacement.
+	const unsigned int epoch = atomic_fetch_xor(&snapshot_epoch, 1) & 1;
+	while (atomic_load(&snapshot_readers[epoch]) != 0) {
+		sched_yield();
+	}
+	bidib_state_snapshot_unref(snapshot);
+}
+
+// Copies the fields of a category from the track state of a block
+static void bidib_state_snapshot_assign(t_bidib_track_state *state, t_bidib_state_category category,
+                                        const t_bidib_track_state *block_state) {
+	switch (category) {
+		case BIDIB_STATE_CATEGORY_ACCESSORIES:
+			state->points_board_count = block_state->points_board_count;
+			state->points_board = block_state->points_board;
+			state->points_dcc_count = block_state->points_dcc_count;
+			state->points_dcc = block_state->points_dcc;
+			state->signals_board_count = block_state->signals_board_count;
+			state->signals_board = block_state->signals_board;
+			state->signals_dcc_count = block_state->signals_dcc_count;
+			state->signals_dcc = block_state->signals_dcc;
+			break;
+		case BIDIB_STATE_CATEGORY_PERIPHERALS:
+			state->peripherals_count = block_state->peripherals_count;
+			state->peripherals = block_state->peripherals;
+			break;
+		case BIDIB_STATE_CATEGORY_SEGMENTS:
+			state->segments_count = block_state->segments_count;
+			state->segments = block_state->segments;
+			break;
+		case BIDIB_STATE_CATEGORY_REVERSERS:
+			state->reversers_count = block_state->reversers_count;
+			state->reversers = block_state->reversers;
+			break;
+		case BIDIB_STATE_CATEGORY_TRAINS:
+			state->trains_count = block_state->trains_count;
+			state->trains = block_state->trains;
+			break;
+		case BIDIB_STATE_CATEGORY_BOOSTERS:
+			state->booster_count = block_state->booster_count;
+			state->booster = block_state->booster;
+			break;
+		case BIDIB_STATE_CATEGORY_TRACK_OUTPUTS:
+			state->track_outputs_count = block_state->track_outputs_count;
+			state->track_outputs = block_state->track_outputs;
+			break;
+		default:
+			break;
+	}
+}
+
+void bidib_state_mark_changed(t_bidib_state_category category) {
+	atomic_fetch_or(&snapshot_changes, 1u << category);
+}
+
+void bidib_state_snapshot_publish(void) {
+	if (atomic_load(&snapshot_changes) == 0) {
+		return;
+	}
+	pthread_mutex_lock(&trackstate_snapshot_mutex);
+	t_bidib_state_snapshot *previous = atomic_load(&snapshot_current);
+	// A category modified after the exchange is marked again and copied by the
+	// next publish, even if this copy already contains the modification
+	const unsigned int changes = atomic_exchange(&snapshot_changes, 0);
+	if (changes == 0 && previous != NULL) {
+		pthread_mutex_unlock(&trackstate_snapshot_mutex);
+		return;
+	}
+
+	t_bidib_state_snapshot *snapshot = calloc(1, sizeof(t_bidib_state_snapshot));
+	bidib_memory_alloc(BIDIB_MEMORY_SNAPSHOTS, sizeof(t_bidib_state_snapshot));
+	atomic_init(&snapshot->refs, 1);
+	for (size_t i = 0; i < BIDIB_STATE_CATEGORY_COUNT; i++) {
+		t_bidib_state_snapshot_block *block;
+		if (previous == NULL || changes & (1u << i)) {
+			block = calloc(1, sizeof(t_bidib_state_snapshot_block));
+			atomic_init(&block->refs, 1);
+			block->bytes = sizeof(t_bidib_state_snapshot_block) +
+			               bidib_get_state_categories(1u << i, 0, &block->state);
+			bidib_memory_alloc(BIDIB_MEMORY_SNAPSHOTS, block->bytes);
+		} else {
+			block = previous->blocks[i];
+			atomic_fetch_add(&block->refs, 1);
+		}
+		snapshot->blocks[i] = block;
+		bidib_state_snapshot_assign(&snapshot->snapshot.state, (t_bidib_state_category) i,
+		                            &block->state);
+	}
+	snapshot->snapshot.version = ++snapshot_version;
+	atomic_store(&snapshot_current, snapshot);
+
+	if (previous != NULL) {
+		bidib_state_snapshot_retire(previous);
+	}
+	pthread_mutex_unlock(&trackstate_snapshot_mutex);
+}
+
+void bidib_state_snapshot_free(void) {
+	pthread_mutex_lock(&trackstate_snapshot_mutex);
+	t_bidib_state_snapshot *previous = atomic_exchange(&snapshot_current, NULL);
+	if (previous != NULL) {
+		bidib_state_snapshot_retire(previous);
+	}
+	// The next state has to be copied completely
+	atomic_store(&snapshot_changes, BIDIB_STATE_CATEGORIES_ALL);
+	pthread_mutex_unlock(&trackstate_snapshot_mutex);
+}
+
+const t_bidib_track_state_snapshot *bidib_acquire_state_snapshot(void) {
+	unsigned int epoch = atomic_load(&snapshot_epoch) & 1;
+	atomic_fetch_add(&snapshot_readers[epoch], 1);
+	// A publisher may have flipped the epoch before the reader was counted, it
+	// then did not wait for the reader
+	while ((atomic_load(&snapshot_epoch) & 1) != epoch) {
+		atomic_fetch_sub(&snapshot_readers[epoch], 1);
+		epoch = atomic_load(&snapshot_epoch) & 1;
+		atomic_fetch_add(&snapshot_readers[epoch], 1);
+	}
+	t_bidib_state_snapshot *snapshot = atomic_load(&snapshot_current);
+	if (snapshot != NULL) {
+		atomic_fetch_add(&snapshot->refs, 1);
+	}
+	atomic_fetch_sub(&snapshot_readers[epoch], 1);
+	return snapshot != NULL ? &snapshot->snapshot : NULL;
+}
+
+void bidib_release_state_snapshot(const t_bidib_track_state_snapshot *snapshot) {
+	if (snapshot != NULL) {
+		bidib_state_snapshot_unref((t_bidib_state_snapshot *) (
+				(const char *) snapshot - offsetof(t_bidib_state_snapshot, snapshot)));
+	}
+}
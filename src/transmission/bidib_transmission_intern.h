@@ -31,8 +31,10 @@
 #define BIDIB_TRANSMISSION_INTERN_H
 
 #include <glib.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 
 #include "../../include/definitions/bidib_definitions_custom.h"
 
@@ -42,6 +44,7 @@ typedef struct {
 	uint8_t addr[4];
 	uint8_t *message;
 	unsigned int action_id;
+	struct timespec enqueue_time;
 } t_bidib_message_queue_entry;
 
 typedef struct {
@@ -54,12 +57,42 @@ typedef struct {
 	uint8_t addr[4];
 } t_bidib_stall_queue_entry;
 
+typedef enum {
+	// the node is ready, the message has to be put into the send buffer
+	BIDIB_NODE_SEND_READY,
+	// the node is not ready, the message was queued or replaced a queued one
+	BIDIB_NODE_SEND_QUEUED,
+	// the node is not ready and its message queue is full, the message was dropped
+	BIDIB_NODE_SEND_REJECTED
+} t_bidib_node_send_result;
+
+// Sequence numbers of a node. Advanced atomically, thus readable and writable
+// without holding bidib_node_state_table_mutex.
+typedef struct {
+	// Packed node address, 0 if the slot is unused
+	_Atomic uint32_t key;
+	_Atomic uint8_t receive_seqnum;
+	_Atomic uint8_t send_seqnum;
+} t_bidib_node_seqnums;
+
 typedef struct {
 	char addr[4];
-	uint8_t receive_seqnum;
-	uint8_t send_seqnum;
+	t_bidib_node_seqnums *seqnums;
+	// only used if the lock-free sequence number index is exhausted
+	t_bidib_node_seqnums seqnums_fallback;
 	bool stall;
 	int current_response_bytes;
+	// deficit (in bytes) for the round robin when draining after a stall
+	int deficit;
+	// fairness metrics: number of dequeued messages and how long they were queued
+	unsigned int dequeued_count;
+	uint64_t total_queue_wait_us;
+	uint64_t max_queue_wait_us;
+	// number of queued messages dropped because their time-to-live expired
+	unsigned int expired_count;
+	// number of messages rejected or coalesced because the message queue was full
+	unsigned int rejected_count;
+	unsigned int coalesced_count;
 	// if this node is stalled, this queue contains all (sub)nodes that are
 	// stalled because of it
 	GQueue *stall_affected_nodes_queue; 
@@ -93,6 +126,19 @@ extern volatile bool bidib_lowlevel_debug_mode;
  */
 void bidib_add_to_buffer(const uint8_t *const message);
 
+/**
+ * Keeps the auto flush from sending the buffered messages, so that a batch of
+ * messages is sent in as few packets as possible. A full send buffer is still
+ * flushed. Every call has to be followed by bidib_release_flush.
+ */
+void bidib_hold_flush(void);
+
+/**
+ * Ends a batch started by bidib_hold_flush, flushing the send buffer once the
+ * last batch ended.
+ */
+void bidib_release_flush(void);
+
 /**
  * Puts a message without any data bytes in the buffer for the receiver node.
  *
@@ -100,9 +146,11 @@ void bidib_add_to_buffer(const uint8_t *const message);
  * at the latest index 3 must be 0x00.
  * @param msg_type the message type.
  * @param action_id reference number to a high level function call.
+ * @return the result of bidib_node_try_send for the message.
  */
-void bidib_buffer_message_without_data(const uint8_t *const addr_stack, uint8_t msg_type,
-                                       unsigned int action_id);
+t_bidib_node_send_result bidib_buffer_message_without_data(const uint8_t *const addr_stack,
+                                                           uint8_t msg_type,
+                                                           unsigned int action_id);
 
 /**
  * Puts a message with data bytes in the buffer for the receiver node.
@@ -113,22 +161,38 @@ void bidib_buffer_message_without_data(const uint8_t *const addr_stack, uint8_t
  * @param data the data bytes.
  * @param data_length the number of data bytes.
  * @param action_id reference number to a high level function call.
+ * @return the result of bidib_node_try_send for the message.
  */
-void bidib_buffer_message_with_data(const uint8_t *const addr_stack, uint8_t msg_type,
-                                    uint8_t data_length, const uint8_t *const data,
-                                    unsigned int action_id);
+t_bidib_node_send_result bidib_buffer_message_with_data(const uint8_t *const addr_stack,
+                                                        uint8_t msg_type, uint8_t data_length,
+                                                        const uint8_t *const data,
+                                                        unsigned int action_id);
 
 /**
- * Checks whether a node is ready to receive a message. If not the message will be enqueued.
+ * Checks whether a node is ready to receive a message. If not the message will be enqueued,
+ * unless the message queue of the node is full, in which case the message either replaces
+ * a queued message for the same object or is rejected.
  *
  * @param addr_stack the address stack. Index 0 represents the top of the stack, at the latest index 3 must be 0x00.
  * @param type the message type.
  * @param message the complete message.
  * @param action_id reference number to a high level function call.
- * @return true if the node is ready, false if not.
+ * @return BIDIB_NODE_SEND_READY if the node is ready, BIDIB_NODE_SEND_QUEUED if the
+ * message was queued, BIDIB_NODE_SEND_REJECTED if it was dropped.
+ */
+t_bidib_node_send_result bidib_node_try_send(const uint8_t *const addr_stack, uint8_t type,
+                                             const uint8_t *const message,
+                                             unsigned int action_id);
+
+/**
+ * Computes the time between two points in time, as used for the time-to-live
+ * of queued messages.
+ *
+ * @param since the earlier point in time.
+ * @param now the later point in time.
+ * @return the elapsed microseconds, 0 if now lies before since.
  */
-bool bidib_node_try_send(const uint8_t *const addr_stack, uint8_t type,
-                         const uint8_t *const message, unsigned int action_id);
+uint64_t bidib_elapsed_us(const struct timespec *const since, const struct timespec *const now);
 
 /**
  * Signals that a message was received from a node to update the node state table.
@@ -148,29 +212,25 @@ unsigned int bidib_node_state_update(const uint8_t *const addr_stack, uint8_t re
 void bidib_node_update_stall(const uint8_t *const addr_stack, uint8_t stall_status);
 
 /**
- * Gets and increments the sequence number of a node for receiving messages.
+ * Checks the sequence number of a received message against the expected one and
+ * sets the expected sequence number to the successor of the received one.
+ * Does not acquire bidib_node_state_table_mutex if the node is already known.
  *
  * @param addr_stack the address of the sender.
- * @return the sequence number.
+ * @param msg_seqnum the sequence number of the received message.
+ * @return the sequence number that was expected.
  */
-uint8_t bidib_node_state_get_and_incr_receive_seqnum(const uint8_t *const addr_stack);
+uint8_t bidib_node_state_sync_receive_seqnum(const uint8_t *const addr_stack, uint8_t msg_seqnum);
 
 /**
- * Gets and increments the sequence number of a node for receiving messages.
+ * Gets and increments the sequence number of a node for sending messages.
+ * Does not acquire bidib_node_state_table_mutex if the node is already known.
  *
  * @param addr_stack the address of the receiver.
  * @return the sequence number.
  */
 uint8_t bidib_node_state_get_and_incr_send_seqnum(const uint8_t *const addr_stack);
 
-/**
- * Sets the sequence number of a node for receiving messages.
- *
- * @param addr_stack the address of the sender.
- * @param seqnum the new sequence number.
- */
-void bidib_node_state_set_receive_seqnum(const uint8_t *const addr_stack, uint8_t seqnum);
-
 /**
  * Resets the node state table.
  * 
@@ -323,7 +383,8 @@ void bidib_node_state_table_init(void);
 void bidib_set_lowlevel_debug_mode(bool uplink_debug_mode_on);
 
 /**
- * Decides how each message should be processed.
+ * Decides how each message should be processed. Takes ownership of the message,
+ * which is either freed or handed over to an uplink queue.
  *
  * @param message the message received from a node.
  * @param type the message type.
@@ -335,5 +396,41 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
                                    const uint8_t *const addr_stack, uint8_t seqnum,
                                    unsigned int action_id);
 
+/**
+ * Accounts an object allocated by a subsystem.
+ *
+ * @param subsystem the subsystem that owns the object.
+ * @param bytes the size of the object.
+ */
+void bidib_memory_alloc(t_bidib_memory_subsystem subsystem, size_t bytes);
+
+/**
+ * Accounts an object freed by a subsystem.
+ *
+ * @param subsystem the subsystem that owned the object.
+ * @param bytes the size of the object.
+ */
+void bidib_memory_free(t_bidib_memory_subsystem subsystem, size_t bytes);
+
+/**
+ * Accounts an object of a subsystem that was replaced by one of another size.
+ *
+ * @param subsystem the subsystem that owns the object.
+ * @param old_bytes the previous size of the object.
+ * @param new_bytes the new size of the object.
+ */
+void bidib_memory_resize(t_bidib_memory_subsystem subsystem, size_t old_bytes,
+                         size_t new_bytes);
+
+/**
+ * Accounts an object whose ownership is handed over to another subsystem.
+ *
+ * @param from the subsystem that owned the object.
+ * @param to the subsystem that owns the object now.
+ * @param bytes the size of the object.
+ */
+void bidib_memory_move(t_bidib_memory_subsystem from, t_bidib_memory_subsystem to,
+                       size_t bytes);
+
 
 #endif
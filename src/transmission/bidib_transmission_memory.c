@@ -0,0 +1,144 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "bidib_transmission_intern.h"
+#include "../state/bidib_state_intern.h"
+#include "../../include/highlevel/bidib_highlevel_util.h"
+
+
+typedef struct {
+	atomic_size_t bytes;
+	atomic_size_t objects;
+	atomic_size_t max_bytes;
+	atomic_size_t max_objects;
+} t_bidib_memory_counter;
+
+// Counters of the subsystems that account their allocations. The track state is
+// measured on demand, so only its high-water marks are kept here. The config
+// counts its arena blocks here, its arrays are measured on demand.
+static t_bidib_memory_counter memory_counters[BIDIB_MEMORY_SUBSYSTEM_COUNT];
+
+
+static void bidib_memory_raise(atomic_size_t *max, size_t value) {
+	size_t current = atomic_load_explicit(max, memory_order_relaxed);
+	while (value > current &&
+	       !atomic_compare_exchange_weak_explicit(max, &current, value,
+	                                              memory_order_relaxed,
+	                                              memory_order_relaxed)) {
+	}
+}
+
+void bidib_memory_alloc(t_bidib_memory_subsystem subsystem, size_t bytes) {
+	t_bidib_memory_counter *counter = &memory_counters[subsystem];
+	bidib_memory_raise(&counter->max_bytes,
+	                   atomic_fetch_add_explicit(&counter->bytes, bytes,
+	                                             memory_order_relaxed) + bytes);
+	bidib_memory_raise(&counter->max_objects,
+	                   atomic_fetch_add_explicit(&counter->objects, 1,
+	                                             memory_order_relaxed) + 1);
+}
+
+void bidib_memory_free(t_bidib_memory_subsystem subsystem, size_t bytes) {
+	t_bidib_memory_counter *counter = &memory_counters[subsystem];
+	atomic_fetch_sub_explicit(&counter->bytes, bytes, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&counter->objects, 1, memory_order_relaxed);
+}
+
+void bidib_memory_resize(t_bidib_memory_subsystem subsystem, size_t old_bytes,
+                         size_t new_bytes) {
+	t_bidib_memory_counter *counter = &memory_counters[subsystem];
+	if (new_bytes >= old_bytes) {
+		bidib_memory_raise(&counter->max_bytes,
+		                   atomic_fetch_add_explicit(&counter->bytes, new_bytes - old_bytes,
+		                                             memory_order_relaxed)
+		                   + new_bytes - old_bytes);
+	} else {
+		atomic_fetch_sub_explicit(&counter->bytes, old_bytes - new_bytes,
+		                          memory_order_relaxed);
+	}
+}
+
+void bidib_memory_move(t_bidib_memory_subsystem from, t_bidib_memory_subsystem to,
+                       size_t bytes) {
+	bidib_memory_alloc(to, bytes);
+	bidib_memory_free(from, bytes);
+}
+
+t_bidib_memory_stats bidib_get_memory_stats(void) {
+	t_bidib_memory_stats stats = {0};
+	size_t track_state_bytes = 0;
+	size_t track_state_objects = 0;
+	bidib_state_measure(&track_state_bytes, &track_state_objects);
+	t_bidib_memory_counter *track_state = &memory_counters[BIDIB_MEMORY_TRACK_STATE];
+	atomic_store_explicit(&track_state->bytes, track_state_bytes, memory_order_relaxed);
+	atomic_store_explicit(&track_state->objects, track_state_objects, memory_order_relaxed);
+	bidib_memory_raise(&track_state->max_bytes, track_state_bytes);
+	bidib_memory_raise(&track_state->max_objects, track_state_objects);
+
+	for (size_t i = 0; i < BIDIB_MEMORY_SUBSYSTEM_COUNT; i++) {
+		t_bidib_memory_usage *usage = &stats.subsystems[i];
+		usage->bytes = atomic_load_explicit(&memory_counters[i].bytes, memory_order_relaxed);
+		usage->objects = atomic_load_explicit(&memory_counters[i].objects, memory_order_relaxed);
+		usage->max_bytes = atomic_load_explicit(&memory_counters[i].max_bytes,
+		                                        memory_order_relaxed);
+		usage->max_objects = atomic_load_explicit(&memory_counters[i].max_objects,
+		                                          memory_order_relaxed);
+		stats.total_bytes += usage->bytes;
+	}
+
+	// The config arrays are not modified while the library is running, so they
+	// are part of every high-water mark
+	size_t config_bytes = 0;
+	size_t config_objects = 0;
+	bidib_state_measure_config(&config_bytes, &config_objects);
+	t_bidib_memory_usage *config = &stats.subsystems[BIDIB_MEMORY_CONFIG];
+	config->bytes += config_bytes;
+	config->objects += config_objects;
+	config->max_bytes += config_bytes;
+	config->max_objects += config_objects;
+	stats.total_bytes += config_bytes;
+	return stats;
+}
+
+void bidib_reset_memory_high_water_marks(void) {
+	for (size_t i = 0; i < BIDIB_MEMORY_SUBSYSTEM_COUNT; i++) {
+		atomic_store_explicit(&memory_counters[i].max_bytes,
+		                      atomic_load_explicit(&memory_counters[i].bytes,
+		                                           memory_order_relaxed),
+		                      memory_order_relaxed);
+		atomic_store_explicit(&memory_counters[i].max_objects,
+		                      atomic_load_explicit(&memory_counters[i].objects,
+		                                           memory_order_relaxed),
+		                      memory_order_relaxed);
+	}
+	syslog_libbidib(LOG_INFO, "Memory high-water marks reset");
+}
@@ -33,11 +33,20 @@
 #include <memory.h>
 #include <time.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 
 #include "bidib_transmission_intern.h"
 #include "../../include/highlevel/bidib_highlevel_util.h"
+#include "../../include/definitions/bidib_messages.h"
 
 #define RESPONSE_QUEUE_EXPIRATION_SECS 2
+// Number of slots of the sequence number index, has to be a power of two
+#define NODE_SEQNUMS_INDEX_SIZE 1024
+// Bytes a node may send per round when the nodes affected by a stall are drained
+#define STALL_RELEASE_QUANTUM 32
+// Number of expired and of rejected action ids that are remembered
+#define REMEMBERED_ACTION_IDS_SIZE 64
 
 pthread_mutex_t bidib_node_state_table_mutex;
 
@@ -45,6 +54,26 @@ static GHashTable *node_state_table = NULL;
 // Limit for the number of bytes expected in form of responses from a node.
 // (to avoid node overload)
 static int response_limit = 48;
+// Maximum number of messages in the message queue of a node, 0 means unlimited.
+// Guarded by bidib_node_state_table_mutex.
+static unsigned int queue_limit = 0;
+// Open addressing index of the sequence numbers of all nodes in node_state_table.
+// Slots are claimed with bidib_node_state_table_mutex acquired, but are never released
+// again (a reset only resets the sequence numbers), so that they can be looked up and
+// advanced without acquiring bidib_node_state_table_mutex.
+static t_bidib_node_seqnums node_seqnums_index[NODE_SEQNUMS_INDEX_SIZE];
+
+// Time-to-live of queued messages per message class in ms, 0 means no expiry.
+// The following are guarded by bidib_node_state_table_mutex.
+static unsigned int message_class_ttl_ms[BIDIB_MSG_CLASS_COUNT] = {0};
+static t_bidib_message_drop_counters drop_counters = {{0}};
+// Ring buffer of the most recently expired action ids
+static unsigned int expired_action_ids[REMEMBERED_ACTION_IDS_SIZE] = {0};
+static size_t expired_action_ids_next = 0;
+// Ring buffer of the most recently rejected action ids, including the ones whose
+// queued message was replaced
+static unsigned int rejected_action_ids[REMEMBERED_ACTION_IDS_SIZE] = {0};
+static size_t rejected_action_ids_next = 0;
 
 void bidib_node_state_table_init() {
 	node_state_table = g_hash_table_new(g_str_hash, g_str_equal);
@@ -55,6 +84,7 @@ static void bidib_node_state_add_response(uint8_t type, t_bidib_node_state *stat
 	if (message_max_resp > 0) {
 		state->current_response_bytes += message_max_resp;
 		t_bidib_response_queue_entry *response = malloc(sizeof(t_bidib_response_queue_entry));
+		bidib_memory_alloc(BIDIB_MEMORY_RESPONSE_QUEUES, sizeof(*response));
 		response->type = type;
 		response->creation_time = time(NULL);
 		response->action_id = action_id;
@@ -70,7 +100,9 @@ static void bidib_node_state_add_message(const uint8_t *const addr_stack, uint8_
 	memcpy(message_entry->addr, addr_stack, 4);
 	message_entry->message = malloc(sizeof(uint8_t) * (message[0] + 1));
 	memcpy(message_entry->message, message, message[0] + 1);
+	bidib_memory_alloc(BIDIB_MEMORY_MESSAGE_QUEUES, sizeof(*message_entry) + message[0] + 1);
 	message_entry->action_id = action_id;
+	clock_gettime(CLOCK_MONOTONIC, &message_entry->enqueue_time);
 	g_queue_push_tail(state->message_queue, message_entry);
 	syslog_libbidib(LOG_DEBUG, 
 	                "Enqueued msg with type: %s to: 0x%02x 0x%02x 0x%02x 0x%02x action id: %d",
@@ -78,6 +110,69 @@ static void bidib_node_state_add_message(const uint8_t *const addr_stack, uint8_
 	                addr_stack[3], action_id);
 }
 
+// Frees a message that was dequeued from the message queue of a node
+static void bidib_node_message_entry_free(t_bidib_message_queue_entry *message_entry) {
+	bidib_memory_free(BIDIB_MEMORY_MESSAGE_QUEUES,
+	                  sizeof(*message_entry) + message_entry->message[0] + 1);
+	free(message_entry->message);
+	free(message_entry);
+}
+
+static uint8_t bidib_next_seqnum(uint8_t seqnum) {
+	// Sequence number 0 disables the sequence check, so it is skipped on wrap-around
+	return (seqnum == 255) ? 0x01 : (uint8_t) (seqnum + 1);
+}
+
+static uint32_t bidib_node_seqnums_key(const uint8_t *const addr_stack) {
+	// Bit 24 marks the slot as used, so that the interface (0x00 0x00 0x00 0x00)
+	// gets a non-zero key as well.
+	return (1u << 24) | (uint32_t) (addr_stack[0] << 16) | (uint32_t) (addr_stack[1] << 8) 
+	       | addr_stack[2];
+}
+
+static size_t bidib_node_seqnums_slot(uint32_t key) {
+	return (size_t) ((key * 2654435761u) >> 22) & (NODE_SEQNUMS_INDEX_SIZE - 1);
+}
+
+// Lock-free. Returns NULL if the node has no slot (yet).
+static t_bidib_node_seqnums *bidib_node_seqnums_lookup(const uint8_t *const addr_stack) {
+	const uint32_t key = bidib_node_seqnums_key(addr_stack);
+	size_t slot = bidib_node_seqnums_slot(key);
+	for (size_t i = 0; i < NODE_SEQNUMS_INDEX_SIZE; i++) {
+		const uint32_t slot_key = atomic_load_explicit(&node_seqnums_index[slot].key,
+		                                               memory_order_acquire);
+		if (slot_key == key) {
+			return &node_seqnums_index[slot];
+		} else if (slot_key == 0) {
+			return NULL;
+		}
+		slot = (slot + 1) & (NODE_SEQNUMS_INDEX_SIZE - 1);
+	}
+	return NULL;
+}
+
+// Shall only be called with bidib_node_state_table_mutex acquired.
+static t_bidib_node_seqnums *bidib_node_seqnums_claim(const uint8_t *const addr_stack) {
+	const uint32_t key = bidib_node_seqnums_key(addr_stack);
+	size_t slot = bidib_node_seqnums_slot(key);
+	for (size_t i = 0; i < NODE_SEQNUMS_INDEX_SIZE; i++) {
+		t_bidib_node_seqnums *seqnums = &node_seqnums_index[slot];
+		const uint32_t slot_key = atomic_load_explicit(&seqnums->key, memory_order_relaxed);
+		if (slot_key == key) {
+			// Slot is left over from before a reset
+			return seqnums;
+		} else if (slot_key == 0) {
+			atomic_store_explicit(&seqnums->receive_seqnum, 0x01, memory_order_relaxed);
+			atomic_store_explicit(&seqnums->send_seqnum, 0x01, memory_order_relaxed);
+			// Publish the slot only after the sequence numbers are initialised
+			atomic_store_explicit(&seqnums->key, key, memory_order_release);
+			return seqnums;
+		}
+		slot = (slot + 1) & (NODE_SEQNUMS_INDEX_SIZE - 1);
+	}
+	return NULL;
+}
+
 // May write to member in node_state_table.
 static t_bidib_node_state *bidib_node_query(const uint8_t *const addr_stack) {
 	t_bidib_node_state *state = g_hash_table_lookup(node_state_table, addr_stack);
@@ -85,13 +180,28 @@ static t_bidib_node_state *bidib_node_query(const uint8_t *const addr_stack) {
 	if (state == NULL) {
 		state = malloc(sizeof(t_bidib_node_state));
 		memcpy(state->addr, addr_stack, 4);
-		state->receive_seqnum = 0x01;
-		state->send_seqnum = 0x01;
+		state->seqnums = bidib_node_seqnums_claim(addr_stack);
+		if (state->seqnums == NULL) {
+			syslog_libbidib(LOG_ERR, "Sequence number index exhausted, using locked sequence "
+			                "numbers for: 0x%02x 0x%02x 0x%02x 0x%02x",
+			                addr_stack[0], addr_stack[1], addr_stack[2], addr_stack[3]);
+			state->seqnums = &state->seqnums_fallback;
+		}
+		atomic_store_explicit(&state->seqnums->receive_seqnum, 0x01, memory_order_relaxed);
+		atomic_store_explicit(&state->seqnums->send_seqnum, 0x01, memory_order_relaxed);
 		state->stall = false;
 		state->current_response_bytes = 0;
+		state->deficit = 0;
+		state->dequeued_count = 0;
+		state->total_queue_wait_us = 0;
+		state->max_queue_wait_us = 0;
+		state->expired_count = 0;
+		state->rejected_count = 0;
+		state->coalesced_count = 0;
 		state->stall_affected_nodes_queue = g_queue_new();
 		state->response_queue = g_queue_new();
 		state->message_queue = g_queue_new();
+		bidib_memory_alloc(BIDIB_MEMORY_NODE_STATES, sizeof(*state) + 3 * sizeof(GQueue));
 		g_hash_table_insert(node_state_table, state->addr, state);
 		syslog_libbidib(LOG_DEBUG, "Add to node state table: 0x%02x 0x%02x 0x%02x 0x%02x",
 		                addr_stack[0], addr_stack[1], addr_stack[2], addr_stack[3]);
@@ -133,6 +243,7 @@ static bool bidib_node_stall_ready(const uint8_t *const addr_stack) {
 				// so add it
 				t_bidib_stall_queue_entry *stall_entry = malloc(sizeof(t_bidib_stall_queue_entry));
 				memcpy(stall_entry->addr, addr_stack, 4);
+				bidib_memory_alloc(BIDIB_MEMORY_STALL_ENTRIES, sizeof(*stall_entry));
 				g_queue_push_tail(state->stall_affected_nodes_queue, stall_entry);
 			}
 			return false;
@@ -148,31 +259,263 @@ static bool bidib_node_stall_ready(const uint8_t *const addr_stack) {
 	return true;
 }
 
-bool bidib_node_try_send(const uint8_t *const addr_stack, uint8_t type,
-                         const uint8_t *const message, unsigned int action_id) {
+// Returns -1 for messages that never expire.
+static int bidib_message_class(uint8_t type) {
+	switch (type) {
+		case MSG_CS_DRIVE:
+			return BIDIB_MSG_CLASS_DRIVE;
+		case MSG_ACCESSORY_SET:
+		case MSG_CS_ACCESSORY:
+			return BIDIB_MSG_CLASS_ACCESSORY;
+		case MSG_LC_OUTPUT:
+			return BIDIB_MSG_CLASS_LC_OUTPUT;
+		case MSG_FEATURE_GETALL:
+		case MSG_FEATURE_GETNEXT:
+		case MSG_FEATURE_GET:
+		case MSG_FEATURE_SET:
+			return BIDIB_MSG_CLASS_FEATURE;
+		default:
+			return -1;
+	}
+}
+
+uint64_t bidib_elapsed_us(const struct timespec *const since, const struct timespec *const now) {
+	// tv_nsec of now is smaller than the one of since whenever a second boundary lies
+	// in between, so the difference has to be computed signed
+	const int64_t elapsed_ns = (int64_t) (now->tv_sec - since->tv_sec) * 1000000000
+	                           + (now->tv_nsec - since->tv_nsec);
+	return elapsed_ns > 0 ? (uint64_t) elapsed_ns / 1000 : 0;
+}
+
+// Shall only be called with bidib_node_state_table_mutex acquired.
+static void bidib_node_remember_rejected(unsigned int action_id) {
+	if (action_id != 0) {
+		rejected_action_ids[rejected_action_ids_next] = action_id;
+		rejected_action_ids_next = (rejected_action_ids_next + 1) % REMEMBERED_ACTION_IDS_SIZE;
+	}
+}
+
+static int bidib_message_seqnum_index(const uint8_t *const message) {
+	int i = 1;
+	while (message[i] != 0x00) {
+		i++;
+	}
+	return i + 1;
+}
+
+// Shall only be called with bidib_node_state_table_mutex acquired.
+// Takes back the sequence number of a message that will not be sent, if it was the
+// most recently assigned one of the node.
+static void bidib_node_take_back_seqnum(t_bidib_node_state *state, uint8_t seqnum) {
+	if (seqnum == 0x00) {
+		// sequence numbers disabled
+		return;
+	}
+	uint8_t expected = bidib_next_seqnum(seqnum);
+	if (!atomic_compare_exchange_strong(&state->seqnums->send_seqnum, &expected, seqnum)) {
+		syslog_libbidib(LOG_WARNING, 
+		                "Unable to take back sequence number %d of 0x%02x 0x%02x 0x%02x 0x%02x",
+		                seqnum, state->addr[0], state->addr[1], state->addr[2], state->addr[3]);
+	}
+}
+
+// Shall only be called with bidib_node_state_table_mutex acquired.
+// A dropped message leaves a gap in the downlink sequence numbers of the node,
+// which it would report as an error. The queued messages are consecutively
+// numbered, so the gap is moved to the end of the queue and closed by taking back
+// the last sequence number, if no message was numbered since.
+static void bidib_node_reclaim_seqnum(t_bidib_node_state *state, uint8_t seqnum) {
+	if (seqnum == 0x00) {
+		// sequence numbers disabled
+		return;
+	}
+	for (GList *l = state->message_queue->head; l != NULL; l = l->next) {
+		uint8_t *queued_message = ((t_bidib_message_queue_entry *) l->data)->message;
+		const int seqnum_index = bidib_message_seqnum_index(queued_message);
+		const uint8_t tmp = queued_message[seqnum_index];
+		queued_message[seqnum_index] = seqnum;
+		seqnum = tmp;
+	}
+	bidib_node_take_back_seqnum(state, seqnum);
+}
+
+// Checks whether two messages of the given type are for the same object, such that
+// the later one supersedes the earlier one.
+static bool bidib_messages_same_object(uint8_t type, const uint8_t *const message_a,
+                                       const uint8_t *const message_b) {
+	const int a = bidib_first_data_byte_index(message_a);
+	const int b = bidib_first_data_byte_index(message_b);
+	if (a < 0 || b < 0) {
+		return false;
+	}
+	switch (type) {
+		case MSG_CS_DRIVE:
+			// same DCC address, format, and speed/function group
+			return memcmp(&message_a[a], &message_b[b], 4) == 0;
+		case MSG_CS_ACCESSORY:
+			// same DCC address and port
+			return memcmp(&message_a[a], &message_b[b], 2) == 0 &&
+			       (message_a[a + 2] & 0x1F) == (message_b[b + 2] & 0x1F);
+		case MSG_ACCESSORY_SET:
+			// same accessory number
+			return message_a[a] == message_b[b];
+		case MSG_LC_OUTPUT:
+			// same port
+			return memcmp(&message_a[a], &message_b[b], 2) == 0;
+		default:
+			return false;
+	}
+}
+
+// Shall only be called with bidib_node_state_table_mutex acquired.
+// Replaces the content of the most recently queued message for the same object,
+// keeping its position and sequence number. Returns false if there is no such message.
+static bool bidib_node_coalesce_message(t_bidib_node_state *state, uint8_t type,
+                                        const uint8_t *const message, unsigned int action_id) {
+	for (GList *l = state->message_queue->tail; l != NULL; l = l->prev) {
+		t_bidib_message_queue_entry *queued_msg = l->data;
+		if (queued_msg->type == type && 
+		    bidib_messages_same_object(type, queued_msg->message, message)) {
+			const uint8_t seqnum = 
+			        queued_msg->message[bidib_message_seqnum_index(queued_msg->message)];
+			syslog_libbidib(LOG_NOTICE, 
+			                "Replaced queued msg with type: %s to: 0x%02x 0x%02x 0x%02x 0x%02x "
+			                "action id: %d by msg with action id: %d, message queue full",
+			                bidib_message_string_mapping[type], state->addr[0], state->addr[1],
+			                state->addr[2], state->addr[3], queued_msg->action_id, action_id);
+			if (queued_msg->action_id != action_id) {
+				bidib_node_remember_rejected(queued_msg->action_id);
+			}
+			bidib_memory_resize(BIDIB_MEMORY_MESSAGE_QUEUES, queued_msg->message[0] + 1,
+			                    message[0] + 1);
+			free(queued_msg->message);
+			queued_msg->message = malloc(sizeof(uint8_t) * (message[0] + 1));
+			memcpy(queued_msg->message, message, message[0] + 1);
+			queued_msg->message[bidib_message_seqnum_index(queued_msg->message)] = seqnum;
+			queued_msg->action_id = action_id;
+			clock_gettime(CLOCK_MONOTONIC, &queued_msg->enqueue_time);
+			state->coalesced_count++;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Shall only be called with bidib_node_state_table_mutex acquired.
+static void bidib_node_drop_expired_messages(t_bidib_node_state *state, 
+                                             const struct timespec *const now) {
+	while (!g_queue_is_empty(state->message_queue)) {
+		t_bidib_message_queue_entry *queued_msg = g_queue_peek_head(state->message_queue);
+		const int msg_class = bidib_message_class(queued_msg->type);
+		if (msg_class < 0 || message_class_ttl_ms[msg_class] == 0 ||
+		    bidib_elapsed_us(&queued_msg->enqueue_time, now) < 
+		    (uint64_t) message_class_ttl_ms[msg_class] * 1000) {
+			return;
+		}
+		syslog_libbidib(LOG_WARNING, 
+		                "Dropped expired msg with type: %s to: 0x%02x 0x%02x 0x%02x 0x%02x "
+		                "action id: %d",
+		                bidib_message_string_mapping[queued_msg->type], state->addr[0], 
+		                state->addr[1], state->addr[2], state->addr[3], queued_msg->action_id);
+		g_queue_pop_head(state->message_queue);
+		state->expired_count++;
+		drop_counters.dropped[msg_class]++;
+		if (queued_msg->action_id != 0) {
+			expired_action_ids[expired_action_ids_next] = queued_msg->action_id;
+			expired_action_ids_next = (expired_action_ids_next + 1) % REMEMBERED_ACTION_IDS_SIZE;
+		}
+		bidib_node_reclaim_seqnum(state, 
+		                          queued_msg->message[bidib_message_seqnum_index(queued_msg->message)]);
+		bidib_node_message_entry_free(queued_msg);
+	}
+}
+
+t_bidib_node_send_result bidib_node_try_send(const uint8_t *const addr_stack, uint8_t type,
+                                             const uint8_t *const message,
+                                             unsigned int action_id) {
 	pthread_mutex_lock(&bidib_node_state_table_mutex);
 	t_bidib_node_state *state = bidib_node_query(addr_stack);
 	int max_response = bidib_response_info[type][1];
-	bool status;
+	t_bidib_node_send_result status;
 	if (bidib_node_stall_ready(addr_stack) && g_queue_is_empty(state->message_queue) &&
 	    state->current_response_bytes + max_response <= response_limit) {
 		// Node is ready
 		bidib_node_state_add_response(type, state, max_response, action_id);
-		status = true;
+		status = BIDIB_NODE_SEND_READY;
 		syslog_libbidib(LOG_DEBUG, 
 		                "Expecting responses with a total of %d bytes from 0x%02x 0x%02x 0x%02x 0x%02x"
 						" after sending msg of type %s with action id: %d",
 		                state->current_response_bytes, addr_stack[0], addr_stack[1], addr_stack[2], 
 		                addr_stack[3], bidib_message_string_mapping[type], action_id);
-	} else {
+	} else if (queue_limit == 0 || g_queue_get_length(state->message_queue) < queue_limit) {
 		// Node is not ready
 		bidib_node_state_add_message(addr_stack, type, message, state, action_id);
-		status = false;
+		status = BIDIB_NODE_SEND_QUEUED;
+	} else {
+		// Node is not ready and its queue is full
+		if (bidib_node_coalesce_message(state, type, message, action_id)) {
+			status = BIDIB_NODE_SEND_QUEUED;
+		} else {
+			status = BIDIB_NODE_SEND_REJECTED;
+			state->rejected_count++;
+			bidib_node_remember_rejected(action_id);
+			syslog_libbidib(LOG_ERR, 
+			                "Rejected msg with type: %s to: 0x%02x 0x%02x 0x%02x 0x%02x "
+			                "action id: %d, message queue full",
+			                bidib_message_string_mapping[type], addr_stack[0], addr_stack[1], 
+			                addr_stack[2], addr_stack[3], action_id);
+		}
+		bidib_node_take_back_seqnum(state, message[bidib_message_seqnum_index(message)]);
 	}
 	pthread_mutex_unlock(&bidib_node_state_table_mutex);
 	return status;
 }
 
+// Shall only be called with bidib_node_state_table_mutex acquired.
+// Returns true if the head of the message queue was put into the send buffer.
+static bool bidib_node_try_queued_message(t_bidib_node_state *state) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	bidib_node_drop_expired_messages(state, &now);
+	if (g_queue_is_empty(state->message_queue) || !bidib_node_stall_ready((uint8_t *) state->addr)) {
+		return false;
+	}
+	t_bidib_message_queue_entry *queued_msg = g_queue_peek_head(state->message_queue);
+	if (state->current_response_bytes + bidib_response_info[queued_msg->type][1] > response_limit) {
+		syslog_libbidib(LOG_DEBUG, 
+		                "Unable to dequeue msg, response queue full. Msg info: "
+		                "type: %s to: 0x%02x 0x%02x 0x%02x 0x%02x action id: %d. "
+		                "Current response bytes: %d; size of response to add: %d",
+		                bidib_message_string_mapping[queued_msg->type], 
+		                state->addr[0], state->addr[1], state->addr[2], state->addr[3], 
+		                queued_msg->action_id, state->current_response_bytes, 
+		                bidib_response_info[queued_msg->type][1]);
+		return false;
+	}
+	// capacity sufficient -> send message
+	bidib_node_state_add_response(queued_msg->type, state,
+	                              bidib_response_info[queued_msg->type][1],
+	                              queued_msg->action_id);
+	bidib_add_to_buffer(queued_msg->message);
+	
+	const uint64_t queue_wait_us = bidib_elapsed_us(&queued_msg->enqueue_time, &now);
+	state->dequeued_count++;
+	state->total_queue_wait_us += queue_wait_us;
+	if (queue_wait_us > state->max_queue_wait_us) {
+		state->max_queue_wait_us = queue_wait_us;
+	}
+	syslog_libbidib(LOG_DEBUG, 
+	                "Dequeued msg with type: %s to: 0x%02x 0x%02x 0x%02x 0x%02x action id: %d "
+	                "after %" PRIu64 " us",
+	                bidib_message_string_mapping[queued_msg->type], state->addr[0], 
+	                state->addr[1], state->addr[2], state->addr[3], queued_msg->action_id,
+	                queue_wait_us);
+	g_queue_pop_head(state->message_queue);
+	bidib_node_message_entry_free(queued_msg);
+	return true;
+}
+
+// Shall only be called with bidib_node_state_table_mutex acquired.
 // Returns the number of sent (dequeued) messages
 static int bidib_node_try_queued_messages(t_bidib_node_state *state) {
 	if (state == NULL) {
@@ -180,34 +523,8 @@ static int bidib_node_try_queued_messages(t_bidib_node_state *state) {
 		return 0;
 	}
 	int sent_count = 0;
-	while (bidib_node_stall_ready((uint8_t *) state->addr) &&
-	       !g_queue_is_empty(state->message_queue)) {
-		t_bidib_message_queue_entry *queued_msg = g_queue_peek_head(state->message_queue);
-		if (state->current_response_bytes + bidib_response_info[queued_msg->type][1] <= response_limit) {
-			// capacity sufficient -> send messages
-			bidib_node_state_add_response(queued_msg->type, state,
-			                              bidib_response_info[queued_msg->type][1],
-			                              queued_msg->action_id);
-			bidib_add_to_buffer(queued_msg->message);
-			syslog_libbidib(LOG_DEBUG, 
-			                "Dequeued msg with type: %s to: 0x%02x 0x%02x 0x%02x 0x%02x action id: %d",
-			                bidib_message_string_mapping[queued_msg->type], state->addr[0], 
-			                state->addr[1], state->addr[2], state->addr[3], queued_msg->action_id);
-			g_queue_pop_head(state->message_queue);
-			free(queued_msg->message);
-			free(queued_msg);
-			sent_count++;
-		} else {
-			syslog_libbidib(LOG_DEBUG, 
-			                "Unable to dequeue msg, response queue full. Msg info: "
-			                "type: %s to: 0x%02x 0x%02x 0x%02x 0x%02x action id: %d. "
-			                "Current response bytes: %d; size of response to add: %d",
-			                bidib_message_string_mapping[queued_msg->type], 
-			                state->addr[0], state->addr[1], state->addr[2], state->addr[3], 
-			                queued_msg->action_id, state->current_response_bytes, 
-			                bidib_response_info[queued_msg->type][1]);
-			break;
-		}
+	while (bidib_node_try_queued_message(state)) {
+		sent_count++;
 	}
 	if (sent_count > 0) {
 		bidib_flush();
@@ -215,6 +532,55 @@ static int bidib_node_try_queued_messages(t_bidib_node_state *state) {
 	return sent_count;
 }
 
+/**
+ * Drains the message queues of several nodes with a deficit round robin, so that
+ * a node with a long queue does not delay the others. Each round, every node may
+ * send up to STALL_RELEASE_QUANTUM bytes (plus its unused deficit); all messages of a
+ * round share packets and are flushed once. A node leaves the round robin when its
+ * queue is empty or it cannot send (stall or response capacity), in the latter case
+ * its queue is continued by bidib_node_state_update.
+ * Shall only be called with bidib_node_state_table_mutex acquired.
+ * 
+ * @param ready_nodes the node states to drain, is emptied.
+ * @return the number of sent (dequeued) messages.
+ */
+static unsigned int bidib_node_try_queued_messages_fair(GQueue *ready_nodes) {
+	unsigned int sent_total = 0;
+	unsigned int rounds = 0;
+	while (!g_queue_is_empty(ready_nodes)) {
+		unsigned int sent_in_round = 0;
+		for (guint n = g_queue_get_length(ready_nodes); n > 0; n--) {
+			t_bidib_node_state *state = g_queue_pop_head(ready_nodes);
+			state->deficit += STALL_RELEASE_QUANTUM;
+			bool blocked = false;
+			while (!g_queue_is_empty(state->message_queue)) {
+				const t_bidib_message_queue_entry *head = g_queue_peek_head(state->message_queue);
+				const int msg_size = head->message[0] + 1;
+				if (msg_size > state->deficit) {
+					break;
+				} else if (!bidib_node_try_queued_message(state)) {
+					blocked = true;
+					break;
+				}
+				state->deficit -= msg_size;
+				sent_in_round++;
+			}
+			if (blocked || g_queue_is_empty(state->message_queue)) {
+				state->deficit = 0;
+			} else {
+				g_queue_push_tail(ready_nodes, state);
+			}
+		}
+		if (sent_in_round > 0) {
+			bidib_flush();
+		}
+		sent_total += sent_in_round;
+		rounds++;
+	}
+	syslog_libbidib(LOG_DEBUG, "Dequeued %u msgs in %u round(s)", sent_total, rounds);
+	return sent_total;
+}
+
 unsigned int bidib_node_state_update(const uint8_t *const addr_stack, uint8_t response_type) {
 	unsigned int action_id = 0;
 	pthread_mutex_lock(&bidib_node_state_table_mutex);
@@ -235,6 +601,7 @@ unsigned int bidib_node_state_update(const uint8_t *const addr_stack, uint8_t re
 				g_queue_pop_head(state->response_queue);
 				state->current_response_bytes -= bidib_response_info[response->type][1];
 				action_id = response->action_id;
+				bidib_memory_free(BIDIB_MEMORY_RESPONSE_QUEUES, sizeof(*response));
 				free(response);
 				response = NULL;
 				sent_msgs += bidib_node_try_queued_messages(state);
@@ -250,6 +617,7 @@ unsigned int bidib_node_state_update(const uint8_t *const addr_stack, uint8_t re
 				                RESPONSE_QUEUE_EXPIRATION_SECS);
 				g_queue_pop_head(state->response_queue);
 				state->current_response_bytes -= bidib_response_info[response->type][1];
+				bidib_memory_free(BIDIB_MEMORY_RESPONSE_QUEUES, sizeof(*response));
 				free(response);
 				response = NULL;
 				if (!g_queue_is_empty(state->response_queue)) {
@@ -283,17 +651,22 @@ void bidib_node_update_stall(const uint8_t *const addr_stack, uint8_t stall_stat
 		t_bidib_stall_queue_entry *elem;
 		// Node is not stalled anymore. Therefore, for all nodes in the stall_affected_nodes_queue,
 		// i.e. nodes that were stalled because this/their supernode was stalled,
-		// try to send any queued messages.
+		// try to send any queued messages, taking turns between the nodes.
+		GQueue *ready_nodes = g_queue_new();
 		while (!g_queue_is_empty(state->stall_affected_nodes_queue)) {
 			elem = g_queue_pop_head(state->stall_affected_nodes_queue);
 			t_bidib_node_state *waiting_node_state = g_hash_table_lookup(
 					node_state_table, elem->addr);
 			if (waiting_node_state != NULL) {
-				bidib_node_try_queued_messages(waiting_node_state);
+				waiting_node_state->deficit = 0;
+				g_queue_push_tail(ready_nodes, waiting_node_state);
 			}
+			bidib_memory_free(BIDIB_MEMORY_STALL_ENTRIES, sizeof(*elem));
 			free(elem);
 			elem = NULL;
 		}
+		bidib_node_try_queued_messages_fair(ready_nodes);
+		g_queue_free(ready_nodes);
 	} else {
 		state->stall = true;
 		syslog_libbidib(LOG_WARNING, "Stall active for: 0x%02x 0x%02x 0x%02x 0x%02x",
@@ -302,35 +675,124 @@ void bidib_node_update_stall(const uint8_t *const addr_stack, uint8_t stall_stat
 	pthread_mutex_unlock(&bidib_node_state_table_mutex);
 }
 
-static uint8_t bidib_get_and_incr_seqnum(uint8_t *seqnum) {
-	if (*seqnum == 255) {
-		*seqnum = 0x01;
-		return 255;
+static uint8_t bidib_get_and_incr_seqnum(_Atomic uint8_t *seqnum) {
+	uint8_t current = atomic_load_explicit(seqnum, memory_order_relaxed);
+	while (!atomic_compare_exchange_weak_explicit(seqnum, &current, bidib_next_seqnum(current),
+	                                              memory_order_relaxed, memory_order_relaxed)) {
+		// current was updated to the latest value, retry
 	}
-	return (*seqnum)++;
+	return current;
 }
 
-uint8_t bidib_node_state_get_and_incr_receive_seqnum(const uint8_t *const addr_stack) {
+uint8_t bidib_node_state_sync_receive_seqnum(const uint8_t *const addr_stack, uint8_t msg_seqnum) {
+	// Whether or not the sequence number matches, the next message is expected
+	// to carry the successor of the received one.
+	t_bidib_node_seqnums *seqnums = bidib_node_seqnums_lookup(addr_stack);
+	if (seqnums != NULL) {
+		return atomic_exchange_explicit(&seqnums->receive_seqnum, bidib_next_seqnum(msg_seqnum),
+		                                memory_order_relaxed);
+	}
 	pthread_mutex_lock(&bidib_node_state_table_mutex);
 	t_bidib_node_state *state = bidib_node_query(addr_stack);
-	uint8_t seqnum = bidib_get_and_incr_seqnum(&state->receive_seqnum);
+	uint8_t expected = atomic_exchange_explicit(&state->seqnums->receive_seqnum,
+	                                            bidib_next_seqnum(msg_seqnum),
+	                                            memory_order_relaxed);
 	pthread_mutex_unlock(&bidib_node_state_table_mutex);
-	return seqnum;
+	return expected;
 }
 
 uint8_t bidib_node_state_get_and_incr_send_seqnum(const uint8_t *const addr_stack) {
+	t_bidib_node_seqnums *seqnums = bidib_node_seqnums_lookup(addr_stack);
+	if (seqnums != NULL) {
+		return bidib_get_and_incr_seqnum(&seqnums->send_seqnum);
+	}
+	// Node not yet known (or index exhausted)
 	pthread_mutex_lock(&bidib_node_state_table_mutex);
 	t_bidib_node_state *state = bidib_node_query(addr_stack);
-	uint8_t seqnum = bidib_get_and_incr_seqnum(&state->send_seqnum);
+	uint8_t seqnum = bidib_get_and_incr_seqnum(&state->seqnums->send_seqnum);
 	pthread_mutex_unlock(&bidib_node_state_table_mutex);
 	return seqnum;
 }
 
-void bidib_node_state_set_receive_seqnum(const uint8_t *const addr_stack, uint8_t seqnum) {
+void bidib_set_message_class_ttl(t_bidib_message_class message_class, unsigned int ttl_ms) {
+	if (message_class >= BIDIB_MSG_CLASS_COUNT) {
+		syslog_libbidib(LOG_ERR, "Set message class ttl: invalid message class %d", message_class);
+		return;
+	}
 	pthread_mutex_lock(&bidib_node_state_table_mutex);
-	t_bidib_node_state *state = bidib_node_query(addr_stack);
-	state->receive_seqnum = seqnum;
+	message_class_ttl_ms[message_class] = ttl_ms;
 	pthread_mutex_unlock(&bidib_node_state_table_mutex);
+	syslog_libbidib(LOG_INFO, "Time-to-live of message class %d set to %u ms", 
+	                message_class, ttl_ms);
+}
+
+bool bidib_is_action_id_expired(unsigned int action_id) {
+	if (action_id == 0) {
+		return false;
+	}
+	bool expired = false;
+	pthread_mutex_lock(&bidib_node_state_table_mutex);
+	for (size_t i = 0; i < REMEMBERED_ACTION_IDS_SIZE; i++) {
+		if (expired_action_ids[i] == action_id) {
+			expired = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&bidib_node_state_table_mutex);
+	return expired;
+}
+
+bool bidib_is_action_id_rejected(unsigned int action_id) {
+	if (action_id == 0) {
+		return false;
+	}
+	bool rejected = false;
+	pthread_mutex_lock(&bidib_node_state_table_mutex);
+	for (size_t i = 0; i < REMEMBERED_ACTION_IDS_SIZE; i++) {
+		if (rejected_action_ids[i] == action_id) {
+			rejected = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&bidib_node_state_table_mutex);
+	return rejected;
+}
+
+t_bidib_message_drop_counters bidib_get_message_drop_counters(void) {
+	pthread_mutex_lock(&bidib_node_state_table_mutex);
+	t_bidib_message_drop_counters counters = drop_counters;
+	pthread_mutex_unlock(&bidib_node_state_table_mutex);
+	return counters;
+}
+
+t_bidib_node_tx_status_query bidib_get_node_tx_status(t_bidib_node_address node_address) {
+	const uint8_t addr_stack[] = {node_address.top, node_address.sub, node_address.subsub, 0x00};
+	t_bidib_node_tx_status_query query = {0};
+	pthread_mutex_lock(&bidib_node_state_table_mutex);
+	const t_bidib_node_state *const state = g_hash_table_lookup(node_state_table, addr_stack);
+	if (state != NULL) {
+		query.known = true;
+		query.stall = state->stall;
+		query.current_response_bytes = state->current_response_bytes;
+		query.max_response_bytes = response_limit;
+		query.response_queue_length = g_queue_get_length(state->response_queue);
+		query.message_queue_length = g_queue_get_length(state->message_queue);
+		query.dequeued_count = state->dequeued_count;
+		query.total_queue_wait_us = state->total_queue_wait_us;
+		query.max_queue_wait_us = state->max_queue_wait_us;
+		query.expired_count = state->expired_count;
+		query.rejected_count = state->rejected_count;
+		query.coalesced_count = state->coalesced_count;
+	}
+	pthread_mutex_unlock(&bidib_node_state_table_mutex);
+	return query;
+}
+
+void bidib_set_node_queue_limit(unsigned int max_queued_messages) {
+	pthread_mutex_lock(&bidib_node_state_table_mutex);
+	queue_limit = max_queued_messages;
+	pthread_mutex_unlock(&bidib_node_state_table_mutex);
+	syslog_libbidib(LOG_INFO, "Message queue limit per node set to %u", max_queued_messages);
 }
 
 void bidib_node_state_table_reset(bool lock_node_state_table_access) {
@@ -345,25 +807,32 @@ void bidib_node_state_table_reset(bool lock_node_state_table_access) {
 		if (value != NULL) {
 			while (!g_queue_is_empty(value->stall_affected_nodes_queue)) {
 				t_bidib_stall_queue_entry *elem0 = g_queue_pop_head(value->stall_affected_nodes_queue);
+				bidib_memory_free(BIDIB_MEMORY_STALL_ENTRIES, sizeof(*elem0));
 				free(elem0);
 			}
 			g_queue_free(value->stall_affected_nodes_queue);
 			while (!g_queue_is_empty(value->response_queue)) {
 				t_bidib_response_queue_entry *elem1 = g_queue_pop_head(value->response_queue);
+				bidib_memory_free(BIDIB_MEMORY_RESPONSE_QUEUES, sizeof(*elem1));
 				free(elem1);
 			}
 			g_queue_free(value->response_queue);
 			while (!g_queue_is_empty(value->message_queue)) {
 				t_bidib_message_queue_entry *elem2 = g_queue_pop_head(value->message_queue);
-				free(elem2->message);
-				free(elem2);
+				bidib_node_message_entry_free(elem2);
 			}
 			g_queue_free(value->message_queue);
+			bidib_memory_free(BIDIB_MEMORY_NODE_STATES, sizeof(*value) + 3 * sizeof(GQueue));
 			free(value);
 			value = NULL;
 			g_hash_table_iter_remove(&iter);
 		}
 	}
+	// Slots of the sequence number index stay claimed, only the sequence numbers are reset
+	for (size_t i = 0; i < NODE_SEQNUMS_INDEX_SIZE; i++) {
+		atomic_store_explicit(&node_seqnums_index[i].receive_seqnum, 0x01, memory_order_relaxed);
+		atomic_store_explicit(&node_seqnums_index[i].send_seqnum, 0x01, memory_order_relaxed);
+	}
 	if (lock_node_state_table_access) {
 		pthread_mutex_unlock(&bidib_node_state_table_mutex);
 	}
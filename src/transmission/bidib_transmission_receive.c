@@ -80,6 +80,7 @@ void bidib_set_lowlevel_debug_mode(bool uplink_debug_mode_on) {
 
 static void bidib_message_queue_free_head(GQueue *queue) {
 	t_bidib_message_queue_entry *elem = g_queue_pop_head(queue);
+	bidib_memory_free(BIDIB_MEMORY_UPLINK_QUEUES, sizeof(*elem) + elem->message[0] + 1);
 	free(elem->message);
 	free(elem);
 	elem = NULL;
@@ -184,6 +185,9 @@ static void bidib_message_queue_add(GQueue *queue, uint8_t *message,
 	message_queue_entry->type = type;
 	memcpy(message_queue_entry->addr, addr_stack, 4);
 	message_queue_entry->message = message;
+	bidib_memory_free(BIDIB_MEMORY_RECEIVED_MESSAGES, message[0] + 1);
+	bidib_memory_alloc(BIDIB_MEMORY_UPLINK_QUEUES,
+	                   sizeof(*message_queue_entry) + message[0] + 1);
 	if (g_queue_get_length(queue) == QUEUE_SIZE) {
 		syslog_libbidib(LOG_WARNING, "A queue is full, dropping its oldest element!");
 		bidib_message_queue_free_head(queue);
@@ -272,7 +276,7 @@ static void bidib_log_sys_error(const uint8_t *const message,
 		g_string_printf(fault_name, "UNKNOWN");
 	}
 	syslog_libbidib(LOG_ERR, "Feedback for action id %d: MSG_SYS_ERROR (board: %s) type: %s (0x%02x): %s", 
-	                action_id, board != NULL ? board->id->str : "UNKNOWN", 
+	                action_id, board != NULL ? board->id : "UNKNOWN", 
 	                err_name, error_type, fault_name->str);
 	g_string_free(fault_name, TRUE);
 }
@@ -292,7 +296,7 @@ static void bidib_log_boost_stat_error(const uint8_t *const message,
 		g_string_printf(fault_name, "UNKNOWN");
 	}
 	syslog_libbidib(LOG_ERR, "Feedback for action id %d: MSG_BOOST_STAT (board: %s) has error: %s", 
-	                action_id, board != NULL ? board->id->str : "UNKNOWN", fault_name->str);
+	                action_id, board != NULL ? board->id : "UNKNOWN", fault_name->str);
 	g_string_free(fault_name, TRUE);
 }
 
@@ -311,13 +315,20 @@ static void bidib_log_boost_stat_okay(const uint8_t *const message,
 		g_string_printf(msg_name, "UNKNOWN");
 	}
 	syslog_libbidib(LOG_INFO, "Feedback for action id %d: MSG_BOOST_STAT (board: %s) has state: %s", 
-	                action_id, board != NULL ? board->id->str : "UNKNOWN", msg_name->str);
+	                action_id, board != NULL ? board->id : "UNKNOWN", msg_name->str);
 	g_string_free(msg_name, TRUE);
 }
 
+// Frees a received message that is not handed over to a queue
+static void bidib_received_message_free(uint8_t *message) {
+	bidib_memory_free(BIDIB_MEMORY_RECEIVED_MESSAGES, message[0] + 1);
+	free(message);
+}
+
 void bidib_handle_received_message(uint8_t *message, uint8_t type,
                                    const uint8_t *const addr_stack, uint8_t seqnum,
                                    unsigned int action_id) {
+	bidib_memory_alloc(BIDIB_MEMORY_RECEIVED_MESSAGES, message[0] + 1);
 	if (type != MSG_STALL && bidib_lowlevel_debug_mode) {
 		// add to message queue
 		bidib_uplink_queue_add(message, type, addr_stack);
@@ -337,7 +348,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			bidib_log_received_message(addr_stack, seqnum, type, LOG_INFO,
 			                           message, action_id);
 			bidib_state_packet_capacity(message[data_index]);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_NODE_LOST:
 			// update state
@@ -353,7 +364,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			bidib_state_node_lost(unique_id);
 			bidib_send_node_changed_ack(node_address, message[data_index], 0);
 			bidib_flush();
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_NODE_NEW:
 			// update state
@@ -369,20 +380,20 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			bidib_state_node_new(node_address, message[data_index + 1], unique_id);
 			bidib_send_node_changed_ack(node_address, message[data_index], 0);
 			bidib_flush();
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_STALL:
 			bidib_log_received_message(addr_stack, seqnum, type, LOG_INFO,
 			                           message, action_id);
 			bidib_node_update_stall(addr_stack, message[message[0]]);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_CS_STATE:
 			// update state
 			bidib_log_received_message(addr_stack, seqnum, type, LOG_DEBUG,
 			                           message, action_id);
 			bidib_state_cs_state(node_address, message[data_index], action_id);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_CS_DRIVE_ACK:
 			// update state
@@ -391,7 +402,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			dcc_address.addrl = message[data_index];
 			dcc_address.addrh = message[data_index + 1];
 			bidib_state_cs_drive_ack(dcc_address, message[data_index + 2], action_id);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_CS_ACCESSORY_ACK:
 			// update state
@@ -406,7 +417,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			                             message[data_index + 2]);
 			pthread_rwlock_unlock(&bidib_boards_rwlock);
 			pthread_mutex_unlock(&trackstate_accessories_mutex);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_CS_DRIVE_MANUAL:
 			// update state
@@ -425,7 +436,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			pthread_rwlock_wrlock(&bidib_trains_rwlock);
 			bidib_state_cs_drive(cs_drive_params);
 			pthread_rwlock_unlock(&bidib_trains_rwlock);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_CS_ACCESSORY_MANUAL:
 			// update state
@@ -439,7 +450,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			bidib_state_cs_accessory_manual(node_address, dcc_address, message[data_index + 2]);
 			pthread_rwlock_unlock(&bidib_boards_rwlock);
 			pthread_mutex_unlock(&trackstate_accessories_mutex);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_LC_STAT:
 			// update state
@@ -450,7 +461,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			peripheral_port.port0 = message[data_index];
 			peripheral_port.port1 = message[data_index + 1];
 			bidib_state_lc_stat(node_address, peripheral_port, message[data_index + 2], action_id);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_LC_WAIT:
 			// update state
@@ -459,7 +470,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			peripheral_port.port0 = message[data_index];
 			peripheral_port.port1 = message[data_index + 1];
 			bidib_state_lc_wait(node_address, peripheral_port, message[data_index + 2]);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_BM_OCC:
 			// update state
@@ -474,7 +485,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 				bidib_send_bm_mirror_occ(node_address, message[data_index], 0);
 				bidib_flush();
 			}
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_BM_FREE:
 			// update state
@@ -489,7 +500,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 				bidib_send_bm_mirror_free(node_address, message[data_index], 0);
 				bidib_flush();
 			}
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_BM_MULTIPLE:
 			// update state
@@ -506,7 +517,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 				                              message[data_index + 1], &message[data_index + 2], 0);
 				bidib_flush();
 			}
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_BM_CONFIDENCE:
 			// update state
@@ -515,7 +526,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			bidib_state_bm_confidence(node_address, message[data_index],
 			                          message[data_index + 1], message[data_index + 2],
 			                          action_id);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_BM_ADDRESS:
 			// update state
@@ -524,7 +535,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			bidib_state_bm_address(node_address, message[data_index],
 			                       (uint8_t) ((message[0] - data_index) / 2),
 			                       &message[data_index + 1]);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_BM_CURRENT:
 			// update state
@@ -532,7 +543,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			                           message, action_id);
 			bidib_state_bm_current(node_address, message[data_index],
 			                       message[data_index + 1]);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_BM_SPEED:
 			// update state
@@ -542,7 +553,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			dcc_address.addrh = message[data_index + 1];
 			bidib_state_bm_speed(dcc_address, message[data_index + 2],
 			                     message[data_index + 3]);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_BM_DYN_STATE:
 			// update state
@@ -552,7 +563,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			dcc_address.addrh = message[data_index + 2];
 			bidib_state_bm_dyn_state(dcc_address, message[data_index + 3],
 			                         message[data_index + 4], action_id);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_BOOST_DIAGNOSTIC:
 			// update state
@@ -561,7 +572,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			bidib_state_boost_diagnostic(node_address,
 			                             (uint8_t) (message[0] - data_index + 1),
 			                             &message[data_index], action_id);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_ACCESSORY_STATE:
 			// update state and check if error
@@ -575,7 +586,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 				// add to error queue
 				bidib_uplink_error_queue_add(message, type, addr_stack);
 			} else {
-				free(message);
+				bidib_received_message_free(message);
 			}
 			break;
 		case MSG_ACCESSORY_NOTIFY:
@@ -592,7 +603,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 				// add to error queue
 				bidib_uplink_error_queue_add(message, type, addr_stack);
 			} else {
-				free(message);
+				bidib_received_message_free(message);
 			}
 			break;
 		case MSG_BOOST_STAT:
@@ -614,7 +625,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 				pthread_rwlock_rdlock(&bidib_boards_rwlock);
 				bidib_log_boost_stat_okay(message, node_address, action_id);
 				pthread_rwlock_unlock(&bidib_boards_rwlock);
-				free(message);
+				bidib_received_message_free(message);
 			}
 			break;
 		case MSG_CS_DRIVE_EVENT:
@@ -627,7 +638,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			} else {
 				bidib_log_received_message(addr_stack, seqnum, type, LOG_INFO,
 				                           message, action_id);
-				free(message);
+				bidib_received_message_free(message);
 			}
 			break;
 		case MSG_SYS_MAGIC:
@@ -678,7 +689,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 			                           message, action_id);
 			bidib_state_vendor(node_address, (uint8_t) (message[0] - data_index + 1),
 			                   &message[data_index], action_id);
-			free(message);
+			bidib_received_message_free(message);
 			break;
 		case MSG_SYS_PONG:
 		case MSG_SYS_P_VERSION:
@@ -708,6 +719,7 @@ void bidib_handle_received_message(uint8_t *message, uint8_t type,
 }
 
 // FIXME: Possible memory leak of 5 bytes? Message malloc not being freed?
+// A leaked message stays accounted in BIDIB_MEMORY_RECEIVED_MESSAGES of bidib_get_memory_stats.
 static void bidib_split_packet(const uint8_t *const buffer, size_t buffer_size) {
 	// j tracks the message size in terms of buffer elements.
 	size_t j = 0;
@@ -732,15 +744,11 @@ static void bidib_split_packet(const uint8_t *const buffer, size_t buffer_size)
 		uint8_t msg_seqnum = bidib_extract_seq_num(message);
 
 		if (msg_seqnum != 0x00) {
-			uint8_t expected_seqnum = bidib_node_state_get_and_incr_receive_seqnum(addr_stack);
+			// Also resynchronises the expected sequence number in case of a mismatch
+			uint8_t expected_seqnum = bidib_node_state_sync_receive_seqnum(addr_stack, msg_seqnum);
 			if (msg_seqnum != expected_seqnum) {
 				// Handle wrong sequence numbers
 				syslog_libbidib(LOG_ERR, "Wrong sequence number, expected %d", expected_seqnum);
-				if (msg_seqnum == 255) {
-					bidib_node_state_set_receive_seqnum(addr_stack, 0x01);
-				} else {
-					bidib_node_state_set_receive_seqnum(addr_stack, ++msg_seqnum);
-				}
 			}
 		}
 		clock_gettime(CLOCK_MONOTONIC_RAW, &end);
@@ -789,6 +797,8 @@ static void bidib_receive_packet(void) {
 	while (bidib_running && !bidib_discard_rx) {
 		data = read_byte(&read_byte_success);
 		while (!read_byte_success) {
+			// Publish the state updates of other threads while idle
+			bidib_state_snapshot_publish();
 			usleep(5000); // 0.005s
 			data = read_byte(&read_byte_success);
 			if (!bidib_running || bidib_discard_rx) {
@@ -827,7 +837,11 @@ static void bidib_receive_packet(void) {
 	if (crc == 0x00) {
 		// Split packet in messages and add them to queue, exclude crc sum
 		buffer_index--;
+		// The state entries that the messages update record when the packet arrived
+		bidib_state_set_receive_time((uint64_t) tv.tv_sec * 1000000000ULL + (uint64_t) tv.tv_nsec);
 		bidib_split_packet(buffer, buffer_index);
+		bidib_state_set_receive_time(0);
+		bidib_state_snapshot_publish();
 	} else {
 		syslog_libbidib(LOG_ERR, "CRC wrong, packet ignored");
 	}
@@ -874,6 +888,8 @@ static uint8_t *bidib_read_message_from_queue(GQueue *queue) {
 	if (!g_queue_is_empty(queue)) {
 		t_bidib_message_queue_entry *entry = g_queue_pop_head(queue);
 		message = entry->message;
+		// The application owns the message from now on
+		bidib_memory_free(BIDIB_MEMORY_UPLINK_QUEUES, sizeof(*entry) + message[0] + 1);
 		free(entry);
 	}
 	return message;
@@ -50,6 +50,8 @@ static volatile unsigned int pkt_max_cap = 64;
 static volatile uint8_t buffer[PACKET_BUFFER_SIZE];
 static volatile uint8_t buffer_aux[PACKET_BUFFER_AUX_SIZE];
 static volatile size_t buffer_index = 0;
+// Number of batches being buffered, the auto flush skips while there is one
+static unsigned int flush_holds = 0;
 
 void bidib_set_write_n_dest(void (*write_n)(uint8_t*, int32_t)) {
 	write_bytes = write_n;
@@ -157,7 +159,9 @@ void bidib_flush(void) {
 void *bidib_auto_flush(void *interval) {
 	while (bidib_running) {
 		pthread_mutex_lock(&bidib_send_buffer_mutex);
-		bidib_flush_impl();
+		if (flush_holds == 0) {
+			bidib_flush_impl();
+		}
 		pthread_mutex_unlock(&bidib_send_buffer_mutex);
 		unsigned int interval_ms = 1000 * *((unsigned int *) (interval));
 		usleep(interval_ms);
@@ -166,6 +170,23 @@ void *bidib_auto_flush(void *interval) {
 	return NULL;
 }
 
+void bidib_hold_flush(void) {
+	pthread_mutex_lock(&bidib_send_buffer_mutex);
+	flush_holds++;
+	pthread_mutex_unlock(&bidib_send_buffer_mutex);
+}
+
+void bidib_release_flush(void) {
+	pthread_mutex_lock(&bidib_send_buffer_mutex);
+	if (flush_holds > 0) {
+		flush_holds--;
+	}
+	if (flush_holds == 0) {
+		bidib_flush_impl();
+	}
+	pthread_mutex_unlock(&bidib_send_buffer_mutex);
+}
+
 void bidib_add_to_buffer(const uint8_t *const message) {
 	pthread_mutex_lock(&bidib_send_buffer_mutex);
 	if (message[0] + 1 + buffer_index > pkt_max_cap) {
@@ -195,20 +216,25 @@ static void bidib_log_send_message(uint8_t message_type, const uint8_t *const ad
 	syslog_libbidib(LOG_DEBUG, "Message bytes to send: %s", hex_string);
 }
 
-static void bidib_buffer_message(uint8_t seqnum, uint8_t type,
-                                 const uint8_t *const message, unsigned int action_id) {
+static t_bidib_node_send_result bidib_buffer_message(uint8_t seqnum, uint8_t type,
+                                                     const uint8_t *const message,
+                                                     unsigned int action_id) {
 	uint8_t addr[4];
 	bidib_extract_address(message, addr);
 	bidib_log_send_message(type, addr, seqnum, message, action_id);
-	if (bidib_node_try_send(addr, type, message, action_id)) {
+	const t_bidib_node_send_result result = bidib_node_try_send(addr, type, message, action_id);
+	if (result == BIDIB_NODE_SEND_READY) {
 		// Node is ready -> Put in send buffer
-		// If node is not ready, the node enqueues the message so nothing else to do here.
+		// If node is not ready, the node enqueues (or rejects) the message so nothing
+		// else to do here.
 		bidib_add_to_buffer(message);
 	}
+	return result;
 }
 
-void bidib_buffer_message_without_data(const uint8_t *const addr_stack, uint8_t msg_type,
-                                       unsigned int action_id) {
+t_bidib_node_send_result bidib_buffer_message_without_data(const uint8_t *const addr_stack,
+                                                           uint8_t msg_type,
+                                                           unsigned int action_id) {
 	// Determine message size
 	uint8_t message_length = 0;
 	uint8_t addr_stack_size = 0;
@@ -240,12 +266,13 @@ void bidib_buffer_message_without_data(const uint8_t *const addr_stack, uint8_t
 	message[addr_stack_size + 2] = msg_type;
 
 	// Buffer message
-	bidib_buffer_message(seqnum, msg_type, message, action_id);
+	return bidib_buffer_message(seqnum, msg_type, message, action_id);
 }
 
-void bidib_buffer_message_with_data(const uint8_t *const addr_stack, uint8_t msg_type,
-                                    uint8_t data_length, const uint8_t *const data,
-                                    unsigned int action_id) {
+t_bidib_node_send_result bidib_buffer_message_with_data(const uint8_t *const addr_stack,
+                                                        uint8_t msg_type, uint8_t data_length,
+                                                        const uint8_t *const data,
+                                                        unsigned int action_id) {
 	// Determine message size
 	uint8_t message_length = data_length;
 	uint8_t addr_stack_size = 0;
@@ -280,5 +307,5 @@ void bidib_buffer_message_with_data(const uint8_t *const addr_stack, uint8_t msg
 	}
 
 	// Buffer message
-	bidib_buffer_message(seqnum, msg_type, message, action_id);
+	return bidib_buffer_message(seqnum, msg_type, message, action_id);
 }
@@ -0,0 +1,300 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "../../include/bidib.h"
+#include "../../src/state/bidib_state_intern.h"
+#include "../../src/state/bidib_state_setter_intern.h"
+#include "../../src/transmission/bidib_transmission_intern.h"
+
+
+// Sets a route of 30 board points spread over several boards, once with one
+// bidib_switch_point per point and once with bidib_set_route, and measures how
+// long the calls take, how many packets are sent and when all points reported
+// their aspect. Each simulated board switches its points one after another,
+// the boards work in parallel.
+
+#define BOARD_COUNT 6
+#define POINTS_PER_BOARD 5
+#define ROUTE_LENGTH (BOARD_COUNT * POINTS_PER_BOARD)
+#define RUNS 100
+#define SWITCH_US 2000
+#define FLUSH_INTERVAL_MS 5
+#define TIMEOUT_MS 2000
+
+typedef struct {
+	uint8_t number;
+	uint8_t aspect;
+} t_bench_command;
+
+typedef struct {
+	pthread_t thread;
+	uint8_t address;
+	GQueue *commands;
+} t_bench_board;
+
+static pthread_mutex_t bench_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bench_cond = PTHREAD_COND_INITIALIZER;
+static t_bench_board bench_boards[BOARD_COUNT];
+static atomic_bool bench_running;
+static atomic_ulong bench_packets;
+
+// Unescaped bytes of the packet being written
+static uint8_t packet[512];
+static size_t packet_length = 0;
+static bool packet_escape = false;
+
+static uint8_t read_byte(int *byte_read) {
+	*byte_read = 0;
+	return 0x00;
+}
+
+// Hands the MSG_ACCESSORY_SET messages of a packet to the simulated boards.
+// Shall only be called with bench_mutex acquired.
+static void bench_dispatch_packet(void) {
+	// The last byte is the CRC
+	for (size_t i = 0; i + 1 < packet_length; i += packet[i] + 1) {
+		const uint8_t *message = &packet[i];
+		if (bidib_extract_msg_type(message) != MSG_ACCESSORY_SET) {
+			continue;
+		}
+		uint8_t addr_stack[4];
+		bidib_extract_address(message, addr_stack);
+		const int data_index = bidib_first_data_byte_index(message);
+		for (size_t j = 0; j < BOARD_COUNT; j++) {
+			if (bench_boards[j].address == addr_stack[0]) {
+				t_bench_command *command = malloc(sizeof(t_bench_command));
+				command->number = message[data_index];
+				command->aspect = message[data_index + 1];
+				g_queue_push_tail(bench_boards[j].commands, command);
+			}
+		}
+	}
+	pthread_cond_broadcast(&bench_cond);
+}
+
+static void write_bytes(uint8_t *msg, int32_t len) {
+	pthread_mutex_lock(&bench_mutex);
+	for (int32_t i = 0; i < len; i++) {
+		if (msg[i] == BIDIB_PKT_MAGIC) {
+			if (packet_length > 0) {
+				bench_dispatch_packet();
+				atomic_fetch_add(&bench_packets, 1);
+			}
+			packet_length = 0;
+		} else if (msg[i] == BIDIB_PKT_ESCAPE) {
+			packet_escape = true;
+		} else if (packet_length < sizeof(packet)) {
+			packet[packet_length++] = packet_escape ? msg[i] ^ 0x20 : msg[i];
+			packet_escape = false;
+		}
+	}
+	pthread_mutex_unlock(&bench_mutex);
+}
+
+// Switches the points of a board one after another and reports each of them
+static void *bench_board(void *arg) {
+	t_bench_board *board = arg;
+	const uint8_t addr_stack[4] = {board->address, 0x00, 0x00, 0x00};
+	const t_bidib_node_address node_address = {board->address, 0x00, 0x00};
+	pthread_mutex_lock(&bench_mutex);
+	while (atomic_load(&bench_running)) {
+		t_bench_command *command = g_queue_pop_head(board->commands);
+		if (command == NULL) {
+			pthread_cond_wait(&bench_cond, &bench_mutex);
+			continue;
+		}
+		// The library may send queued messages from within, which writes packets
+		pthread_mutex_unlock(&bench_mutex);
+		usleep(SWITCH_US);
+		const unsigned int action_id = bidib_node_state_update(addr_stack, MSG_ACCESSORY_STATE);
+		bidib_state_accessory_state(node_address, command->number, command->aspect, 2,
+		                            BIDIB_EXEC_STATE_REACHED_VERIFIED, 0, action_id);
+		free(command);
+		pthread_mutex_lock(&bench_mutex);
+	}
+	pthread_mutex_unlock(&bench_mutex);
+	return NULL;
+}
+
+static bool bench_write_config(const char *dir) {
+	char path[512];
+	snprintf(path, sizeof(path), "%s/bidib_board_config.yml", dir);
+	FILE *boards = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/bidib_track_config.yml", dir);
+	FILE *track = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/bidib_train_config.yml", dir);
+	FILE *trains = fopen(path, "w");
+	if (boards == NULL || track == NULL || trains == NULL) {
+		return false;
+	}
+	fprintf(boards, "boards:\n");
+	fprintf(track, "boards:\n");
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		fprintf(boards, "  - id: board%d\n    unique-id: 0x0500000000%04X\n", i, i + 1);
+		fprintf(track, "  - id: board%d\n    points-board:\n", i);
+		for (int j = 0; j < POINTS_PER_BOARD; j++) {
+			fprintf(track, "      - id: point%d_%d\n        number: 0x%02X\n"
+			        "        aspects:\n          - id: normal\n            value: 0x00\n"
+			        "          - id: reverse\n            value: 0x01\n", i, j, j);
+		}
+	}
+	fprintf(trains, "trains:\n  - id: train1\n    dcc-address: 0x0001\n"
+	        "    dcc-speed-steps: 126\n");
+	fclose(boards);
+	fclose(track);
+	fclose(trains);
+	return true;
+}
+
+static uint64_t bench_elapsed_us(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) ((now.tv_sec - start->tv_sec) * 1000000
+	                   + (now.tv_nsec - start->tv_nsec) / 1000);
+}
+
+static void bench_print(const char *name, uint64_t issue_us, uint64_t complete_us,
+                        unsigned long packets, unsigned int failed) {
+	printf("%-20s %8.1f us issue %8.1f us complete %6.1f packets/route %u timeouts\n",
+	       name, (double) issue_us / RUNS, (double) complete_us / RUNS,
+	       (double) packets / RUNS, failed);
+}
+
+// Sets the route with one bidib_switch_point per point, flushing after each call
+// as an application serving one request per point does, or once after all calls
+static unsigned int bench_switch_points(const char *name, char ids[][32],
+                                        const char *const *aspects, bool flush_each) {
+	uint64_t issue_us = 0, complete_us = 0;
+	unsigned int failed = 0;
+	atomic_store(&bench_packets, 0);
+	for (int run = 0; run < RUNS; run++) {
+		const char *aspect = aspects[run & 0x01];
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int i = 0; i < ROUTE_LENGTH; i++) {
+			bidib_switch_point(ids[i], aspect);
+			if (flush_each) {
+				bidib_flush();
+			}
+		}
+		bidib_flush();
+		issue_us += bench_elapsed_us(&start);
+		for (int i = 0; i < ROUTE_LENGTH; i++) {
+			failed += !bidib_wait_point_state(ids[i], aspect, TIMEOUT_MS);
+		}
+		complete_us += bench_elapsed_us(&start);
+	}
+	bench_print(name, issue_us, complete_us, atomic_load(&bench_packets), failed);
+	return failed;
+}
+
+int main(void) {
+	char dir[] = "/tmp/bidib_route_benchmark_XXXXXX";
+	bidib_set_lowlevel_debug_mode(true);
+	if (mkdtemp(dir) == NULL || !bench_write_config(dir) ||
+	    bidib_start_pointer(&read_byte, &write_bytes, dir, FLUSH_INTERVAL_MS)) {
+		fprintf(stderr, "Could not start the library\n");
+		return 1;
+	}
+	// Leave the log of every message out of the measurement
+	setlogmask(LOG_UPTO(LOG_WARNING));
+	atomic_store(&bench_running, true);
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		t_bidib_unique_id_mod unique_id = {0x05, 0x00, 0x00, 0x00, 0x00,
+		                                   0x00, (uint8_t) (i + 1)};
+		// Connect the boards as nodes of the interface
+		t_bidib_node_address interface_address = {0x00, 0x00, 0x00};
+		bidib_state_node_new(interface_address, (uint8_t) (i + 1), unique_id);
+		bench_boards[i].address = (uint8_t) (i + 1);
+		bench_boards[i].commands = g_queue_new();
+		pthread_create(&bench_boards[i].thread, NULL, bench_board, &bench_boards[i]);
+	}
+
+	char ids[ROUTE_LENGTH][32];
+	t_bidib_route_element elements[ROUTE_LENGTH];
+	for (int i = 0; i < ROUTE_LENGTH; i++) {
+		// Interleave the boards, as the points of a route are rarely sorted by board
+		snprintf(ids[i], sizeof(ids[i]), "point%d_%d", i % BOARD_COUNT, i / BOARD_COUNT);
+		elements[i].type = BIDIB_ROUTE_ELEMENT_POINT;
+		elements[i].id = ids[i];
+	}
+	printf("Route of %d points on %d boards, %d us per switching, %d runs\n",
+	       ROUTE_LENGTH, BOARD_COUNT, SWITCH_US, RUNS);
+
+	const char *aspects[] = {"normal", "reverse"};
+	const unsigned int switch_failed = bench_switch_points("flush per point", ids, aspects, true)
+	                                   + bench_switch_points("flush per route", ids, aspects, false);
+
+	uint64_t issue_us = 0, complete_us = 0;
+	unsigned int failed = 0;
+	atomic_store(&bench_packets, 0);
+	for (int run = 0; run < RUNS; run++) {
+		for (int i = 0; i < ROUTE_LENGTH; i++) {
+			elements[i].aspect = aspects[run & 0x01];
+		}
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		const unsigned int route = bidib_set_route(elements, ROUTE_LENGTH);
+		issue_us += bench_elapsed_us(&start);
+		failed += bidib_wait_route(route, TIMEOUT_MS) != BIDIB_ROUTE_COMPLETE;
+		complete_us += bench_elapsed_us(&start);
+		bidib_free_route(route);
+	}
+	bench_print("bidib_set_route", issue_us, complete_us, atomic_load(&bench_packets), failed);
+
+	pthread_mutex_lock(&bench_mutex);
+	atomic_store(&bench_running, false);
+	pthread_cond_broadcast(&bench_cond);
+	pthread_mutex_unlock(&bench_mutex);
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		pthread_join(bench_boards[i].thread, NULL);
+		g_queue_free_full(bench_boards[i].commands, free);
+	}
+	bidib_stop();
+	char path[512];
+	const char *files[] = {"bidib_board_config.yml", "bidib_track_config.yml",
+	                       "bidib_train_config.yml"};
+	for (size_t i = 0; i < 3; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+		unlink(path);
+	}
+	rmdir(dir);
+	return failed + switch_failed > 0;
+}
@@ -0,0 +1,204 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../src/state/bidib_state_intern.h"
+
+
+// Loads a large synthetic layout and reports the time, the heap allocations
+// and the resident memory of parsing the configs and of freeing them again.
+
+#define BOARD_COUNT 200
+#define POINTS_PER_BOARD 32
+#define SIGNALS_PER_BOARD 16
+#define PERIPHERALS_PER_BOARD 32
+#define SEGMENTS_PER_BOARD 128
+#define TRAIN_COUNT 200
+
+// Counts all allocations of the process, including the ones inside libbidib and glib
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+static atomic_ulong malloc_count = 0;
+
+void *malloc(size_t size) {
+	atomic_fetch_add_explicit(&malloc_count, 1, memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+	atomic_fetch_add_explicit(&malloc_count, 1, memory_order_relaxed);
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	if (ptr == NULL) {
+		atomic_fetch_add_explicit(&malloc_count, 1, memory_order_relaxed);
+	}
+	return __libc_realloc(ptr, size);
+}
+
+static void bench_write_boards(FILE *file) {
+	fprintf(file, "boards:\n");
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		fprintf(file, "  - id: board%d\n    unique-id: 0x050000000%05X\n", i, i + 1);
+	}
+}
+
+static void bench_write_track(FILE *file) {
+	fprintf(file, "boards:\n");
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		fprintf(file, "  - id: board%d\n    points-board:\n", i);
+		for (int j = 0; j < POINTS_PER_BOARD; j++) {
+			fprintf(file, "      - id: point%d_%d\n        number: 0x%02X\n"
+			        "        aspects:\n"
+			        "          - id: normal\n            value: 0x01\n"
+			        "          - id: reverse\n            value: 0x00\n"
+			        "        initial: normal\n", i, j, j);
+		}
+		fprintf(file, "    signals-board:\n");
+		for (int j = 0; j < SIGNALS_PER_BOARD; j++) {
+			fprintf(file, "      - id: signal%d_%d\n        number: 0x%02X\n"
+			        "        aspects:\n"
+			        "          - id: green\n            value: 0x02\n"
+			        "          - id: orange\n            value: 0x01\n"
+			        "          - id: red\n            value: 0x00\n"
+			        "        initial: red\n", i, j, POINTS_PER_BOARD + j);
+		}
+		fprintf(file, "    peripherals:\n");
+		for (int j = 0; j < PERIPHERALS_PER_BOARD; j++) {
+			fprintf(file, "      - id: led%d_%d\n        number: 0x%02X\n"
+			        "        port: 0x%04X\n"
+			        "        aspects:\n"
+			        "          - id: off\n            value: 0x00\n"
+			        "          - id: on\n            value: 0x01\n"
+			        "        initial: off\n        type: onebit\n", i, j, j, j);
+		}
+		fprintf(file, "    segments:\n");
+		for (int j = 0; j < SEGMENTS_PER_BOARD; j++) {
+			fprintf(file, "      - id: seg%d_%d\n        address: 0x%02X\n"
+			        "        length: 12.5cm\n", i, j, j);
+		}
+	}
+}
+
+static void bench_write_trains(FILE *file) {
+	fprintf(file, "trains:\n");
+	for (int i = 0; i < TRAIN_COUNT; i++) {
+		fprintf(file, "  - id: train%d\n    dcc-address: 0x%04X\n    dcc-speed-steps: 126\n"
+		        "    calibration:\n", i, i + 1);
+		for (int j = 0; j < 9; j++) {
+			fprintf(file, "      - %d\n", (j + 1) * 12);
+		}
+		fprintf(file, "    peripherals:\n      - id: light\n        bit: 4\n"
+		        "      - id: horn\n        bit: 5\n");
+	}
+}
+
+static bool bench_write_config(const char *dir) {
+	const char *files[] = {"bidib_board_config.yml", "bidib_track_config.yml",
+	                       "bidib_train_config.yml"};
+	void (*writers[])(FILE *) = {bench_write_boards, bench_write_track, bench_write_trains};
+	char path[512];
+	for (size_t i = 0; i < 3; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+		FILE *file = fopen(path, "w");
+		if (file == NULL) {
+			return false;
+		}
+		writers[i](file);
+		fclose(file);
+	}
+	return true;
+}
+
+static void bench_remove_config(const char *dir) {
+	const char *files[] = {"bidib_board_config.yml", "bidib_track_config.yml",
+	                       "bidib_train_config.yml"};
+	char path[512];
+	for (size_t i = 0; i < 3; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+		unlink(path);
+	}
+	rmdir(dir);
+}
+
+static long bench_resident_kib(void) {
+	long size = 0, resident = 0;
+	FILE *file = fopen("/proc/self/statm", "r");
+	if (file != NULL) {
+		if (fscanf(file, "%ld %ld", &size, &resident) != 2) {
+			resident = 0;
+		}
+		fclose(file);
+	}
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static double bench_elapsed_ms(const struct timespec *start, const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+int main(void) {
+	char dir[] = "/tmp/bidib_config_benchmark_XXXXXX";
+	if (mkdtemp(dir) == NULL || !bench_write_config(dir)) {
+		fprintf(stderr, "Could not write the configs\n");
+		return 1;
+	}
+
+	struct timespec start, parsed, freed;
+	const long resident_before = bench_resident_kib();
+	const unsigned long mallocs_before = atomic_load(&malloc_count);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	const int error = bidib_state_init(dir);
+	clock_gettime(CLOCK_MONOTONIC, &parsed);
+	const unsigned long mallocs = atomic_load(&malloc_count) - mallocs_before;
+	const long resident = bench_resident_kib() - resident_before;
+	bidib_state_free();
+	clock_gettime(CLOCK_MONOTONIC, &freed);
+	bench_remove_config(dir);
+	if (error) {
+		fprintf(stderr, "Could not parse the configs\n");
+		return 1;
+	}
+
+	printf("%d boards, %d points, %d signals, %d peripherals, %d segments, %d trains\n",
+	       BOARD_COUNT, BOARD_COUNT * POINTS_PER_BOARD, BOARD_COUNT * SIGNALS_PER_BOARD,
+	       BOARD_COUNT * PERIPHERALS_PER_BOARD, BOARD_COUNT * SEGMENTS_PER_BOARD, TRAIN_COUNT);
+	printf("startup:  %8.1f ms, %lu allocations, %ld KiB resident\n",
+	       bench_elapsed_ms(&start, &parsed), mallocs, resident);
+	printf("shutdown: %8.1f ms\n", bench_elapsed_ms(&parsed, &freed));
+	return 0;
+}
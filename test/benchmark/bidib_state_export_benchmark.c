@@ -0,0 +1,206 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "../../include/highlevel/bidib_highlevel_getter.h"
+#include "../../include/highlevel/bidib_highlevel_export.h"
+#include "../../src/state/bidib_state_intern.h"
+#include "../../src/state/bidib_state_setter_intern.h"
+
+
+// Publishes the track state into the shared memory export while the occupancy
+// of all segments toggles, and compares how fast another thread reads consistent
+// images from the export with how fast it copies the state with bidib_get_state.
+
+#define BOARD_COUNT 8
+#define SEGMENTS_PER_BOARD 64
+#define TRAIN_COUNT 16
+#define DURATION_MS 500
+#define EXPORT_NAME "/bidib_export_benchmark"
+
+static atomic_bool bench_running;
+static atomic_bool bench_torn;
+
+static bool bench_write_config(const char *dir) {
+	char path[512];
+	snprintf(path, sizeof(path), "%s/bidib_board_config.yml", dir);
+	FILE *boards = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/bidib_track_config.yml", dir);
+	FILE *track = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/bidib_train_config.yml", dir);
+	FILE *trains = fopen(path, "w");
+	if (boards == NULL || track == NULL || trains == NULL) {
+		return false;
+	}
+	fprintf(boards, "boards:\n");
+	fprintf(track, "boards:\n");
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		fprintf(boards, "  - id: board%d\n    unique-id: 0x0500000000%04X\n", i, i + 1);
+		// The parser expects the points before the segments
+		fprintf(track, "  - id: board%d\n    points-board:\n", i);
+		for (int j = 0; j < 8; j++) {
+			fprintf(track, "      - id: point%d_%d\n        number: 0x%02X\n"
+			        "        aspects:\n          - id: normal\n            value: 0x00\n"
+			        "          - id: reverse\n            value: 0x01\n", i, j, j);
+		}
+		fprintf(track, "    segments:\n");
+		for (int j = 0; j < SEGMENTS_PER_BOARD; j++) {
+			fprintf(track, "      - id: seg%d_%d\n        address: 0x%02X\n"
+			        "        length: 1cm\n", i, j, j);
+		}
+	}
+	fprintf(trains, "trains:\n");
+	for (int i = 0; i < TRAIN_COUNT; i++) {
+		fprintf(trains, "  - id: train%d\n    dcc-address: 0x%04X\n"
+		        "    dcc-speed-steps: 126\n", i, i + 1);
+	}
+	fclose(boards);
+	fclose(track);
+	fclose(trains);
+	return true;
+}
+
+// Toggles the occupancy of all segments and publishes every state in between,
+// so that each published image has the same occupancy on all boards
+static void *bench_writer(void *arg) {
+	unsigned long *published = arg;
+	uint8_t data[SEGMENTS_PER_BOARD / 8];
+	while (atomic_load(&bench_running)) {
+		memset(data, (*published & 0x01) ? 0x55 : 0xAA, sizeof(data));
+		for (int i = 0; i < BOARD_COUNT; i++) {
+			t_bidib_node_address node_address = {(uint8_t) (i + 1), 0x00, 0x00};
+			bidib_state_bm_multiple(node_address, 0x00, SEGMENTS_PER_BOARD, data);
+		}
+		bidib_state_export_publish();
+		(*published)++;
+	}
+	return NULL;
+}
+
+static void *bench_export_reader(void *arg) {
+	t_bidib_export_reader *reader = arg;
+	const size_t words = (bidib_export_header(reader)->segment_count + 63) / 64;
+	unsigned long reads = 0;
+	t_bidib_export_image image;
+	while (atomic_load(&bench_running)) {
+		if (!bidib_export_read(reader, &image)) {
+			atomic_store(&bench_torn, true);
+			break;
+		}
+		for (size_t i = 1; i < words; i++) {
+			if (image.occupied[i] != image.occupied[0]) {
+				atomic_store(&bench_torn, true);
+			}
+		}
+		reads++;
+	}
+	return (void *) reads;
+}
+
+static void *bench_getter_reader(void *arg __attribute__((unused))) {
+	unsigned long reads = 0;
+	while (atomic_load(&bench_running)) {
+		t_bidib_track_state state = bidib_get_state();
+		bidib_free_track_state(state);
+		reads++;
+	}
+	return (void *) reads;
+}
+
+static void bench_run(const char *name, void *(*read)(void *), void *arg) {
+	pthread_t writer_thread, reader_thread;
+	unsigned long published = 0;
+	atomic_store(&bench_running, true);
+	pthread_create(&writer_thread, NULL, bench_writer, &published);
+	pthread_create(&reader_thread, NULL, read, arg);
+	struct timespec duration = {DURATION_MS / 1000, (DURATION_MS % 1000) * 1000000L};
+	nanosleep(&duration, NULL);
+	atomic_store(&bench_running, false);
+	void *reads;
+	pthread_join(reader_thread, &reads);
+	pthread_join(writer_thread, NULL);
+	printf("%-20s %12.0f reads/s %12.0f publishes/s\n", name,
+	       (unsigned long) reads * 1000.0 / DURATION_MS, published * 1000.0 / DURATION_MS);
+}
+
+int main(void) {
+	char dir[] = "/tmp/bidib_export_benchmark_XXXXXX";
+	bidib_state_export_set_name(EXPORT_NAME);
+	if (mkdtemp(dir) == NULL || !bench_write_config(dir) || bidib_state_init(dir) ||
+	    !bidib_state_export_enabled()) {
+		fprintf(stderr, "Could not initialise the state\n");
+		return 1;
+	}
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		t_bidib_unique_id_mod unique_id = {0x05, 0x00, 0x00, 0x00, 0x00,
+		                                   0x00, (uint8_t) (i + 1)};
+		// Connect the boards as nodes of the interface
+		t_bidib_node_address interface_address = {0x00, 0x00, 0x00};
+		bidib_state_node_new(interface_address, (uint8_t) (i + 1), unique_id);
+	}
+
+	t_bidib_export_reader *reader = bidib_export_open(EXPORT_NAME);
+	if (reader == NULL) {
+		fprintf(stderr, "Could not open the export\n");
+		bidib_state_free();
+		return 1;
+	}
+	printf("%d segments, %d points, %d trains, image of %u bytes, %ld CPUs online\n",
+	       BOARD_COUNT * SEGMENTS_PER_BOARD, BOARD_COUNT * 8, TRAIN_COUNT,
+	       bidib_export_header(reader)->image_size, sysconf(_SC_NPROCESSORS_ONLN));
+	atomic_store(&bench_torn, false);
+	bench_run("bidib_export_read", bench_export_reader, reader);
+	bench_run("bidib_get_state", bench_getter_reader, NULL);
+
+	bidib_export_close(reader);
+	bidib_state_free();
+	bidib_state_export_set_name(NULL);
+	char path[512];
+	const char *files[] = {"bidib_board_config.yml", "bidib_track_config.yml",
+	                       "bidib_train_config.yml"};
+	for (size_t i = 0; i < 3; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+		unlink(path);
+	}
+	rmdir(dir);
+	if (atomic_load(&bench_torn)) {
+		printf("A reader saw an inconsistent image\n");
+		return 1;
+	}
+	return 0;
+}
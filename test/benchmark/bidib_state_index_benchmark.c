@@ -0,0 +1,256 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <glib.h>
+
+#include "../../src/state/bidib_state_intern.h"
+#include "../../src/state/bidib_state_getter_intern.h"
+
+
+// Compares the id lookups of the state getters with the linear search they
+// replaced, for a config with thousands of entities.
+
+#define BOARD_COUNT 64
+#define POINTS_PER_BOARD 64
+#define SEGMENT_COUNT 4096
+#define PERIPHERAL_COUNT 4096
+#define TRAIN_COUNT 1024
+#define LOOKUPS 200000
+
+static char *bench_id(const char *prefix, size_t i) {
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%s%zu", prefix, i);
+	return strdup(buffer);
+}
+
+static double bench_elapsed_ns(struct timespec start, struct timespec end) {
+	return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void bench_populate(void) {
+	for (size_t b = 0; b < BOARD_COUNT; b++) {
+		t_bidib_board board = {0};
+		char *id = bench_id("board", b);
+		board.id = bidib_state_arena_strdup(id);
+		free(id);
+		board.unique_id.class_id = 0x40;
+		board.unique_id.vendor_id = 0x0D;
+		board.unique_id.product_id1 = b & 0xFF;
+		board.unique_id.product_id2 = b >> 8;
+		board.features = g_array_new(FALSE, FALSE, sizeof(t_bidib_board_feature));
+		board.points_board = g_array_new(FALSE, FALSE, sizeof(t_bidib_board_accessory_mapping));
+		board.points_dcc = g_array_new(FALSE, FALSE, sizeof(t_bidib_dcc_accessory_mapping));
+		board.signals_board = g_array_new(FALSE, FALSE, sizeof(t_bidib_board_accessory_mapping));
+		board.signals_dcc = g_array_new(FALSE, FALSE, sizeof(t_bidib_dcc_accessory_mapping));
+		board.peripherals = g_array_new(FALSE, FALSE, sizeof(t_bidib_peripheral_mapping));
+		board.segments = g_array_new(FALSE, FALSE, sizeof(t_bidib_segment_mapping));
+		board.reversers = g_array_new(FALSE, FALSE, sizeof(t_bidib_reverser_mapping));
+		for (size_t p = 0; p < POINTS_PER_BOARD; p++) {
+			char *point_id = bench_id("point", b * POINTS_PER_BOARD + p);
+			t_bidib_board_accessory_mapping mapping = {
+				.id = bidib_state_arena_strdup(point_id),
+				.number = p,
+				.aspects = g_array_new(FALSE, FALSE, sizeof(t_bidib_aspect))
+			};
+			g_array_append_val(board.points_board, mapping);
+			t_bidib_board_accessory_state point_state = {.id = point_id};
+			bidib_state_add_board_point_state(point_state);
+		}
+		bidib_state_add_board(board);
+	}
+	pthread_rwlock_wrlock(&bidib_boards_rwlock);
+	bidib_state_index_build_mappings();
+	pthread_rwlock_unlock(&bidib_boards_rwlock);
+
+	for (size_t i = 0; i < SEGMENT_COUNT; i++) {
+		char *id = bench_id("seg", i);
+		t_bidib_segment_state_intern segment_state = {
+			.id = bidib_state_arena_strdup(id),
+			.length = bidib_state_arena_strdup("0cm"),
+			.dcc_addresses = g_array_new(FALSE, FALSE, sizeof(t_bidib_dcc_address))
+		};
+		free(id);
+		bidib_state_add_segment_state(segment_state);
+	}
+	for (size_t i = 0; i < PERIPHERAL_COUNT; i++) {
+		t_bidib_peripheral_state peripheral_state = {.id = bench_id("peripheral", i)};
+		bidib_state_add_peripheral_state(peripheral_state);
+	}
+	for (size_t i = 0; i < TRAIN_COUNT; i++) {
+		char *id = bench_id("train", i);
+		t_bidib_train_state_intern train_state = {
+			.id = bidib_state_arena_strdup(id),
+			.peripherals = g_array_new(FALSE, FALSE, sizeof(t_bidib_train_peripheral_state))
+		};
+		free(id);
+		bidib_state_add_train_state(train_state);
+	}
+}
+
+static void *bench_linear_segment(const char *segment) {
+	for (size_t i = 0; i < bidib_track_state.segments->len; i++) {
+		t_bidib_segment_state_intern *segment_state_i =
+			&g_array_index(bidib_track_state.segments, t_bidib_segment_state_intern, i);
+		if (!strcmp(segment_state_i->id, segment)) {
+			return segment_state_i;
+		}
+	}
+	return NULL;
+}
+
+static void *bench_linear_peripheral(const char *peripheral) {
+	for (size_t i = 0; i < bidib_track_state.peripherals->len; i++) {
+		t_bidib_peripheral_state *peripheral_state_i =
+			&g_array_index(bidib_track_state.peripherals, t_bidib_peripheral_state, i);
+		if (!strcmp(peripheral_state_i->id, peripheral)) {
+			return peripheral_state_i;
+		}
+	}
+	return NULL;
+}
+
+static void *bench_linear_train_state(const char *train) {
+	for (size_t i = 0; i < bidib_track_state.trains->len; i++) {
+		t_bidib_train_state_intern *train_state_i =
+			&g_array_index(bidib_track_state.trains, t_bidib_train_state_intern, i);
+		if (!strcmp(train_state_i->id, train)) {
+			return train_state_i;
+		}
+	}
+	return NULL;
+}
+
+static void *bench_linear_point_mapping(const char *point) {
+	for (size_t i = 0; i < bidib_boards->len; i++) {
+		t_bidib_board *board_i = &g_array_index(bidib_boards, t_bidib_board, i);
+		for (size_t j = 0; j < board_i->points_board->len; j++) {
+			t_bidib_board_accessory_mapping *mapping =
+				&g_array_index(board_i->points_board, t_bidib_board_accessory_mapping, j);
+			if (!strcmp(mapping->id, point)) {
+				return mapping;
+			}
+		}
+	}
+	return NULL;
+}
+
+static void *bench_indexed_segment(const char *id) {
+	return bidib_state_get_segment_state_ref(id);
+}
+
+static void *bench_indexed_peripheral(const char *id) {
+	return bidib_state_get_peripheral_state_ref(id);
+}
+
+static void *bench_indexed_train_state(const char *id) {
+	return bidib_state_get_train_state_ref(id);
+}
+
+static void *bench_indexed_point_mapping(const char *id) {
+	return bidib_state_get_board_accessory_mapping_ref(id, true);
+}
+
+static double bench_run(void *(*lookup)(const char *), char **ids, size_t id_count,
+                        size_t lookups, void **results) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < lookups; i++) {
+		void *result = lookup(ids[i % id_count]);
+		if (i < id_count) {
+			results[i] = result;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return bench_elapsed_ns(start, end) / lookups;
+}
+
+static bool bench_compare(const char *name, const char *prefix, size_t count,
+                          void *(*indexed)(const char *), void *(*linear)(const char *)) {
+	char **ids = malloc(count * sizeof(char *));
+	void **indexed_results = malloc(count * sizeof(void *));
+	void **linear_results = malloc(count * sizeof(void *));
+	for (size_t i = 0; i < count; i++) {
+		// Spread the lookups over the whole array
+		ids[i] = bench_id(prefix, (i * 7919) % count);
+	}
+
+	// The linear search is slow, so it gets fewer rounds
+	size_t linear_lookups = count * 4;
+	double linear_ns = bench_run(linear, ids, count, linear_lookups, linear_results);
+	double indexed_ns = bench_run(indexed, ids, count, LOOKUPS, indexed_results);
+
+	bool equal = true;
+	for (size_t i = 0; i < count; i++) {
+		if (indexed_results[i] == NULL || indexed_results[i] != linear_results[i]) {
+			equal = false;
+		}
+		free(ids[i]);
+	}
+	free(ids);
+	free(indexed_results);
+	free(linear_results);
+
+	printf("%-22s %6zu entries: linear %10.1f ns/lookup, indexed %8.1f ns/lookup, "
+	       "speedup %7.1fx%s\n", name, count, linear_ns, indexed_ns,
+	       linear_ns / indexed_ns, equal ? "" : " (RESULTS DIFFER)");
+	return equal;
+}
+
+int main(void) {
+	if (bidib_state_init(NULL)) {
+		fprintf(stderr, "Could not initialise the state\n");
+		return 1;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	bench_populate();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("Populated %d entities in %.1f ms\n",
+	       BOARD_COUNT * POINTS_PER_BOARD * 2 + SEGMENT_COUNT + PERIPHERAL_COUNT + TRAIN_COUNT,
+	       bench_elapsed_ns(start, end) / 1e6);
+
+	bool ok = true;
+	ok &= bench_compare("segment states", "seg", SEGMENT_COUNT,
+	                    bench_indexed_segment, bench_linear_segment);
+	ok &= bench_compare("peripheral states", "peripheral", PERIPHERAL_COUNT,
+	                    bench_indexed_peripheral, bench_linear_peripheral);
+	ok &= bench_compare("train states", "train", TRAIN_COUNT,
+	                    bench_indexed_train_state, bench_linear_train_state);
+	ok &= bench_compare("point mappings", "point", BOARD_COUNT * POINTS_PER_BOARD,
+	                    bench_indexed_point_mapping, bench_linear_point_mapping);
+
+	bidib_state_free();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "../../include/highlevel/bidib_highlevel_getter.h"
+#include "../../src/state/bidib_state_intern.h"
+#include "../../src/state/bidib_state_setter_intern.h"
+
+
+// Floods the peripheral state with LC_STAT reports, as sent continuously by
+// the sync peripherals, and counts the heap allocations they cause.
+
+#define REPORT_COUNT 1000000
+
+// Counts all allocations of the process, including the ones inside libbidib
+extern void *__libc_malloc(size_t size);
+static atomic_ulong malloc_count = 0;
+
+void *malloc(size_t size) {
+	atomic_fetch_add_explicit(&malloc_count, 1, memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+int main(void) {
+	if (bidib_state_init("../test/unit/state_tests_config")) {
+		fprintf(stderr, "Could not initialise the state\n");
+		return 1;
+	}
+	// Connect board1 of the config as interface, so that its ports are routed
+	t_bidib_unique_id_mod unique_id = {0xDA, 0x00, 0x0D, 0x68, 0x00, 0x01, 0xEE};
+	t_bidib_node_address node_address = {0x00, 0x00, 0x00};
+	bidib_state_node_new(node_address, 0x00, unique_id);
+	// Leave the debug log of every report out of the measurement
+	setlogmask(LOG_UPTO(LOG_INFO));
+
+	t_bidib_peripheral_port port = {0x23, 0x01};
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	const unsigned long mallocs_before = atomic_load(&malloc_count);
+	for (unsigned int i = 0; i < REPORT_COUNT; i++) {
+		bidib_state_lc_stat(node_address, port, (uint8_t) (i & 0x01), i);
+	}
+	const unsigned long mallocs = atomic_load(&malloc_count) - mallocs_before;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	t_bidib_peripheral_state_query query = bidib_get_peripheral_state("led1");
+	const bool updated = query.available && strcmp(query.data.state_id, "state2") == 0;
+	bidib_free_peripheral_state_query(query);
+	bidib_state_free();
+
+	const double duration_s = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%d LC_STAT reports: %lu allocations (%.3f per report), %.0f reports/s\n",
+	       REPORT_COUNT, mallocs, (double) mallocs / REPORT_COUNT, REPORT_COUNT / duration_s);
+	if (!updated) {
+		printf("The peripheral state was not updated\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,296 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <glib.h>
+
+#include "../../include/highlevel/bidib_highlevel_getter.h"
+#include "../../include/highlevel/bidib_highlevel_server.h"
+#include "../../src/state/bidib_state_intern.h"
+#include "../../src/state/bidib_state_setter_intern.h"
+#include "../../src/transmission/bidib_transmission_intern.h"
+
+
+// Serves the track state to many clients while the occupancy of all segments
+// toggles as fast as possible. Some of the clients read slowly, so that their
+// changes are coalesced. After the changes stop, every client has to end up with
+// the occupancy of the track state.
+
+#define BOARD_COUNT 8
+#define SEGMENTS_PER_BOARD 64
+#define TRAIN_COUNT 4
+#define CLIENT_COUNT 50
+// Every SLOW_CLIENT_EVERY-th client pauses SLOW_CLIENT_PAUSE_MS between reads
+#define SLOW_CLIENT_EVERY 10
+#define SLOW_CLIENT_PAUSE_MS 20
+#define DURATION_MS 1000
+#define CATCH_UP_MS 5000
+#define SERVER_PATH "/tmp/bidib_server_benchmark.sock"
+
+typedef struct {
+	int fd;
+	bool slow;
+	uint8_t buffer[16384];
+	size_t used;
+	uint8_t occupied[BOARD_COUNT * SEGMENTS_PER_BOARD];
+	uint64_t seq;
+	unsigned long syncs;
+	unsigned long entries;
+	unsigned long bytes;
+	bool failed;
+} t_bench_client;
+
+static atomic_bool bench_running;
+static _Atomic uint64_t bench_final_seq;
+static t_bench_client bench_clients[CLIENT_COUNT];
+
+static bool bench_write_config(const char *dir) {
+	char path[512];
+	snprintf(path, sizeof(path), "%s/bidib_board_config.yml", dir);
+	FILE *boards = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/bidib_track_config.yml", dir);
+	FILE *track = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/bidib_train_config.yml", dir);
+	FILE *trains = fopen(path, "w");
+	if (boards == NULL || track == NULL || trains == NULL) {
+		return false;
+	}
+	fprintf(boards, "boards:\n");
+	fprintf(track, "boards:\n");
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		fprintf(boards, "  - id: board%d\n    unique-id: 0x0500000000%04X\n", i, i + 1);
+		fprintf(track, "  - id: board%d\n    segments:\n", i);
+		for (int j = 0; j < SEGMENTS_PER_BOARD; j++) {
+			fprintf(track, "      - id: seg%d_%d\n        address: 0x%02X\n"
+			        "        length: 1cm\n", i, j, j);
+		}
+	}
+	fprintf(trains, "trains:\n");
+	for (int i = 0; i < TRAIN_COUNT; i++) {
+		fprintf(trains, "  - id: train%d\n    dcc-address: 0x%04X\n"
+		        "    dcc-speed-steps: 126\n", i, i + 1);
+	}
+	fclose(boards);
+	fclose(track);
+	fclose(trains);
+	return true;
+}
+
+// Applies the complete records in the buffer of a client
+static void bench_parse(t_bench_client *client) {
+	size_t offset = 0;
+	while (client->used - offset >= sizeof(t_bidib_server_record)) {
+		t_bidib_server_record record;
+		memcpy(&record, client->buffer + offset, sizeof(record));
+		if (client->used - offset < sizeof(record) + record.size) {
+			break;
+		}
+		const uint8_t *payload = client->buffer + offset + sizeof(record);
+		if (record.type == BIDIB_SERVER_HELLO) {
+			t_bidib_server_hello hello;
+			memcpy(&hello, payload, sizeof(hello));
+			if (hello.version != BIDIB_SERVER_VERSION ||
+			    hello.segment_count != BOARD_COUNT * SEGMENTS_PER_BOARD) {
+				client->failed = true;
+			}
+		} else if (record.type == BIDIB_SERVER_ENTRY && record.kind == BIDIB_EXPORT_SEGMENTS) {
+			client->occupied[record.position] = payload[0];
+			client->entries++;
+		} else if (record.type == BIDIB_SERVER_SYNC) {
+			memcpy(&client->seq, payload, sizeof(client->seq));
+			client->syncs++;
+		}
+		offset += sizeof(record) + record.size;
+	}
+	memmove(client->buffer, client->buffer + offset, client->used - offset);
+	client->used -= offset;
+}
+
+static void *bench_client(void *arg) {
+	t_bench_client *client = arg;
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (atomic_load(&bench_running) || client->seq < atomic_load(&bench_final_seq)) {
+		const ssize_t received = recv(client->fd, client->buffer + client->used,
+		                              sizeof(client->buffer) - client->used, 0);
+		if (received <= 0) {
+			client->failed = true;
+			break;
+		}
+		client->used += (size_t) received;
+		client->bytes += (size_t) received;
+		bench_parse(client);
+		if (client->slow) {
+			struct timespec pause = {0, SLOW_CLIENT_PAUSE_MS * 1000000L};
+			nanosleep(&pause, NULL);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec - start.tv_sec) * 1000 > DURATION_MS + CATCH_UP_MS) {
+			client->failed = true;
+			break;
+		}
+	}
+	return NULL;
+}
+
+static void *bench_writer(void *arg) {
+	unsigned long *changes = arg;
+	uint8_t data[SEGMENTS_PER_BOARD / 8];
+	while (atomic_load(&bench_running)) {
+		memset(data, (*changes & 0x01) ? 0x55 : 0xAA, sizeof(data));
+		for (int i = 0; i < BOARD_COUNT; i++) {
+			t_bidib_node_address node_address = {(uint8_t) (i + 1), 0x00, 0x00};
+			bidib_state_bm_multiple(node_address, 0x00, SEGMENTS_PER_BOARD, data);
+		}
+		(*changes)++;
+	}
+	return NULL;
+}
+
+static int bench_connect(void) {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, SERVER_PATH);
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd != -1 && connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Checks that a client ended up with the occupancy of the track state
+static bool bench_verify(const t_bench_client *client) {
+	for (size_t i = 0; i < BOARD_COUNT * SEGMENTS_PER_BOARD; i++) {
+		char id[32];
+		snprintf(id, sizeof(id), "seg%zu_%zu", i / SEGMENTS_PER_BOARD, i % SEGMENTS_PER_BOARD);
+		t_bidib_segment_state_query query = bidib_get_segment_state(id);
+		const bool occupied = query.known && query.data.occupied;
+		bidib_free_segment_state_query(query);
+		if (occupied != (client->occupied[i] != 0)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(void) {
+	char dir[] = "/tmp/bidib_server_benchmark_XXXXXX";
+	bidib_state_server_set_path(SERVER_PATH);
+	if (mkdtemp(dir) == NULL || !bench_write_config(dir) || bidib_state_init(dir) ||
+	    !bidib_state_server_enabled()) {
+		fprintf(stderr, "Could not initialise the state\n");
+		return 1;
+	}
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		t_bidib_unique_id_mod unique_id = {0x05, 0x00, 0x00, 0x00, 0x00,
+		                                   0x00, (uint8_t) (i + 1)};
+		// Connect the boards as nodes of the interface
+		t_bidib_node_address interface_address = {0x00, 0x00, 0x00};
+		bidib_state_node_new(interface_address, (uint8_t) (i + 1), unique_id);
+	}
+
+	bidib_running = true;
+	pthread_t server_thread;
+	pthread_create(&server_thread, NULL, bidib_state_server_run, NULL);
+	atomic_store(&bench_running, true);
+	atomic_store(&bench_final_seq, UINT64_MAX);
+	pthread_t client_threads[CLIENT_COUNT];
+	for (int i = 0; i < CLIENT_COUNT; i++) {
+		memset(&bench_clients[i], 0, sizeof(t_bench_client));
+		bench_clients[i].fd = bench_connect();
+		bench_clients[i].slow = i % SLOW_CLIENT_EVERY == SLOW_CLIENT_EVERY - 1;
+		if (bench_clients[i].fd == -1) {
+			fprintf(stderr, "Could not connect to the server\n");
+			return 1;
+		}
+		pthread_create(&client_threads[i], NULL, bench_client, &bench_clients[i]);
+	}
+
+	pthread_t writer_thread;
+	unsigned long changes = 0;
+	pthread_create(&writer_thread, NULL, bench_writer, &changes);
+	struct timespec duration = {DURATION_MS / 1000, (DURATION_MS % 1000) * 1000000L};
+	nanosleep(&duration, NULL);
+	atomic_store(&bench_running, false);
+	pthread_join(writer_thread, NULL);
+	// The clients keep reading until they received the final state
+	atomic_store(&bench_final_seq, bidib_state_get_change_seq());
+	bool consistent = true;
+	unsigned long syncs[2] = {0, 0}, entries = 0, bytes = 0;
+	for (int i = 0; i < CLIENT_COUNT; i++) {
+		pthread_join(client_threads[i], NULL);
+		const t_bench_client *client = &bench_clients[i];
+		consistent = consistent && !client->failed && bench_verify(client);
+		syncs[client->slow] += client->syncs;
+		entries += client->entries;
+		bytes += client->bytes;
+		close(client->fd);
+	}
+	bidib_running = false;
+	pthread_join(server_thread, NULL);
+
+	const unsigned int slow_count = CLIENT_COUNT / SLOW_CLIENT_EVERY;
+	printf("%d segments, %d clients (%u slow), %ld CPUs online\n",
+	       BOARD_COUNT * SEGMENTS_PER_BOARD, CLIENT_COUNT, slow_count,
+	       sysconf(_SC_NPROCESSORS_ONLN));
+	printf("state changes          %12.0f /s\n", changes * 1000.0 / DURATION_MS);
+	printf("deltas per fast client %12.0f /s\n",
+	       syncs[0] * 1000.0 / DURATION_MS / (CLIENT_COUNT - slow_count));
+	printf("deltas per slow client %12.0f /s\n",
+	       syncs[1] * 1000.0 / DURATION_MS / slow_count);
+	printf("entries to all clients %12.0f /s\n", entries * 1000.0 / DURATION_MS);
+	printf("bytes to all clients   %12.0f /s\n", bytes * 1000.0 / DURATION_MS);
+
+	bidib_state_free();
+	bidib_state_server_set_path(NULL);
+	char path[512];
+	const char *files[] = {"bidib_board_config.yml", "bidib_track_config.yml",
+	                       "bidib_train_config.yml"};
+	for (size_t i = 0; i < 3; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+		unlink(path);
+	}
+	rmdir(dir);
+	if (!consistent) {
+		printf("A client did not end up with the state\n");
+		return 1;
+	}
+	return 0;
+}
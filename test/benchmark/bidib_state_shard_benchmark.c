@@ -0,0 +1,173 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "../../include/highlevel/bidib_highlevel_getter.h"
+#include "../../src/state/bidib_state_intern.h"
+#include "../../src/state/bidib_state_setter_intern.h"
+
+
+// Simulates occupancy detectors on several boards, each reporting on its own
+// thread with MSG_BM_MULTIPLE, and compares the update throughput of the
+// sharded segment states with that of one lock for all segments.
+
+#define BOARD_COUNT 8
+#define SEGMENTS_PER_BOARD 64
+#define DURATION_MS 500
+
+static atomic_bool bench_running;
+static bool bench_global_lock;
+
+static bool bench_write_config(const char *dir) {
+	char path[512];
+	snprintf(path, sizeof(path), "%s/bidib_board_config.yml", dir);
+	FILE *boards = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/bidib_track_config.yml", dir);
+	FILE *track = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/bidib_train_config.yml", dir);
+	FILE *trains = fopen(path, "w");
+	if (boards == NULL || track == NULL || trains == NULL) {
+		return false;
+	}
+	fprintf(boards, "boards:\n");
+	fprintf(track, "boards:\n");
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		fprintf(boards, "  - id: board%d\n    unique-id: 0x0500000000%04X\n", i, i + 1);
+		fprintf(track, "  - id: board%d\n    segments:\n", i);
+		for (int j = 0; j < SEGMENTS_PER_BOARD; j++) {
+			fprintf(track, "      - id: seg%d_%d\n        address: 0x%02X\n"
+			        "        length: 1cm\n", i, j, j);
+		}
+	}
+	fprintf(trains, "trains:\n  - id: train1\n    dcc-address: 0x0001\n"
+	        "    dcc-speed-steps: 126\n");
+	fclose(boards);
+	fclose(track);
+	fclose(trains);
+	return true;
+}
+
+static t_bidib_node_address bench_node_address(int board) {
+	t_bidib_node_address node_address = {(uint8_t) (board + 1), 0x00, 0x00};
+	return node_address;
+}
+
+// Toggles the occupancy of all segments of a board with every message. No
+// addresses are detected, so the updates themselves only lock the shard, and
+// the global lock can be emulated by wrapping them in trackstate_segments_mutex.
+static void *bench_detector(void *arg) {
+	const int board = *(int *) arg;
+	const t_bidib_node_address node_address = bench_node_address(board);
+	uint8_t data[SEGMENTS_PER_BOARD / 8];
+	unsigned long messages = 0;
+	while (atomic_load(&bench_running)) {
+		memset(data, (messages & 0x01) ? 0x55 : 0xAA, sizeof(data));
+		if (bench_global_lock) {
+			pthread_mutex_lock(&trackstate_segments_mutex);
+		}
+		bidib_state_bm_multiple(node_address, 0x00, SEGMENTS_PER_BOARD, data);
+		if (bench_global_lock) {
+			pthread_mutex_unlock(&trackstate_segments_mutex);
+		}
+		messages++;
+	}
+	return (void *) messages;
+}
+
+static double bench_run(int boards) {
+	pthread_t threads[BOARD_COUNT];
+	int board_numbers[BOARD_COUNT];
+	atomic_store(&bench_running, true);
+	for (int i = 0; i < boards; i++) {
+		board_numbers[i] = i;
+		pthread_create(&threads[i], NULL, bench_detector, &board_numbers[i]);
+	}
+	struct timespec duration = {DURATION_MS / 1000, (DURATION_MS % 1000) * 1000000L};
+	nanosleep(&duration, NULL);
+	atomic_store(&bench_running, false);
+	unsigned long messages = 0;
+	for (int i = 0; i < boards; i++) {
+		void *result;
+		pthread_join(threads[i], &result);
+		messages += (unsigned long) result;
+	}
+	return messages * 1000.0 / DURATION_MS;
+}
+
+int main(void) {
+	char dir[] = "/tmp/bidib_shard_benchmark_XXXXXX";
+	if (mkdtemp(dir) == NULL || !bench_write_config(dir) || bidib_state_init(dir)) {
+		fprintf(stderr, "Could not initialise the state\n");
+		return 1;
+	}
+	for (int i = 0; i < BOARD_COUNT; i++) {
+		t_bidib_unique_id_mod unique_id = {0x05, 0x00, 0x00, 0x00, 0x00,
+		                                   0x00, (uint8_t) (i + 1)};
+		// Connect the boards as nodes of the interface
+		t_bidib_node_address interface_address = {0x00, 0x00, 0x00};
+		bidib_state_node_new(interface_address, (uint8_t) (i + 1), unique_id);
+	}
+
+	printf("%d boards with %d segments each, %ld CPUs online\n",
+	       BOARD_COUNT, SEGMENTS_PER_BOARD, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("boards   sharded msgs/s   one lock msgs/s\n");
+	for (int boards = 1; boards <= BOARD_COUNT; boards *= 2) {
+		bench_global_lock = false;
+		const double sharded = bench_run(boards);
+		bench_global_lock = true;
+		const double global = bench_run(boards);
+		printf("%6d %16.0f %17.0f\n", boards, sharded, global);
+	}
+
+	t_bidib_board_occupancy_query occupancy = bidib_get_board_occupancy("board0");
+	bidib_state_free();
+	char path[512];
+	const char *files[] = {"bidib_board_config.yml", "bidib_track_config.yml",
+	                       "bidib_train_config.yml"};
+	for (size_t i = 0; i < 3; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+		unlink(path);
+	}
+	rmdir(dir);
+	if (!occupancy.known || (occupancy.occupied[0] != 0x5555555555555555ULL &&
+	                         occupancy.occupied[0] != 0xAAAAAAAAAAAAAAAAULL)) {
+		printf("The occupancy of the segments was not updated\n");
+		return 1;
+	}
+	return 0;
+}
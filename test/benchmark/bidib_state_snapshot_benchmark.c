@@ -0,0 +1,194 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <glib.h>
+
+#include "../../include/highlevel/bidib_highlevel_getter.h"
+#include "../../src/state/bidib_state_intern.h"
+
+
+// Compares the reader throughput of bidib_get_state with that of the state
+// snapshots, while another thread floods the segment states with updates the
+// way the receive thread does.
+
+#define POINT_COUNT 1024
+#define SEGMENT_COUNT 1024
+#define PERIPHERAL_COUNT 1024
+#define TRAIN_COUNT 128
+#define READER_COUNT 4
+#define DURATION_MS 1000
+
+static atomic_bool bench_running;
+static atomic_bool bench_failed;
+
+static char *bench_id(const char *prefix, size_t i) {
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%s%zu", prefix, i);
+	return strdup(buffer);
+}
+
+static void bench_populate(void) {
+	for (size_t i = 0; i < POINT_COUNT; i++) {
+		t_bidib_board_accessory_state point_state = {.id = bench_id("point", i)};
+		bidib_state_add_board_point_state(point_state);
+	}
+	for (size_t i = 0; i < SEGMENT_COUNT; i++) {
+		char *id = bench_id("seg", i);
+		t_bidib_segment_state_intern segment_state = {
+			.id = bidib_state_arena_strdup(id),
+			.length = bidib_state_arena_strdup("0cm"),
+			.dcc_addresses = g_array_new(FALSE, FALSE, sizeof(t_bidib_dcc_address))
+		};
+		free(id);
+		bidib_state_add_segment_state(segment_state);
+	}
+	for (size_t i = 0; i < PERIPHERAL_COUNT; i++) {
+		t_bidib_peripheral_state peripheral_state = {.id = bench_id("peripheral", i)};
+		bidib_state_add_peripheral_state(peripheral_state);
+	}
+	for (size_t i = 0; i < TRAIN_COUNT; i++) {
+		char *id = bench_id("train", i);
+		t_bidib_train_state_intern train_state = {
+			.id = bidib_state_arena_strdup(id),
+			.peripherals = g_array_new(FALSE, FALSE, sizeof(t_bidib_train_peripheral_state))
+		};
+		free(id);
+		bidib_state_add_train_state(train_state);
+	}
+	bidib_state_snapshot_publish();
+}
+
+// Toggles the occupancy of the segments one by one and publishes after each
+// update, like the receive thread does after each packet
+static void *bench_updater(void *arg) {
+	unsigned long *updates = arg;
+	size_t i = 0;
+	while (atomic_load(&bench_running)) {
+		pthread_mutex_lock(&trackstate_segments_mutex);
+		t_bidib_segment_state_intern *segment_state = &g_array_index(
+				bidib_track_state.segments, t_bidib_segment_state_intern, i % SEGMENT_COUNT);
+		segment_state->occupied = !segment_state->occupied;
+		bidib_state_mark_changed(BIDIB_STATE_CATEGORY_SEGMENTS);
+		pthread_mutex_unlock(&trackstate_segments_mutex);
+		bidib_state_snapshot_publish();
+		i++;
+	}
+	*updates = i;
+	return NULL;
+}
+
+static void *bench_reader_get_state(void *arg) {
+	unsigned long *reads = arg;
+	unsigned long i = 0;
+	while (atomic_load(&bench_running)) {
+		t_bidib_track_state track_state = bidib_get_state();
+		if (track_state.segments_count != SEGMENT_COUNT) {
+			atomic_store(&bench_failed, true);
+		}
+		bidib_free_track_state(track_state);
+		i++;
+	}
+	*reads = i;
+	return NULL;
+}
+
+static void *bench_reader_snapshot(void *arg) {
+	unsigned long *reads = arg;
+	unsigned long i = 0;
+	uint64_t last_version = 0;
+	while (atomic_load(&bench_running)) {
+		const t_bidib_track_state_snapshot *snapshot = bidib_acquire_state_snapshot();
+		if (snapshot == NULL || snapshot->version < last_version ||
+		    snapshot->state.segments_count != SEGMENT_COUNT ||
+		    snapshot->state.points_board_count != POINT_COUNT) {
+			atomic_store(&bench_failed, true);
+		} else {
+			last_version = snapshot->version;
+		}
+		bidib_release_state_snapshot(snapshot);
+		i++;
+	}
+	*reads = i;
+	return NULL;
+}
+
+static void bench_run(const char *name, void *(*reader)(void *)) {
+	pthread_t updater_thread;
+	pthread_t reader_threads[READER_COUNT];
+	unsigned long updates = 0;
+	unsigned long reads[READER_COUNT];
+
+	atomic_store(&bench_running, true);
+	pthread_create(&updater_thread, NULL, bench_updater, &updates);
+	for (size_t i = 0; i < READER_COUNT; i++) {
+		pthread_create(&reader_threads[i], NULL, reader, &reads[i]);
+	}
+	struct timespec duration = {DURATION_MS / 1000, (DURATION_MS % 1000) * 1000000L};
+	nanosleep(&duration, NULL);
+	atomic_store(&bench_running, false);
+
+	unsigned long total_reads = 0;
+	for (size_t i = 0; i < READER_COUNT; i++) {
+		pthread_join(reader_threads[i], NULL);
+		total_reads += reads[i];
+	}
+	pthread_join(updater_thread, NULL);
+
+	printf("%-14s %d readers: %10.0f reads/s, updater: %8.0f updates/s\n",
+	       name, READER_COUNT, total_reads * 1000.0 / DURATION_MS,
+	       updates * 1000.0 / DURATION_MS);
+}
+
+int main(void) {
+	if (bidib_state_init(NULL)) {
+		fprintf(stderr, "Could not initialise the state\n");
+		return 1;
+	}
+	bench_populate();
+	printf("Track state with %d points, %d segments, %d peripherals, %d trains\n",
+	       POINT_COUNT, SEGMENT_COUNT, PERIPHERAL_COUNT, TRAIN_COUNT);
+
+	atomic_store(&bench_failed, false);
+	bench_run("bidib_get_state", bench_reader_get_state);
+	bench_run("snapshot", bench_reader_snapshot);
+
+	bidib_state_free();
+	if (atomic_load(&bench_failed)) {
+		printf("Readers observed an inconsistent state\n");
+		return 1;
+	}
+	return 0;
+}
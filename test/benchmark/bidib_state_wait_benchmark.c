@@ -0,0 +1,154 @@
+/*
+ *
+ * Copyright (C) 2017 University of Bamberg, Software Technologies Research Group
+ * <https://www.uni-bamberg.de/>, <http://www.swt-bamberg.de/>
+ *
+ * This file is part of the BiDiB library (libbidib), used to communicate with
+ * BiDiB <www.bidib.org> systems over a serial connection. This library was
+ * developed as part of Nicolas Gross’ student project.
+ *
+ * libbidib is licensed under the GNU GENERAL PUBLIC LICENSE (Version 3), see
+ * the LICENSE file at the project's top-level directory for details or consult
+ * <http://www.gnu.org/licenses/>.
+ *
+ * libbidib is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * libbidib is a RESEARCH PROTOTYPE and distributed WITHOUT ANY WARRANTY, without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * The following people contributed to the conception and realization of the
+ * present libbidib (in alphabetic order by surname):
+ *
+ * - Nicolas Gross <https://github.com/nicolasgross>
+ * - Bernhard Luedtke <https://github.com/BLuedtke>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "../../include/highlevel/bidib_highlevel_getter.h"
+#include "../../src/state/bidib_state_intern.h"
+#include "../../src/transmission/bidib_transmission_intern.h"
+
+
+// Measures how long it takes until a thread waiting for a point aspect notices
+// the state update, once with bidib_wait_point_state and once by polling the
+// point state the way the physical test helpers used to.
+
+#define ITERATIONS 200
+#define POLL_INTERVAL_US 10000
+#define TIMEOUT_MS 1000
+
+static const char *const bench_aspects[2] = {"normal", "reverse"};
+
+static atomic_uint bench_done;
+static atomic_bool bench_failed;
+static struct timespec bench_updated[ITERATIONS];
+static struct timespec bench_noticed[ITERATIONS];
+
+static bool bench_poll_point_state(const char *point, const char *aspect) {
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		t_bidib_unified_accessory_state_query query = bidib_get_point_state(point);
+		const bool reached = query.known &&
+		                     strcmp(query.board_accessory_state.state_id, aspect) == 0;
+		bidib_free_unified_accessory_state_query(query);
+		if (reached) {
+			return true;
+		}
+		usleep(POLL_INTERVAL_US);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while ((now.tv_sec - start.tv_sec) * 1000 +
+	         (now.tv_nsec - start.tv_nsec) / 1000000 < TIMEOUT_MS);
+	return false;
+}
+
+static void *bench_waiter(void *arg) {
+	const bool poll = *(const bool *) arg;
+	for (size_t i = 0; i < ITERATIONS; i++) {
+		const char *aspect = bench_aspects[i % 2];
+		const bool reached = poll ? bench_poll_point_state("point0", aspect)
+		                          : bidib_wait_point_state("point0", aspect, TIMEOUT_MS);
+		clock_gettime(CLOCK_MONOTONIC, &bench_noticed[i]);
+		if (!reached) {
+			atomic_store(&bench_failed, true);
+		}
+		atomic_fetch_add(&bench_done, 1);
+	}
+	return NULL;
+}
+
+// Updates the point the way the receive thread does for an accessory state message
+static void bench_update_point(const char *aspect) {
+	pthread_mutex_lock(&trackstate_accessories_mutex);
+	t_bidib_board_accessory_state *point_state = &g_array_index(
+			bidib_track_state.points_board, t_bidib_board_accessory_state, 0);
+	free(point_state->data.state_id);
+	point_state->data.state_id = strdup(aspect);
+	bidib_state_stamp(BIDIB_STATE_INDEX_POINTS_BOARD, point_state);
+	pthread_mutex_unlock(&trackstate_accessories_mutex);
+}
+
+static void bench_run(const char *name, bool poll) {
+	pthread_t waiter_thread;
+	atomic_store(&bench_done, 0);
+	pthread_create(&waiter_thread, NULL, bench_waiter, &poll);
+	for (size_t i = 0; i < ITERATIONS; i++) {
+		// Give the waiter time to block
+		usleep(2000);
+		clock_gettime(CLOCK_MONOTONIC, &bench_updated[i]);
+		bench_update_point(bench_aspects[i % 2]);
+		while (atomic_load(&bench_done) <= i) {
+			usleep(100);
+		}
+	}
+	pthread_join(waiter_thread, NULL);
+
+	double total_us = 0;
+	double max_us = 0;
+	for (size_t i = 0; i < ITERATIONS; i++) {
+		const double latency_us = (bench_noticed[i].tv_sec - bench_updated[i].tv_sec) * 1e6 +
+		                          (bench_noticed[i].tv_nsec - bench_updated[i].tv_nsec) / 1e3;
+		total_us += latency_us;
+		if (latency_us > max_us) {
+			max_us = latency_us;
+		}
+	}
+	printf("%-22s wake-up latency: mean %9.1f us, max %9.1f us\n",
+	       name, total_us / ITERATIONS, max_us);
+}
+
+int main(void) {
+	if (bidib_state_init(NULL)) {
+		fprintf(stderr, "Could not initialise the state\n");
+		return 1;
+	}
+	t_bidib_board_accessory_state point_state = {.id = strdup("point0")};
+	bidib_state_add_board_point_state(point_state);
+	// The wait functions return immediately if the library is not running
+	bidib_running = true;
+
+	atomic_store(&bench_failed, false);
+	bench_run("bidib_wait_point_state", false);
+	bench_run("poll every 10ms", true);
+
+	bidib_running = false;
+	bidib_state_free();
+	if (atomic_load(&bench_failed)) {
+		printf("A waiter did not notice an update\n");
+		return 1;
+	}
+	return 0;
+}
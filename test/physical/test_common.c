@@ -41,6 +41,7 @@
 #define SIGNAL_WAITING_TIME_S	3	   // in seconds
 #define POINT_WAITING_TIME_S	3	   // in seconds
 #define TRAIN_WAITING_TIME_US	125000 // in microseconds (0.125s)
+#define TRAIN_WAITING_LOG_MS	2000   // in milliseconds, interval of the waiting log
 
 t_bidib_id_list_query points;
 t_bidib_id_list_query signals;
@@ -82,7 +83,14 @@ t_bidib_id_list_query testsuite_filterOutIds(t_bidib_id_list_query inputIdQuery,
 	// the outputIdQuery will likely be smaller, but we don't know if the IDs 
 	// in filterOutIds are actually contained in inputIdQuery, thus theoretically
 	// the length of outputIdQuery can be that of inputIdQuery at most.
-	outputIdQuery.ids = malloc(sizeof(char *) * inputIdQuery.length);
+	// Like the queries of the library, the table and the IDs share one block,
+	// so that bidib_free_id_list_query can free it.
+	size_t size = sizeof(char *) * inputIdQuery.length;
+	for (size_t i = 0; i < inputIdQuery.length; i++) {
+		size += strlen(inputIdQuery.ids[i]) + 1;
+	}
+	outputIdQuery.ids = malloc(size);
+	char *strings = (char *) (outputIdQuery.ids + inputIdQuery.length);
 	bool isFilteredOut = false;
 	for (size_t i = 0; i < inputIdQuery.length; i++) {
 		isFilteredOut = false;
@@ -93,7 +101,8 @@ t_bidib_id_list_query testsuite_filterOutIds(t_bidib_id_list_query inputIdQuery,
 			}
 		}
 		if (!isFilteredOut) {
-			outputIdQuery.ids[outputIdQuery.length] = strdup(inputIdQuery.ids[i]);
+			outputIdQuery.ids[outputIdQuery.length] = strcpy(strings, inputIdQuery.ids[i]);
+			strings += strlen(strings) + 1;
 			outputIdQuery.length++;
 		}
 	}
@@ -243,26 +252,20 @@ void testsuite_driveTo(const char *segment, int speed, const char *train) {
 	printf("testsuite: drive %s to %s at speed %d\n", train, segment, speed);
 	bidib_set_train_speed(train, speed, "master");
 	bidib_flush();
-	t_bidib_dcc_address_query tr_dcc_addr = bidib_get_train_dcc_addr(train);
-	t_bidib_dcc_address dcc_address;
-	long counter = 0;
 	while (bidib_is_running()) {
-		t_bidib_segment_state_query seg_query = bidib_get_segment_state(segment);
-		for (size_t j = 0; j < seg_query.data.dcc_address_cnt; j++) {
-			dcc_address = seg_query.data.dcc_addresses[j];
-			if (tr_dcc_addr.dcc_address.addrh == dcc_address.addrh 
-			    &&  tr_dcc_addr.dcc_address.addrl == dcc_address.addrl) {
-				struct timespec tv;
-				clock_gettime(CLOCK_MONOTONIC, &tv);
-				bidib_free_segment_state_query(seg_query);
-				printf("testsuite: drive %s to %s at speed %d - REACHED TARGET - "
-				       "detected at time %ld.%06ld\n", 
-				       train, segment, speed, tv.tv_sec, tv.tv_nsec/1000);
-				return;
-			}
+		// Wakes up as soon as the segment state was updated
+		if (bidib_wait_segment_has_train(segment, train, TRAIN_WAITING_LOG_MS)) {
+			struct timespec tv;
+			clock_gettime(CLOCK_MONOTONIC, &tv);
+			printf("testsuite: drive %s to %s at speed %d - REACHED TARGET - "
+			       "detected at time %ld.%06ld\n", 
+			       train, segment, speed, tv.tv_sec, tv.tv_nsec/1000);
+			return;
 		}
-		if (seg_query.data.occupied) {
-			// If the segment is occupied, but the train's address hasnt been found (see loop above),
+		struct timespec tv;
+		clock_gettime(CLOCK_MONOTONIC, &tv);
+		if (testsuite_is_segment_occupied(segment)) {
+			// If the segment is occupied, but the train's address hasnt been detected,
 			// then we end up here. This is probably the case if...
 			//    a) the train ID hasn't been broadcasted on this segment yet (~0.3s delay common)
 			//    b) the train has been lost but the occupancy detection (detecting *something*)
@@ -270,23 +273,13 @@ void testsuite_driveTo(const char *segment, int speed, const char *train) {
 			// Scenario a will probably be more common and it is difficult to distinguish between 
 			// the two scenarios. For now, we just log this case and see if we learn something
 			// during test execution.
-			struct timespec tv;
-			clock_gettime(CLOCK_MONOTONIC, &tv);
 			printf("testsuite: drive %s to %s at speed %d - "
 			       "segment is occupied, but train not detected on it, time %ld.%06ld\n", 
 			       train, segment, speed, tv.tv_sec, tv.tv_nsec/1000);
 		}
-		bidib_free_segment_state_query(seg_query);
-		
-		if (counter++ % 16 == 0) {
-			struct timespec tv;
-			clock_gettime(CLOCK_MONOTONIC, &tv);
-			printf("testsuite: drive %s to %s at speed %d - "
-			       "waiting for train to arrive, time %ld.%06ld\n", 
-			       train, segment, speed, tv.tv_sec, tv.tv_nsec/1000);
-		}
-		
-		usleep(TRAIN_WAITING_TIME_US);
+		printf("testsuite: drive %s to %s at speed %d - "
+		       "waiting for train to arrive, time %ld.%06ld\n", 
+		       train, segment, speed, tv.tv_sec, tv.tv_nsec/1000);
 	}
 }
 
@@ -348,41 +341,56 @@ void testsuite_switch_point(const char *point, const char *aspect) {
 	bidib_flush();
 }
 
+// Checks whether a point is in an aspect without waiting. If report is set, the
+// reason is printed if not.
+static bool testsuite_point_has_aspect(const char *point, const char *aspect, bool report) {
+	t_bidib_unified_accessory_state_query state = bidib_get_point_state(point);
+	if (!state.known) {
+		if (report) {
+			printf("testsuite: check point aspect - unknown point %s\n", point);
+		}
+		bidib_free_unified_accessory_state_query(state);
+		return false;
+	}
+	const char *state_id = state.type == BIDIB_ACCESSORY_BOARD 
+	                       ? state.board_accessory_state.state_id 
+	                       : state.dcc_accessory_state.state_id;
+	const bool has_aspect = strcmp(state_id, aspect) == 0;
+	if (!has_aspect && report) {
+		printf("testsuite: check point aspect - point %s is in aspect %s, not in %s\n",
+		       point, state_id, aspect);
+	}
+	bidib_free_unified_accessory_state_query(state);
+	return has_aspect;
+}
+
 bool testsuite_check_point_aspect(const char *point, const char *aspect) {
 	if (point == NULL || aspect == NULL) {
 		printf("testsuite: check point aspect - invalid parameters\n");
 		return false;
 	}
-	t_bidib_unified_accessory_state_query state = bidib_get_point_state(point);
-	if (!state.known) {
-		printf("testsuite: check point aspect - unknown point %s\n", point);
-		bidib_free_unified_accessory_state_query(state);
-		return false;
+	// Returns as soon as the feedback of the point arrived
+	if (bidib_wait_point_state(point, aspect, POINT_WAITING_TIME_S * 1000)) {
+		return true;
 	}
-	if (state.type == BIDIB_ACCESSORY_BOARD) {
-		if (strcmp(state.board_accessory_state.state_id, aspect) == 0) {
-			bidib_free_unified_accessory_state_query(state);
-			return true;
-		} else {
-			printf("testsuite: check point aspect - point %s is in aspect %s, not in %s\n",
-			       point, state.board_accessory_state.state_id, aspect);
-		}
-	} else {
-		if (strcmp(state.dcc_accessory_state.state_id, aspect) == 0) {
-			bidib_free_unified_accessory_state_query(state);
-			return true;
-		} else {
-			printf("testsuite: check point aspect - point %s is in aspect %s, not in %s\n",
-			       point, state.dcc_accessory_state.state_id, aspect);
+	return testsuite_point_has_aspect(point, aspect, true);
+}
+
+static bool testsuite_points_have_aspect(const char **points, int points_len, 
+                                         const char *aspect, bool report) {
+	bool point_check = true;
+	if (points_len > 0 && points != NULL) {
+		for (int i = 0; i < points_len && (point_check || report); i++) {
+			point_check &= testsuite_point_has_aspect(points[i], aspect, report);
 		}
 	}
-	
-	bidib_free_unified_accessory_state_query(state);
-	return false;
+	return point_check;
 }
 
 bool testsuite_set_and_check_points(const char **points_normal, int points_normal_len,
                                     const char **points_reverse, int points_reverse_len) {
+	// Current change sequence number, taken before switching so that no feedback is missed
+	uint64_t seq = bidib_get_changes_since(UINT64_MAX).seq;
 	if (points_normal_len > 0 && points_normal != NULL) {
 		for (int i = 0; i < points_normal_len; i++) {
 			testsuite_switch_point(points_normal[i], "normal");
@@ -393,18 +401,31 @@ bool testsuite_set_and_check_points(const char **points_normal, int points_norma
 			testsuite_switch_point(points_reverse[i], "reverse");
 		}
 	}
-	sleep(POINT_WAITING_TIME_S);
-	bool point_check = true;
-	if (points_normal_len > 0 && points_normal != NULL) {
-		for (int i = 0; i < points_normal_len; i++) {
-			point_check &= testsuite_check_point_aspect(points_normal[i], "normal");
+	// All points switch in parallel, so they share one deadline and are rechecked
+	// whenever the state changed
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += POINT_WAITING_TIME_S;
+	while (!testsuite_points_have_aspect(points_normal, points_normal_len, "normal", false) ||
+	       !testsuite_points_have_aspect(points_reverse, points_reverse_len, "reverse", false)) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		const long remaining_ms = (deadline.tv_sec - now.tv_sec) * 1000
+		                          + (deadline.tv_nsec - now.tv_nsec) / 1000000;
+		if (remaining_ms <= 0) {
+			break;
 		}
-	}
-	if (points_reverse_len > 0 && points_reverse != NULL) {
-		for (int i = 0; i < points_reverse_len; i++) {
-			point_check &= testsuite_check_point_aspect(points_reverse[i], "reverse");
+		const uint64_t current = bidib_wait_for_changes(seq, (unsigned int) remaining_ms);
+		if (current == seq) {
+			// timeout expired or library stopped
+			break;
 		}
+		seq = current;
 	}
+	bool point_check = 
+	        testsuite_points_have_aspect(points_normal, points_normal_len, "normal", true);
+	point_check &= 
+	        testsuite_points_have_aspect(points_reverse, points_reverse_len, "reverse", true);
 	return point_check;
 }
 
@@ -467,6 +467,21 @@ static void overall_state_generated_correctly(void **state __attribute__((unused
 	assert_string_equal(track_state.reversers[0].id, "reverser");
 
 	bidib_free_track_state(track_state);
+
+	size_t required;
+	// The reservations are aligned relative to the buffer, which has to be aligned
+	// like memory from malloc
+	void *too_small = malloc(8);
+	assert_false(bidib_get_state_buf(&track_state, too_small, 8, &required));
+	assert_int_equal(required, bidib_get_state_size());
+	free(too_small);
+	void *buffer = malloc(required);
+	assert_true(bidib_get_state_buf(&track_state, buffer, required, NULL));
+	assert_int_equal(track_state.segments_count, 2);
+	assert_string_equal(track_state.segments[1].id, "seg2");
+	assert_string_equal(track_state.trains[0].id, "train1");
+	assert_null(track_state.block);
+	free(buffer);
 }
 
 int main(void) {
@@ -33,6 +33,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #include "../../include/bidib.h"
 #include "../../src/transmission/bidib_transmission_intern.h"
@@ -290,6 +291,7 @@ static void received_stall_zero_flushes_node_and_subnodes(void **state __attribu
 		// wait until stall zero is read
 	}
 	bidib_flush();
+	// messages of both nodes are drained in the same round and share a packet
 	assert_int_equal(output_buffer[163], BIDIB_PKT_MAGIC);
 	assert_int_equal(output_buffer[164], 0x05);
 	assert_int_equal(output_buffer[165], 0x01);
@@ -297,19 +299,121 @@ static void received_stall_zero_flushes_node_and_subnodes(void **state __attribu
 	assert_int_equal(output_buffer[167], 0x00);
 	assert_int_equal(output_buffer[168], 0x01);
 	assert_int_equal(output_buffer[169], MSG_SYS_GET_MAGIC);
-	// crc
-	assert_int_equal(output_buffer[171], BIDIB_PKT_MAGIC);
-	assert_int_equal(output_buffer[172], BIDIB_PKT_MAGIC);
-	assert_int_equal(output_buffer[173], 0x06);
-	assert_int_equal(output_buffer[174], 0x01);
-	assert_int_equal(output_buffer[175], 0x02);
-	assert_int_equal(output_buffer[176], 0x01);
-	assert_int_equal(output_buffer[177], 0x00);
-	assert_int_equal(output_buffer[178], 0x01);
-	assert_int_equal(output_buffer[179], MSG_SYS_GET_MAGIC);
+	assert_int_equal(output_buffer[170], 0x06);
+	assert_int_equal(output_buffer[171], 0x01);
+	assert_int_equal(output_buffer[172], 0x02);
+	assert_int_equal(output_buffer[173], 0x01);
+	assert_int_equal(output_buffer[174], 0x00);
+	assert_int_equal(output_buffer[175], 0x01);
+	assert_int_equal(output_buffer[176], MSG_SYS_GET_MAGIC);
 	// CRC sum tested extra
-	assert_int_equal(output_buffer[181], BIDIB_PKT_MAGIC);
-	assert_int_equal(output_index, 182);
+	assert_int_equal(output_buffer[178], BIDIB_PKT_MAGIC);
+	assert_int_equal(output_index, 179);
+}
+
+static void send_seqnum_wraps_around_to_one(void **state __attribute__((unused))) {
+	const uint8_t addr_stack[] = {0x05, 0x00, 0x00, 0x00};
+	for (unsigned int i = 1; i <= 255; i++) {
+		assert_int_equal(bidib_node_state_get_and_incr_send_seqnum(addr_stack), i);
+	}
+	// 0 disables the sequence check and is therefore skipped
+	assert_int_equal(bidib_node_state_get_and_incr_send_seqnum(addr_stack), 0x01);
+}
+
+static void receive_seqnum_resyncs_after_mismatch(void **state __attribute__((unused))) {
+	const uint8_t addr_stack[] = {0x06, 0x00, 0x00, 0x00};
+	assert_int_equal(bidib_node_state_sync_receive_seqnum(addr_stack, 0x01), 0x01);
+	// mismatch, expected 2 -> next expected is 6
+	assert_int_equal(bidib_node_state_sync_receive_seqnum(addr_stack, 0x05), 0x02);
+	assert_int_equal(bidib_node_state_sync_receive_seqnum(addr_stack, 0x06), 0x06);
+	// mismatch, expected 7 -> next expected is 1
+	assert_int_equal(bidib_node_state_sync_receive_seqnum(addr_stack, 0xFF), 0x07);
+	assert_int_equal(bidib_node_state_sync_receive_seqnum(addr_stack, 0x01), 0x01);
+}
+
+static void expired_queued_message_is_dropped(void **state __attribute__((unused))) {
+	const uint8_t addr_stack[] = {0x07, 0x00, 0x00, 0x00};
+	t_bidib_node_address address = {0x07, 0x00, 0x00};
+	const unsigned int prev_output_index = output_index;
+	bidib_set_message_class_ttl(BIDIB_MSG_CLASS_ACCESSORY, 1);
+	bidib_node_update_stall(addr_stack, 0x01);
+	bidib_send_accessory_set(address, 0x00, 0x01, 42);
+	usleep(5000);
+	bidib_node_update_stall(addr_stack, 0x00);
+	bidib_flush();
+	assert_int_equal(output_index, prev_output_index);
+	assert_true(bidib_is_action_id_expired(42));
+	assert_int_equal(bidib_get_message_drop_counters().dropped[BIDIB_MSG_CLASS_ACCESSORY], 1);
+	// sequence number of the dropped message is used again
+	assert_int_equal(bidib_node_state_get_and_incr_send_seqnum(addr_stack), 0x01);
+	bidib_set_message_class_ttl(BIDIB_MSG_CLASS_ACCESSORY, 0);
+}
+
+static void elapsed_time_spans_second_boundary(void **state __attribute__((unused))) {
+	const struct timespec since = {1, 999000000};
+	const struct timespec now = {2, 1000000};
+	assert_int_equal(bidib_elapsed_us(&since, &now), 2000);
+	assert_int_equal(bidib_elapsed_us(&now, &since), 0);
+}
+
+static void full_queue_coalesces_or_rejects_messages(void **state __attribute__((unused))) {
+	const uint8_t addr_stack[] = {0x08, 0x00, 0x00, 0x00};
+	t_bidib_node_address address = {0x08, 0x00, 0x00};
+	const unsigned int prev_output_index = output_index;
+	bidib_set_node_queue_limit(1);
+	bidib_node_update_stall(addr_stack, 0x01);
+	bidib_send_accessory_set(address, 0x00, 0x01, 43); // queued
+	bidib_send_accessory_set(address, 0x00, 0x02, 44); // replaces the queued one
+	bidib_send_accessory_set(address, 0x01, 0x01, 45); // rejected
+	assert_true(bidib_is_action_id_rejected(43));
+	assert_false(bidib_is_action_id_rejected(44));
+	assert_true(bidib_is_action_id_rejected(45));
+	t_bidib_node_tx_status_query status = bidib_get_node_tx_status(address);
+	assert_true(status.known);
+	assert_true(status.stall);
+	assert_int_equal(status.message_queue_length, 1);
+	assert_int_equal(status.coalesced_count, 1);
+	assert_int_equal(status.rejected_count, 1);
+	bidib_set_node_queue_limit(0);
+	bidib_node_update_stall(addr_stack, 0x00);
+	bidib_flush();
+	assert_int_equal(output_buffer[prev_output_index], BIDIB_PKT_MAGIC);
+	assert_int_equal(output_buffer[prev_output_index + 1], 0x06);
+	assert_int_equal(output_buffer[prev_output_index + 2], 0x08);
+	assert_int_equal(output_buffer[prev_output_index + 3], 0x00);
+	assert_int_equal(output_buffer[prev_output_index + 4], 0x01);
+	assert_int_equal(output_buffer[prev_output_index + 5], MSG_ACCESSORY_SET);
+	assert_int_equal(output_buffer[prev_output_index + 6], 0x00);
+	assert_int_equal(output_buffer[prev_output_index + 7], 0x02);
+	// sequence numbers of the replacing and rejected message are taken back
+	assert_int_equal(bidib_node_state_get_and_incr_send_seqnum(addr_stack), 0x02);
+	status = bidib_get_node_tx_status(address);
+	assert_false(status.stall);
+	assert_int_equal(status.message_queue_length, 0);
+	assert_int_equal(status.dequeued_count, 1);
+	assert_true(status.total_queue_wait_us >= status.max_queue_wait_us);
+}
+
+static void try_send_reports_rejected_message(void **state __attribute__((unused))) {
+	const uint8_t addr_stack[] = {0x09, 0x00, 0x00, 0x00};
+	uint8_t message[] = {0x06, 0x09, 0x00, 0x00, MSG_ACCESSORY_SET, 0x00, 0x01};
+	message[3] = bidib_node_state_get_and_incr_send_seqnum(addr_stack);
+	assert_int_equal(bidib_node_try_send(addr_stack, MSG_ACCESSORY_SET, message, 0),
+	                 BIDIB_NODE_SEND_READY);
+	bidib_add_to_buffer(message);
+	bidib_flush();
+	bidib_set_node_queue_limit(1);
+	bidib_node_update_stall(addr_stack, 0x01);
+	message[3] = bidib_node_state_get_and_incr_send_seqnum(addr_stack);
+	assert_int_equal(bidib_node_try_send(addr_stack, MSG_ACCESSORY_SET, message, 0),
+	                 BIDIB_NODE_SEND_QUEUED);
+	message[3] = bidib_node_state_get_and_incr_send_seqnum(addr_stack);
+	message[5] = 0x01;
+	assert_int_equal(bidib_node_try_send(addr_stack, MSG_ACCESSORY_SET, message, 0),
+	                 BIDIB_NODE_SEND_REJECTED);
+	bidib_set_node_queue_limit(0);
+	bidib_node_update_stall(addr_stack, 0x00);
+	bidib_flush();
 }
 
 int main(void) {
@@ -330,7 +434,13 @@ int main(void) {
 		cmocka_unit_test(crc_sums_are_correct),
 		cmocka_unit_test(queued_messages_sent_if_capacity_free_again),
 		cmocka_unit_test(received_stall_one_blocks_node_and_subnodes),
-		cmocka_unit_test(received_stall_zero_flushes_node_and_subnodes)
+		cmocka_unit_test(received_stall_zero_flushes_node_and_subnodes),
+		cmocka_unit_test(send_seqnum_wraps_around_to_one),
+		cmocka_unit_test(receive_seqnum_resyncs_after_mismatch),
+		cmocka_unit_test(expired_queued_message_is_dropped),
+		cmocka_unit_test(elapsed_time_spans_second_boundary),
+		cmocka_unit_test(full_queue_coalesces_or_rejects_messages),
+		cmocka_unit_test(try_send_reports_rejected_message)
 	};
 	int ret = cmocka_run_group_tests(tests, NULL, NULL);
 	syslog_libbidib(LOG_INFO, "bidib_send_tests: %s", "Send tests stopped");
@@ -30,15 +30,25 @@
 #include <stddef.h>
 #include <setjmp.h>
 #include <cmocka.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "../../include/bidib.h"
 #include "../../include/definitions/bidib_definitions_custom.h"
+#include "../../src/state/bidib_state_intern.h"
+#include "../../src/state/bidib_state_setter_intern.h"
 #include "../../src/transmission/bidib_transmission_intern.h"
 
-
+static char server_dir[] = "/tmp/bidib_state_tests.XXXXXX";
+static char server_path[sizeof(server_dir) + 16];
+static char export_name[64];
 static uint8_t input_buffer[128];
 static uint8_t output_buffer[256];
 static volatile bool wait_for_accessory_change = true;
@@ -273,7 +283,8 @@ static void accessory_state_change_updates_state_correctly(void **state __attrib
 	assert_int_equal(query.board_accessory_state.state_value, 0x00);
 	assert_int_equal(query.board_accessory_state.execution_state, BIDIB_EXEC_STATE_REACHED);
 	wait_for_accessory_change = false;
-	usleep(100000);
+	assert_true(bidib_wait_point_state("point1", "normal", 1000));
+	assert_false(bidib_wait_point_state("point1", "reverse", 10));
 	bidib_free_unified_accessory_state_query(query);
 	query = bidib_get_point_state("point1");
 	assert_int_equal(query.known, true);
@@ -282,6 +293,19 @@ static void accessory_state_change_updates_state_correctly(void **state __attrib
 	assert_int_equal(query.board_accessory_state.state_value, 0x01);
 	assert_int_equal(query.board_accessory_state.execution_state, BIDIB_EXEC_STATE_REACHED_VERIFIED);
 	bidib_free_unified_accessory_state_query(query);
+	char state_id[8];
+	assert_true(bidib_get_point_state_buf("point1", &query, state_id, sizeof(state_id)));
+	assert_int_equal(query.type, BIDIB_ACCESSORY_BOARD);
+	assert_ptr_equal(query.board_accessory_state.state_id, state_id);
+	assert_string_equal(state_id, "normal");
+	assert_int_equal(query.board_accessory_state.state_value, 0x01);
+	const char *const points[] = {"point1", "unknown"};
+	t_bidib_unified_accessory_state_list_query states = bidib_get_point_states(points, 2);
+	assert_int_equal(states.length, 2);
+	assert_int_equal(states.states[0].known, true);
+	assert_string_equal(states.states[0].board_accessory_state.state_id, "normal");
+	assert_int_equal(states.states[1].known, false);
+	bidib_free_unified_accessory_state_list_query(states);
 }
 
 static void peripheral_state_change_updates_state_correctly(void **state __attribute__((unused))) {
@@ -303,6 +327,13 @@ static void peripheral_state_change_updates_state_correctly(void **state __attri
 	bidib_free_peripheral_state_query(query);
 }
 
+static void count_segment_addresses(const char *id, const t_bidib_segment_state_data *data,
+                                    void *ctx) {
+	assert_string_equal(id, "seg1");
+	assert_int_equal(data->occupied, true);
+	*(size_t *) ctx = data->dcc_address_cnt;
+}
+
 static void occupancy_detection_updates_state_correctly(void **state __attribute__((unused))) {
 	t_bidib_segment_state_query query = bidib_get_segment_state("seg1");
 	assert_int_equal(query.known, true);
@@ -313,8 +344,50 @@ static void occupancy_detection_updates_state_correctly(void **state __attribute
 	assert_int_equal(query.data.confidence.conf_void, false);
 	assert_int_equal(query.data.confidence.nosignal, false);
 	bidib_free_segment_state_query(query);
+	t_bidib_track_state_changes changes = bidib_get_changes_since(0);
+	assert_true(changes.seq > 0);
+	const uint64_t seq_before = changes.seq;
+	bidib_free_track_state_changes(changes);
+	const t_bidib_track_state_snapshot *snapshot_before = bidib_acquire_state_snapshot();
+	assert_non_null(snapshot_before);
+	struct timespec before_packet;
+	clock_gettime(CLOCK_MONOTONIC, &before_packet);
 	wait_for_occupancy_change = false;
 	usleep(100000);
+	changes = bidib_get_changes_since(seq_before);
+	assert_true(changes.seq > seq_before);
+	bool seg1_changed = false;
+	for (size_t i = 0; i < changes.state.segments_count; i++) {
+		seg1_changed |= strcmp(changes.state.segments[i].id, "seg1") == 0;
+	}
+	assert_true(seg1_changed);
+	// Only the segments and trains were modified
+	assert_int_equal(changes.state.peripherals_count, 0);
+	assert_int_equal(changes.state.points_board_count, 0);
+	bidib_free_track_state_changes(changes);
+	const t_bidib_track_state_snapshot *snapshot_after = bidib_acquire_state_snapshot();
+	assert_non_null(snapshot_after);
+	assert_true(snapshot_after->version > snapshot_before->version);
+	size_t seg1_index = bidib_get_segment_state_index("seg1");
+	assert_int_equal(snapshot_before->state.segments[seg1_index].data.occupied, false);
+	assert_int_equal(snapshot_after->state.segments[seg1_index].data.occupied, true);
+	assert_int_equal(snapshot_after->state.segments[seg1_index].data.dcc_address_cnt, 2);
+	// Unmodified categories are shared between the snapshots
+	assert_ptr_equal(snapshot_before->state.peripherals, snapshot_after->state.peripherals);
+	bidib_release_state_snapshot(snapshot_before);
+	bidib_release_state_snapshot(snapshot_after);
+	t_bidib_board_occupancy_query occupancy = bidib_get_board_occupancy("board1");
+	assert_int_equal(occupancy.known, true);
+	assert_true(occupancy.occupied[0] & 0x01);
+	assert_false(occupancy.occupied[0] & 0x06);
+	t_bidib_id_list_query occupied_segments = bidib_get_occupied_segments();
+	assert_int_equal(occupied_segments.length, 1);
+	assert_string_equal(occupied_segments.ids[0], "seg1");
+	bidib_free_id_list_query(occupied_segments);
+	t_bidib_id_ref_list_query occupied_segments_ref = bidib_get_occupied_segments_ref();
+	assert_int_equal(occupied_segments_ref.length, 1);
+	assert_string_equal(occupied_segments_ref.ids[0], "seg1");
+	bidib_free_id_ref_list_query(occupied_segments_ref);
 	query = bidib_get_segment_state("seg1");
 	assert_int_equal(query.known, true);
 	assert_int_equal(query.data.occupied, true);
@@ -329,7 +402,18 @@ static void occupancy_detection_updates_state_correctly(void **state __attribute
 	assert_int_equal(query.data.confidence.freeze, true);
 	assert_int_equal(query.data.confidence.conf_void, true);
 	assert_int_equal(query.data.confidence.nosignal, true);
+	// The occupancy records when the packet that reported it was received
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	assert_true(query.received_ns >= (uint64_t) before_packet.tv_sec * 1000000000ULL +
+	                                 (uint64_t) before_packet.tv_nsec);
+	assert_true(query.received_ns <= (uint64_t) now.tv_sec * 1000000000ULL +
+	                                 (uint64_t) now.tv_nsec);
 	bidib_free_segment_state_query(query);
+	t_bidib_train_position_query position_query = bidib_get_train_position("train2");
+	assert_int_equal(position_query.length, 1);
+	assert_string_equal(position_query.segments[0], "seg1");
+	bidib_free_train_position_query(position_query);
 	wait_for_second_occupancy_change = false;
 	usleep(100000);
 	query = bidib_get_segment_state("seg1");
@@ -345,6 +429,53 @@ static void occupancy_detection_updates_state_correctly(void **state __attribute
 	assert_int_equal(query.data.confidence.conf_void, true);
 	assert_int_equal(query.data.confidence.nosignal, true);
 	bidib_free_segment_state_query(query);
+	position_query = bidib_get_train_position("train1");
+	assert_int_equal(position_query.length, 1);
+	assert_string_equal(position_query.segments[0], "seg1");
+	bidib_free_train_position_query(position_query);
+	position_query = bidib_get_train_position("train2");
+	assert_int_equal(position_query.length, 0);
+	bidib_free_train_position_query(position_query);
+	size_t visited_address_cnt = 0;
+	assert_true(bidib_visit_segment_state("seg1", count_segment_addresses, &visited_address_cnt));
+	assert_int_equal(visited_address_cnt, 1);
+	assert_false(bidib_visit_segment_state("unknown", count_segment_addresses, NULL));
+	t_bidib_segment_state_data segment_data;
+	t_bidib_dcc_address dcc_addresses[4];
+	assert_true(bidib_get_segment_state_buf("seg1", &segment_data, dcc_addresses, 4));
+	assert_int_equal(segment_data.dcc_address_cnt, 1);
+	assert_ptr_equal(segment_data.dcc_addresses, dcc_addresses);
+	assert_int_equal(dcc_addresses[0].addrl, 0x23);
+	assert_int_equal(dcc_addresses[0].addrh, 0x01);
+	t_bidib_train_state_query train_query = bidib_get_train_state("train2");
+	assert_int_equal(train_query.known, true);
+	assert_int_equal(train_query.data.on_track, false);
+	bidib_free_train_state_query(train_query);
+	const char *const segments[] = {"seg1", "unknown", "seg2"};
+	t_bidib_segment_state_list_query segment_states = bidib_get_segment_states(segments, 3);
+	assert_int_equal(segment_states.length, 3);
+	assert_int_equal(segment_states.states[0].known, true);
+	assert_int_equal(segment_states.states[0].data.occupied, true);
+	assert_int_equal(segment_states.states[0].data.dcc_address_cnt, 1);
+	assert_int_equal(segment_states.states[0].data.dcc_addresses[0].addrl, 0x23);
+	assert_int_equal(segment_states.states[1].known, false);
+	assert_int_equal(segment_states.states[2].known, true);
+	assert_int_equal(segment_states.states[2].data.occupied, false);
+	bidib_free_segment_state_list_query(segment_states);
+	const char *const trains[] = {"train1", "train2"};
+	t_bidib_train_state_list_query train_states = bidib_get_train_states(trains, 2);
+	assert_int_equal(train_states.length, 2);
+	assert_int_equal(train_states.states[0].known, true);
+	assert_int_equal(train_states.states[0].data.on_track, true);
+	assert_int_equal(train_states.states[1].known, true);
+	assert_int_equal(train_states.states[1].data.on_track, false);
+	bidib_free_train_state_list_query(train_states);
+	t_bidib_train_position_list_query positions = bidib_get_train_positions_all();
+	assert_int_equal(positions.length, 1);
+	assert_string_equal(positions.trains[0], "train1");
+	assert_int_equal(positions.positions[0].length, 1);
+	assert_string_equal(positions.positions[0].segments[0], "seg1");
+	bidib_free_train_position_list_query(positions);
 }
 
 static void cs_drive_and_ack_updates_state_correctly(void **state __attribute__((unused))) {
@@ -395,8 +526,362 @@ static void reverser_updates_state_correctly(void **state __attribute__((unused)
 	bidib_free_reverser_state_query(reverser_state);
 }
 
+static void set_point1_state(uint8_t aspect) {
+	const t_bidib_node_address board1 = {0x00, 0x00, 0x00};
+	bidib_state_accessory_state(board1, 0x02, aspect, 0x02, 0x00, 0x00, 0);
+}
+
+static void assert_point1_state(const char *aspect) {
+	t_bidib_unified_accessory_state_query query = bidib_get_point_state("point1");
+	assert_true(query.known);
+	assert_string_equal(query.board_accessory_state.state_id, aspect);
+	bidib_free_unified_accessory_state_query(query);
+}
+
+static bool receive_all(int fd, void *data, size_t size) {
+	size_t received = 0;
+	while (received < size) {
+		const ssize_t n = recv(fd, (uint8_t *) data + received, size - received, 0);
+		if (n <= 0) {
+			return false;
+		}
+		received += (size_t) n;
+	}
+	return true;
+}
+
+static int connect_state_server(void) {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, server_path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert_true(fd != -1);
+	assert_int_equal(connect(fd, (struct sockaddr *) &address, sizeof(address)), 0);
+	struct timeval timeout = {2, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	return fd;
+}
+
+static void state_server_sends_snapshot_of_state(void **state __attribute__((unused))) {
+	int fd = connect_state_server();
+
+	t_bidib_server_record record;
+	t_bidib_server_hello hello;
+	assert_true(receive_all(fd, &record, sizeof(record)));
+	assert_int_equal(record.type, BIDIB_SERVER_HELLO);
+	assert_int_equal(record.size, sizeof(hello));
+	assert_true(receive_all(fd, &hello, sizeof(hello)));
+	assert_int_equal(hello.version, BIDIB_SERVER_VERSION);
+	assert_true(hello.segment_count > 0);
+
+	char **segment_ids = calloc(hello.segment_count, sizeof(char *));
+	size_t segments_checked = 0;
+	uint8_t payload[256];
+	while (true) {
+		assert_true(receive_all(fd, &record, sizeof(record)));
+		assert_true(record.size <= sizeof(payload));
+		assert_true(receive_all(fd, payload, record.size));
+		if (record.type == BIDIB_SERVER_SYNC) {
+			break;
+		} else if (record.kind != BIDIB_EXPORT_SEGMENTS) {
+			continue;
+		}
+		assert_true(record.position < hello.segment_count);
+		if (record.type == BIDIB_SERVER_ID) {
+			segment_ids[record.position] = strdup((const char *) payload);
+		} else if (record.type == BIDIB_SERVER_ENTRY) {
+			// The ids are sent before the entries
+			assert_non_null(segment_ids[record.position]);
+			t_bidib_segment_state_query segment_state =
+					bidib_get_segment_state(segment_ids[record.position]);
+			assert_true(segment_state.known);
+			assert_int_equal(payload[0], segment_state.data.occupied);
+			bidib_free_segment_state_query(segment_state);
+			segments_checked++;
+		}
+	}
+	assert_int_equal(segments_checked, hello.segment_count);
+	for (size_t i = 0; i < hello.segment_count; i++) {
+		free(segment_ids[i]);
+	}
+	free(segment_ids);
+	close(fd);
+}
+
+static void state_server_sends_changes_after_snapshot(void **state __attribute__((unused))) {
+	int fd = connect_state_server();
+	t_bidib_server_record record;
+	uint8_t payload[256];
+	uint64_t snapshot_seq = 0;
+	int64_t point1_position = -1;
+	do {
+		assert_true(receive_all(fd, &record, sizeof(record)));
+		assert_true(record.size <= sizeof(payload));
+		assert_true(receive_all(fd, payload, record.size));
+		if (record.type == BIDIB_SERVER_ID && record.kind == BIDIB_EXPORT_POINTS &&
+		    strcmp((const char *) payload, "point1") == 0) {
+			point1_position = record.position;
+		} else if (record.type == BIDIB_SERVER_SYNC) {
+			memcpy(&snapshot_seq, payload, sizeof(snapshot_seq));
+		}
+	} while (record.type != BIDIB_SERVER_SYNC);
+	assert_true(point1_position >= 0);
+	assert_point1_state("normal");
+
+	set_point1_state(0x00); // reverse
+	bool point1_sent = false;
+	uint64_t delta_seq = 0;
+	do {
+		assert_true(receive_all(fd, &record, sizeof(record)));
+		assert_true(record.size <= sizeof(payload));
+		assert_true(receive_all(fd, payload, record.size));
+		// Deltas consist of entries only, the ids are only part of the snapshot
+		assert_true(record.type == BIDIB_SERVER_ENTRY || record.type == BIDIB_SERVER_SYNC);
+		if (record.type == BIDIB_SERVER_ENTRY && record.kind == BIDIB_EXPORT_POINTS &&
+		    record.position == point1_position) {
+			t_bidib_export_accessory accessory;
+			assert_int_equal(record.size, sizeof(accessory));
+			memcpy(&accessory, payload, sizeof(accessory));
+			// reverse is the second aspect of point1
+			assert_int_equal(accessory.aspect, 1);
+			point1_sent = true;
+		} else if (record.type == BIDIB_SERVER_SYNC) {
+			memcpy(&delta_seq, payload, sizeof(delta_seq));
+		}
+	} while (!point1_sent || record.type != BIDIB_SERVER_SYNC);
+	assert_true(delta_seq > snapshot_seq);
+	close(fd);
+}
+
+static void state_export_matches_getters(void **state __attribute__((unused))) {
+	t_bidib_export_reader *reader = bidib_export_open(export_name);
+	assert_non_null(reader);
+	const t_bidib_export_header *header = bidib_export_header(reader);
+	assert_true(header->segment_count > 0);
+	assert_true(header->point_count > 0);
+	// The export thread publishes the changes asynchronously
+	const uint64_t change_seq = bidib_get_changes_since(UINT64_MAX).seq;
+	t_bidib_export_image image;
+	for (int i = 0; i < 100; i++) {
+		assert_true(bidib_export_read(reader, &image));
+		if (image.change_seq >= change_seq) {
+			break;
+		}
+		usleep(10000);
+	}
+	assert_true(image.change_seq >= change_seq);
+
+	for (size_t i = 0; i < header->segment_count; i++) {
+		const char *id = bidib_export_id(reader, BIDIB_EXPORT_SEGMENTS, i);
+		assert_non_null(id);
+		t_bidib_segment_state_query segment_state = bidib_get_segment_state(id);
+		assert_true(segment_state.known);
+		const bool occupied = (image.occupied[i / 64] >> (i % 64)) & 1;
+		assert_int_equal(occupied, segment_state.data.occupied);
+		bidib_free_segment_state_query(segment_state);
+	}
+	for (size_t i = 0; i < header->point_count; i++) {
+		const char *id = bidib_export_id(reader, BIDIB_EXPORT_POINTS, i);
+		assert_non_null(id);
+		t_bidib_unified_accessory_state_query point_state = bidib_get_point_state(id);
+		assert_true(point_state.known);
+		if (point_state.type == BIDIB_ACCESSORY_BOARD) {
+			assert_int_equal(image.points[i].execution_state,
+			                 point_state.board_accessory_state.execution_state);
+		} else {
+			assert_int_equal(image.points[i].execution_state, 0xFF);
+		}
+		bidib_free_unified_accessory_state_query(point_state);
+	}
+	for (size_t i = 0; i < header->train_count; i++) {
+		const char *id = bidib_export_id(reader, BIDIB_EXPORT_TRAINS, i);
+		assert_non_null(id);
+		t_bidib_train_state_query train_state = bidib_get_train_state(id);
+		assert_true(train_state.known);
+		assert_int_equal(image.trains[i].on_track, train_state.data.on_track);
+		bidib_free_train_state_query(train_state);
+	}
+	assert_null(bidib_export_id(reader, BIDIB_EXPORT_SEGMENTS, header->segment_count));
+	bidib_export_close(reader);
+}
+
+static void memory_stats_account_library_structures(void **state __attribute__((unused))) {
+	t_bidib_memory_stats stats = bidib_get_memory_stats();
+	const t_bidib_memory_usage *config = &stats.subsystems[BIDIB_MEMORY_CONFIG];
+	const t_bidib_memory_usage *track_state = &stats.subsystems[BIDIB_MEMORY_TRACK_STATE];
+	const t_bidib_memory_usage *indexes = &stats.subsystems[BIDIB_MEMORY_INDEXES];
+	const t_bidib_memory_usage *snapshots = &stats.subsystems[BIDIB_MEMORY_SNAPSHOTS];
+	assert_true(config->bytes > 0);
+	// Arena blocks and the arrays of the boards, mappings and aspects
+	assert_true(config->objects > bidib_boards->len);
+	assert_true(track_state->objects > 0);
+	assert_true(indexes->objects > 0);
+	// The snapshot published at startup with its blocks
+	assert_true(snapshots->objects > 1);
+	assert_true(snapshots->bytes > 0);
+	assert_true(stats.subsystems[BIDIB_MEMORY_NODE_STATES].objects > 0);
+	// All received messages were handled, none of them is left over
+	assert_int_equal(stats.subsystems[BIDIB_MEMORY_RECEIVED_MESSAGES].objects, 0);
+	assert_int_equal(stats.subsystems[BIDIB_MEMORY_RECEIVED_MESSAGES].bytes, 0);
+	assert_true(stats.subsystems[BIDIB_MEMORY_RECEIVED_MESSAGES].max_objects > 0);
+	assert_true(stats.total_bytes >= config->bytes + track_state->bytes + indexes->bytes +
+	                                 snapshots->bytes);
+
+	bidib_reset_memory_high_water_marks();
+	stats = bidib_get_memory_stats();
+	assert_int_equal(stats.subsystems[BIDIB_MEMORY_RECEIVED_MESSAGES].max_objects, 0);
+	assert_int_equal(stats.subsystems[BIDIB_MEMORY_CONFIG].max_bytes,
+	                 stats.subsystems[BIDIB_MEMORY_CONFIG].bytes);
+}
+
+static void state_file_restores_stored_states(void **state __attribute__((unused))) {
+	char dir[] = "/tmp/bidib_state_tests.XXXXXX";
+	assert_non_null(mkdtemp(dir));
+	char path[sizeof(dir) + 16];
+	snprintf(path, sizeof(path), "%s/state", dir);
+	bidib_state_persist_set_path(path);
+
+	// A new file is not valid for the configs until it was written
+	bidib_state_persist_open();
+	assert_false(bidib_state_persist_restore());
+	set_point1_state(0x00); // reverse
+	bidib_state_persist_close();
+
+	// Round trip
+	set_point1_state(0x01); // normal, not stored
+	bidib_state_persist_open();
+	assert_true(bidib_state_persist_restore());
+	assert_point1_state("reverse");
+	// Only a report of the board after the restore lets the initial value be skipped
+	const uint64_t restore_seq = bidib_state_get_change_seq();
+	const t_bidib_state_initial_value reverse = {"point1", "reverse"};
+	assert_false(bidib_state_initial_value_reached(BIDIB_STATE_INDEX_POINTS_BOARD, &reverse,
+	                                               restore_seq));
+	set_point1_state(0x00);
+	assert_true(bidib_state_initial_value_reached(BIDIB_STATE_INDEX_POINTS_BOARD, &reverse,
+	                                              restore_seq));
+	bidib_state_persist_close();
+
+	// Written for other configs
+	int fd = open(path, O_RDWR);
+	assert_true(fd != -1);
+	const uint64_t other_config_hash = 42;
+	assert_int_equal(pwrite(fd, &other_config_hash, sizeof(other_config_hash), 8),
+	                 sizeof(other_config_hash));
+	close(fd);
+	set_point1_state(0x01);
+	bidib_state_persist_open();
+	assert_false(bidib_state_persist_restore());
+	assert_point1_state("normal");
+	set_point1_state(0x00);
+	bidib_state_persist_close();
+
+	// Corrupt
+	fd = open(path, O_RDWR);
+	assert_true(fd != -1);
+	const uint64_t corrupt_magic = 0;
+	assert_int_equal(pwrite(fd, &corrupt_magic, sizeof(corrupt_magic), 0),
+	                 sizeof(corrupt_magic));
+	close(fd);
+	set_point1_state(0x01);
+	bidib_state_persist_open();
+	assert_false(bidib_state_persist_restore());
+	assert_point1_state("normal");
+	set_point1_state(0x00);
+	bidib_state_persist_close();
+
+	// Truncated
+	assert_int_equal(truncate(path, 12), 0);
+	set_point1_state(0x01);
+	bidib_state_persist_open();
+	assert_false(bidib_state_persist_restore());
+	assert_point1_state("normal");
+	bidib_state_persist_close();
+
+	bidib_state_persist_set_path(NULL);
+	unlink(path);
+	rmdir(dir);
+}
+
+static void route_is_set_and_tracked(void **state __attribute__((unused))) {
+	const t_bidib_route_element invalid[] = {
+		{BIDIB_ROUTE_ELEMENT_POINT, "point2", "reverse"},
+		{BIDIB_ROUTE_ELEMENT_SIGNAL, "signal1", "blue"}
+	};
+	t_bidib_unified_accessory_state_query point_state = bidib_get_point_state("point2");
+	assert_true(point_state.known);
+	char *state_id = strdup(point_state.dcc_accessory_state.state_id);
+	bidib_free_unified_accessory_state_query(point_state);
+	assert_int_equal(bidib_set_route(invalid, 2), 0);
+	// Nothing is set if an element is invalid
+	point_state = bidib_get_point_state("point2");
+	assert_string_equal(point_state.dcc_accessory_state.state_id, state_id);
+	bidib_free_unified_accessory_state_query(point_state);
+	free(state_id);
+
+	// DCC points report no state, so a route of only DCC points is complete once sent
+	const t_bidib_route_element dcc_route[] = {{BIDIB_ROUTE_ELEMENT_POINT, "point2", "reverse"}};
+	unsigned int route = bidib_set_route(dcc_route, 1);
+	assert_true(route != 0);
+	assert_int_equal(bidib_wait_route(route, 100), BIDIB_ROUTE_COMPLETE);
+	point_state = bidib_get_point_state("point2");
+	assert_string_equal(point_state.dcc_accessory_state.state_id, "reverse");
+	bidib_free_unified_accessory_state_query(point_state);
+	bidib_free_route(route);
+	assert_int_equal(bidib_get_route_status(route), BIDIB_ROUTE_UNKNOWN);
+
+	// An element may only be contained once
+	const t_bidib_route_element duplicate[] = {
+		{BIDIB_ROUTE_ELEMENT_POINT, "point1", "normal"},
+		{BIDIB_ROUTE_ELEMENT_POINT, "point2", "normal"},
+		{BIDIB_ROUTE_ELEMENT_POINT, "point1", "reverse"}
+	};
+	assert_int_equal(bidib_set_route(duplicate, 3), 0);
+
+	// The board elements are awaited until they report their aspect as reached
+	const t_bidib_node_address board1 = {0x00, 0x00, 0x00};
+	const t_bidib_route_element board_route[] = {
+		{BIDIB_ROUTE_ELEMENT_POINT, "point1", "reverse"},
+		{BIDIB_ROUTE_ELEMENT_SIGNAL, "signal1", "green"},
+		{BIDIB_ROUTE_ELEMENT_POINT, "point2", "normal"}
+	};
+	route = bidib_set_route(board_route, 3);
+	assert_true(route != 0);
+	assert_int_equal(bidib_get_route_status(route), BIDIB_ROUTE_PENDING);
+	// MSG_ACCESSORY_STATE: point1 is switching
+	bidib_state_accessory_state(board1, 0x02, 0x00, 0x02, 0x01, 0x00, 0);
+	assert_int_equal(bidib_get_route_status(route), BIDIB_ROUTE_PENDING);
+	// MSG_ACCESSORY_NOTIFY: point1 reached reverse
+	bidib_state_accessory_state(board1, 0x02, 0x00, 0x02, 0x00, 0x00, 0);
+	assert_int_equal(bidib_get_route_status(route), BIDIB_ROUTE_PENDING);
+	// MSG_ACCESSORY_STATE: signal1 reached green
+	bidib_state_accessory_state(board1, 0x10, 0x02, 0x03, 0x00, 0x00, 0);
+	assert_int_equal(bidib_wait_route(route, 100), BIDIB_ROUTE_COMPLETE);
+	bidib_free_route(route);
+
+	// A board element that reports an error fails the route
+	const t_bidib_route_element failing_route[] = {
+		{BIDIB_ROUTE_ELEMENT_POINT, "point1", "normal"}
+	};
+	route = bidib_set_route(failing_route, 1);
+	assert_true(route != 0);
+	assert_int_equal(bidib_get_route_status(route), BIDIB_ROUTE_PENDING);
+	bidib_state_accessory_state(board1, 0x02, 0x00, 0x02, BIDIB_ACC_STATE_ERROR,
+	                            BIDIB_ACC_STATE_ERROR_POSITION, 0);
+	assert_int_equal(bidib_wait_route(route, 100), BIDIB_ROUTE_FAILED);
+	bidib_free_route(route);
+}
+
 int main(void) {
 	test_setup();
+	if (mkdtemp(server_dir) == NULL) {
+		return 1;
+	}
+	snprintf(server_path, sizeof(server_path), "%s/state.sock", server_dir);
+	bidib_set_state_server(server_path);
+	snprintf(export_name, sizeof(export_name), "/bidib_state_tests_%d", (int) getpid());
+	bidib_set_state_export(export_name);
 	bidib_start_pointer(&read_byte, &write_bytes, "../test/unit/state_tests_config", 250);
 	syslog_libbidib(LOG_INFO, "bidib_state_tests: %s", "State tests started");
 	const struct CMUnitTest tests[] = {
@@ -406,10 +891,18 @@ int main(void) {
 		cmocka_unit_test(peripheral_state_change_updates_state_correctly),
 		cmocka_unit_test(occupancy_detection_updates_state_correctly),
 		cmocka_unit_test(cs_drive_and_ack_updates_state_correctly),
-		cmocka_unit_test(reverser_updates_state_correctly)
+		cmocka_unit_test(reverser_updates_state_correctly),
+		cmocka_unit_test(state_server_sends_snapshot_of_state),
+		cmocka_unit_test(state_server_sends_changes_after_snapshot),
+		cmocka_unit_test(state_export_matches_getters),
+		cmocka_unit_test(memory_stats_account_library_structures),
+		cmocka_unit_test(state_file_restores_stored_states),
+		cmocka_unit_test(route_is_set_and_tracked)
 	};
 	int ret = cmocka_run_group_tests(tests, NULL, NULL);
 	syslog_libbidib(LOG_INFO, "bidib_state_tests: %s", "State tests stopped");
 	bidib_stop();
+	// The server removes its socket when the library is stopped
+	rmdir(server_dir);
 	return ret;
 }